@@ -1,3 +1,35 @@
-from ._aynime_capture import Session, Snapshot, set_log_handle
+﻿from ._aynime_capture import (
+    Session,
+    Snapshot,
+    ArchiveSnapshot,
+    Subscription,
+    SharedRingPublisher,
+    Y4MStream,
+    set_log_handle,
+    set_capture_thread_count,
+    get_capture_thread_loads,
+    configure_thread_pool,
+    get_thread_pool_stats,
+    configure_host_arena,
+    get_host_arena_stats,
+    set_memory_budget,
+    get_memory_usage,
+)
 
-__all__ = ["Session", "Snapshot", "set_log_handle"]
+__all__ = [
+    "Session",
+    "Snapshot",
+    "ArchiveSnapshot",
+    "Subscription",
+    "SharedRingPublisher",
+    "Y4MStream",
+    "set_log_handle",
+    "set_capture_thread_count",
+    "get_capture_thread_loads",
+    "configure_thread_pool",
+    "get_thread_pool_stats",
+    "configure_host_arena",
+    "get_host_arena_stats",
+    "set_memory_budget",
+    "get_memory_usage",
+]
@@ -1,6 +1,7 @@
-# aynime_capture/__init__.pyi
+﻿# aynime_capture/__init__.pyi
 
-from typing import Optional
+import asyncio
+from typing import Any, Callable, Literal, Optional, Union
 
 def set_log_handle(handle: int) -> None:
     """ログ出力を設定する
@@ -10,11 +11,114 @@ def set_log_handle(handle: int) -> None:
     """
     ...
 
+def set_capture_thread_count(count: int) -> None:
+    """キャプチャスレッドの最大本数を設定する
+
+    キャプチャスレッドは全セッションで共有され、
+    新しいセッションは担当セッション数が最も少ないスレッドに割り当てられる。
+    設定は以降に開始したセッションから反映される。
+
+    Args:
+        count: キャプチャスレッドの最大本数。
+    """
+    ...
+
+def get_capture_thread_loads() -> list[int]:
+    """稼働中のキャプチャスレッドごとの担当セッション数を取得する"""
+    ...
+
+def configure_thread_pool(
+    num_workers: Optional[int] = None,
+    affinity_mask: Optional[int] = None,
+) -> None:
+    """ネイティブの CPU 処理を分担するワーカースレッドプールを設定する
+
+    変換・縮小・圧縮・書き出し等の CPU 処理は、全セッションで共有する１つのプール上で行う。
+    プールは最初の読み出しで起動し、起動後に呼ぶとエラーになる。
+
+    Args:
+        num_workers: ワーカー数。None なら論理コア数 - 1 (最低 1)。
+        affinity_mask: 全ワーカーを固定するコアのビットマスク (ビット i が論理コア i)。None なら OS 任せ。
+    """
+    ...
+
+def get_thread_pool_stats() -> dict[str, Any]:
+    """ワーカースレッドプールの統計を取得する
+
+    まだ起動していなければ起動する。
+
+    Returns:
+        {"num_workers": ワーカー数,
+         "queue_depths": ワーカーごとの積まれている仕事の数のリスト,
+         "queued": {"interactive": ..., "bulk": ...} 優先度ごとの積まれている仕事の数,
+         "executed": 実行した仕事の数の累計,
+         "steals": 他のワーカーのキューから取った仕事の数の累計}
+
+    GetFrameByTime 等の呼び出し元が結果を待つ処理は interactive、
+    スナップショット・書き出し等は bulk として積まれ、interactive が先に実行される。
+    """
+    ...
+
+def configure_host_arena(
+    large_pages: Optional[bool] = None,
+    max_pooled_bytes: Optional[int] = None,
+) -> None:
+    """スナップショットの読み出し結果を置くホストメモリのアリーナを設定する
+
+    スナップショット１つ分の読み出し結果は、ページ境界に揃えた１つのアリーナにまとめて置かれる。
+    使い終わったアリーナは取っておき、同じ大きさのスナップショットで使い回す。
+
+    Args:
+        large_pages: True なら以降のアリーナを大きいページで確保する。
+            SeLockMemoryPrivilege が無い場合は通常のページで確保する。None なら変えない。
+        max_pooled_bytes: 使い回すために取っておくアリーナの合計サイズの上限。None なら変えない。
+    """
+    ...
+
+def get_host_arena_stats() -> dict[str, Any]:
+    """ホストメモリのアリーナの統計を取得する
+
+    Returns:
+        {"pooled_arenas": 取っておいているアリーナの数,
+         "pooled_bytes": 取っておいているアリーナの合計サイズ,
+         "created": 生成したアリーナの数の累計,
+         "reused": 使い回したアリーナの数の累計,
+         "large_page_arenas": 大きいページで確保できたアリーナの数の累計}
+    """
+    ...
+
+def set_memory_budget(budget_in_bytes: Optional[int]) -> None:
+    """全セッション合計のフレームバッファ用メモリ予算を設定する
+
+    合計使用量が予算を超えると、weight の小さいセッションから順に
+    古いフレームが破棄される。ただし各セッションの min_duration_in_sec ぶんは破棄されない。
+
+    Args:
+        budget_in_bytes: 予算のバイト数。None なら予算なし。
+    """
+    ...
+
+def get_memory_usage() -> dict[str, Any]:
+    """全セッションのフレームバッファ用メモリ使用量を取得する
+
+    Returns:
+        {"budget": 予算 (予算なしなら None), "total": 合計使用量,
+         "sessions": 各セッションの Session.memory_usage のリスト,
+         "categories": プロセス全体の区分ごとの使用量}
+
+    categories は "frame_texture" (フレームバッファのテクスチャ)・"staging_texture" (読み出し用テクスチャ)・
+    "readback_buffer" (スナップショット等の読み出し結果)・"python_bytes" (Python に渡した bytes) をキーに、
+    {"current_bytes", "peak_bytes", "allocations", "releases", "total_bytes"} を持つ。
+    python_bytes は解放を追えないので、allocations と total_bytes だけが有効。
+    """
+    ...
+
 class Session:
     """キャプチャセッション
 
     このクラスのインスタンスが存命の間、
     バックグラウンドスレッド上でキャプチャが継続して実行されます。
+    バックグラウンドスレッドは他のセッションと共有されます。
     """
 
     def __init__(
@@ -23,6 +127,16 @@ class Session:
         duration_in_sec: float,
         max_width: Optional[int],
         max_height: Optional[int],
+        weight: float = ...,
+        min_duration_in_sec: float = ...,
+        deduplicate: bool = ...,
+        hot_duration_in_sec: Optional[float] = ...,
+        spill_dir: Optional[str] = ...,
+        spill_after_in_sec: float = ...,
+        spill_budget_in_bytes: int = ...,
+        spill_segment_size_in_bytes: int = ...,
+        scene_cut_threshold: Optional[float] = ...,
+        frame_format: Literal["bgra", "nv12"] = ...,
     ) -> None:
         """キャプチャセッションを開始する。
 
@@ -31,6 +145,62 @@ class Session:
             duration_in_sec: バッファ上に保持する秒数。
             max_width: キャプチャしたフレームの最大水平サイズ
             max_height: キャプチャしたフレームの最大垂直サイズ
+            weight: メモリ予算超過時の優先度。大きいほどフレームが破棄されにくい。
+            min_duration_in_sec: メモリ予算超過時にも破棄しない秒数。
+            deduplicate: True なら直前と同一内容のフレームはコピーせず、テクスチャを共有して保持する。
+                取得できるフレームは変わらない。
+            hot_duration_in_sec: GPU テクスチャのまま保持する秒数。
+                これより古いフレームはバックグラウンドで読み出し、ホストメモリ上に可逆圧縮して保持する。
+                GetFrameByTime や Snapshot からは区別なく取得できる。None なら全て GPU 上に保持する。
+            spill_dir: 一時セグメントファイルを置くディレクトリ。指定すると、spill_after_in_sec より古い
+                圧縮済みフレームをバックグラウンドでディスクに移す。hot_duration_in_sec の指定が必要。
+                ファイルはセッション終了時に自動で削除される。
+            spill_after_in_sec: 圧縮済みフレームをディスクに移すまでの秒数。
+            spill_budget_in_bytes: セグメントファイルの合計サイズの上限。
+                超えた場合は最も古いセグメントを、そこに書き出したフレームごと破棄する。
+            spill_segment_size_in_bytes: セグメントファイル１つのサイズ。
+            scene_cut_threshold: 直前のフレームとの差 (0 〜 1) がこれを超えたフレームをシーンの切り替えとみなす。
+                指定すると、フレームの到着ごとに GPU 上で縮小輝度を求めてシーン切り替えの索引を作り、
+                GetSceneCuts が使えるようになる。一般的な映像なら 0.25 前後。None なら検出しない。
+            frame_format: バッファ上に保持するテクスチャのフォーマット。
+                "bgra" なら 4 バイト/画素。"nv12" なら 1.5 バイト/画素（BT.709 full range）で、
+                到着時に１度だけ変換し、読み出し時に BGR に戻す。色差が 2x2 画素で共有されるぶん劣化する。
+        """
+        ...
+
+    @staticmethod
+    def Replay(
+        path: str,
+        duration_in_sec: float,
+        realtime: bool = ...,
+        loop: bool = ...,
+        speed: float = ...,
+        max_width: Optional[int] = ...,
+        max_height: Optional[int] = ...,
+        weight: float = ...,
+        min_duration_in_sec: float = ...,
+        deduplicate: bool = ...,
+        hot_duration_in_sec: Optional[float] = ...,
+        spill_dir: Optional[str] = ...,
+        spill_after_in_sec: float = ...,
+        spill_budget_in_bytes: int = ...,
+        spill_segment_size_in_bytes: int = ...,
+        scene_cut_threshold: Optional[float] = ...,
+        frame_format: Literal["bgra", "nv12"] = ...,
+    ) -> "Session":
+        """ウィンドウの代わりに Snapshot.Save で書き出したアーカイブを流すセッションを開始する。
+
+        フレームはキャプチャと同じ経路でバッファに入るので、Session の API はそのまま使える。
+        ゲームを起動せずに、記録済みの映像で下流の処理を再現・検証するためのもの。
+
+        Args:
+            path: アーカイブのパス。
+            duration_in_sec: バッファ上に保持する秒数。
+            realtime: True なら記録時の間隔どおりに流す。False なら待たずに流し、
+                フレームのタイムスタンプに追従する仮想時刻で保持秒数・相対時刻を解決する。
+            loop: True なら末尾まで流したら先頭に戻る。
+            speed: 再生速度の倍率。
+            その他の引数はコンストラクタと同じ。
         """
         ...
 
@@ -52,6 +222,242 @@ class Session:
         """
         ...
 
+    def GetFrameByTimeAsync(
+        self, time_in_sec: float
+    ) -> asyncio.Future[tuple[Optional[int], Optional[int], Optional[bytes]]]:
+        """GetFrameByTime の asyncio 版。
+
+        読み出しは BG スレッド上で行われ、完了時にイベントループへ通知される。
+        実行中のイベントループ上から呼ぶ必要がある。
+        返り値の Future をキャンセルすると、未着手の読み出しもキャンセルされる。
+
+        Args:
+            time_in_sec: 最新フレームからの相対秒数 (例: 0.1)。
+
+        Returns:
+            GetFrameByTime と同じタプルを結果に持つ Future。
+        """
+        ...
+
+    def WaitForNewFrame(
+        self,
+        timeout_in_sec: Optional[float] = ...,
+        after_seq: Optional[int] = ...,
+    ) -> tuple[Optional[int], Optional[float], Optional[int], Optional[int], Optional[bytes]]:
+        """新しいフレームが到着するまで待機して取得する。
+
+        待機中は GIL を解放する。
+
+        Args:
+            timeout_in_sec: 最大待機秒数。None なら無期限に待つ。
+            after_seq: このシーケンス番号より新しいフレームを待つ。
+                None なら呼び出し時点の最新フレームより新しいフレームを待つ。
+
+        Returns:
+            (Sequence, Timestamp In Sec, Width, Height, Frame Raw Buffer) のタプル。
+            Sequence は次回呼び出しの after_seq に渡すことで取りこぼしなく待機できる。
+            タイムアウトした場合 (None, None, None, None, None) を返す。
+        """
+        ...
+
+    def Subscribe(
+        self,
+        callback: Callable[[int, float, int, int, bytes], object],
+        max_pending: int = ...,
+        overflow: Literal["drop_oldest", "drop_newest", "block"] = ...,
+    ) -> "Subscription":
+        """新着フレームの配送を開始する。
+
+        到着したフレームは BG スレッド上で１回だけ読み出され、
+        全購読者に到着順で配送される。
+
+        Args:
+            callback: callback(seq, timestamp_in_sec, width, height, frame_buffer) の形で呼ばれる。
+                queue.Queue.put を渡せばキュー経由で受け取れる。
+            max_pending: 配送待ちにできるフレームの最大枚数。
+            overflow: 配送待ちが溢れた時の挙動。
+                "drop_oldest" なら最も古い配送待ちフレームを、
+                "drop_newest" なら到着したフレームを捨てる。
+                "block" なら空きが出るまで全購読者への配送を止める。
+        """
+        ...
+
+    def PublishSharedRing(
+        self,
+        name: str,
+        num_slots: int = ...,
+        slot_size_in_bytes: int = ...,
+    ) -> "SharedRingPublisher":
+        """新着フレームの名前付き共有メモリへの書き出しを開始する。
+
+        書き出したフレームは aynime_capture.shared_ring.SharedFrameRingReader で
+        別プロセスからゼロコピーで読み出せる。
+
+        Args:
+            name: 共有メモリ（ファイルマッピングオブジェクト）の名前。
+            num_slots: リングに保持するフレーム数。
+            slot_size_in_bytes: スロット１つ分の容量。これより大きいフレームは書き出されない。
+        """
+        ...
+
+    def StreamY4M(
+        self,
+        target: Union[str, int],
+        fps: float,
+        matrix: Literal["bt601", "bt709"] = ...,
+        max_pending: int = ...,
+        overflow: Literal["drop_oldest", "drop_newest", "block"] = ...,
+    ) -> "Y4MStream":
+        """新着フレームの YUV4MPEG2 (4:2:0, limited range) での書き出しを開始する。
+
+        フレームサイズは最初のフレームで決まり、以降サイズの違うフレームは書き出されない。
+
+        Args:
+            target: 書き出し先のパス、または ffmpeg の stdin に繋いだパイプなどのファイルディスクリプタ。
+            fps: ヘッダに書き込むフレームレート。
+            matrix: YUV 変換の係数。
+            max_pending: 変換待ちにできるフレームの最大数。
+            overflow: 変換待ちがいっぱいの場合の挙動。
+        """
+        ...
+
+    @property
+    def memory_usage(self) -> dict[str, Any]:
+        """フレームバッファ用メモリ使用量
+        (hwnd, weight, min_duration_in_sec, bytes, floor_bytes, limit_bytes, categories)。
+
+        limit_bytes はメモリ予算から課された上限で、上限なしなら None。
+        categories はこのセッションの区分ごとの使用量で、形式は get_memory_usage と同じ。
+        """
+        ...
+
+    def GetSceneCuts(self, duration_in_sec: Optional[float] = ...) -> list[tuple[float, float]]:
+        """直近 duration_in_sec 秒以内のシーン切り替えを古い順に取得する。
+
+        索引はフレームの到着ごとに更新済みなので、問い合わせは二分探索だけで済む。
+        scene_cut_threshold を指定したセッションでのみ使える。
+
+        Args:
+            duration_in_sec: さかのぼる秒数。None ならバッファ全体。
+
+        Returns:
+            (relative_in_sec, score) のリスト。relative_in_sec は新しいシーンの最初のフレームの相対時刻で、
+            GetFrameByTime や Snapshot の duration_in_sec にそのまま使える。
+            score は直前のフレームとの差 (0 〜 1)。
+        """
+        ...
+
+    @property
+    def dedup_stats(self) -> dict[str, int]:
+        """重複フレーム排除の統計。
+
+        deduplicated_frames, saved_bytes はセッション開始からの累計、
+        held_duplicates, held_saved_bytes は現在バッファ上にある分。
+        """
+        ...
+
+    @property
+    def tier_stats(self) -> dict[str, Optional[float]]:
+        """ホット層（GPU テクスチャ）・コールド層（圧縮済みホストメモリ）・ディスク層の統計。
+
+        (hot_frames, cold_frames, hot_bytes, cold_bytes, cold_raw_bytes, cold_saved_bytes,
+        cold_tiles, cold_stored_tiles, compression_ratio,
+        spilled_frames, spilled_bytes, spill_disk_bytes)。
+        コールド層は 64x64 のタイル単位でキーフレームから変化した部分だけを保持する。
+        cold_stored_tiles / cold_tiles が実際に保持しているタイルの割合。
+        compression_ratio は cold_raw_bytes / cold_bytes で、コールド層が空なら None。
+        ディスク層の値は spill_dir を指定した場合のみ 0 以外になる。
+        """
+        ...
+
+    @property
+    def replay_finished(self) -> bool:
+        """Replay で開始したセッションが最後のフレームを流し終えたら True。
+
+        loop=True のリプレイやキャプチャセッションでは常に False。
+        """
+        ...
+
+class Subscription:
+    """フレーム購読
+
+    このクラスのインスタンスが存命の間、
+    バックグラウンドスレッド上でコールバックが呼び出されます。
+    """
+
+    def __enter__(self) -> "Subscription":
+        """コンテキストマネージャ開始。"""
+        ...
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        """コンテキストマネージャ終了。"""
+        ...
+
+    def Close(self) -> None:
+        """購読を停止する。"""
+        ...
+
+    @property
+    def stats(self) -> dict[str, float]:
+        """配送統計 (delivered, dropped, pending, latest_lag_in_sec, max_lag_in_sec)。"""
+        ...
+
+class SharedRingPublisher:
+    """共有メモリフレームリングへの書き出し
+
+    このクラスのインスタンスが存命の間、
+    バックグラウンドスレッド上で新着フレームが書き出されます。
+    """
+
+    def __enter__(self) -> "SharedRingPublisher":
+        """コンテキストマネージャ開始。"""
+        ...
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        """コンテキストマネージャ終了。"""
+        ...
+
+    def Close(self) -> None:
+        """書き出しを停止する。アタッチ中の読み手がいる間、共有メモリは残る。"""
+        ...
+
+    @property
+    def name(self) -> str:
+        """共有メモリの名前。"""
+        ...
+
+    @property
+    def stats(self) -> dict[str, int]:
+        """書き出し統計 (published, oversized, dropped)。"""
+        ...
+
+class Y4MStream:
+    """YUV4MPEG2 ストリームへの書き出し
+
+    このクラスのインスタンスが存命の間、
+    バックグラウンドスレッド上で新着フレームが変換・書き出しされます。
+    """
+
+    def __enter__(self) -> "Y4MStream":
+        """コンテキストマネージャ開始。"""
+        ...
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        """コンテキストマネージャ終了。"""
+        ...
+
+    def Close(self) -> None:
+        """書き出しを停止し、残りを書き出す。ファイルディスクリプタは閉じない。"""
+        ...
+
+    @property
+    def stats(self) -> dict[str, Any]:
+        """書き出し統計 (written, mismatched, dropped, failed)。
+
+        failed はパイプが閉じられた等で書き出しに失敗して止まった場合に True になる。
+        """
+        ...
+
 class Snapshot:
     """キャプチャバッファスナップショット
 
@@ -88,3 +494,171 @@ class Snapshot:
             (Width, Height, Frame Raw Buffer) のタプル。
         """
         ...
+
+    def GetFrameView(self, frame_index: int) -> tuple[int, int, memoryview]:
+        """GetFrame のコピーしない版。
+
+        スナップショットのアリーナ上の読み出し結果を、読み取り専用の memoryview でそのまま返す。
+        memoryview が生きている間はアリーナが解放されないので、スナップショットを閉じた後も読める。
+
+        Returns:
+            (Width, Height, Frame Raw Buffer View) のタプル。
+        """
+        ...
+
+    def GetFrameAsync(self, frame_index: int) -> asyncio.Future[tuple[int, int, bytes]]:
+        """GetFrame の asyncio 版。
+
+        読み出しの完了時にイベントループへ通知される。
+        実行中のイベントループ上から呼ぶ必要がある。
+        返り値の Future をキャンセルしても、同じフレームの GetFrame / GetFrameAsync には影響しない。
+        スナップショットを閉じた後、全ての Future がキャンセルされた未着手のフレームは読み出しを省く。
+
+        Returns:
+            GetFrame と同じタプルを結果に持つ Future。
+        """
+        ...
+
+    def GetFrameTime(self, frame_index: int) -> float:
+        """指定インデックスのフレームが、最新フレームから何秒さかのぼったものかを返す。"""
+        ...
+
+    def Save(self, path: str, compress: bool = ...) -> None:
+        """全フレームをアーカイブファイルに書き出す。
+
+        フレームの読み出しを待ちながら、圧縮と書き込みをバックグラウンドのスレッドで並行に行う。
+        書き出したファイルは ArchiveSnapshot で開ける。
+
+        Args:
+            path: 書き出し先のパス。既存のファイルは上書きする。
+            compress: True ならフレームごとに可逆圧縮する。
+                False ならマップした先をそのまま画素として読めるように、無圧縮でページ境界に揃えて書き出す。
+        """
+        ...
+
+    def ExportGif(
+        self,
+        path: str,
+        fps: Optional[float] = ...,
+        max_colors: int = ...,
+        dither: Literal["none", "ordered", "floyd_steinberg"] = ...,
+        palette: Literal["global", "local"] = ...,
+        optimize: bool = ...,
+    ) -> None:
+        """全フレームをループするアニメーション GIF に書き出す。
+
+        パレット生成・減色・ディザリング・LZW 符号化をフレーム単位で複数スレッドに分散する。
+
+        Args:
+            path: 書き出し先のパス。既存のファイルは上書きする。
+            fps: 再生時のフレームレート。None ならフレームのタイムスタンプどおりに表示する。
+            max_colors: パレットの色数 (2 〜 256)。optimize が True なら１色を透過色に充てる。
+            dither: "none" は最も近い色に置き換えるだけ。"ordered" は Bayer 行列で、
+                静止部分がフレーム間で揺れないので optimize と相性が良い。
+                "floyd_steinberg" は誤差拡散で、滑らかだがファイルは大きくなりやすい。
+            palette: "global" なら全フレームで１つのパレット、"local" ならフレームごとのパレット。
+            optimize: True なら直前のフレームから変化した矩形だけを、変化の無い画素を透過にして書き出す。
+                直前と同一のフレームは前のフレームの表示時間に繰り入れる。
+        """
+        ...
+
+    def ExportY4M(
+        self,
+        target: Union[str, int],
+        fps: Optional[float] = ...,
+        matrix: Literal["bt601", "bt709"] = ...,
+    ) -> None:
+        """全フレームを YUV4MPEG2 (4:2:0, limited range) で書き出す。
+
+        色変換と書き込みはバックグラウンドの I/O スレッドと重ねて行う。
+
+        Args:
+            target: 書き出し先のパス、または ffmpeg の stdin に繋いだパイプなどのファイルディスクリプタ。
+            fps: ヘッダに書き込むフレームレート。None ならフレームのタイムスタンプの平均間隔から求める。
+            matrix: YUV 変換の係数。
+        """
+        ...
+
+    def ContactSheet(
+        self,
+        columns: int,
+        thumb_width: int,
+        thumb_height: Optional[int] = ...,
+        indices: Optional[list[int]] = ...,
+        count: Optional[int] = ...,
+    ) -> tuple[int, int, bytes]:
+        """選んだフレームを縮小して格子状に並べた１枚の画像を返す。
+
+        縮小（面積平均）はフレーム単位で複数スレッドに分散し、出力バッファに直接書き込む。
+        Python 側に渡るのはコンタクトシート１枚分のデータだけ。
+        フレームは縦横比を保ってセルの中央に収め、余白は黒で埋める。
+
+        Args:
+            columns: １行に並べるサムネイル数。
+            thumb_width: セルの幅。
+            thumb_height: セルの高さ。None なら最初のフレームの縦横比に合わせる。
+            indices: 並べるフレームのインデックス（この順に並べる）。
+            count: 先頭から末尾まで等間隔に選ぶフレーム数。indices とは同時に指定できない。
+                どちらも None なら全フレームを並べる。
+
+        Returns:
+            GetFrame と同じ (width, height, frame_buffer) のタプル。frame_buffer は BGR24。
+        """
+        ...
+
+    def PruneNearDuplicates(
+        self,
+        threshold: float = ...,
+        metric: Literal["sad", "ssim"] = ...,
+    ) -> list[tuple[int, float]]:
+        """ほぼ同一のフレームが続く区間を１枚に統合し、残ったフレームの一覧を返す。
+
+        フレームは縮小した輝度で、統合中の区間の先頭フレームと比較する。
+        直前のフレームとだけ比べないので、ゆっくりしたフェードが１枚に潰れることは無い。
+
+        Args:
+            threshold: 統合する差分の上限 (0 〜 1)。0 なら完全に同一のフレームだけを統合する。
+            metric: "sad" は平均絶対差で、全体が薄く変わるフェードに敏感。
+                "ssim" は 8x8 ブロックごとの SSIM の平均を 1 から引いたもので、部分的な構造の変化に敏感。
+
+        Returns:
+            (frame_index, duration_in_sec) のリスト。
+            duration_in_sec は統合したフレームの表示時間の合計で、末尾のフレームは平均フレーム間隔とする。
+        """
+        ...
+
+class ArchiveSnapshot:
+    """アーカイブファイルのスナップショット
+
+    Snapshot.Save で書き出したファイルを、Snapshot と同じ操作で読み出します。
+    ファイルはメモリマップし、任意のフレームにインデックスから直接アクセスします。
+    """
+
+    def __init__(self, path: str) -> None:
+        """アーカイブファイルを開く。書き出しが完了していないファイルはエラーになる。"""
+        ...
+
+    def __enter__(self) -> "ArchiveSnapshot":
+        """コンテキストマネージャ開始。"""
+        ...
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        """コンテキストマネージャ終了。ファイルを閉じる。"""
+        ...
+
+    @property
+    def size(self) -> int:
+        """アーカイブ上のフレーム枚数。"""
+        ...
+
+    def GetFrame(self, frame_index: int) -> tuple[int, int, bytes]:
+        """指定インデックスのフレームを取得する。
+
+        Returns:
+            (Width, Height, Frame Raw Buffer) のタプル。
+        """
+        ...
+
+    def GetFrameTime(self, frame_index: int) -> float:
+        """指定インデックスのフレームが、最新フレームから何秒さかのぼったものかを返す。"""
+        ...
@@ -0,0 +1,275 @@
+# aynime_capture/shared_ring.py
+"""共有メモリフレームリング
+
+Session.PublishSharedRing が書き出す名前付き共有メモリを、
+別プロセスからゼロコピーで読み出すためのモジュール。
+
+レイアウトは core/include/shared_frame_ring.h と一致させること。
+Windows ではファイルマッピング、Linux では POSIX 共有メモリ (/dev/shm) を使う。
+SharedFrameRingWriter は WGC の代わりに合成フレームを流すためのもので、
+Linux 上でのテストにも使える。
+"""
+
+from __future__ import annotations
+
+import mmap
+import os
+import struct
+import sys
+import time
+from typing import NamedTuple, Optional
+
+# 共有メモリの識別子 'AYCR'
+MAGIC = 0x52435941
+
+# レイアウトのバージョン
+VERSION = 1
+
+# ピクセルフォーマット
+FORMAT_BGR24 = 1
+
+# ヘッダ: magic, version, num_slots, slot_desc_size, slot_capacity, data_offset, latest_seq
+_HEADER = struct.Struct("<IIIIQQQ")
+_HEADER_SIZE = 64
+_LATEST_SEQ_OFFSET = 32
+
+# スロット記述子: lock, seq, timestamp, width, height, stride, format, size
+_SLOT = struct.Struct("<QQqIIIIQ")
+_SLOT_SIZE = 64
+
+# ピクセルデータ領域の先頭アライメント
+_DATA_ALIGNMENT = 4096
+
+# seqlock の読み直し回数の上限
+_MAX_RETRIES = 1000
+
+
+class SharedFrame(NamedTuple):
+    """共有メモリ上のフレーム
+
+    data は共有メモリを直接指す memoryview で、コピーされていない。
+    書き手に上書きされる可能性があるので、使い終わったら
+    SharedFrameRingReader.is_valid で上書きされていないか確認すること。
+    """
+
+    seq: int
+    timestamp_in_sec: float
+    width: int
+    height: int
+    stride: int
+    format: int
+    slot: int
+    lock: int
+    data: memoryview
+
+
+def _open_mapping(name: str, size: int, create: bool) -> mmap.mmap:
+    """名前付き共有メモリをマップする"""
+    if sys.platform == "win32":
+        access = mmap.ACCESS_WRITE if create else mmap.ACCESS_READ
+        return mmap.mmap(-1, size, tagname=name, access=access)
+    path = os.path.join("/dev/shm", name.lstrip("/"))
+    if create:
+        fd = os.open(path, os.O_RDWR | os.O_CREAT | os.O_EXCL, 0o600)
+        try:
+            os.ftruncate(fd, size)
+            return mmap.mmap(fd, size, access=mmap.ACCESS_WRITE)
+        finally:
+            os.close(fd)
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        if size <= 0:
+            size = os.fstat(fd).st_size
+        return mmap.mmap(fd, size, access=mmap.ACCESS_READ)
+    finally:
+        os.close(fd)
+
+
+class SharedFrameRingReader:
+    """共有メモリフレームリングの読み手
+
+    任意の数のプロセスから同時にアタッチできる。
+    """
+
+    def __init__(self, name: str) -> None:
+        """共有メモリにアタッチする。
+
+        Args:
+            name: Session.PublishSharedRing に渡した名前。
+        """
+        # ヘッダだけ読んで全体のサイズを解決
+        head = _open_mapping(name, _HEADER_SIZE, create=False)
+        try:
+            magic, version, num_slots, slot_desc_size, slot_capacity, data_offset, _ = (
+                _HEADER.unpack_from(head, 0)
+            )
+        finally:
+            head.close()
+        if magic != MAGIC:
+            raise RuntimeError(f"{name} is not an aynime_capture shared ring")
+        if version != VERSION or slot_desc_size != _SLOT_SIZE:
+            raise RuntimeError(f"{name} has an unsupported layout version {version}")
+        self._num_slots = num_slots
+        self._slot_capacity = slot_capacity
+        self._data_offset = data_offset
+        self._map = _open_mapping(name, data_offset + slot_capacity * num_slots, create=False)
+        self._view = memoryview(self._map)
+
+    def __enter__(self) -> "SharedFrameRingReader":
+        return self
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        self.close()
+        return False
+
+    def close(self) -> None:
+        """デタッチする。取得済みの SharedFrame.data も使えなくなる。"""
+        if self._map is not None:
+            self._view.release()
+            self._map.close()
+            self._map = None
+
+    @property
+    def num_slots(self) -> int:
+        """リングのスロット数。"""
+        return self._num_slots
+
+    @property
+    def latest_seq(self) -> int:
+        """最後に書き込まれたフレームの seq。まだ無ければ 0。"""
+        return struct.unpack_from("<Q", self._map, _LATEST_SEQ_OFFSET)[0]
+
+    def _read_slot(self, slot: int) -> Optional[SharedFrame]:
+        """seqlock で整合の取れたスロット記述子を読む"""
+        offset = _HEADER_SIZE + slot * _SLOT_SIZE
+        for _ in range(_MAX_RETRIES):
+            lock, seq, timestamp, width, height, stride, fmt, size = _SLOT.unpack_from(self._map, offset)
+            if lock & 1:
+                continue
+            if struct.unpack_from("<Q", self._map, offset)[0] != lock:
+                continue
+            if seq == 0:
+                return None
+            begin = self._data_offset + slot * self._slot_capacity
+            return SharedFrame(
+                seq, timestamp / 10_000_000, width, height, stride, fmt, slot, lock,
+                self._view[begin:begin + size],
+            )
+        return None
+
+    def acquire(self, seq: Optional[int] = None) -> Optional[SharedFrame]:
+        """フレームをコピーせずに取得する。
+
+        Args:
+            seq: 取得するフレームの seq。None なら最新フレーム。
+
+        Returns:
+            SharedFrame。該当フレームがリング上に無ければ None。
+        """
+        found = None
+        for slot in range(self._num_slots):
+            frame = self._read_slot(slot)
+            if frame is None:
+                continue
+            if seq is not None:
+                if frame.seq == seq:
+                    return frame
+            elif found is None or frame.seq > found.seq:
+                found = frame
+        return found
+
+    def is_valid(self, frame: SharedFrame) -> bool:
+        """acquire したフレームが書き手に上書きされていなければ True を返す。"""
+        offset = _HEADER_SIZE + frame.slot * _SLOT_SIZE
+        return struct.unpack_from("<Q", self._map, offset)[0] == frame.lock
+
+    def read(self, seq: Optional[int] = None) -> Optional[tuple[int, float, int, int, bytes]]:
+        """フレームをコピーして取得する。
+
+        Returns:
+            (seq, timestamp_in_sec, width, height, frame_buffer) のタプル。
+            該当フレームがリング上に無ければ None。
+        """
+        for _ in range(_MAX_RETRIES):
+            frame = self.acquire(seq)
+            if frame is None:
+                return None
+            data = bytes(frame.data)
+            if self.is_valid(frame):
+                return (frame.seq, frame.timestamp_in_sec, frame.width, frame.height, data)
+        return None
+
+    def wait(self, after_seq: int, timeout_in_sec: Optional[float] = None,
+             poll_interval_in_sec: float = 0.001) -> Optional[int]:
+        """after_seq より新しいフレームが書き込まれるまで待つ。
+
+        Returns:
+            最新フレームの seq。タイムアウトした場合 None。
+        """
+        deadline = None if timeout_in_sec is None else time.monotonic() + timeout_in_sec
+        while True:
+            latest = self.latest_seq
+            if latest > after_seq:
+                return latest
+            if deadline is not None and time.monotonic() >= deadline:
+                return None
+            time.sleep(poll_interval_in_sec)
+
+
+class SharedFrameRingWriter:
+    """共有メモリフレームリングの書き手
+
+    通常は Session.PublishSharedRing が C++ 側で書き込むので不要。
+    合成フレームでの動作確認用。
+    """
+
+    def __init__(self, name: str, num_slots: int, slot_size_in_bytes: int) -> None:
+        if num_slots < 1 or slot_size_in_bytes < 1:
+            raise ValueError("num_slots and slot_size_in_bytes must be positive")
+        desc_end = _HEADER_SIZE + _SLOT_SIZE * num_slots
+        data_offset = (desc_end + _DATA_ALIGNMENT - 1) // _DATA_ALIGNMENT * _DATA_ALIGNMENT
+        self._name = name
+        self._num_slots = num_slots
+        self._slot_capacity = slot_size_in_bytes
+        self._data_offset = data_offset
+        self._next_slot = 0
+        self._map = _open_mapping(name, data_offset + slot_size_in_bytes * num_slots, create=True)
+        # magic は最後に書き込み、読み手が書きかけのヘッダを見ないようにする
+        _HEADER.pack_into(self._map, 0, 0, VERSION, num_slots, _SLOT_SIZE, slot_size_in_bytes, data_offset, 0)
+        struct.pack_into("<I", self._map, 0, MAGIC)
+
+    def __enter__(self) -> "SharedFrameRingWriter":
+        return self
+
+    def __exit__(self, exc_type, exc, tb) -> bool:
+        self.close()
+        return False
+
+    def close(self) -> None:
+        """共有メモリを閉じる。Linux では名前も削除する。"""
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+            if sys.platform != "win32":
+                os.unlink(os.path.join("/dev/shm", self._name.lstrip("/")))
+
+    def publish(self, seq: int, timestamp_in_sec: float, width: int, height: int,
+                frame_buffer: bytes, stride: Optional[int] = None, format: int = FORMAT_BGR24) -> bool:
+        """フレームを１つ書き込む。スロットに収まらない場合は False を返す。"""
+        size = len(frame_buffer)
+        if size > self._slot_capacity:
+            return False
+        slot = self._next_slot
+        self._next_slot = (slot + 1) % self._num_slots
+        offset = _HEADER_SIZE + slot * _SLOT_SIZE
+        lock = struct.unpack_from("<Q", self._map, offset)[0]
+        struct.pack_into("<Q", self._map, offset, lock + 1)
+        _SLOT.pack_into(
+            self._map, offset, lock + 1, seq, int(timestamp_in_sec * 10_000_000),
+            width, height, width * 3 if stride is None else stride, format, size,
+        )
+        begin = self._data_offset + slot * self._slot_capacity
+        self._map[begin:begin + size] = frame_buffer
+        struct.pack_into("<Q", self._map, offset, lock + 2)
+        struct.pack_into("<Q", self._map, _LATEST_SEQ_OFFSET, seq)
+        return True
@@ -0,0 +1,1208 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// other
+#include "async_texture_readback.h"
+#include "capture_scheduler.h"
+#include "contact_sheet.h"
+#include "frame_buffer.h"
+#include "host_arena.h"
+#include "nv12_texture.h"
+#include "staging_texture_ring.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include "y4m_writer.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 出力 JSON のスキーマバージョン
+    // @note: 項目の意味を変えたら上げること。過去の結果と比較できなくなる
+    const int BENCH_SCHEMA_VERSION = 1;
+
+    // １項目あたりの最低計測時間
+    const double BENCH_MIN_TIME_IN_SEC = 0.5;
+
+    // 計測するフレームバッファの深さ（フレーム数）
+    // @note: 60fps で 1 秒、10 秒、60 秒ぶん
+    const std::size_t BENCH_DEPTHS[] = { 60, 600, 3600 };
+
+    // フレームの間隔
+    const auto BENCH_FRAME_INTERVAL = wgc::TimeSpan(10'000'000 / 60);
+
+    // フレーム・変換カーネルのサイズ
+    const std::size_t BENCH_FRAME_WIDTH = 1920;
+    const std::size_t BENCH_FRAME_HEIGHT = 1080;
+
+    // スナップショットの fps
+    const double BENCH_SNAPSHOT_FPS = 30.0;
+
+    // 競合ストレスのデフォルト設定
+    // @note: 本番で問題になるのは 144Hz のキャプチャに Python スレッドが群がるケース
+    const double BENCH_STRESS_RATE_HZ = 144.0;
+    const std::size_t BENCH_STRESS_READERS[] = { 1, 4, 16 };
+    const double BENCH_STRESS_DURATION_IN_SEC = 2.0;
+
+    // 競合ストレスのフレームバッファの保持秒数
+    const double BENCH_STRESS_HOLD_IN_SEC = 5.0;
+
+    // 読み手がスナップショットを取る割合（N 回に１回）
+    const std::size_t BENCH_STRESS_FREEZE_INTERVAL = 16;
+
+    // 生産者の待機でスピンに切り替える残り時間
+    // @note: Windows の sleep は粒度が粗く、寝過ごしを競合による遅延と区別できなくなるため
+    const auto BENCH_STRESS_SPIN_MARGIN = std::chrono::milliseconds(2);
+
+    // 読み出しパイプラインで計測する先行転送の深さ
+    const std::size_t BENCH_READBACK_DEPTHS[] = { 1, 4 };
+
+    // 読み出しパイプラインの１回あたりのフレーム数
+    const std::size_t BENCH_READBACK_FRAMES = 32;
+
+    // 読み出しパイプラインで模擬する GPU コピー１回の所要時間
+    const auto BENCH_READBACK_COPY_TIME = std::chrono::microseconds(2000);
+
+    // 単一フレーム変換のレイテンシを計測するフレームのサイズ
+    // @note: 並列化が効いてくる 4K
+    const std::size_t BENCH_LATENCY_FRAME_WIDTH = 3840;
+    const std::size_t BENCH_LATENCY_FRAME_HEIGHT = 2160;
+
+    // 単一フレーム変換のレイテンシを計測するスレッド数（呼び出し元スレッドを含む）
+    const std::size_t BENCH_LATENCY_THREADS[] = { 1, 2, 4, 8 };
+
+    // 読み出し結果の確保を計測するスナップショット１つ分のフレーム数
+    // @note: 30fps で 2 秒ぶん
+    const std::size_t BENCH_HOST_BUFFER_FRAMES = 60;
+
+    // キャプチャスケジューラのスケーリングを計測するセッション数・ワーカー数
+    const std::size_t BENCH_SCALING_SESSIONS[] = { 1, 4, 16, 64 };
+    const std::size_t BENCH_SCALING_WORKERS[] = { 1, 2, 4 };
+
+    // 合成セッションが１フレームあたりに読むバイト数
+    // @note: PushCapturedFrame の CPU 側の処理の代わり
+    const std::size_t BENCH_SCALING_FRAME_BYTES = 256 * 1024;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // GPU を使わずに FrameBuffer を動かすためのテクスチャ
+    /* @note:
+        FrameBuffer・FreezedFrameBuffer がテクスチャに対して行うのは、
+        参照カウントの増減と GetDesc だけなので、それだけ本物らしく振る舞えばよい。
+        読み出し（ReadbackTexture）には渡せないので、ホット層のみの構成で使うこと。
+    */
+    class _MockTexture final : public ID3D11Texture2D
+    {
+    public:
+        explicit _MockTexture(const D3D11_TEXTURE2D_DESC& desc)
+        : m_refCount(1)
+        , m_desc(desc)
+        {
+            // nop
+        }
+
+        // IUnknown
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (!ppvObject)
+            {
+                return E_POINTER;
+            }
+            const bool isSupported = (
+                riid == __uuidof(IUnknown) ||
+                riid == __uuidof(ID3D11DeviceChild) ||
+                riid == __uuidof(ID3D11Resource) ||
+                riid == __uuidof(ID3D11Texture2D)
+            );
+            if (!isSupported)
+            {
+                *ppvObject = nullptr;
+                return E_NOINTERFACE;
+            }
+            AddRef();
+            *ppvObject = static_cast<ID3D11Texture2D*>(this);
+            return S_OK;
+        }
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++m_refCount;
+        }
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG refCount = --m_refCount;
+            if (refCount == 0)
+            {
+                delete this;
+            }
+            return refCount;
+        }
+
+        // ID3D11DeviceChild
+        void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override
+        {
+            *ppDevice = nullptr;
+        }
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override
+        {
+            return DXGI_ERROR_NOT_FOUND;
+        }
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override
+        {
+            return E_NOTIMPL;
+        }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override
+        {
+            return E_NOTIMPL;
+        }
+
+        // ID3D11Resource
+        void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* pResourceDimension) override
+        {
+            *pResourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+        }
+        void STDMETHODCALLTYPE SetEvictionPriority(UINT) override
+        {
+            // nop
+        }
+        UINT STDMETHODCALLTYPE GetEvictionPriority() override
+        {
+            return 0;
+        }
+
+        // ID3D11Texture2D
+        void STDMETHODCALLTYPE GetDesc(D3D11_TEXTURE2D_DESC* pDesc) override
+        {
+            *pDesc = m_desc;
+        }
+
+    private:
+        std::atomic<ULONG>      m_refCount;
+        D3D11_TEXTURE2D_DESC    m_desc;
+    };
+
+    // 計測結果
+    struct _BENCH_RESULT
+    {
+        std::string     name;
+        std::string     params;         // JSON オブジェクトの中身
+        std::uint64_t   iterations;
+        double          nsPerOp;
+        double          mbPerSec;       // バイト数を指定しない項目は 0
+    };
+
+    // 競合ストレスの設定
+    struct _STRESS_PARAM
+    {
+        double                      rateInHz;
+        std::vector<std::size_t>    numReadersList;
+        double                      durationInSec;
+    };
+
+    // 競合ストレスの結果
+    struct _STRESS_RESULT
+    {
+        std::string     name;
+        std::string     params;             // JSON オブジェクトの中身
+        std::uint64_t   pushes;
+        double          pushP50InUs;
+        double          pushP90InUs;
+        double          pushP99InUs;
+        double          pushP999InUs;
+        double          pushMaxInUs;
+        double          missedRatio;        // 次のフレームの予定時刻までに追加を終えられなかった割合
+        std::uint64_t   lookups;
+        std::uint64_t   freezes;
+        double          readerOpsPerSec;    // 読み手全体の合計
+    };
+
+    // 計測を回して結果を集めるクラス
+    class _BenchRunner
+    {
+    public:
+        // @note: filter を指定すると、名前にその文字列を含む項目だけを計測する
+        explicit _BenchRunner(const std::string& filter)
+        : m_filter(filter)
+        , m_results()
+        {
+            // nop
+        }
+
+        // 最低計測時間に達するまで func を繰り返して計測する
+        /* @note:
+            呼び出し回数を倍々に増やし、１回の計測が最低計測時間を超えたものを採用する。
+            時計の読み出しのオーバーヘッドが結果に混ざらないようにするため。
+            bytesPerOp を指定すると、スループット（MB/s）も求める。
+        */
+        template<class Func>
+        void Measure(
+            const std::string& name,
+            const std::string& params,
+            std::size_t bytesPerOp,
+            Func func
+        )
+        {
+            using Clock = std::chrono::steady_clock;
+
+            // 対象外ならスキップ
+            if (!IsSelected(name))
+            {
+                return;
+            }
+            std::cerr << name << " {" << params << "}" << std::endl;
+
+            // ウォームアップ
+            func();
+
+            std::uint64_t iterations = 1;
+            for (;;)
+            {
+                const auto start = Clock::now();
+                for (std::uint64_t i = 0; i < iterations; ++i)
+                {
+                    func();
+                }
+                const double elapsedInSec = std::chrono::duration<double>(Clock::now() - start).count();
+                if (elapsedInSec >= BENCH_MIN_TIME_IN_SEC)
+                {
+                    const double secPerOp = elapsedInSec / static_cast<double>(iterations);
+                    m_results.push_back(_BENCH_RESULT{
+                        name,
+                        params,
+                        iterations,
+                        secPerOp * 1e9,
+                        bytesPerOp > 0 ? static_cast<double>(bytesPerOp) / secPerOp / (1024.0 * 1024.0) : 0.0
+                    });
+                    return;
+                }
+                iterations *= 2;
+            }
+        }
+
+        // 名前が filter に一致するなら true を返す
+        bool IsSelected(const std::string& name) const
+        {
+            return name.find(m_filter) != std::string::npos;
+        }
+
+        // 競合ストレスの結果を追加する
+        void AddStressResult(_STRESS_RESULT result)
+        {
+            m_stressResults.push_back(std::move(result));
+        }
+
+        // 計測結果
+        const std::vector<_BENCH_RESULT>& GetResults() const
+        {
+            return m_results;
+        }
+
+        // 競合ストレスの結果
+        const std::vector<_STRESS_RESULT>& GetStressResults() const
+        {
+            return m_stressResults;
+        }
+
+    private:
+        std::string                 m_filter;
+        std::vector<_BENCH_RESULT>  m_results;
+        std::vector<_STRESS_RESULT> m_stressResults;
+    };
+
+    // 仮想時刻
+    /* @note:
+        FrameBuffer に渡す clock。
+        QPC に依存させないことで、フレームを実時間より速く詰められるようにする。
+    */
+    class _VirtualClock
+    {
+    public:
+        _VirtualClock()
+        : m_now(0)
+        {
+            // nop
+        }
+
+        void Advance(wgc::TimeSpan delta)
+        {
+            m_now.fetch_add(delta.count());
+        }
+
+        std::function<wgc::TimeSpan()> ToFunction()
+        {
+            return [this]() { return wgc::TimeSpan(m_now.load()); };
+        }
+
+    private:
+        std::atomic<wgc::TimeSpan::rep> m_now;
+    };
+
+    // GPU を使わずに RunReadbackPipeline を動かすためのバックエンド
+    /* @note:
+        GPU のコピーは発行順に１つずつ copyTime かかるものとして、完了時刻だけ計算する。
+        完了した転送は実際に NV12 --> BGR24 変換を行い、CPU 側の負荷を再現する。
+    */
+    class _MockReadbackBackend : public ayc::IReadbackBackend
+    {
+    public:
+        _MockReadbackBackend(
+            std::size_t count,
+            std::chrono::steady_clock::duration copyTime,
+            std::size_t width,
+            std::size_t height
+        )
+        : m_readyTimes(count)
+        , m_copyTime(copyTime)
+        , m_gpuIdleTime()
+        , m_width(width)
+        , m_height(height)
+        , m_nv12(width * height * 3 / 2, 128)
+        , m_bgr(width * height * 3)
+        {
+            // nop
+        }
+
+        bool Issue(std::size_t index) override
+        {
+            // @note: GPU が空いていればすぐ、埋まっていれば前のコピーの後に始まる
+            m_gpuIdleTime = std::max(m_gpuIdleTime, std::chrono::steady_clock::now()) + m_copyTime;
+            m_readyTimes[index] = m_gpuIdleTime;
+            return true;
+        }
+
+        bool TryComplete(std::size_t index) override
+        {
+            if (std::chrono::steady_clock::now() < m_readyTimes[index])
+            {
+                return false;
+            }
+            ayc::ConvertNV12ToBGR(
+                m_bgr.data(),
+                m_nv12.data(),
+                m_width,
+                m_nv12.data() + m_width * m_height,
+                m_width,
+                m_width,
+                m_height
+            );
+            return true;
+        }
+
+        void WaitForProgress(std::size_t /*index*/) override
+        {
+            std::this_thread::yield();
+        }
+
+    private:
+        std::vector<std::chrono::steady_clock::time_point>  m_readyTimes;
+        std::chrono::steady_clock::duration                 m_copyTime;
+        std::chrono::steady_clock::time_point               m_gpuIdleTime;
+        std::size_t                                         m_width;
+        std::size_t                                         m_height;
+        std::vector<std::uint8_t>                           m_nv12;
+        std::vector<std::uint8_t>                           m_bgr;
+    };
+
+    // WGC を使わずに CaptureScheduler を動かすためのキャプチャワーカー
+    /* @note:
+        スレッド１本で Invoke のタスクとセッションの仕事を処理する。
+        セッションの仕事は本物のワーカーと同じく CaptureTaskQueue で１巡回ずつ処理する。
+    */
+    class _SyntheticCaptureWorker : public ayc::ICaptureWorker
+    {
+    public:
+        _SyntheticCaptureWorker()
+        : m_guard()
+        , m_cv()
+        , m_tasks()
+        , m_sessionTasks(1)
+        , m_hasSessionTasks(false)
+        , m_isStopped(false)
+        , m_thread()
+        {
+            m_thread = std::thread([this]() { _ThreadHandler(); });
+        }
+
+        ~_SyntheticCaptureWorker() override
+        {
+            {
+                std::scoped_lock lock(m_guard);
+                m_isStopped = true;
+            }
+            m_cv.notify_all();
+            m_thread.join();
+        }
+
+        void Invoke(const std::function<void(void)>& task) override
+        {
+            if (std::this_thread::get_id() == m_thread.get_id())
+            {
+                task();
+                return;
+            }
+            std::promise<void> done;
+            auto doneFuture = done.get_future();
+            {
+                std::scoped_lock lock(m_guard);
+                m_tasks.emplace_back(
+                    [&]()
+                    {
+                        try
+                        {
+                            task();
+                            done.set_value();
+                        }
+                        catch (...)
+                        {
+                            done.set_exception(std::current_exception());
+                        }
+                    }
+                );
+            }
+            m_cv.notify_one();
+            doneFuture.get();
+        }
+
+        void Post(const void* pSession, std::function<void(void)> task) override
+        {
+            m_sessionTasks.Push(pSession, std::move(task));
+            {
+                std::scoped_lock lock(m_guard);
+                m_hasSessionTasks = true;
+            }
+            m_cv.notify_one();
+        }
+
+        void Discard(const void* pSession) override
+        {
+            m_sessionTasks.Discard(pSession);
+        }
+
+    private:
+        void _ThreadHandler()
+        {
+            for (;;)
+            {
+                std::deque<std::function<void(void)>> tasks;
+                {
+                    std::unique_lock lock(m_guard);
+                    m_cv.wait(lock, [&]() { return m_isStopped || m_hasSessionTasks || !m_tasks.empty(); });
+                    if (m_isStopped)
+                    {
+                        return;
+                    }
+                    tasks.swap(m_tasks);
+                    m_hasSessionTasks = false;
+                }
+                for (const auto& task : tasks)
+                {
+                    task();
+                }
+                if (m_sessionTasks.RunRound())
+                {
+                    std::scoped_lock lock(m_guard);
+                    m_hasSessionTasks = true;
+                }
+            }
+        }
+
+        std::mutex                              m_guard;
+        std::condition_variable                 m_cv;
+        std::deque<std::function<void(void)>>   m_tasks;
+        ayc::CaptureTaskQueue                   m_sessionTasks;
+        bool                                    m_hasSessionTasks;
+        bool                                    m_isStopped;
+        std::thread                             m_thread;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // モックテクスチャを生成する
+    wgc::com_ptr<ID3D11Texture2D> _CreateMockTexture(std::size_t width, std::size_t height)
+    {
+        D3D11_TEXTURE2D_DESC desc{};
+        {
+            desc.Width = static_cast<UINT>(width);
+            desc.Height = static_cast<UINT>(height);
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        }
+        wgc::com_ptr<ID3D11Texture2D> pTexture;
+        pTexture.attach(new _MockTexture(desc));
+        return pTexture;
+    }
+
+    // フレームバッファを depth フレームで満たす
+    void _FillFrameBuffer(
+        ayc::FrameBuffer& frameBuffer,
+        _VirtualClock& clock,
+        const wgc::com_ptr<ID3D11Texture2D>& pTexture,
+        std::size_t depth
+    )
+    {
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            clock.Advance(BENCH_FRAME_INTERVAL);
+            frameBuffer.PushFrame(pTexture, clock.ToFunction()());
+        }
+    }
+
+    // 保持秒数を解決する
+    // @note: 最も古いフレームがちょうど収まるように、半フレームぶん余裕を持たせる
+    double _ToHoldInSec(std::size_t depth)
+    {
+        return std::chrono::duration<double>(BENCH_FRAME_INTERVAL).count() * (static_cast<double>(depth) - 0.5);
+    }
+
+    // 合成画像（BGR24）を生成する
+    // @note: 定数だと変換が速く見えることがあるので、それなりに変化のある絵にする
+    std::string _MakeTestImage(std::size_t width, std::size_t height)
+    {
+        std::string image(width * height * 3, '\0');
+        auto* const p = reinterpret_cast<std::uint8_t*>(image.data());
+        for (std::size_t v = 0; v < height; ++v)
+        {
+            for (std::size_t u = 0; u < width; ++u)
+            {
+                auto* const pPixel = p + (v * width + u) * 3;
+                pPixel[0] = static_cast<std::uint8_t>(u * 255 / width);
+                pPixel[1] = static_cast<std::uint8_t>(v * 255 / height);
+                pPixel[2] = static_cast<std::uint8_t>((u * 7 + v * 13) & 0xFF);
+            }
+        }
+        return image;
+    }
+
+    // FrameBuffer・FreezedFrameBuffer・スナップショットのインデックスマップを計測する
+    void _RunFrameBufferBenchmarks(_BenchRunner& runner)
+    {
+        const auto pTexture = _CreateMockTexture(BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT);
+        for (const auto depth : BENCH_DEPTHS)
+        {
+            const auto params = std::format("\"depth\": {}", depth);
+
+            // 定常状態（１枚追加して１枚追い出す）の PushFrame
+            {
+                _VirtualClock clock;
+                ayc::FrameBuffer frameBuffer(_ToHoldInSec(depth), nullptr, false, std::nullopt, std::nullopt, clock.ToFunction());
+                _FillFrameBuffer(frameBuffer, clock, pTexture, depth);
+                runner.Measure("frame_buffer.push_frame", params, 0, [&]()
+                {
+                    clock.Advance(BENCH_FRAME_INTERVAL);
+                    frameBuffer.PushFrame(pTexture, clock.ToFunction()());
+                });
+            }
+            // GetFrame
+            // @note: 相対時刻は保持範囲内を一巡させる
+            {
+                _VirtualClock clock;
+                ayc::FrameBuffer frameBuffer(_ToHoldInSec(depth), nullptr, false, std::nullopt, std::nullopt, clock.ToFunction());
+                _FillFrameBuffer(frameBuffer, clock, pTexture, depth);
+                const double holdInSec = _ToHoldInSec(depth);
+                std::size_t counter = 0;
+                runner.Measure("frame_buffer.get_frame", params, 0, [&]()
+                {
+                    const double relativeInSec = holdInSec * static_cast<double>(counter % 97) / 97.0;
+                    counter += 1;
+                    const auto source = frameBuffer.GetFrame(relativeInSec);
+                    if (!source)
+                    {
+                        throw MAKE_GENERAL_ERROR("GetFrame returned no frame");
+                    }
+                });
+            }
+            // FreezedFrameBuffer の構築とインデックスマップ
+            {
+                _VirtualClock clock;
+                ayc::FrameBuffer frameBuffer(_ToHoldInSec(depth), nullptr, false, std::nullopt, std::nullopt, clock.ToFunction());
+                _FillFrameBuffer(frameBuffer, clock, pTexture, depth);
+                runner.Measure("freezed_frame_buffer.construct", params, 0, [&]()
+                {
+                    const ayc::FreezedFrameBuffer freezed(frameBuffer, std::numeric_limits<double>::max());
+                    if (freezed.GetSize() != depth)
+                    {
+                        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unexpected snapshot size", freezed.GetSize());
+                    }
+                });
+
+                const ayc::FreezedFrameBuffer freezed(frameBuffer, std::numeric_limits<double>::max());
+                std::vector<std::size_t> indexUserToRaw;
+                std::vector<double> relativesInSec;
+                runner.Measure(
+                    "snapshot.resolve_index_map",
+                    std::format("{}, \"fps\": {}", params, BENCH_SNAPSHOT_FPS),
+                    0,
+                    [&]() { freezed.ResolveIndexMap(indexUserToRaw, relativesInSec, BENCH_SNAPSHOT_FPS, std::nullopt); }
+                );
+            }
+        }
+    }
+
+    // 画素変換カーネルを計測する
+    void _RunKernelBenchmarks(_BenchRunner& runner)
+    {
+        const std::size_t width = BENCH_FRAME_WIDTH;
+        const std::size_t height = BENCH_FRAME_HEIGHT;
+        const auto params = std::format("\"width\": {}, \"height\": {}", width, height);
+        const auto image = _MakeTestImage(width, height);
+        const auto* const pImage = reinterpret_cast<const std::uint8_t*>(image.data());
+
+        // BGR24 --> I420
+        const std::size_t chromaSize = ((width + 1) / 2) * ((height + 1) / 2);
+        std::vector<std::uint8_t> i420(width * height + chromaSize * 2);
+        runner.Measure("kernel.bgr_to_i420", params, image.size(), [&]()
+        {
+            ayc::ConvertBGRToI420(
+                i420.data(),
+                i420.data() + width * height,
+                i420.data() + width * height + chromaSize,
+                pImage,
+                width,
+                height,
+                ayc::YuvMatrix::BT709
+            );
+        });
+
+        // NV12 --> BGR24
+        // @note: 中身は I420 の輝度をそのまま使い、色差は適当に埋める
+        std::vector<std::uint8_t> nv12(width * height * 3 / 2, 128);
+        std::copy(i420.begin(), i420.begin() + width * height, nv12.begin());
+        std::vector<std::uint8_t> bgr(width * height * 3);
+        runner.Measure("kernel.nv12_to_bgr", params, bgr.size(), [&]()
+        {
+            ayc::ConvertNV12ToBGR(
+                bgr.data(),
+                nv12.data(),
+                width,
+                nv12.data() + width * height,
+                width,
+                width,
+                height
+            );
+        });
+
+        // BGR24 の面積平均縮小
+        const std::size_t thumbWidth = width / 4;
+        const std::size_t thumbHeight = height / 4;
+        std::vector<std::uint8_t> thumb(thumbWidth * thumbHeight * 3);
+        runner.Measure(
+            "kernel.resize_bgr_area",
+            std::format("{}, \"dst_width\": {}, \"dst_height\": {}", params, thumbWidth, thumbHeight),
+            image.size(),
+            [&]() { ayc::ResizeBGRArea(thumb.data(), thumbWidth, thumbHeight, thumbWidth * 3, pImage, width, height); }
+        );
+    }
+
+    // 読み出しパイプラインのスケジューリングを計測する
+    /* @note:
+        depth = 1 は転送と変換を交互に行う（従来の ReadbackTexture と同じ）。
+        depth を上げると、変換の裏で後続の転送が進むぶん速くなるはず。
+    */
+    void _RunReadbackBenchmarks(_BenchRunner& runner)
+    {
+        const std::size_t width = BENCH_FRAME_WIDTH;
+        const std::size_t height = BENCH_FRAME_HEIGHT;
+        const auto copyTimeInUs = std::chrono::duration_cast<std::chrono::microseconds>(BENCH_READBACK_COPY_TIME).count();
+        for (const auto depth : BENCH_READBACK_DEPTHS)
+        {
+            runner.Measure(
+                "readback.pipeline",
+                std::format(
+                    "\"width\": {}, \"height\": {}, \"frames\": {}, \"copy_us\": {}, \"depth\": {}",
+                    width, height, BENCH_READBACK_FRAMES, copyTimeInUs, depth
+                ),
+                width * height * 3 * BENCH_READBACK_FRAMES,
+                [&]()
+                {
+                    _MockReadbackBackend backend(BENCH_READBACK_FRAMES, BENCH_READBACK_COPY_TIME, width, height);
+                    ayc::RunReadbackPipeline(backend, BENCH_READBACK_FRAMES, depth);
+                }
+            );
+        }
+    }
+
+    // 単一フレームの変換のレイテンシをスレッド数ごとに計測する
+    /* @note:
+        GetFrameByTime のマップ後の変換段（ConvertMappedTextureToBGR）だけを測る。
+        スレッド数ごとにプールを作り直すので、プロセス共通のプールの大きさには依存しない。
+    */
+    void _RunLatencyBenchmarks(_BenchRunner& runner)
+    {
+        if (!runner.IsSelected("latency.convert_frame"))
+        {
+            return;
+        }
+        const std::size_t width = BENCH_LATENCY_FRAME_WIDTH;
+        const std::size_t height = BENCH_LATENCY_FRAME_HEIGHT;
+
+        // マップしたテクスチャの代わり
+        // @note: 実際の RowPitch と同じく、行末に余白を持たせる
+        const std::size_t bgraPitch = width * 4 + 64;
+        const auto image = _MakeTestImage(width, height);
+        std::vector<std::uint8_t> bgra(bgraPitch * height);
+        for (std::size_t v = 0; v < height; ++v)
+        {
+            for (std::size_t u = 0; u < width; ++u)
+            {
+                std::copy_n(image.data() + (v * width + u) * 3, 3, bgra.data() + v * bgraPitch + u * 4);
+            }
+        }
+        const std::size_t nv12Pitch = width + 64;
+        std::vector<std::uint8_t> nv12(nv12Pitch * height * 3 / 2, 128);
+        std::vector<std::uint8_t> bgr(width * height * 3);
+
+        for (const auto numThreads : BENCH_LATENCY_THREADS)
+        {
+            ayc::ThreadPool pool(numThreads - 1);
+            for (const bool isNV12 : { false, true })
+            {
+                runner.Measure(
+                    "latency.convert_frame",
+                    std::format(
+                        "\"width\": {}, \"height\": {}, \"format\": \"{}\", \"threads\": {}",
+                        width, height, isNV12 ? "nv12" : "bgra", numThreads
+                    ),
+                    bgr.size(),
+                    [&]()
+                    {
+                        ayc::ConvertMappedTextureToBGR(
+                            bgr.data(),
+                            isNV12 ? nv12.data() : bgra.data(),
+                            isNV12 ? nv12Pitch : bgraPitch,
+                            width,
+                            height,
+                            isNV12,
+                            pool
+                        );
+                    }
+                );
+            }
+        }
+    }
+
+    // スナップショット１つ分の読み出し結果の確保・書き込み・解放を計測する
+    /* @note:
+        string はフレームごとに確保する従来の方式、arena は HostArenaPool から１つのアリーナを得る方式。
+        書き込みは全ページに触れるので、新しく確保したメモリのページフォールトも含めて測る。
+    */
+    void _RunHostBufferBenchmarks(_BenchRunner& runner)
+    {
+        const std::size_t frameSize = BENCH_FRAME_WIDTH * BENCH_FRAME_HEIGHT * 3;
+        const std::size_t numFrames = BENCH_HOST_BUFFER_FRAMES;
+        const auto params = std::format(
+            "\"width\": {}, \"height\": {}, \"frames\": {}",
+            BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT, numFrames
+        );
+        runner.Measure(
+            "alloc.snapshot_buffers",
+            std::format("{}, \"mode\": \"string\"", params),
+            frameSize * numFrames,
+            [&]()
+            {
+                std::vector<std::string> frames(numFrames);
+                for (auto& frame : frames)
+                {
+                    frame.resize(frameSize);
+                    std::memset(frame.data(), 0x80, frame.size());
+                }
+            }
+        );
+        // @note: プロセス共通のプールの設定に依存しないよう、専用のプールを使う
+        ayc::HostArenaPool pool(frameSize * numFrames * 2);
+        runner.Measure(
+            "alloc.snapshot_buffers",
+            std::format("{}, \"mode\": \"arena\"", params),
+            frameSize * numFrames,
+            [&]()
+            {
+                const auto pArena = pool.Acquire(frameSize, numFrames);
+                for (std::size_t i = 0; i < numFrames; ++i)
+                {
+                    std::memset(pArena->GetSlot(i), 0x80, frameSize);
+                }
+            }
+        );
+    }
+
+    // キャプチャスケジューラのスケーリングを計測する
+    /* @note:
+        合成ワーカーを使い、全セッションが１フレームずつ仕事を投入してから全て処理されるまでを１回とする。
+        ワーカー数を増やした時の伸びと、セッション数を増やした時の劣化を見る。
+    */
+    void _RunSchedulerBenchmarks(_BenchRunner& runner)
+    {
+        if (!runner.IsSelected("scaling.capture_scheduler"))
+        {
+            return;
+        }
+        const std::vector<std::uint8_t> frame(BENCH_SCALING_FRAME_BYTES, 0x80);
+        for (const auto numWorkers : BENCH_SCALING_WORKERS)
+        {
+            for (const auto numSessions : BENCH_SCALING_SESSIONS)
+            {
+                ayc::CaptureScheduler scheduler(
+                    []() { return std::make_shared<_SyntheticCaptureWorker>(); },
+                    numWorkers
+                );
+                std::vector<std::shared_ptr<ayc::ICaptureWorker>> workers;
+                for (std::size_t s = 0; s < numSessions; ++s)
+                {
+                    workers.push_back(scheduler.Register());
+                }
+                // @note: セッションごとに結果を書き込み、最適化で消されないようにする
+                std::vector<std::uint64_t> sinks(numSessions, 0);
+                runner.Measure(
+                    "scaling.capture_scheduler",
+                    std::format(
+                        "\"sessions\": {}, \"workers\": {}, \"frame_bytes\": {}",
+                        numSessions, numWorkers, BENCH_SCALING_FRAME_BYTES
+                    ),
+                    numSessions * BENCH_SCALING_FRAME_BYTES,
+                    [&]()
+                    {
+                        std::atomic<std::size_t> numRemaining(numSessions);
+                        std::promise<void> done;
+                        for (std::size_t s = 0; s < numSessions; ++s)
+                        {
+                            workers[s]->Post(
+                                &sinks[s],
+                                [&, s]()
+                                {
+                                    sinks[s] += std::accumulate(frame.begin(), frame.end(), std::uint64_t(0));
+                                    if (numRemaining.fetch_sub(1) == 1)
+                                    {
+                                        done.set_value();
+                                    }
+                                }
+                            );
+                        }
+                        done.get_future().wait();
+                    }
+                );
+                for (const auto& pWorker : workers)
+                {
+                    scheduler.Unregister(pWorker);
+                }
+            }
+        }
+    }
+
+    // 昇順に並べたサンプルからパーセンタイルを得る
+    double _Percentile(const std::vector<double>& sorted, double ratio)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        const auto index = static_cast<std::size_t>(ratio * static_cast<double>(sorted.size() - 1));
+        return sorted[index];
+    }
+
+    // 指定時刻まで待つ
+    // @note: 大半は sleep で待ち、最後だけ yield しながらスピンする
+    void _WaitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        const auto sleepUntil = deadline - BENCH_STRESS_SPIN_MARGIN;
+        if (std::chrono::steady_clock::now() < sleepUntil)
+        {
+            std::this_thread::sleep_until(sleepUntil);
+        }
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // 生産者１つと読み手 numReaders 個で FrameBuffer を奪い合わせる
+    /* @note:
+        生産者はキャプチャスレッドを模して rateInHz で PushFrame し続ける。
+        読み手は Python スレッドを模して、GetFrame（GetFrameByTime 相当）を繰り返し、
+        BENCH_STRESS_FREEZE_INTERVAL 回に１回 FreezedFrameBuffer（Snapshot 相当）を作る。
+        時刻は実時間（NowFromQPC）を使う。
+    */
+    _STRESS_RESULT _RunStress(double rateInHz, std::size_t numReaders, double durationInSec)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const auto pTexture = _CreateMockTexture(BENCH_FRAME_WIDTH, BENCH_FRAME_HEIGHT);
+        ayc::FrameBuffer frameBuffer(BENCH_STRESS_HOLD_IN_SEC);
+
+        // 保持秒数ぶんのフレームを過去の時刻で詰めておく
+        // @note: 最初から定常状態（１枚追加して１枚追い出す）で計測するため
+        const auto interval = std::chrono::duration_cast<wgc::TimeSpan>(std::chrono::duration<double>(1.0 / rateInHz));
+        {
+            const auto numPrefill = static_cast<std::size_t>(BENCH_STRESS_HOLD_IN_SEC * rateInHz);
+            const auto nowInTS = ayc::NowFromQPC();
+            for (std::size_t i = numPrefill; i > 0; --i)
+            {
+                frameBuffer.PushFrame(pTexture, nowInTS - interval * static_cast<wgc::TimeSpan::rep>(i));
+            }
+        }
+
+        // 読み手
+        std::atomic<bool> isStopped = false;
+        std::vector<std::uint64_t> lookupsList(numReaders, 0);
+        std::vector<std::uint64_t> freezesList(numReaders, 0);
+        std::vector<std::thread> readers;
+        for (std::size_t r = 0; r < numReaders; ++r)
+        {
+            readers.emplace_back([&, r]()
+            {
+                // @note: 読み手ごとに引く時刻をずらす
+                std::size_t counter = r * 31;
+                std::uint64_t lookups = 0;
+                std::uint64_t freezes = 0;
+                while (!isStopped.load(std::memory_order_relaxed))
+                {
+                    counter += 1;
+                    if (counter % BENCH_STRESS_FREEZE_INTERVAL == 0)
+                    {
+                        const ayc::FreezedFrameBuffer freezed(frameBuffer, 1.0);
+                        freezes += 1;
+                    }
+                    else
+                    {
+                        const double relativeInSec = BENCH_STRESS_HOLD_IN_SEC * static_cast<double>(counter % 97) / 97.0;
+                        const auto source = frameBuffer.GetFrame(relativeInSec);
+                        lookups += 1;
+                    }
+                }
+                lookupsList[r] = lookups;
+                freezesList[r] = freezes;
+            });
+        }
+
+        // 生産者
+        // @note: 予定時刻は開始時刻からの等間隔で決め、遅れても詰め直さない
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rateInHz));
+        const auto numPushes = static_cast<std::size_t>(durationInSec * rateInHz);
+        std::vector<double> latenciesInUs;
+        latenciesInUs.reserve(numPushes);
+        std::size_t numMissed = 0;
+        const auto start = Clock::now();
+        for (std::size_t i = 0; i < numPushes; ++i)
+        {
+            const auto deadline = start + period * static_cast<Clock::rep>(i + 1);
+            _WaitUntil(deadline);
+
+            const auto pushStart = Clock::now();
+            frameBuffer.PushFrame(pTexture, ayc::NowFromQPC());
+            const auto pushStop = Clock::now();
+
+            latenciesInUs.push_back(std::chrono::duration<double, std::micro>(pushStop - pushStart).count());
+            if (pushStop > deadline + period)
+            {
+                numMissed += 1;
+            }
+        }
+        const double elapsedInSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // 後始末
+        isStopped = true;
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+
+        // 集計
+        std::ranges::sort(latenciesInUs);
+        const auto lookups = std::accumulate(lookupsList.begin(), lookupsList.end(), std::uint64_t(0));
+        const auto freezes = std::accumulate(freezesList.begin(), freezesList.end(), std::uint64_t(0));
+        return _STRESS_RESULT{
+            "stress.frame_buffer",
+            std::format(
+                "\"rate_hz\": {}, \"readers\": {}, \"duration_in_sec\": {}, \"hold_in_sec\": {}, \"freeze_interval\": {}",
+                rateInHz,
+                numReaders,
+                durationInSec,
+                BENCH_STRESS_HOLD_IN_SEC,
+                BENCH_STRESS_FREEZE_INTERVAL
+            ),
+            numPushes,
+            _Percentile(latenciesInUs, 0.5),
+            _Percentile(latenciesInUs, 0.9),
+            _Percentile(latenciesInUs, 0.99),
+            _Percentile(latenciesInUs, 0.999),
+            latenciesInUs.empty() ? 0.0 : latenciesInUs.back(),
+            numPushes > 0 ? static_cast<double>(numMissed) / static_cast<double>(numPushes) : 0.0,
+            lookups,
+            freezes,
+            static_cast<double>(lookups + freezes) / elapsedInSec
+        };
+    }
+
+    // 競合ストレスを計測する
+    void _RunStressBenchmarks(_BenchRunner& runner, const _STRESS_PARAM& param)
+    {
+        if (!runner.IsSelected("stress.frame_buffer"))
+        {
+            return;
+        }
+        for (const auto numReaders : param.numReadersList)
+        {
+            std::cerr << std::format("stress.frame_buffer {{rate_hz: {}, readers: {}}}", param.rateInHz, numReaders) << std::endl;
+            runner.AddStressResult(_RunStress(param.rateInHz, numReaders, param.durationInSec));
+        }
+    }
+
+    // カンマ区切りの数値リストをパースする
+    std::vector<std::size_t> _ParseSizeList(const std::string& text)
+    {
+        std::vector<std::size_t> values;
+        std::istringstream iss(text);
+        std::string token;
+        while (std::getline(iss, token, ','))
+        {
+            values.push_back(static_cast<std::size_t>(std::stoull(token)));
+        }
+        if (values.empty())
+        {
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid list", text);
+        }
+        return values;
+    }
+
+    // 計測結果を JSON で書き出す
+    void _WriteJson(std::ostream& os, const _BenchRunner& runner)
+    {
+        const auto& results = runner.GetResults();
+        const auto& stressResults = runner.GetStressResults();
+        os << "{\n";
+        os << std::format("  \"schema_version\": {},\n", BENCH_SCHEMA_VERSION);
+        os << std::format("  \"min_time_in_sec\": {},\n", BENCH_MIN_TIME_IN_SEC);
+        os << std::format("  \"hardware_concurrency\": {},\n", std::thread::hardware_concurrency());
+        os << "  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            os << std::format(
+                "    {{\"name\": \"{}\", \"params\": {{{}}}, \"iterations\": {}, \"ns_per_op\": {:.1f}, \"mb_per_sec\": {:.1f}}}{}\n",
+                r.name,
+                r.params,
+                r.iterations,
+                r.nsPerOp,
+                r.mbPerSec,
+                (i + 1 < results.size()) ? "," : ""
+            );
+        }
+        os << "  ],\n";
+        os << "  \"stress\": [\n";
+        for (std::size_t i = 0; i < stressResults.size(); ++i)
+        {
+            const auto& r = stressResults[i];
+            os << std::format(
+                "    {{\"name\": \"{}\", \"params\": {{{}}}, \"pushes\": {}, "
+                "\"push_latency_in_us\": {{\"p50\": {:.1f}, \"p90\": {:.1f}, \"p99\": {:.1f}, \"p999\": {:.1f}, \"max\": {:.1f}}}, "
+                "\"missed_deadline_ratio\": {:.4f}, \"lookups\": {}, \"freezes\": {}, \"reader_ops_per_sec\": {:.1f}}}{}\n",
+                r.name,
+                r.params,
+                r.pushes,
+                r.pushP50InUs,
+                r.pushP90InUs,
+                r.pushP99InUs,
+                r.pushP999InUs,
+                r.pushMaxInUs,
+                r.missedRatio,
+                r.lookups,
+                r.freezes,
+                r.readerOpsPerSec,
+                (i + 1 < stressResults.size()) ? "," : ""
+            );
+        }
+        os << "  ]\n";
+        os << "}\n";
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Entry Point
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    /* @note:
+        usage: bench.exe [filter] [--rate=HZ] [--readers=N,N,...] [--duration=SEC]
+        filter を指定すると、名前にその文字列を含む項目だけを計測する。
+        --rate・--readers・--duration は競合ストレス（stress.*）の生産者のレート・読み手の数・計測時間。
+        結果は標準出力に JSON で書き出し、進捗は標準エラー出力に出す。
+    */
+    try
+    {
+        // 引数
+        std::string filter = "";
+        _STRESS_PARAM stressParam{
+            BENCH_STRESS_RATE_HZ,
+            std::vector<std::size_t>(std::begin(BENCH_STRESS_READERS), std::end(BENCH_STRESS_READERS)),
+            BENCH_STRESS_DURATION_IN_SEC
+        };
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (arg.starts_with("--rate="))
+            {
+                stressParam.rateInHz = std::stod(arg.substr(7));
+            }
+            else if (arg.starts_with("--readers="))
+            {
+                stressParam.numReadersList = _ParseSizeList(arg.substr(10));
+            }
+            else if (arg.starts_with("--duration="))
+            {
+                stressParam.durationInSec = std::stod(arg.substr(11));
+            }
+            else if (arg.starts_with("--"))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown option", arg);
+            }
+            else
+            {
+                filter = arg;
+            }
+        }
+        if (!(stressParam.rateInHz > 0.0) || !(stressParam.durationInSec > 0.0))
+        {
+            throw MAKE_GENERAL_ERROR("Stress rate and duration must be positive");
+        }
+
+        _BenchRunner runner(filter);
+        _RunFrameBufferBenchmarks(runner);
+        _RunKernelBenchmarks(runner);
+        _RunReadbackBenchmarks(runner);
+        _RunLatencyBenchmarks(runner);
+        _RunHostBufferBenchmarks(runner);
+        _RunSchedulerBenchmarks(runner);
+        _RunStressBenchmarks(runner, stressParam);
+        _WriteJson(std::cout, runner);
+    }
+    catch (const ayc::GeneralError& e)
+    {
+        std::cerr << e.ToString() << std::endl;
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,9 +1,90 @@
 ﻿
 #pragma once
 
+#include "cold_frame_store.h"
+#include "host_arena.h"
+#include "memory_tracker.h"
+#include "staging_texture_ring.h"
+#include "thread_pool.h"
+
 namespace ayc
 {
+	// ステージングテクスチャへの転送を発行済みの読み出し
+	/* @note:
+		生成時に転送（CopyResource）を発行するだけで、完了は待たない。
+		TryReadback で GPU を待たずに完了を確かめ、終わっていればメモリイメージを読み出す。
+		転送の後ろにイベントクエリを置き、WaitForCopy はその完了を見ながら待つ。
+		ステージングテクスチャは StagingTextureRing から借り、破棄時に返す。
+	*/
+	class PendingTextureReadback
+	{
+	public:
+		// コンストラクタ
+		explicit PendingTextureReadback(const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture);
+
+		// デストラクタ
+		~PendingTextureReadback();
+
+		// コピー禁止
+		PendingTextureReadback(const PendingTextureReadback&) = delete;
+		PendingTextureReadback& operator=(const PendingTextureReadback&) = delete;
+
+		// 転送が終わっていればメモリイメージを pDst に読み出して true を返す
+		/* @note:
+			終わっていなければ何もせずに false を返す。
+			pDst は GetWidth() * GetHeight() * 3 バイト。
+		*/
+		bool TryReadback(std::uint8_t* pDst);
+
+		// 論理サイズの幅
+		std::size_t GetWidth() const noexcept
+		{
+			return m_logicalWidth;
+		}
+
+		// 論理サイズの高さ
+		std::size_t GetHeight() const noexcept
+		{
+			return m_logicalHeight;
+		}
+
+		// 転送が終わるまで最大 maxWait 待つ
+		/* @note:
+			終わっていれば true を返す。
+			最初は yield しながら見張り、それでも終わらなければ sleep を挟んで CPU を空ける。
+		*/
+		bool WaitForCopy(std::chrono::microseconds maxWait);
+
+	private:
+		// 転送が終わっていれば true
+		bool _IsCopyDone();
+
+		wgc::com_ptr<ID3D11Texture2D>	m_pStagingTexture;
+		wgc::com_ptr<ID3D11Query>		m_pCopyQuery;		// 転送の完了を表すイベントクエリ。作れなければ nullptr
+		bool							m_isFlushed;
+		std::size_t						m_logicalWidth;
+		std::size_t						m_logicalHeight;
+		bool							m_isNV12;
+	};
+
+	// マップしたステージングテクスチャの中身を BGR24 に変換する
+	/* @note:
+		pSrc は BGRA（isNV12 が false）か、輝度の後に色差を詰めた NV12（isNV12 が true）。
+		一定以上の大きさのフレームは、行を帯に分けて pool で並列に変換する。
+		pDst は width * height * 3 バイト。
+	*/
+	void ConvertMappedTextureToBGR(
+		std::uint8_t* pDst,
+		const std::uint8_t* pSrc,
+		std::size_t rowPitch,
+		std::size_t width,
+		std::size_t height,
+		bool isNV12,
+		ThreadPool& pool
+	);
+
 	// テクスチャからメモリイメージを読み出す
+	// @note: 転送の完了まで待つ
 	void ReadbackTexture(
 		std::size_t& outWidth,
 		std::size_t& outHeight,
@@ -11,20 +92,55 @@ namespace ayc
 		const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture
 	);
 
+	// テクスチャからメモリイメージを HostArenaPool のバッファに読み出す
+	// @note: 同じ大きさのフレームを読み続けると、バッファが使い回される
+	void ReadbackTexture(
+		std::size_t& outWidth,
+		std::size_t& outHeight,
+		HostBuffer& outBuffer,
+		const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture
+	);
+
+	// ホット層・コールド層どちらのフレームからでもメモリイメージを読み出す
+	/* @note:
+		コールド層のフレームは pDecoder で展開する。
+		続けて何枚も読み出す場合は同じ ColdFrameDecoder を渡すと、差分の展開を使い回せる。
+	*/
+	void ReadbackFrame(
+		std::size_t& outWidth,
+		std::size_t& outHeight,
+		std::string& outBuffer,
+		const FRAME_SOURCE& source,
+		ColdFrameDecoder* pDecoder = nullptr
+	);
+
 	// GPU テクスチャのメインメモリへの読み出しを非同期で行うクラス
-	class AsyncTextureReadback
+	/* @note:
+		ThreadPool のワーカー上で ReadbackPipeline を少しずつ進め、転送を先行発行しながら順に読み出す。
+		生成したスレッドの優先度で積むので、スナップショットは BULK、GetFrameByTimeAsync は INTERACTIVE になる。
+		読み出し結果は、最大のフレームに合わせたスロットを持つ HostArena １つに詰める。
+		アリーナは全ての結果（Python に渡したものを含む）が破棄されるとプールに戻る。
+	*/
+	class AsyncTextureReadback : private IReadbackBackend
 	{
 	public:
 		struct RESULT
 		{
 			std::size_t width;
 			std::size_t height;
-			std::string textureBuffer;
+			HostBuffer textureBuffer;
 		};
 
+		// 転送完了ハンドラ
+		/* @note:
+			BG スレッド上から呼ばれる。
+			キャンセルされた場合と失敗した場合は pResult が nullptr になる。
+		*/
+		using CompletionHandler = std::function<void(const RESULT* pResult, std::exception_ptr pError)>;
+
 		// コンストラクタ
 		AsyncTextureReadback(
-			const std::vector<wgc::com_ptr<ID3D11Texture2D>>& sourceTextures
+			const std::vector<FRAME_SOURCE>& sources
 		);
 
 		// デストラクタ
@@ -37,23 +153,95 @@ namespace ayc
 		// 読み出し結果を得る
 		const RESULT& operator[](std::size_t index) const;
 
+		// 転送完了ハンドラを登録する
+		// @note: 既に転送が終わっていれば、呼び出し元スレッド上で即座に呼ばれる
+		void OnCompleted(std::size_t index, CompletionHandler handler);
+
+		// 転送の数（間引かれたフレームを含む）
+		std::size_t GetSize() const noexcept
+		{
+			return m_jobs.size();
+		}
+
+		// 転送の待ち手を１つ増やす
+		/* @note:
+			同じ転送を複数の待ち手（スナップショット本体・asyncio の Future など）で共有する時は、
+			待ち手ごとに Retain し、待つのをやめたら Release する。
+			間引かれたフレームに対しては何もしない。
+		*/
+		void Retain(std::size_t index);
+
+		// 転送の待ち手を１つ減らす
+		// @note: 待ち手が無くなった未着手の転送はキャンセルする。転送中・転送済みならキャンセルしない
+		void Release(std::size_t index);
+
+		// 読み出し結果の記帳先を得る
+		// @note: 生成したスレッドの記帳先（MemoryTracker::Current）
+		const std::shared_ptr<MemoryTracker>& GetMemoryTracker() const noexcept
+		{
+			return m_pMemoryTracker;
+		}
+
 	private:
+		// 転送状態
+		enum class _STATUS
+		{
+			PENDING,
+			RUNNING,
+			COMPLETED,
+			FAILED,
+			CANCELLED,
+		};
+
 		// 転送結果の取得権オブジェクト
 		struct _JOB
 		{
-			wgc::com_ptr<ID3D11Texture2D>	pSourceTexture;
-			RESULT							result;
-			bool							completed;
+			FRAME_SOURCE							source;
+			RESULT									result;
+			_STATUS									status;
+			std::exception_ptr						pError;
+			std::vector<CompletionHandler>			handlers;
+			std::unique_ptr<PendingTextureReadback>	pPending;	// 発行済み・未完了の転送
+			std::size_t								slotIndex;	// m_pArena 上の読み出し先
+			std::size_t								numWaiters;	// Retain された数
 		};
 
-		// BG スレッドハンドラ
-		void _ThreadHandler();
+		// 転送が終わっているなら true を返す
+		static bool _IsFinished(const _JOB& job);
+
+		// 転送完了ハンドラを呼ぶ
+		static void _InvokeHandler(const _JOB& job, const CompletionHandler& handler);
+
+		// 転送を完了・失敗させて通知する
+		void _Finish(_JOB& job, std::exception_ptr pError);
+
+		// 全ての読み出し結果を詰めるアリーナを得る
+		// @note: BG スレッドからのみ呼ばれる
+		void _AcquireArena();
+
+		// IReadbackBackend
+		// @note: BG スレッドからのみ呼ばれる
+		bool Issue(std::size_t index) override;
+		bool TryComplete(std::size_t index) override;
+		void WaitForProgress(std::size_t index) override;
+
+		// 終わっていない転送を全て失敗させる
+		void _FailUnfinished(std::exception_ptr pError);
+
+		// 読み出しを少し進める
+		// @note: ThreadPool に Submit して実行する。終わっていなければ自分を積み直す
+		void _RunStep();
 
 		// 内部状態
-		mutable std::mutex				m_mutex;
-		mutable std::condition_variable	m_cv;
-		std::vector<_JOB>				m_jobs;
-		std::thread						m_thread;
+		mutable std::mutex					m_mutex;
+		mutable std::condition_variable		m_cv;
+		std::vector<_JOB>					m_jobs;
+		std::unique_ptr<ReadbackPipeline>	m_pPipeline;	// _RunStep からのみ触る
+		std::promise<void>					m_done;
+		std::future<void>					m_task;		// 全ての _RunStep の完了
+		std::shared_ptr<MemoryTracker>		m_pMemoryTracker;
+		std::shared_ptr<HostArena>			m_pArena;		// 読み出し結果の置き場所
+		ColdFrameDecoder					m_decoder;		// コールド層のフレームは時刻順に並んでいるので、展開を使い回す
 	};
 }
 
@@ -0,0 +1,153 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// ICaptureWorker
+	//-------------------------------------------------------------------------
+
+	// キャプチャワーカーのインターフェース
+	/* @note:
+		複数のキャプチャアイテムを所有するスレッド１本を表す。
+		スケジューラ本体はこのインターフェースにしか依存しないので、
+		合成ソースを流すワーカーに差し替えればスケーリング挙動を WGC 抜きで計測できる。
+	*/
+	class ICaptureWorker
+	{
+	public:
+		// デストラクタ
+		// @note: ワーカースレッドの終了を待機する
+		virtual ~ICaptureWorker() = default;
+
+		// ワーカースレッド上でタスクを同期実行する
+		// @note: タスク内で発生した例外は呼び出し元に再送される
+		virtual void Invoke(const std::function<void(void)>& task) = 0;
+
+		// セッションの仕事を非同期で投入する
+		/* @note:
+			投入した仕事は CaptureTaskQueue に積まれ、セッション単位のラウンドロビンで実行される。
+			１つのセッションが仕事を積み続けても、他のセッションにも毎巡回で順番が回ってくる。
+		*/
+		virtual void Post(const void* pSession, std::function<void(void)> task) = 0;
+
+		// セッションの未実行の仕事を捨てる
+		// @note: 仕事が参照しているオブジェクトを破棄する前に、ワーカースレッド上で呼ぶこと
+		virtual void Discard(const void* pSession) = 0;
+	};
+
+	//-------------------------------------------------------------------------
+	// CaptureTaskQueue
+	//-------------------------------------------------------------------------
+
+	// セッション間で公平に仕事を取り出すキュー
+	/* @note:
+		ICaptureWorker の実装が使う、スレッドに依存しない部分。
+		セッションごとに FIFO を持ち、RunRound の１回で各セッションから最大 budgetPerSession 件ずつ実行する。
+		巡回の先頭は毎回ずらすので、特定のセッションだけが常に先に処理されることもない。
+		投入はどのスレッドからでもよいが、RunRound は１スレッドからのみ呼ぶこと。
+		巡回中に取り出し済みの仕事は Discard では止まらないので、Discard も RunRound と同じスレッドから呼ぶこと。
+	*/
+	class CaptureTaskQueue
+	{
+	public:
+		// コンストラクタ
+		explicit CaptureTaskQueue(std::size_t budgetPerSession);
+
+		// デストラクタ
+		~CaptureTaskQueue() = default;
+
+		// コピー禁止
+		CaptureTaskQueue(const CaptureTaskQueue&) = delete;
+		CaptureTaskQueue& operator=(const CaptureTaskQueue&) = delete;
+
+		// セッションの仕事を積む
+		void Push(const void* pSession, std::function<void(void)> task);
+
+		// セッションの未実行の仕事を捨てる
+		void Discard(const void* pSession);
+
+		// 全てのセッションの仕事を捨てる
+		void Clear();
+
+		// 仕事を抱えているセッションを１巡する
+		/* @note:
+			呼び出し時点で仕事を抱えているセッションだけを巡回する。
+			仕事の中で投げられた例外はログに出して握りつぶす（他のセッションを止めないため）。
+			巡回後も仕事が残っていれば true を返す。
+		*/
+		bool RunRound();
+
+		// 未実行の仕事の数
+		std::size_t GetNumPending() const;
+
+	private:
+		// セッション１つ分の仕事
+		struct _SESSION
+		{
+			const void*								pSession;
+			std::deque<std::function<void(void)>>	tasks;
+		};
+
+		mutable std::mutex		m_guard;
+		std::deque<_SESSION>	m_sessions;		// 巡回順、仕事を抱えているセッションのみ
+		std::size_t				m_numPending;
+		std::size_t				m_budgetPerSession;
+	};
+
+	//-------------------------------------------------------------------------
+	// CaptureScheduler
+	//-------------------------------------------------------------------------
+
+	// キャプチャスケジューラ
+	/* @note:
+		セッションごとにスレッドを立てるのではなく、
+		少数のワーカースレッドに複数のセッションを相乗りさせる。
+		新しいセッションは担当セッション数が最も少ないワーカーに割り当てる。
+	*/
+	class CaptureScheduler
+	{
+	public:
+		// ワーカー生成関数
+		typedef std::function<std::shared_ptr<ICaptureWorker>(void)> WorkerFactory;
+
+		// コンストラクタ
+		CaptureScheduler(
+			WorkerFactory workerFactory,
+			std::size_t maxWorkers
+		);
+
+		// デストラクタ
+		~CaptureScheduler() = default;
+
+		// コピー禁止
+		CaptureScheduler(const CaptureScheduler&) = delete;
+		CaptureScheduler& operator=(const CaptureScheduler&) = delete;
+
+		// 最大ワーカー数を設定する
+		// @note: 稼働中のワーカーには影響しない、以降の割り当てから反映される
+		void SetMaxWorkers(std::size_t maxWorkers);
+
+		// セッションを登録し、担当ワーカーを得る
+		std::shared_ptr<ICaptureWorker> Register();
+
+		// セッションの登録を解除する
+		// @note: 担当セッションが無くなったワーカーは終了する
+		void Unregister(const std::shared_ptr<ICaptureWorker>& pWorker);
+
+		// 稼働中ワーカーごとの担当セッション数を得る
+		std::vector<std::size_t> GetLoads() const;
+
+	private:
+		// ワーカー１本分の管理情報
+		struct _ENTRY
+		{
+			std::shared_ptr<ICaptureWorker>	pWorker;
+			std::size_t						numSessions;
+		};
+
+		WorkerFactory		m_workerFactory;
+		mutable std::mutex	m_guard;
+		std::vector<_ENTRY>	m_entries;
+		std::size_t			m_maxWorkers;
+	};
+}
@@ -0,0 +1,231 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Constants
+	//-------------------------------------------------------------------------
+
+	// キーフレームの間隔
+	/* @note:
+		キーフレーム以外はキーフレームからタイル単位の差分で保持する。
+		１枚を復元するコストは「キーフレーム＋差分１枚」で頭打ちになるので、
+		間隔を延ばすと変化が累積して差分タイルが増えることだけが代償になる。
+	*/
+	constexpr std::size_t COLD_FRAME_KEYFRAME_INTERVAL = 30;
+
+	// タイル１辺のピクセル数
+	constexpr std::size_t COLD_FRAME_TILE_SIZE = 64;
+
+	//-------------------------------------------------------------------------
+	// Forward Declaration
+	//-------------------------------------------------------------------------
+
+	class SpillSegment;
+
+	//-------------------------------------------------------------------------
+	// ColdFrame
+	//-------------------------------------------------------------------------
+
+	// ホストメモリ上に圧縮して保持するフレーム
+	/* @note:
+		画素は ReadbackTexture と同じ BGR24 (stride = width * 3)。
+		フレームを COLD_FRAME_TILE_SIZE 四方のタイルに区切り、タイルごとに LZ 系の可逆圧縮にかけて保持する。
+		キーフレームは全タイルの画素そのものを、
+		それ以外はキーフレームから変化したタイルだけをキーフレームとのバイト差分で保持する。
+		直前のフレームと同じ内容の差分タイルは、直前のフレームと共有する。
+		SpillStore でディスクに書き出したフレームは、タイルをセグメントファイルのマップ先から直接読む。
+		生成後は不変なので、複数スレッドから同時に読んでよい。
+	*/
+	class ColdFrame
+	{
+		friend class ColdFrameEncoder;
+		friend class ColdFrameDecoder;
+		friend class SpillStore;
+
+	public:
+		// 幅
+		std::size_t GetWidth() const noexcept
+		{
+			return m_width;
+		}
+
+		// 高さ
+		std::size_t GetHeight() const noexcept
+		{
+			return m_height;
+		}
+
+		// キーフレームなら true を返す
+		bool IsKeyframe() const noexcept
+		{
+			return !m_pKeyframe;
+		}
+
+		// 差分の元になるキーフレーム
+		// @note: キーフレームなら nullptr
+		const std::shared_ptr<const ColdFrame>& GetKeyframe() const noexcept
+		{
+			return m_pKeyframe;
+		}
+
+		// ディスクに書き出したフレームなら true を返す
+		bool IsSpilled() const noexcept
+		{
+			return static_cast<bool>(m_pSegment);
+		}
+
+		// 圧縮後のサイズ
+		/* @note:
+			直前のフレーム・キーフレームと共有しているタイルは含まない。
+			ディスクに書き出したフレームは、メモリ上に残っている管理領域のサイズ。
+		*/
+		std::size_t GetSizeInBytes() const noexcept
+		{
+			return m_sizeInBytes;
+		}
+
+		// ディスク上のサイズ
+		// @note: ディスクに書き出していなければゼロ
+		std::size_t GetSpilledSizeInBytes() const noexcept
+		{
+			return m_spilledSizeInBytes;
+		}
+
+		// 書き出し先セグメントの通し番号
+		// @note: ディスクに書き出していなければゼロ
+		std::uint64_t GetSegmentId() const noexcept
+		{
+			return m_segmentId;
+		}
+
+		// 展開後のサイズ
+		std::size_t GetRawSizeInBytes() const noexcept
+		{
+			return m_width * m_height * 3;
+		}
+
+		// タイル数
+		std::size_t GetNumTiles() const noexcept
+		{
+			return m_numTilesX * m_numTilesY;
+		}
+
+		// このフレーム自身が保持しているタイル数
+		std::size_t GetNumStoredTiles() const noexcept
+		{
+			return m_numStoredTiles;
+		}
+
+	private:
+		// タイルの圧縮データを得る
+		// @note: キーフレームから変化していないタイルなら空
+		std::span<const std::uint8_t> _GetTile(std::size_t index) const;
+
+		std::size_t										m_width;
+		std::size_t										m_height;
+		std::size_t										m_numTilesX;
+		std::size_t										m_numTilesY;
+		std::shared_ptr<const ColdFrame>				m_pKeyframe;
+		std::vector<std::uint64_t>						m_tileHashes;
+		std::vector<std::shared_ptr<const std::string>>	m_tiles;		// @note: キーフレームから変化していないタイルは nullptr
+		std::size_t										m_numStoredTiles;
+		std::size_t										m_sizeInBytes;
+		std::shared_ptr<const SpillSegment>				m_pSegment;		// @note: ディスクに書き出したフレームだけが持つ
+		std::uint64_t									m_segmentId;
+		std::uint64_t									m_recordOffset;
+		std::size_t										m_spilledSizeInBytes;
+	};
+
+	//-------------------------------------------------------------------------
+	// ColdFrameEncoder
+	//-------------------------------------------------------------------------
+
+	// 到着順にフレームを圧縮するクラス
+	/* @note:
+		キーフレームと直前に圧縮したフレームを覚えておくので、
+		１つのインスタンスは１本のフレーム列専用。スレッドセーフではない。
+	*/
+	class ColdFrameEncoder
+	{
+	public:
+		// コンストラクタ
+		ColdFrameEncoder();
+
+		// デストラクタ
+		~ColdFrameEncoder() = default;
+
+		// BGR24 の画素を圧縮する
+		std::shared_ptr<const ColdFrame> Encode(
+			std::size_t width,
+			std::size_t height,
+			const std::string& buffer
+		);
+
+	private:
+		std::shared_ptr<const ColdFrame>	m_pKeyframe;
+		std::string							m_keyframeBuffer;
+		std::shared_ptr<const ColdFrame>	m_pPrevFrame;
+		std::string							m_prevBuffer;
+		std::size_t							m_numSinceKeyframe;
+	};
+
+	//-------------------------------------------------------------------------
+	// ColdFrameDecoder
+	//-------------------------------------------------------------------------
+
+	// コールドフレームを展開するクラス
+	/* @note:
+		最後に展開したキーフレームを覚えておき、同じキーフレームを参照するフレームは差分タイルを当てるだけで済ませる。
+		タイルの展開は複数スレッドで並列に行う。
+		スレッドセーフではない。
+	*/
+	class ColdFrameDecoder
+	{
+	public:
+		// コンストラクタ
+		ColdFrameDecoder();
+
+		// デストラクタ
+		~ColdFrameDecoder() = default;
+
+		// BGR24 の画素に展開する
+		void Decode(
+			std::size_t& outWidth,
+			std::size_t& outHeight,
+			std::string& outBuffer,
+			const std::shared_ptr<const ColdFrame>& pFrame
+		);
+
+		// BGR24 の画素を pDst に展開する
+		// @note: pDst は pFrame->GetRawSizeInBytes() バイト
+		void Decode(
+			std::uint8_t* pDst,
+			const std::shared_ptr<const ColdFrame>& pFrame
+		);
+
+	private:
+		std::shared_ptr<const ColdFrame>	m_pCachedKeyframe;
+		std::string							m_keyframeBuffer;
+	};
+
+	//-------------------------------------------------------------------------
+	// FRAME_SOURCE
+	//-------------------------------------------------------------------------
+
+	// 読み出し元のフレーム
+	/* @note:
+		ホット層のフレームは pTexture、コールド層のフレームは pColdFrame を持つ。
+		どちらも空なら「フレームなし」。
+	*/
+	struct FRAME_SOURCE
+	{
+		wgc::com_ptr<ID3D11Texture2D>		pTexture;
+		std::shared_ptr<const ColdFrame>	pColdFrame;
+
+		explicit operator bool() const noexcept
+		{
+			return pTexture || pColdFrame;
+		}
+	};
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+
+namespace ayc
+{
+	// コンタクトシートに並べるフレーム
+	struct CONTACT_SHEET_FRAME
+	{
+		std::size_t						width;
+		std::size_t						height;
+		std::span<const std::uint8_t>	frameBuffer;	// @note: BGR24 (stride = width * 3)
+	};
+
+	// コンタクトシートの結果
+	struct CONTACT_SHEET
+	{
+		std::size_t		width;
+		std::size_t		height;
+		std::string		frameBuffer;				// @note: BGR24 (stride = width * 3)
+	};
+
+	// BGR24 の画像を面積平均で拡大縮小する
+	/* @note:
+		出力画素が覆う入力の範囲を、重なった面積で重み付けして平均する。
+		縮小ではモアレが出にくく、拡大では最近傍に近い結果になる。
+		横方向→縦方向の順に分離して処理する。dstStride はバイト単位。
+	*/
+	void ResizeBGRArea(
+		std::uint8_t* pDst,
+		std::size_t dstWidth,
+		std::size_t dstHeight,
+		std::size_t dstStride,
+		const std::uint8_t* pSrc,
+		std::size_t srcWidth,
+		std::size_t srcHeight
+	);
+
+	// フレームを縮小して格子状に並べた１枚の画像を作る
+	/* @note:
+		セルのサイズは thumbWidth x thumbHeight で、フレームは縦横比を保ってセルの中央に収める。
+		余白は黒。縮小はフレーム単位で複数スレッドに分散し、出力バッファのセルに直接書き込む。
+	*/
+	CONTACT_SHEET MakeContactSheet(
+		const std::vector<CONTACT_SHEET_FRAME>& frames,
+		std::size_t numColumns,
+		std::size_t thumbWidth,
+		std::size_t thumbHeight
+	);
+}
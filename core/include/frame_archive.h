@@ -0,0 +1,225 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Archive File Layout
+	//-------------------------------------------------------------------------
+
+	/* @note:
+		Snapshot を書き出すアーカイブファイルのレイアウト。
+		エンディアンはリトルエンディアン。
+
+		[FRAME_ARCHIVE_HEADER]
+		[FRAME_ARCHIVE_ENTRY] x numFrames
+		(FRAME_ARCHIVE_PAYLOAD_ALIGNMENT 境界までパディング)
+		[フレームのペイロード] x numFrames  ... 各 FRAME_ARCHIVE_PAYLOAD_ALIGNMENT 境界から
+
+		インデックスはフレーム数ぶんの固定長なので、任意のフレームに O(1) でアクセスできる。
+		非圧縮のペイロードはページ境界に揃えてあるので、マップした先をそのまま画素として読める。
+		内容が同じフレームはペイロードを共有する（複数のエントリが同じ位置を指す）。
+		ヘッダはペイロードとインデックスを書き終えてから最後に書き込むので、
+		書き出し途中で止まったファイルは magic がゼロのままになる。
+	*/
+
+	// ファイルの識別子 'AYCA'
+	constexpr std::uint32_t FRAME_ARCHIVE_MAGIC = 0x41435941;
+
+	// レイアウトのバージョン
+	constexpr std::uint32_t FRAME_ARCHIVE_VERSION = 1;
+
+	// ペイロードの先頭アライメント
+	constexpr std::uint64_t FRAME_ARCHIVE_PAYLOAD_ALIGNMENT = 4096;
+
+	// ピクセルフォーマット
+	enum class FrameArchiveFormat : std::uint32_t
+	{
+		BGR24 = 1,	// B, G, R の順に 8bit ずつ
+	};
+
+	// ペイロードの圧縮形式
+	enum class FrameArchiveCompression : std::uint32_t
+	{
+		NONE	= 0,	// 画素そのもの
+		LZ		= 1,	// CompressLZ で圧縮したもの
+	};
+
+	// ファイル先頭のヘッダ
+	struct FRAME_ARCHIVE_HEADER
+	{
+		std::uint32_t	magic;
+		std::uint32_t	version;
+		std::uint32_t	numFrames;
+		std::uint32_t	entrySizeInBytes;
+		std::uint64_t	indexOffsetInBytes;
+		std::uint64_t	dataOffsetInBytes;
+		std::uint64_t	fileSizeInBytes;
+		std::uint64_t	reserved[3];
+	};
+	static_assert(sizeof(FRAME_ARCHIVE_HEADER) == 64);
+
+	// フレーム１枚ぶんのインデックス
+	struct FRAME_ARCHIVE_ENTRY
+	{
+		double			relativeInSec;		// @note: 最新フレームからさかのぼった秒数
+		std::uint32_t	width;
+		std::uint32_t	height;
+		std::uint32_t	stride;
+		std::uint32_t	format;				// @note: FrameArchiveFormat
+		std::uint32_t	compression;		// @note: FrameArchiveCompression
+		std::uint32_t	reserved0;
+		std::uint64_t	payloadOffsetInBytes;
+		std::uint64_t	payloadSizeInBytes;
+		std::uint64_t	rawSizeInBytes;		// @note: 展開後のサイズ（stride * height）
+		std::uint64_t	reserved1;
+	};
+	static_assert(sizeof(FRAME_ARCHIVE_ENTRY) == 64);
+
+	//-------------------------------------------------------------------------
+	// FrameArchiveWriter
+	//-------------------------------------------------------------------------
+
+	// アーカイブファイルを書き出すクラス
+	/* @note:
+		Append したフレームは BG で圧縮・書き出しを行う。
+		圧縮はフレーム単位で ThreadPool に積み、書き出しは I/O スレッド１本で先頭から順に行う。
+		書き出し待ちのフレーム数に上限を設けて、圧縮が先走ってメモリを食い潰さないようにする。
+	*/
+	class FrameArchiveWriter
+	{
+	public:
+		// コンストラクタ
+		// @note: 既存のファイルは上書きする
+		FrameArchiveWriter(
+			const std::string& path,
+			std::size_t numFrames,
+			bool isCompressed
+		);
+
+		// デストラクタ
+		// @note: Close せずに破棄した場合、ファイルは不完全なまま（magic がゼロ）残る
+		~FrameArchiveWriter();
+
+		// コピー禁止
+		FrameArchiveWriter(const FrameArchiveWriter&) = delete;
+		FrameArchiveWriter& operator=(const FrameArchiveWriter&) = delete;
+
+		// フレームを１枚追加する
+		/* @note:
+			frameBuffer は BGR24 (stride = width * 3)。
+			書き出しが終わるまで参照し続けるので、Close するまで破棄しないこと。
+			直前と同じバッファを渡した場合は、ペイロードを共有する。
+			BG スレッドでエラーが起きていれば、ここで再送する。
+		*/
+		void Append(
+			double relativeInSec,
+			std::size_t width,
+			std::size_t height,
+			std::span<const std::uint8_t> frameBuffer
+		);
+
+		// 残りを書き出して、インデックスとヘッダを書き込む
+		// @note: BG スレッドでエラーが起きていれば、ここで再送する
+		void Close();
+
+	private:
+		// 書き出し待ちのフレーム
+		struct _JOB
+		{
+			std::size_t						index;
+			double							relativeInSec;
+			std::size_t						width;
+			std::size_t						height;
+			std::span<const std::uint8_t>	frameBuffer;
+			bool							isDuplicate;
+			FrameArchiveCompression			compression;
+			std::string						compressed;
+		};
+
+		// フレームを１枚圧縮して書き出しに回す
+		// @note: ThreadPool のワーカー上で実行する
+		void _CompressJob(_JOB job);
+
+		// 書き出しを行う BG スレッドハンドラ
+		void _WriteThreadHandler();
+
+		// フレームを１枚書き出す
+		void _WriteJob(const _JOB& job);
+
+		// BG スレッドを止める
+		void _StopThreads();
+
+		// BG スレッドのエラーを再送する
+		// @note: m_guard をロックして呼ぶこと
+		void _RethrowError();
+
+		HANDLE								m_hFile;
+		std::size_t							m_numFrames;
+		bool								m_isCompressed;
+		std::uint64_t						m_dataOffsetInBytes;
+		std::uint64_t						m_writeOffsetInBytes;
+		std::vector<FRAME_ARCHIVE_ENTRY>	m_entries;
+		const std::uint8_t*					m_pLastFrameData;
+
+		mutable std::mutex					m_guard;
+		std::condition_variable				m_cv;
+		std::map<std::size_t, _JOB>			m_writeQueue;
+		std::size_t							m_numAppended;
+		std::size_t							m_numInFlight;
+		std::size_t							m_numCompressing;	// ThreadPool に積んだ圧縮のうち、終わっていないものの数
+		bool								m_isFinishing;
+		std::exception_ptr					m_pError;
+		std::thread							m_writeThread;
+	};
+
+	//-------------------------------------------------------------------------
+	// FrameArchive
+	//-------------------------------------------------------------------------
+
+	// アーカイブファイルを読み出すクラス
+	/* @note:
+		ファイルを丸ごと読み取り専用でマップし、インデックスから直接ペイロードを引く。
+		生成後は不変なので、複数スレッドから同時に読んでよい。
+	*/
+	class FrameArchive
+	{
+	public:
+		// コンストラクタ
+		explicit FrameArchive(const std::string& path);
+
+		// デストラクタ
+		~FrameArchive();
+
+		// コピー禁止
+		FrameArchive(const FrameArchive&) = delete;
+		FrameArchive& operator=(const FrameArchive&) = delete;
+
+		// フレーム数
+		std::size_t GetSize() const noexcept
+		{
+			return m_numFrames;
+		}
+
+		// インデックス指定でエントリを取得する
+		const FRAME_ARCHIVE_ENTRY& GetEntry(std::size_t index) const;
+
+		// インデックス指定でフレームを読み出す
+		// @note: 圧縮されていればここで展開する
+		void ReadFrame(
+			std::size_t& width,
+			std::size_t& height,
+			std::string& frameBuffer,
+			std::size_t index
+		) const;
+
+	private:
+		// マップとファイルを閉じる
+		void _Close();
+
+		HANDLE							m_hFile;
+		HANDLE							m_hMapping;
+		const std::uint8_t*				m_pView;
+		std::size_t						m_numFrames;
+		const FRAME_ARCHIVE_ENTRY*		m_pEntries;
+	};
+}
@@ -1,5 +1,9 @@
 ﻿#pragma once
 
+#include "cold_frame_store.h"
+#include "frame_signature.h"
+#include "memory_arbiter.h"
+#include "spill_store.h"
 
 namespace ayc
 {
@@ -18,6 +22,10 @@ namespace ayc
 	/* @note:
 		WGC が通知してきたフレームの直接的な受け入れ先。
 		過去一定秒数の間のフレームを保持するのが役目。
+
+		ホット層の保持秒数を指定すると２層構成になる。
+		それより古いフレームは BG スレッドで読み出してホストメモリ上に圧縮して保持し（コールド層）、
+		テクスチャは手放す。
 	*/
 	class FrameBuffer
 	{
@@ -25,38 +33,219 @@ namespace ayc
 
 	public:
 		// フレーム１枚を表す構造体
+		// @note: ホット層のフレームは pTexture、コールド層のフレームは pColdFrame を持つ
 		struct FRAME
 		{
 			wgc::com_ptr<ID3D11Texture2D> pTexture;
 			wgc::TimeSpan timeSpan;
+			std::uint64_t seq;
+			std::size_t sizeInBytes;
+			std::shared_ptr<const FRAME_SIGNATURE> pSignature;
+			std::shared_ptr<const ColdFrame> pColdFrame;
+		};
+
+		// 重複フレーム排除の統計情報
+		struct DEDUP_STATS
+		{
+			std::uint64_t	deduplicatedFrames;		// これまでに排除したフレーム数
+			std::uint64_t	savedBytes;				// これまでに排除したフレームのサイズ合計
+			std::size_t		heldDuplicates;			// バッファ上の排除済みフレーム数
+			std::size_t		heldSavedBytes;			// バッファ上の排除済みフレームのサイズ合計
+		};
+
+		// ホット層・コールド層・ディスク層の統計情報
+		struct TIER_STATS
+		{
+			std::size_t		hotFrames;				// ホット層のフレーム数
+			std::size_t		coldFrames;				// コールド層のフレーム数
+			std::size_t		hotBytes;				// ホット層のテクスチャのサイズ合計
+			std::size_t		coldBytes;				// コールド層の圧縮後のサイズ合計
+			std::size_t		coldRawBytes;			// コールド層の展開後のサイズ合計
+			std::size_t		coldTiles;				// コールド層のタイル数合計
+			std::size_t		coldStoredTiles;		// コールド層で実際に保持しているタイル数合計
+			std::size_t		spilledFrames;			// ディスクに書き出したフレーム数
+			std::size_t		spilledBytes;			// ディスクに書き出したフレームのレコードサイズ合計
+			std::size_t		spillDiskBytes;			// 書き出し先セグメントファイルのサイズ合計
 		};
 
 		// 内部コンテナ型
 		typedef std::deque<FRAME> Impl;
 
 		// コンストラクタ
-		FrameBuffer(double holdInSec);
+		/* @note:
+			pMemoryAccount を渡すと、使用量を記帳し、
+			MemoryArbiter に課された上限に従って保持量を削るようになる。
+			isDedupEnabled が true なら、直前と同一内容のフレームはテクスチャを共有して保持する。
+			hotHoldInSec を指定すると、それより古いフレームをコールド層に移す。
+			spillParam を指定すると、さらに古いコールド層のフレームをディスクに書き出す（hotHoldInSec 必須）。
+			clock は「現在」を返す関数で、nullptr なら NowFromQPC。リプレイの早送りでは仮想時刻を渡す。
+		*/
+		FrameBuffer(
+			double holdInSec,
+			std::shared_ptr<MemoryAccount> pMemoryAccount = nullptr,
+			bool isDedupEnabled = false,
+			std::optional<double> hotHoldInSec = std::nullopt,
+			std::optional<SPILL_PARAM> spillParam = std::nullopt,
+			std::function<wgc::TimeSpan()> clock = nullptr
+		);
 
 		// デストラクタ
-		~FrameBuffer() = default;
+		~FrameBuffer();
+
+		// コピー禁止
+		FrameBuffer(const FrameBuffer&) = delete;
+		FrameBuffer& operator=(const FrameBuffer&) = delete;
 
 		// フレームを全削除
 		void Clear();
 
+		// フレームバッファを閉じる
+		// @note: WaitFrame で待機中のスレッドも起こされる
+		void Close();
+
 		// フレームを１つ追加する
-		void PushFrame(
+		// @note: 追加したフレームのシーケンス番号を返す
+		std::uint64_t PushFrame(
 			const wgc::com_ptr<ID3D11Texture2D>& pTexture,
-			const wgc::TimeSpan& timeSpan
+			const wgc::TimeSpan& timeSpan,
+			std::shared_ptr<const FRAME_SIGNATURE> pSignature = nullptr
 		);
 
+		// 重複フレームの排除が有効なら true を返す
+		bool IsDedupEnabled() const noexcept
+		{
+			return m_isDedupEnabled;
+		}
+
+		// 追加済みのフレームに署名を付け、直前のフレームと同一内容ならテクスチャを共有させる
+		/* @note:
+			署名は GPU からの読み出しを待たないよう到着の１フレーム後に届くので、
+			フレームはコピーを取って先に PushFrame しておき、後から重複を畳む。
+			共有させた場合は true を返し、そのフレームのコピーは手放す。
+			seq のフレームが削除済み・コールド層に移動済みなら、署名を付けるだけ（あるいは何もしない）。
+		*/
+		bool ResolveSignature(
+			std::uint64_t seq,
+			std::shared_ptr<const FRAME_SIGNATURE> pSignature
+		);
+
+		// 重複フレーム排除の統計情報を取得する
+		DEDUP_STATS GetDedupStats() const;
+
+		// ホット層・コールド層・ディスク層の統計情報を取得する
+		TIER_STATS GetTierStats() const;
+
 		// 相対時刻指定でフレームを１つ取得する
-		wgc::com_ptr<ID3D11Texture2D> GetFrame(double relativeInSec) const;
+		FRAME_SOURCE GetFrame(double relativeInSec) const;
+
+		// 最新フレームのシーケンス番号を取得する
+		// @note: まだ１枚もフレームが来ていなければ 0
+		std::uint64_t GetLatestSequence() const;
 
+		// afterSeq より新しいフレームが到着するまで待機し、最新フレームを取得する
+		/* @note:
+			タイムアウト・クローズ時は pTexture が nullptr のフレームを返す。
+			timeoutInSec が std::nullopt か、１年を超える（inf を含む）なら無期限に待つ。
+			最新フレームはコールド層に移さないので、返すフレームは必ずテクスチャを持つ。
+		*/
+		FRAME WaitFrame(
+			std::uint64_t afterSeq,
+			std::optional<double> timeoutInSec
+		) const;
 
 	private:
-		mutable std::mutex	m_guard;
-		Impl				m_impl;
-		double				m_holdInSec;
+		// フレームを追加して、賞味期限切れ・上限超過のフレームを削除する
+		// @note: m_guard はロックせずに呼ぶこと。追加したフレームのシーケンス番号を返す
+		std::uint64_t _PushFrame(FRAME frame);
+
+		// 使用量を記帳する
+		// @note: m_guard はロックせずに呼ぶこと
+		void _UpdateMemoryAccount(const wgc::TimeSpan& nowInTS);
+
+		// 「現在」を得る
+		wgc::TimeSpan _Now() const
+		{
+			return m_clock();
+		}
+
+		// 区分ごとの使用量の記帳先を得る
+		// @note: 記帳先が無ければプロセス全体の記帳先
+		const std::shared_ptr<MemoryTracker>& _GetMemoryTracker() const
+		{
+			return m_pMemoryAccount ? m_pMemoryAccount->GetTracker() : MemoryTracker::Global();
+		}
+
+		// 先頭のフレームを削除する
+		// @note: m_guard をロックして呼ぶこと
+		void _PopFrontFrame();
+
+		// フレームから外れたキーフレーム
+		/* @note:
+			後続の差分フレームが ColdFrame 経由で参照している間はメモリに残るので、記帳も残しておく。
+			pKeyframe は同一性の判定にだけ使う。
+		*/
+		struct _EVICTED_KEYFRAME
+		{
+			const ColdFrame*	pKeyframe;
+			std::size_t			sizeInBytes;
+		};
+
+		// 参照する差分フレームが無くなったキーフレームの記帳を戻す
+		// @note: m_guard をロックして呼ぶこと
+		void _ReleaseEvictedKeyframes();
+
+		// 前のフレームと同じテクスチャ・コールドフレームを共有しているなら true を返す
+		static bool _IsSharedWith(const FRAME& frame, const FRAME& prevFrame);
+
+		// コールド層に移すべきフレームを探す
+		// @note: m_guard をロックして呼ぶこと
+		Impl::const_iterator _FindDemoteTarget(const wgc::TimeSpan& nowInTS) const;
+
+		// ディスクに書き出すべきフレームを探す
+		// @note: m_guard をロックして呼ぶこと
+		Impl::const_iterator _FindSpillTarget(const wgc::TimeSpan& nowInTS) const;
+
+		// フレームの中身をコールドフレームに差し替える
+		/* @note:
+			expected はテクスチャ・コールドフレームの差し替え前の値。
+			読み出し中に削除・差し替えされたフレームなら何もしない。
+		*/
+		void _ReplaceWithColdFrame(
+			std::uint64_t seq,
+			const FRAME_SOURCE& expected,
+			const std::shared_ptr<const ColdFrame>& pColdFrame
+		);
+
+		// 破棄済みセグメントに書き出したフレームを削除する
+		void _EvictRetiredFrames(std::uint64_t retiredSegmentId);
+
+		// コールド層・ディスクへの移動を止める
+		void _StopBackgroundThreads();
+
+		// コールド層への移動を行う BG スレッドハンドラ
+		void _DemoteThreadHandler();
+
+		// ディスクへの書き出しを行う BG スレッドハンドラ
+		void _SpillThreadHandler();
+
+		mutable std::mutex				m_guard;
+		mutable std::condition_variable	m_cv;
+		Impl							m_impl;
+		double							m_holdInSec;
+		std::uint64_t					m_latestSeq;
+		bool							m_isClosed;
+		std::size_t						m_sizeInBytes;
+		std::vector<_EVICTED_KEYFRAME>	m_evictedKeyframes;
+		std::shared_ptr<MemoryAccount>	m_pMemoryAccount;
+		bool							m_isDedupEnabled;
+		std::uint64_t					m_numDeduplicated;
+		std::uint64_t					m_dedupSavedBytes;
+		std::optional<double>			m_hotHoldInSec;
+		std::condition_variable			m_demoteCV;
+		std::thread						m_demoteThread;
+		std::unique_ptr<SpillStore>		m_pSpillStore;
+		std::thread						m_spillThread;
+		std::function<wgc::TimeSpan()>	m_clock;
 	};
 
 	//-------------------------------------------------------------------------
@@ -72,6 +261,7 @@ namespace ayc
 		struct FRAME
 		{
 			wgc::com_ptr<ID3D11Texture2D> pTexture;
+			std::shared_ptr<const ColdFrame> pColdFrame;
 			double relativeInSec;
 		};
 
@@ -111,8 +301,21 @@ namespace ayc
 		// 指定相対時刻と最も近いフレームのインデックスを取得する
 		std::size_t GetFrameIndex(double relativeInSec) const;
 
+		// 「ユーザー --> 生」のインデックスマップを解決する
+		/* @note:
+			fps 指定がある場合は指定 fps でキャプチャしたかのように見えるように、フレームの取捨選択を行う。
+			durationInSec が std::nullopt なら、保持しているフレームの範囲全体。
+			fps 指定が無い場合は恒等写像になる。
+		*/
+		void ResolveIndexMap(
+			std::vector<std::size_t>& outIndexUserToRaw,
+			std::vector<double>& outRelativesInSec,
+			std::optional<double> fps,
+			std::optional<double> durationInSec
+		) const;
+
 		// インテックス指定でフレームを１つ取得する
-		wgc::com_ptr<ID3D11Texture2D> operator [](std::size_t index) const;
+		FRAME_SOURCE operator [](std::size_t index) const;
 
 	private:
 		Impl	m_impl;
@@ -0,0 +1,82 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Parameters
+	//-------------------------------------------------------------------------
+
+	// フレーム間の差分の測り方
+	/* @note:
+		どちらも縮小した輝度で比較し、0（同一）〜 1 の値を返す。
+		SAD は全体が薄く変化するフェードに、SSIM は一部だけの構造の変化に敏感。
+	*/
+	enum class FrameDiffMetric
+	{
+		SAD,		// 平均絶対差を 255 で割ったもの
+		SSIM,		// 8x8 ブロックごとの SSIM の平均を 1 から引いたもの
+	};
+
+	// 間引きの設定
+	struct PRUNE_PARAM
+	{
+		double				threshold;		// 代表フレームとの差分がこれ以下なら統合する（0 なら完全一致のみ）
+		FrameDiffMetric		metric;
+	};
+
+	// 間引きの入力フレーム
+	struct PRUNE_FRAME
+	{
+		std::size_t						width;
+		std::size_t						height;
+		std::span<const std::uint8_t>	frameBuffer;	// @note: BGR24 (stride = width * 3)
+	};
+
+	// 間引きの結果
+	struct PRUNED_FRAME
+	{
+		std::size_t		frameIndex;			// 代表フレーム（統合した中で最初のフレーム）のインデックス
+		std::size_t		numMerged;			// 統合したフレーム数（代表フレームを含む）
+		double			durationInSec;		// 統合したフレームの表示時間の合計
+	};
+
+	// 比較用に縮小した輝度
+	struct FRAME_THUMBNAIL
+	{
+		std::size_t					srcWidth;
+		std::size_t					srcHeight;
+		std::size_t						width;
+		std::size_t					height;
+		std::vector<std::uint8_t>	luma;
+	};
+
+	//-------------------------------------------------------------------------
+	// Functions
+	//-------------------------------------------------------------------------
+
+	// BGR24 のフレームを比較用の輝度に縮小する
+	// @note: 長辺が 128 画素以下になるよう、正方ブロックの平均で縮小する
+	FRAME_THUMBNAIL MakeFrameThumbnail(const PRUNE_FRAME& frame);
+
+	// 縮小した輝度同士の差分を求める
+	// @note: 元のサイズが違う場合は常に 1
+	double ComputeFrameDifference(
+		const FRAME_THUMBNAIL& lhs,
+		const FRAME_THUMBNAIL& rhs,
+		FrameDiffMetric metric
+	);
+
+	// ほぼ同一のフレームを統合し、表示時間を延ばした一覧を返す
+	/* @note:
+		relativesInSec は「最新フレームからさかのぼった秒数」で、古い順に並んでいるもの。
+		末尾のフレームは平均フレーム間隔だけ表示されるものとする。
+		比較は直前のフレームではなく、統合中の代表フレームと行う。
+		直前とだけ比べると、ゆっくりしたフェードやスクロールが際限なく１枚に潰れてしまうため。
+		縮小はフレーム単位で複数スレッドに分散する。
+	*/
+	std::vector<PRUNED_FRAME> PruneNearDuplicateFrames(
+		const std::vector<PRUNE_FRAME>& frames,
+		const std::vector<double>& relativesInSec,
+		const PRUNE_PARAM& param
+	);
+}
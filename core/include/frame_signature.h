@@ -0,0 +1,60 @@
+﻿#pragma once
+
+namespace ayc
+{
+	// 署名のタイル１辺のピクセル数
+	constexpr std::uint32_t FRAME_SIGNATURE_TILE_SIZE = 16;
+
+	// フレーム内容の署名
+	/* @note:
+		フレームを FRAME_SIGNATURE_TILE_SIZE 四方のタイルに区切り、
+		タイルごとのチェックサムを並べたもの。
+		チェックサムは独立な２つの 32 ビットハッシュの和を上位・下位に並べた 64 ビットで、
+		全タイルが一致すれば同一内容のフレームとみなす。
+		32 ビットの和だけでは、テクスチャを共有してよいと言い切るには衝突の余地が大きい。
+		シーン切り替えの検出用に、タイルごとの輝度（0 〜 255）の合計も持つ。
+	*/
+	struct FRAME_SIGNATURE
+	{
+		std::uint32_t				width;
+		std::uint32_t				height;
+		std::uint32_t				numTilesX;
+		std::uint32_t				numTilesY;
+		std::vector<std::uint64_t>	tiles;
+		std::vector<std::uint32_t>	tileLumas;
+
+		bool operator==(const FRAME_SIGNATURE&) const = default;
+	};
+
+	// 計算を発行済みの署名
+	/* @note:
+		生成時にコンピュートシェーダーと読み出し用バッファへのコピーを発行するだけで、完了は待たない。
+		チェックサムと輝度はタイル数の３倍の uint だけを読み出す。
+		キャプチャスレッドを GPU 待ちで止めないよう、次のフレームが届いてから Resolve すること。
+		テクスチャには D3D11_BIND_SHADER_RESOURCE が必要。
+	*/
+	class PendingFrameSignature
+	{
+	public:
+		// コンストラクタ
+		explicit PendingFrameSignature(const wgc::com_ptr<ID3D11Texture2D>& pSrcTex);
+
+		// デストラクタ
+		~PendingFrameSignature();
+
+		// コピー禁止
+		PendingFrameSignature(const PendingFrameSignature&) = delete;
+		PendingFrameSignature& operator=(const PendingFrameSignature&) = delete;
+
+		// 署名を得る
+		/* @note:
+			読み出しが終わっていなければ待つ。発行から１フレーム経っていれば、まず待たずに済む。
+			２回目以降は１回目の結果を返す。
+		*/
+		std::shared_ptr<const FRAME_SIGNATURE> Resolve();
+
+	private:
+		std::shared_ptr<FRAME_SIGNATURE>	m_pSignature;
+		wgc::com_ptr<ID3D11Buffer>			m_pStagingBuffer;	// 読み出し用バッファ。読み出し済みなら nullptr
+	};
+}
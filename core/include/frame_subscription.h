@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include "async_texture_readback.h"
+#include "utils.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Forward Declaration
+	//-------------------------------------------------------------------------
+
+	class WGCSession;
+	class FrameSubscriber;
+	class FrameDispatcher;
+
+	//-------------------------------------------------------------------------
+	// Types
+	//-------------------------------------------------------------------------
+
+	// 購読キューが溢れた時の挙動
+	enum class OverflowPolicy
+	{
+		DROP_OLDEST,	// 最も古い配送待ちフレームを捨てる
+		DROP_NEWEST,	// 到着したフレームを捨てる
+		BLOCK,			// 空きが出るまでディスパッチャを止める
+	};
+
+	// 購読者に配送されるフレーム
+	/* @note:
+		読み出し結果は全購読者で共有するので shared_ptr で持つ。
+	*/
+	struct SUBSCRIBED_FRAME
+	{
+		std::uint64_t										seq;
+		wgc::TimeSpan										timeSpan;
+		std::shared_ptr<const AsyncTextureReadback::RESULT>	pResult;
+	};
+
+	// 購読者ごとの統計情報
+	struct SUBSCRIBER_STATS
+	{
+		std::uint64_t	delivered;		// 配送済みフレーム数
+		std::uint64_t	dropped;		// 溢れて捨てたフレーム数
+		std::size_t		pending;		// 配送待ちフレーム数
+		double			latestLagInSec;	// 直近の配送完了時点でのフレーム到着からの遅れ
+		double			maxLagInSec;	// 配送完了時点でのフレーム到着からの遅れの最大値
+	};
+
+	//-------------------------------------------------------------------------
+	// FrameSubscriber
+	//-------------------------------------------------------------------------
+
+	// フレーム購読者
+	/* @note:
+		ディスパッチャと配送スレッドの間に挟まる有界キュー。
+		溢れた時の挙動は OverflowPolicy で指定する。
+	*/
+	class FrameSubscriber
+	{
+	public:
+		// コンストラクタ
+		FrameSubscriber(
+			std::size_t maxPending,
+			OverflowPolicy overflowPolicy
+		);
+
+		// デストラクタ
+		~FrameSubscriber() = default;
+
+		// コピー禁止
+		FrameSubscriber(const FrameSubscriber&) = delete;
+		FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+		// フレームを１つ投入する（ディスパッチャ側）
+		void Push(const SUBSCRIBED_FRAME& frame);
+
+		// フレームを１つ取り出す（配送側）
+		// @note: キューが空なら待機する、クローズされたら false を返す
+		bool Pop(SUBSCRIBED_FRAME& outFrame);
+
+		// 配送完了を記録する
+		void MarkDelivered(const SUBSCRIBED_FRAME& frame);
+
+		// 購読を終了する
+		// @note: Push, Pop で待機中のスレッドも起こされる
+		void Close();
+
+		// 統計情報を取得する
+		SUBSCRIBER_STATS GetStats() const;
+
+	private:
+		mutable std::mutex				m_guard;
+		std::condition_variable			m_cv;
+		std::deque<SUBSCRIBED_FRAME>	m_queue;
+		std::size_t						m_maxPending;
+		OverflowPolicy					m_overflowPolicy;
+		bool							m_isClosed;
+		SUBSCRIBER_STATS				m_stats;
+	};
+
+	//-------------------------------------------------------------------------
+	// FrameDispatcher
+	//-------------------------------------------------------------------------
+
+	// フレーム配送クラス
+	/* @note:
+		新着フレームを BG スレッドで待ち受け、１フレームにつき１回だけ読み出して、
+		その結果を全購読者に配る。
+	*/
+	class FrameDispatcher
+	{
+	public:
+		// コンストラクタ
+		FrameDispatcher(const std::shared_ptr<WGCSession>& pWGCSession);
+
+		// デストラクタ
+		~FrameDispatcher();
+
+		// コピー禁止
+		FrameDispatcher(const FrameDispatcher&) = delete;
+		FrameDispatcher& operator=(const FrameDispatcher&) = delete;
+
+		// 購読を開始する
+		std::shared_ptr<FrameSubscriber> Subscribe(
+			std::size_t maxPending,
+			OverflowPolicy overflowPolicy
+		);
+
+		// 購読を終了する
+		void Unsubscribe(const std::shared_ptr<FrameSubscriber>& pSubscriber);
+
+		// 配送を停止する
+		// @note: 全購読者もクローズされる
+		void Close();
+
+	private:
+		// BG スレッドハンドラ
+		void _ThreadHandler();
+
+		// 内部状態
+		std::shared_ptr<WGCSession>						m_pWGCSession;
+		std::mutex										m_guard;
+		std::vector<std::shared_ptr<FrameSubscriber>>	m_subscribers;
+		std::atomic<bool>								m_isStopping;
+		std::thread										m_thread;
+	};
+}
@@ -0,0 +1,70 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Parameters
+	//-------------------------------------------------------------------------
+
+	// ディザリングの方式
+	enum class GifDither
+	{
+		NONE,				// 最も近いパレット色に置き換えるだけ
+		ORDERED,			// 8x8 の Bayer 行列。画素ごとに独立なので、静止部分はフレーム間で同じ結果になる
+		FLOYD_STEINBERG,	// 誤差拡散。滑らかだが、静止部分でもフレームごとにノイズが揺れやすい
+	};
+
+	// パレットの持ち方
+	enum class GifPalette
+	{
+		GLOBAL,		// 全フレームのヒストグラムから１つのパレットを作る
+		LOCAL,		// フレームごとにパレットを作る
+	};
+
+	// GIF の書き出し設定
+	struct GIF_PARAM
+	{
+		std::size_t		maxColors;			// パレットの最大色数（2 〜 256）。透過を使う場合は１色を透過色に充てる
+		GifDither		dither;
+		GifPalette		palette;
+		bool			isDeltaEnabled;		// 直前のフレームから変化した矩形だけを、変化の無い画素を透過にして書き出す
+	};
+
+	// GIF に書き出すフレーム
+	struct GIF_FRAME
+	{
+		std::size_t						width;
+		std::size_t						height;
+		std::span<const std::uint8_t>	frameBuffer;	// @note: BGR24 (stride = width * 3)
+		std::uint32_t					delayInCs;		// @note: 表示時間（1/100 秒単位）
+	};
+
+	//-------------------------------------------------------------------------
+	// Functions
+	//-------------------------------------------------------------------------
+
+	// フレームのタイムスタンプから GIF の表示時間を解決する
+	/* @note:
+		relativesInSec は「最新フレームからさかのぼった秒数」で、古い順に並んでいるもの。
+		fps が指定されていれば、タイムスタンプの代わりに等間隔とみなす。
+		GIF の表示時間は 1/100 秒単位なので、丸め誤差を持ち越して全体の長さがずれないようにする。
+	*/
+	std::vector<std::uint32_t> ResolveGifDelaysInCs(
+		const std::vector<double>& relativesInSec,
+		std::optional<double> fps
+	);
+
+	// アニメーション GIF を書き出す
+	/* @note:
+		パレット生成（ヒストグラム → メディアンカット → k-means で仕上げ）、
+		減色・ディザリング、差分化、LZW 符号化をフレーム単位で複数スレッドに分散し、
+		書き出しだけを先頭から順に行う。
+		メモリを食い潰さないよう、一度に処理するフレーム数はスレッド数の数倍に抑える。
+		既存のファイルは上書きする。
+	*/
+	void WriteGif(
+		const std::string& path,
+		const std::vector<GIF_FRAME>& frames,
+		const GIF_PARAM& param
+	);
+}
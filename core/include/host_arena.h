@@ -0,0 +1,204 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// HostArena
+	//-------------------------------------------------------------------------
+
+	// 同じ大きさのスロットに切り分けて使う、ひとかたまりのホストメモリ
+	/* @note:
+		スナップショットのように寿命が揃ったフレームを、１回の確保と１回の解放で扱う。
+		VirtualAlloc でページ境界に揃えて確保し、各スロットもページ境界から始まる。
+		生成・再利用は HostArenaPool が行う。
+	*/
+	class HostArena
+	{
+	public:
+		// コンストラクタ
+		/* @note:
+			slotSize はページサイズの倍数に切り上げる。
+			useLargePages が true なら大きいページでの確保を試み、できなければ通常のページで確保する。
+		*/
+		HostArena(
+			std::size_t slotSize,
+			std::size_t numSlots,
+			bool useLargePages
+		);
+
+		// デストラクタ
+		~HostArena();
+
+		// コピー禁止
+		HostArena(const HostArena&) = delete;
+		HostArena& operator=(const HostArena&) = delete;
+
+		// index 番目のスロットの先頭を得る
+		std::uint8_t* GetSlot(std::size_t index) const;
+
+		// スロット１つ分のサイズ（ページサイズの倍数）
+		std::size_t GetSlotSize() const noexcept
+		{
+			return m_slotSize;
+		}
+
+		// スロットの数
+		std::size_t GetNumSlots() const noexcept
+		{
+			return m_numSlots;
+		}
+
+		// 確保したサイズ
+		std::size_t GetSizeInBytes() const noexcept
+		{
+			return m_sizeInBytes;
+		}
+
+		// 大きいページで確保できていれば true
+		bool IsLargePages() const noexcept
+		{
+			return m_isLargePages;
+		}
+
+	private:
+		std::uint8_t*	m_pMemory;
+		std::size_t		m_slotSize;
+		std::size_t		m_numSlots;
+		std::size_t		m_sizeInBytes;
+		bool			m_isLargePages;
+	};
+
+	//-------------------------------------------------------------------------
+	// HostArenaPool
+	//-------------------------------------------------------------------------
+
+	// 使い終わった HostArena を取っておき、同じ大きさの確保で使い回すプール
+	/* @note:
+		同じウィンドウを同じ長さでスナップショットし続けると、毎回同じ大きさのアリーナが要る。
+		最後の参照が外れたアリーナはここに戻り、次の Acquire でそのまま渡す。
+		取っておく合計サイズが上限を超えたら、古いものから解放する。
+		プロセス全体で共有するので、全ての操作はスレッドセーフ。
+	*/
+	class HostArenaPool
+	{
+	public:
+		// 統計
+		struct STATS
+		{
+			std::size_t		pooledArenas;		// 取っておいているアリーナの数
+			std::size_t		pooledBytes;		// 取っておいているアリーナの合計サイズ
+			std::uint64_t	createdArenas;		// 生成したアリーナの数の累計
+			std::uint64_t	reusedArenas;		// 使い回したアリーナの数の累計
+			std::uint64_t	largePageArenas;	// 大きいページで生成できたアリーナの数の累計
+		};
+
+		// プロセス共通のインスタンスを得る
+		static HostArenaPool& Instance();
+
+		// コンストラクタ
+		explicit HostArenaPool(std::size_t maxPooledBytes);
+
+		// デストラクタ
+		~HostArenaPool() = default;
+
+		// コピー禁止
+		HostArenaPool(const HostArenaPool&) = delete;
+		HostArenaPool& operator=(const HostArenaPool&) = delete;
+
+		// slotSize 以上のスロットを numSlots 個以上持つアリーナを得る
+		/* @note:
+			取っておいたアリーナのうち、スロットのサイズが同じで、数が numSlots ～ 2 * numSlots のものを使い回す。
+			無ければ生成する。返したアリーナの最後の参照が外れると、プールに戻る。
+		*/
+		std::shared_ptr<HostArena> Acquire(std::size_t slotSize, std::size_t numSlots);
+
+		// 設定を変える
+		/* @note:
+			省略した項目は変えない。以降に生成するアリーナから反映する。
+			maxPooledBytes を下げると、超えた分をその場で解放する。
+		*/
+		void Configure(
+			std::optional<bool> useLargePages,
+			std::optional<std::size_t> maxPooledBytes
+		);
+
+		// 取っておいたアリーナを全て解放する
+		void Clear();
+
+		// 統計を得る
+		STATS GetStats() const;
+
+	private:
+		// 使い終わったアリーナを受け取る
+		void _Release(HostArena* pArena);
+
+		// 上限を超えた分を取り出す
+		// @note: m_guard をロックして呼ぶこと。解放はロックの外で行う
+		std::vector<std::unique_ptr<HostArena>> _TrimLocked();
+
+		mutable std::mutex							m_guard;
+		std::deque<std::unique_ptr<HostArena>>		m_freeArenas;		// 戻ってきた順（古い順）
+		std::size_t									m_pooledBytes;
+		std::size_t									m_maxPooledBytes;
+		bool										m_useLargePages;
+		std::uint64_t								m_numCreated;
+		std::uint64_t								m_numReused;
+		std::uint64_t								m_numLargePages;
+	};
+
+	//-------------------------------------------------------------------------
+	// HostBuffer
+	//-------------------------------------------------------------------------
+
+	// HostArena のスロット１つ分を指すバッファ
+	/* @note:
+		コピーしてもメモリは共有し、最後のコピーが破棄されるまでアリーナを生かしておく。
+		Python に渡したバッファもこれを持つので、Snapshot を閉じた後も読める。
+	*/
+	class HostBuffer
+	{
+	public:
+		// 空のバッファを表すコンストラクタ
+		HostBuffer() noexcept;
+
+		// pArena の slotIndex 番目のスロットの先頭 size バイトを指すコンストラクタ
+		HostBuffer(
+			std::shared_ptr<HostArena> pArena,
+			std::size_t slotIndex,
+			std::size_t size
+		);
+
+		// size バイトのバッファを HostArenaPool から得る
+		// @note: スロット１つのアリーナを使うので、同じ大きさのフレームを読み続けると使い回される
+		static HostBuffer Allocate(std::size_t size);
+
+		// 先頭
+		std::uint8_t* GetData() const noexcept
+		{
+			return m_pData;
+		}
+
+		// サイズ
+		std::size_t GetSize() const noexcept
+		{
+			return m_size;
+		}
+
+		// 空なら true
+		bool IsEmpty() const noexcept
+		{
+			return m_size == 0;
+		}
+
+		// 読み取り用の範囲
+		std::span<const std::uint8_t> GetSpan() const noexcept
+		{
+			return std::span<const std::uint8_t>(m_pData, m_size);
+		}
+
+	private:
+		std::shared_ptr<HostArena>	m_pArena;
+		std::uint8_t*				m_pData;
+		std::size_t					m_size;
+	};
+}
@@ -0,0 +1,19 @@
+﻿#pragma once
+
+namespace ayc
+{
+	// LZ 系の可逆圧縮
+	/* @note:
+		LZ4 のブロック形式と同じ考え方の、単純で速い一致探索。
+		フレーム間の差分のように同じバイトが続くデータでは、距離１の長い一致が大半を占める。
+		out は一旦クリアしてから書き出す。
+	*/
+	void CompressLZ(std::string& out, const std::uint8_t* pSrc, std::size_t srcSize);
+
+	// LZ 系の可逆圧縮を展開する
+	/* @note:
+		展開後のサイズ dstSize は呼び出し元で保持しておくこと。
+		壊れたデータで範囲外を読み書きしないよう、全ての長さを検査する。
+	*/
+	void DecompressLZ(std::uint8_t* pDst, std::size_t dstSize, const std::uint8_t* pSrc, std::size_t srcSize);
+}
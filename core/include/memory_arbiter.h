@@ -0,0 +1,172 @@
+﻿#pragma once
+
+#include "memory_tracker.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Forward Declaration
+	//-------------------------------------------------------------------------
+
+	class MemoryAccount;
+	class MemoryArbiter;
+
+	//-------------------------------------------------------------------------
+	// MemoryAccount
+	//-------------------------------------------------------------------------
+
+	// メモリ使用量の記帳先（セッション１つ分）
+	/* @note:
+		PushFrame のたびに読み書きされるので、値は全て atomic で持つ。
+	*/
+	class MemoryAccount
+	{
+		friend class MemoryArbiter;
+
+	public:
+		// 上限なしを表す値
+		static constexpr std::int64_t NO_LIMIT = std::numeric_limits<std::int64_t>::max();
+
+		// コンストラクタ
+		MemoryAccount(
+			std::uint64_t id,
+			double weight,
+			double minHoldInSec
+		);
+
+		// デストラクタ
+		~MemoryAccount() = default;
+
+		// コピー禁止
+		MemoryAccount(const MemoryAccount&) = delete;
+		MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+		// 識別子（HWND）
+		std::uint64_t GetId() const noexcept
+		{
+			return m_id;
+		}
+
+		// 優先度の重み（大きいほど削られにくい）
+		double GetWeight() const noexcept
+		{
+			return m_weight;
+		}
+
+		// 最低限保持する秒数
+		double GetMinHoldInSec() const noexcept
+		{
+			return m_minHoldInSec;
+		}
+
+		// 現在の使用量
+		std::int64_t GetBytes() const noexcept
+		{
+			return m_bytes.load(std::memory_order_relaxed);
+		}
+
+		// 削れない使用量（最低保持秒数ぶん）
+		std::int64_t GetFloorBytes() const noexcept
+		{
+			return m_floorBytes.load(std::memory_order_relaxed);
+		}
+
+		// 使用量の上限
+		std::int64_t GetLimitBytes() const noexcept
+		{
+			return m_limitBytes.load(std::memory_order_relaxed);
+		}
+
+		// 区分ごとの使用量の記帳先
+		// @note: 記帳した値はプロセス全体の記帳先（MemoryTracker::Global）にも記帳される
+		const std::shared_ptr<MemoryTracker>& GetTracker() const noexcept
+		{
+			return m_pTracker;
+		}
+
+	private:
+		const std::uint64_t			m_id;
+		const double				m_weight;
+		const double				m_minHoldInSec;
+		std::atomic<std::int64_t>	m_bytes;
+		std::atomic<std::int64_t>	m_floorBytes;
+		std::atomic<std::int64_t>	m_limitBytes;
+		const std::shared_ptr<MemoryTracker>	m_pTracker;
+	};
+
+	//-------------------------------------------------------------------------
+	// MemoryArbiter
+	//-------------------------------------------------------------------------
+
+	// プロセス全体のメモリ予算管理
+	/* @note:
+		各セッションのフレームバッファが記帳した使用量の合計が予算を超えたら、
+		重みの小さいセッションから順に上限を課して保持量を削らせる。
+		記帳自体は atomic 操作だけで済ませ、再配分が必要な時だけロックを取る。
+	*/
+	class MemoryArbiter
+	{
+	public:
+		// プロセス共通のインスタンスを得る
+		static MemoryArbiter& Instance();
+
+		// コンストラクタ
+		MemoryArbiter();
+
+		// デストラクタ
+		~MemoryArbiter() = default;
+
+		// コピー禁止
+		MemoryArbiter(const MemoryArbiter&) = delete;
+		MemoryArbiter& operator=(const MemoryArbiter&) = delete;
+
+		// 予算を設定する
+		// @note: std::nullopt なら予算なし
+		void SetBudget(std::optional<std::int64_t> budgetBytes);
+
+		// 予算を得る
+		std::optional<std::int64_t> GetBudget() const;
+
+		// 全セッションの使用量の合計を得る
+		std::int64_t GetTotalBytes() const noexcept
+		{
+			return m_totalBytes.load(std::memory_order_relaxed);
+		}
+
+		// 記帳先を登録する
+		std::shared_ptr<MemoryAccount> Register(
+			std::uint64_t id,
+			double weight,
+			double minHoldInSec
+		);
+
+		// 記帳先の登録を解除する
+		void Unregister(const std::shared_ptr<MemoryAccount>& pAccount);
+
+		// 使用量を記帳する
+		// @note: PushFrame から毎回呼ばれる
+		void Update(
+			MemoryAccount& account,
+			std::int64_t bytes,
+			std::int64_t floorBytes
+		);
+
+		// 登録済みの記帳先を全て得る
+		std::vector<std::shared_ptr<MemoryAccount>> GetAccounts() const;
+
+	private:
+		// 他のスレッドが再配分中でなければ、上限を再配分する
+		// @note: Update から呼ぶ。ロックを取れなければ何もしない
+		void _TryRebalance();
+
+		// 上限を再配分する
+		// @note: m_guard をロックして呼ぶこと
+		void _RebalanceLocked();
+
+		mutable std::mutex							m_guard;
+		std::vector<std::shared_ptr<MemoryAccount>>	m_accounts;
+		std::atomic<std::int64_t>					m_budgetBytes;
+		std::atomic<std::int64_t>					m_totalBytes;
+		std::atomic<std::size_t>					m_numLimited;
+	};
+}
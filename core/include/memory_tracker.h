@@ -0,0 +1,139 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Types
+	//-------------------------------------------------------------------------
+
+	// 記帳するメモリの区分
+	enum class MemoryCategory
+	{
+		FRAME_TEXTURE,		// フレームバッファが保持するテクスチャ（VRAM）
+		STAGING_TEXTURE,	// 読み出し用のステージングテクスチャ（VRAM）
+		READBACK_BUFFER,	// AsyncTextureReadback が保持する読み出し結果（ホストメモリ）
+		PYTHON_BYTES,		// Python に渡した bytes（ホストメモリ）
+	};
+
+	// 区分の数
+	constexpr std::size_t NUM_MEMORY_CATEGORIES = 4;
+
+	//-------------------------------------------------------------------------
+	// MemoryTracker
+	//-------------------------------------------------------------------------
+
+	// 区分ごとのメモリ使用量の記帳先
+	/* @note:
+		プロセス全体で１つ（Global）と、セッションごとに１つ（MemoryAccount が持つ）。
+		セッションの記帳先に記帳すると、プロセス全体の記帳先にも同じ値が記帳される。
+		生成・解放のたびに呼ばれるので、値は全て atomic で持つ。
+	*/
+	class MemoryTracker
+	{
+	public:
+		// 区分１つ分のカウンタ
+		struct COUNTERS
+		{
+			std::int64_t	currentBytes;		// 現在の使用量
+			std::int64_t	peakBytes;			// 使用量の最大値
+			std::uint64_t	allocations;		// 生成回数
+			std::uint64_t	releases;			// 解放回数
+			std::uint64_t	totalBytes;			// 生成したサイズの累計
+		};
+
+		// プロセス全体の記帳先を得る
+		static const std::shared_ptr<MemoryTracker>& Global();
+
+		// 現在のスレッドの記帳先を得る
+		// @note: MemoryTrackerScope で設定されていなければ Global
+		static std::shared_ptr<MemoryTracker> Current();
+
+		// コンストラクタ
+		// @note: pParent を渡すと、記帳した値を pParent にも記帳する
+		explicit MemoryTracker(std::shared_ptr<MemoryTracker> pParent = nullptr);
+
+		// デストラクタ
+		~MemoryTracker() = default;
+
+		// コピー禁止
+		MemoryTracker(const MemoryTracker&) = delete;
+		MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+		// 生成を記帳する
+		void RecordAllocation(MemoryCategory category, std::int64_t bytes);
+
+		// 解放を記帳する
+		void RecordRelease(MemoryCategory category, std::int64_t bytes);
+
+		// 解放を追えない引き渡しを記帳する
+		/* @note:
+			Python に渡した bytes は Python の GC が解放するので、生成回数と累計だけ数える。
+			現在の使用量・最大値は変わらない。
+		*/
+		void RecordTransfer(MemoryCategory category, std::int64_t bytes);
+
+		// カウンタを得る
+		COUNTERS GetCounters(MemoryCategory category) const;
+
+	private:
+		// 区分１つ分のカウンタ（atomic 版）
+		struct _ATOMIC_COUNTERS
+		{
+			std::atomic<std::int64_t>	currentBytes;
+			std::atomic<std::int64_t>	peakBytes;
+			std::atomic<std::uint64_t>	allocations;
+			std::atomic<std::uint64_t>	releases;
+			std::atomic<std::uint64_t>	totalBytes;
+		};
+
+		std::shared_ptr<MemoryTracker>								m_pParent;
+		std::array<_ATOMIC_COUNTERS, NUM_MEMORY_CATEGORIES>			m_counters;
+	};
+
+	//-------------------------------------------------------------------------
+	// MemoryTrackerScope
+	//-------------------------------------------------------------------------
+
+	// スコープの間、現在のスレッドの記帳先を差し替える
+	/* @note:
+		ReadbackTexture のように、どのセッションのために呼ばれたか知らない関数の記帳先を決めるためのもの。
+		入れ子にでき、スコープを抜けると元に戻る。
+	*/
+	class MemoryTrackerScope
+	{
+	public:
+		// コンストラクタ
+		// @note: pTracker が nullptr なら何も差し替えない
+		explicit MemoryTrackerScope(std::shared_ptr<MemoryTracker> pTracker);
+
+		// デストラクタ
+		~MemoryTrackerScope();
+
+		// コピー禁止
+		MemoryTrackerScope(const MemoryTrackerScope&) = delete;
+		MemoryTrackerScope& operator=(const MemoryTrackerScope&) = delete;
+
+	private:
+		std::shared_ptr<MemoryTracker>	m_pPrevTracker;
+	};
+
+	//-------------------------------------------------------------------------
+	// Functions
+	//-------------------------------------------------------------------------
+
+	// テクスチャのサイズ（バイト数）を得る
+	// @note: NV12 で保持しているテクスチャは R8 に詰めてあるので 1 バイト/テクセル
+	std::size_t GetTextureSizeInBytes(const wgc::com_ptr<ID3D11Texture2D>& pTexture);
+
+	// テクスチャの生成を記帳し、テクスチャが解放された時に解放を記帳する
+	/* @note:
+		テクスチャのプライベートデータに解放を検知するオブジェクトを持たせるので、
+		スナップショット等で参照が共有されていても、最後の参照が手放された時に解放が記帳される。
+		記帳済みのテクスチャなら何もしない。
+	*/
+	void TrackTexture(
+		const wgc::com_ptr<ID3D11Texture2D>& pTexture,
+		MemoryCategory category,
+		const std::shared_ptr<MemoryTracker>& pTracker
+	);
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+namespace ayc
+{
+	// フレームバッファに保持するテクスチャのフォーマット
+	enum class FrameFormat
+	{
+		BGRA,		// B8G8R8A8（4 バイト/画素）
+		NV12,		// NV12（1.5 バイト/画素）
+	};
+
+	// テクスチャを NV12 に変換してコピーする
+	/* @note:
+		BT.709 full range。縮小が必要なら変換と同じパスで行う。
+		DXGI_FORMAT_NV12 は幅・高さが偶数に限られ、レンダーターゲットにできるかもドライバ次第なので、
+		R8_UNORM のテクスチャ１枚に輝度面と色差面（UV 交互）を縦に詰めて持つ。
+		幅・高さは偶数に切り上げ、論理サイズはテクスチャのプライベートデータに記録する。
+	*/
+	wgc::com_ptr<ID3D11Texture2D> ConvertTextureToNV12(
+		const wgc::com_ptr<ID3D11Texture2D>& pSrcTex,
+		UINT destWidth,
+		UINT destHeight
+	);
+
+	// ConvertTextureToNV12 で作ったテクスチャなら true を返し、論理サイズを書き戻す
+	bool GetNV12TextureSize(
+		std::size_t& outWidth,
+		std::size_t& outHeight,
+		const wgc::com_ptr<ID3D11Texture2D>& pTexture
+	);
+
+	// NV12（BT.709 full range）を BGR24 に変換する
+	/* @note:
+		pUV は輝度２行につき１行で、UV を交互に並べたもの。
+		幅・高さが奇数の場合、色差は切り上げたサイズで持っている前提。
+		pDst は width * height * 3 バイト。
+	*/
+	void ConvertNV12ToBGR(
+		std::uint8_t* pDst,
+		const std::uint8_t* pY,
+		std::size_t yStride,
+		const std::uint8_t* pUV,
+		std::size_t uvStride,
+		std::size_t width,
+		std::size_t height
+	);
+}
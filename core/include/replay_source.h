@@ -0,0 +1,168 @@
+﻿#pragma once
+
+#include "frame_archive.h"
+#include "utils.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Forward Declaration
+	//-------------------------------------------------------------------------
+
+	namespace details
+	{
+		class WGCSessionState;
+	}
+
+	//-------------------------------------------------------------------------
+	// Parameters
+	//-------------------------------------------------------------------------
+
+	// リプレイの設定
+	struct REPLAY_PARAM
+	{
+		bool	isRealtime;		// true なら記録時の間隔どおりに待って流し、false なら待たずに流す
+		bool	isLooped;		// 末尾まで流したら先頭に戻る
+		double	speed;			// 再生速度の倍率
+	};
+
+	// 次に流すフレーム
+	struct REPLAY_STEP
+	{
+		std::size_t		frameIndex;		// アーカイブ上のインデックス
+		double			offsetInSec;	// 再生開始からの経過秒数（再生速度の倍率を適用済み）
+	};
+
+	//-------------------------------------------------------------------------
+	// ReplaySchedule
+	//-------------------------------------------------------------------------
+
+	// アーカイブのタイムスタンプから、フレームを流す順番と時刻を決めるクラス
+	/* @note:
+		D3D11 にも Win32 にも依存しないので、どのプラットフォームでも単体で動かせる。
+		ループ時は、末尾のフレームから平均フレーム間隔だけ空けて先頭に戻る。
+	*/
+	class ReplaySchedule
+	{
+	public:
+		// コンストラクタ
+		// @note: relativesInSec はアーカイブのエントリ順の「最新フレームからさかのぼった秒数」
+		ReplaySchedule(
+			const std::vector<double>& relativesInSec,
+			double speed,
+			bool isLooped
+		);
+
+		// 次に流すフレームを得る
+		// @note: 末尾まで流し終えたら（ループしないなら）false を返す
+		bool Next(REPLAY_STEP& step);
+
+		// １周の秒数（再生速度の倍率を適用前）
+		double GetLoopDurationInSec() const noexcept
+		{
+			return m_loopDurationInSec;
+		}
+
+	private:
+		std::vector<double>		m_offsetsInSec;
+		double					m_loopDurationInSec;
+		double					m_speed;
+		bool					m_isLooped;
+		std::size_t				m_nextIndex;
+		std::uint64_t			m_numLoops;
+	};
+
+	//-------------------------------------------------------------------------
+	// ReplayClock
+	//-------------------------------------------------------------------------
+
+	// リプレイ中のフレームバッファが参照する「現在」
+	/* @note:
+		実時間で流す場合は NowFromQPC をそのまま返す。
+		待たずに流す場合は、最後に流したフレームのタイムスタンプを「現在」とする。
+		こうすると保持秒数・最近傍フレームの選択が、実時間で流した場合と同じ結果になる。
+	*/
+	class ReplayClock
+	{
+	public:
+		// コンストラクタ
+		explicit ReplayClock(bool isVirtual);
+
+		// 「現在」を得る
+		wgc::TimeSpan Now() const;
+
+		// 仮想時刻を進める
+		// @note: 実時間の時計なら何もしない
+		void Advance(const wgc::TimeSpan& nowInTS);
+
+	private:
+		bool								m_isVirtual;
+		std::atomic<wgc::TimeSpan::rep>		m_nowInTicks;
+	};
+
+	//-------------------------------------------------------------------------
+	// ReplaySource
+	//-------------------------------------------------------------------------
+
+	// アーカイブを再生して、キャプチャの代わりにフレームを流すクラス
+	/* @note:
+		BG スレッドでフレームを展開してテクスチャに上げ、
+		WGCSessionState::PushCapturedFrame に渡すので、キャプチャと同じ経路を通る。
+		例外はトンネルに入れて、WGCSession 側の呼び出しで再送させる。
+	*/
+	class ReplaySource
+	{
+	public:
+		// コンストラクタ
+		ReplaySource(
+			const std::string& path,
+			const REPLAY_PARAM& param,
+			const std::shared_ptr<ReplayClock>& pClock,
+			details::WGCSessionState& state,
+			ExceptionTunnel& exceptionTunnel,
+			std::optional<std::size_t> maxWidth,
+			std::optional<std::size_t> maxHeight
+		);
+
+		// デストラクタ
+		~ReplaySource();
+
+		// コピー禁止
+		ReplaySource(const ReplaySource&) = delete;
+		ReplaySource& operator=(const ReplaySource&) = delete;
+
+		// 再生を止める
+		void Close();
+
+		// 末尾まで流し終えたら true を返す
+		bool IsFinished() const noexcept
+		{
+			return m_isFinished;
+		}
+
+	private:
+		// BG スレッドハンドラ
+		void _ThreadHandler();
+
+		// BGR24 のフレームからテクスチャを生成する
+		wgc::com_ptr<ID3D11Texture2D> _CreateTexture(
+			std::size_t width,
+			std::size_t height,
+			const std::string& frameBuffer
+		);
+
+		FrameArchive						m_archive;
+		ReplaySchedule						m_schedule;
+		REPLAY_PARAM						m_param;
+		std::shared_ptr<ReplayClock>		m_pClock;
+		details::WGCSessionState&			m_state;
+		ExceptionTunnel&					m_exceptionTunnel;
+		std::optional<std::size_t>			m_maxWidth;
+		std::optional<std::size_t>			m_maxHeight;
+		std::mutex							m_guard;
+		std::condition_variable				m_cv;
+		bool								m_isClosed;
+		std::atomic<bool>					m_isFinished;
+		std::thread							m_thread;
+	};
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "frame_signature.h"
+
+namespace ayc
+{
+	// シーン切り替え１つ分
+	struct SCENE_CUT
+	{
+		double		relativeInSec;		// 切り替わった後の最初のフレームの相対時刻（最新フレームからさかのぼった秒数）
+		double		score;				// 直前のフレームとの差（0 〜 1）
+	};
+
+	// シーン切り替えの索引
+	/* @note:
+		フレームの署名が届くごとに、FRAME_SIGNATURE のタイル輝度から直前のフレームとの差を求め、
+		閾値を超えたものだけを時刻順に記録する。
+		署名は GPU からの読み出しを待たないよう、フレームの到着の１フレーム後に届く。
+		記録はフレーム自身のタイムスタンプで行うので、遅れて届いても時刻順は崩れない。
+		差はタイル輝度の平均絶対差と、タイル輝度のヒストグラムの Earth Mover's Distance の平均。
+		前者は構図の変化、後者は明るさの分布の変化を拾う。
+		記録は到着順（＝時刻順）に並ぶので、範囲の問い合わせは二分探索で済む。
+	*/
+	class SceneCutIndex
+	{
+	public:
+		// コンストラクタ
+		// @note: clock は「現在」を返す関数で、nullptr なら NowFromQPC
+		SceneCutIndex(
+			double holdInSec,
+			double threshold,
+			std::function<wgc::TimeSpan()> clock = nullptr
+		);
+
+		// デストラクタ
+		~SceneCutIndex() = default;
+
+		// コピー禁止
+		SceneCutIndex(const SceneCutIndex&) = delete;
+		SceneCutIndex& operator=(const SceneCutIndex&) = delete;
+
+		// フレームの署名を記録する
+		// @note: 到着順に呼ぶこと。フレームサイズが変わった場合は必ず切り替えとみなす
+		void Push(
+			const std::shared_ptr<const FRAME_SIGNATURE>& pSignature,
+			const wgc::TimeSpan& timeSpan
+		);
+
+		// 直近 durationInSec 秒以内のシーン切り替えを古い順に取得する
+		// @note: 二分探索で範囲の先頭を求めるので、O(log n + 該当数)
+		std::vector<SCENE_CUT> GetCuts(double durationInSec) const;
+
+		// 最後に署名を記録したフレームの直前のフレームとの差を取得する
+		// @note: 署名は１フレーム遅れで届くので、最新フレームの１つ前のフレームについての差
+		double GetLatestScore() const;
+
+	private:
+		// 記録１つ分
+		struct _ENTRY
+		{
+			wgc::TimeSpan	timeSpan;
+			double			score;
+		};
+
+		// タイル輝度から求めた特徴量
+		struct _FEATURE
+		{
+			std::uint32_t				width;
+			std::uint32_t				height;
+			std::vector<std::uint8_t>	tileMeans;
+			std::vector<std::uint32_t>	histogram;
+			std::uint64_t				numPixels;
+		};
+
+		// 署名から特徴量を求める
+		static _FEATURE _MakeFeature(const FRAME_SIGNATURE& signature);
+
+		// 特徴量同士の差を求める
+		static double _ComputeScore(const _FEATURE& lhs, const _FEATURE& rhs);
+
+		mutable std::mutex				m_guard;
+		std::deque<_ENTRY>				m_cuts;
+		std::optional<_FEATURE>			m_prevFeature;
+		double							m_latestScore;
+		double							m_holdInSec;
+		double							m_threshold;
+		std::function<wgc::TimeSpan()>	m_clock;
+	};
+}
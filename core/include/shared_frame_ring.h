@@ -0,0 +1,179 @@
+﻿#pragma once
+
+#include "frame_subscription.h"
+#include "utils.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Shared Memory Layout
+	//-------------------------------------------------------------------------
+
+	/* @note:
+		別プロセスの読み手（aynime_capture/shared_ring.py）と共有するレイアウト。
+		変更する場合は SHARED_FRAME_RING_VERSION を上げて、読み手側も合わせること。
+
+		[SHARED_FRAME_RING_HEADER]
+		[SHARED_FRAME_SLOT] x numSlots
+		(ページ境界までパディング)
+		[スロットのピクセルデータ] x numSlots  ... 各 slotCapacityInBytes バイト
+
+		スロットは seqlock で保護する。
+		書き手は lock を奇数にしてから記述子とデータを書き換え、偶数に戻す。
+		読み手は読む前後で lock が同じ偶数であることを確認し、違えば読み直す。
+	*/
+
+	// 共有メモリの識別子 'AYCR'
+	constexpr std::uint32_t SHARED_FRAME_RING_MAGIC = 0x52435941;
+
+	// レイアウトのバージョン
+	constexpr std::uint32_t SHARED_FRAME_RING_VERSION = 1;
+
+	// ピクセルフォーマット
+	enum class SharedFrameFormat : std::uint32_t
+	{
+		BGR24 = 1,	// B, G, R の順に 8bit ずつ
+	};
+
+	// 共有メモリ先頭のヘッダ
+	struct alignas(64) SHARED_FRAME_RING_HEADER
+	{
+		std::uint32_t	magic;
+		std::uint32_t	version;
+		std::uint32_t	numSlots;
+		std::uint32_t	slotDescSizeInBytes;
+		std::uint64_t	slotCapacityInBytes;
+		std::uint64_t	dataOffsetInBytes;
+		std::uint64_t	latestSeq;			// @note: 最後に書き終えたフレームの seq（atomic_ref でアクセス）
+	};
+	static_assert(sizeof(SHARED_FRAME_RING_HEADER) == 64);
+
+	// スロット記述子
+	struct alignas(64) SHARED_FRAME_SLOT
+	{
+		std::uint64_t	lock;				// @note: seqlock（atomic_ref でアクセス）
+		std::uint64_t	seq;
+		std::int64_t	timestamp;			// @note: 100ns 単位
+		std::uint32_t	width;
+		std::uint32_t	height;
+		std::uint32_t	stride;
+		std::uint32_t	format;
+		std::uint64_t	sizeInBytes;
+	};
+	static_assert(sizeof(SHARED_FRAME_SLOT) == 64);
+
+	//-------------------------------------------------------------------------
+	// SharedFrameRing
+	//-------------------------------------------------------------------------
+
+	// 名前付き共有メモリ上のフレームリングバッファ（書き手側）
+	class SharedFrameRing
+	{
+	public:
+		// コンストラクタ
+		SharedFrameRing(
+			const std::string& name,
+			std::size_t numSlots,
+			std::size_t slotCapacityInBytes
+		);
+
+		// デストラクタ
+		~SharedFrameRing();
+
+		// コピー禁止
+		SharedFrameRing(const SharedFrameRing&) = delete;
+		SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+		// フレームを１つ書き込む
+		// @note: スロットに収まらない場合は何もせずに false を返す
+		bool Publish(
+			std::uint64_t seq,
+			wgc::TimeSpan timeSpan,
+			std::size_t width,
+			std::size_t height,
+			std::size_t stride,
+			SharedFrameFormat format,
+			const void* pData,
+			std::size_t sizeInBytes
+		);
+
+		// 共有メモリの名前
+		const std::string& GetName() const noexcept
+		{
+			return m_name;
+		}
+
+	private:
+		// スロット記述子を得る
+		SHARED_FRAME_SLOT& _GetSlot(std::size_t index);
+
+		// スロットのピクセルデータ先頭を得る
+		std::uint8_t* _GetSlotData(std::size_t index);
+
+		std::string					m_name;
+		HANDLE						m_hMapping;
+		std::uint8_t*				m_pView;
+		std::size_t					m_numSlots;
+		std::size_t					m_slotCapacityInBytes;
+		std::size_t					m_nextSlot;
+	};
+
+	//-------------------------------------------------------------------------
+	// SharedFramePublisher
+	//-------------------------------------------------------------------------
+
+	// 書き出しの統計情報
+	struct SHARED_FRAME_PUBLISHER_STATS
+	{
+		std::uint64_t	published;		// 書き込んだフレーム数
+		std::uint64_t	oversized;		// スロットに収まらず捨てたフレーム数
+		std::uint64_t	dropped;		// 書き込みが間に合わず捨てたフレーム数
+	};
+
+	// 新着フレームを共有メモリリングに書き出すクラス
+	/* @note:
+		FrameDispatcher の購読者として振る舞い、BG スレッド上で書き出す。
+		GIL は一切触らない。
+	*/
+	class SharedFramePublisher
+	{
+	public:
+		// コンストラクタ
+		SharedFramePublisher(
+			const std::shared_ptr<FrameDispatcher>& pFrameDispatcher,
+			const std::string& name,
+			std::size_t numSlots,
+			std::size_t slotCapacityInBytes
+		);
+
+		// デストラクタ
+		~SharedFramePublisher();
+
+		// コピー禁止
+		SharedFramePublisher(const SharedFramePublisher&) = delete;
+		SharedFramePublisher& operator=(const SharedFramePublisher&) = delete;
+
+		// 書き出しを停止する
+		void Close();
+
+		// 共有メモリの名前
+		const std::string& GetName() const noexcept
+		{
+			return m_ring.GetName();
+		}
+
+		// 統計情報を取得する
+		SHARED_FRAME_PUBLISHER_STATS GetStats() const;
+
+	private:
+		// BG スレッドハンドラ
+		void _ThreadHandler();
+
+		SharedFrameRing							m_ring;
+		std::shared_ptr<FrameDispatcher>		m_pFrameDispatcher;
+		std::shared_ptr<FrameSubscriber>		m_pSubscriber;
+		std::atomic<std::uint64_t>				m_numPublished;
+		std::atomic<std::uint64_t>				m_numOversized;
+		std::thread								m_thread;
+	};
+}
@@ -0,0 +1,215 @@
+﻿#pragma once
+
+#include "cold_frame_store.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Spill File Layout
+	//-------------------------------------------------------------------------
+
+	/* @note:
+		セグメントファイルは作成時に固定サイズで確保し、丸ごとメモリマップする。
+		レコードは先頭から詰めて追記するだけで、書き換えはしない。
+
+		[SPILL_RECORD_HEADER]
+		[SPILL_TILE_ENTRY] x numTilesX * numTilesY
+		[タイルの圧縮データ] ... 可変長、次のレコードは 8 バイト境界から
+
+		差分フレームのレコードは、同じセグメント内のキーフレームのレコードを参照する。
+		セグメントをまたぐ時はキーフレームを書き直すので、セグメントは単独で展開できる。
+	*/
+
+	// レコードの識別子 'AYCS'
+	constexpr std::uint32_t SPILL_RECORD_MAGIC = 0x53435941;
+
+	// レコードのヘッダ
+	struct SPILL_RECORD_HEADER
+	{
+		std::uint32_t	magic;
+		std::uint32_t	isKeyframe;
+		std::int64_t	timestamp;			// @note: 100ns 単位
+		std::uint32_t	width;
+		std::uint32_t	height;
+		std::uint32_t	numTilesX;
+		std::uint32_t	numTilesY;
+		std::uint64_t	keyframeOffset;		// @note: 参照するキーフレームのレコード位置（キーフレーム自身なら 0）
+		std::uint64_t	recordSizeInBytes;
+	};
+	static_assert(sizeof(SPILL_RECORD_HEADER) == 48);
+
+	// タイル１枚の格納位置
+	struct SPILL_TILE_ENTRY
+	{
+		std::uint64_t	offset;				// @note: セグメント先頭からの位置
+		std::uint64_t	sizeInBytes;		// @note: ゼロならキーフレームから変化なし
+	};
+	static_assert(sizeof(SPILL_TILE_ENTRY) == 16);
+
+	//-------------------------------------------------------------------------
+	// Parameters
+	//-------------------------------------------------------------------------
+
+	// 書き出しの設定
+	struct SPILL_PARAM
+	{
+		std::string		directory;				// セグメントファイルを置くディレクトリ
+		double			spillAfterInSec;		// これより古いコールドフレームをディスクに移す
+		std::uint64_t	budgetInBytes;			// セグメントファイルの合計サイズの上限
+		std::uint64_t	segmentSizeInBytes;		// セグメントファイル１つのサイズ
+	};
+
+	// 書き出しの統計情報
+	struct SPILL_STATS
+	{
+		std::size_t		segments;				// 使用中のセグメント数
+		std::uint64_t	diskBytes;				// 使用中のセグメントファイルのサイズ合計
+		std::uint64_t	usedBytes;				// 使用中のセグメントに書き込んだサイズ合計
+		std::uint64_t	records;				// 使用中のセグメントに書き込んだフレーム数
+		std::uint64_t	retiredSegments;		// 上限を超えて破棄したセグメント数
+	};
+
+	//-------------------------------------------------------------------------
+	// SpillSegment
+	//-------------------------------------------------------------------------
+
+	// メモリマップしたセグメントファイル１つ
+	/* @note:
+		ファイルは FILE_FLAG_DELETE_ON_CLOSE で開くので、
+		最後の参照（ColdFrame が持っている）が無くなった時点でディスクからも消える。
+	*/
+	class SpillSegment
+	{
+	public:
+		// コンストラクタ
+		SpillSegment(
+			const std::string& path,
+			std::uint64_t id,
+			std::uint64_t capacityInBytes
+		);
+
+		// デストラクタ
+		~SpillSegment();
+
+		// コピー禁止
+		SpillSegment(const SpillSegment&) = delete;
+		SpillSegment& operator=(const SpillSegment&) = delete;
+
+		// セグメントの通し番号
+		std::uint64_t GetId() const noexcept
+		{
+			return m_id;
+		}
+
+		// ファイルサイズ
+		std::uint64_t GetCapacityInBytes() const noexcept
+		{
+			return m_capacityInBytes;
+		}
+
+		// 書き込み済みのサイズ
+		std::uint64_t GetUsedInBytes() const noexcept
+		{
+			return m_usedInBytes;
+		}
+
+		// マップ先の先頭
+		const std::uint8_t* GetData() const noexcept
+		{
+			return m_pView;
+		}
+
+		// 追記先を確保する
+		// @note: 収まらなければ nullptr を返す
+		std::uint8_t* Allocate(std::uint64_t sizeInBytes, std::uint64_t& outOffset);
+
+		// 書き込んだフレームを数える
+		void CountRecord() noexcept
+		{
+			++m_numRecords;
+		}
+
+		// 書き込んだフレーム数
+		// @note: 差分の参照先として書き直したキーフレームは含まない
+		std::uint64_t GetNumRecords() const noexcept
+		{
+			return m_numRecords;
+		}
+
+	private:
+		std::uint64_t					m_id;
+		HANDLE							m_hFile;
+		HANDLE							m_hMapping;
+		std::uint8_t*					m_pView;
+		std::uint64_t					m_capacityInBytes;
+		std::uint64_t					m_usedInBytes;
+		std::uint64_t					m_numRecords;
+	};
+
+	//-------------------------------------------------------------------------
+	// SpillStore
+	//-------------------------------------------------------------------------
+
+	// コールドフレームをディスクに書き出すクラス
+	/* @note:
+		Spill は I/O スレッド１本から呼ぶこと。
+		書き出したフレームはセグメントファイルを直接参照するので、展開時に read は発生しない。
+		合計サイズが上限を超える場合は、最も古いセグメントから破棄する。
+	*/
+	class SpillStore
+	{
+	public:
+		// コンストラクタ
+		explicit SpillStore(const SPILL_PARAM& param);
+
+		// デストラクタ
+		~SpillStore() = default;
+
+		// コピー禁止
+		SpillStore(const SpillStore&) = delete;
+		SpillStore& operator=(const SpillStore&) = delete;
+
+		// 設定
+		const SPILL_PARAM& GetParam() const noexcept
+		{
+			return m_param;
+		}
+
+		// コールドフレームを書き出して、セグメントファイルを参照するコールドフレームを返す
+		std::shared_ptr<const ColdFrame> Spill(
+			const std::shared_ptr<const ColdFrame>& pFrame,
+			const wgc::TimeSpan& timeSpan
+		);
+
+		// 破棄済みセグメントの通し番号の最大値
+		// @note: まだ１つも破棄していなければ 0
+		std::uint64_t GetRetiredSegmentId() const;
+
+		// 統計情報を取得する
+		SPILL_STATS GetStats() const;
+
+	private:
+		// レコードを１つ書き込む
+		std::shared_ptr<const ColdFrame> _WriteRecord(
+			SpillSegment& segment,
+			const std::shared_ptr<const SpillSegment>& pSegment,
+			const ColdFrame& frame,
+			const std::shared_ptr<const ColdFrame>& pSpilledKeyframe,
+			const wgc::TimeSpan& timeSpan
+		);
+
+		// 新しいセグメントを開く
+		// @note: 上限を超える分は古いセグメントから破棄する
+		void _OpenSegment();
+
+		mutable std::mutex							m_guard;
+		SPILL_PARAM									m_param;
+		std::deque<std::shared_ptr<SpillSegment>>	m_segments;
+		std::uint64_t								m_retiredSegmentId;
+		std::uint64_t								m_numRetired;
+		std::shared_ptr<const ColdFrame>			m_pKeyframeSource;
+		std::shared_ptr<const ColdFrame>			m_pSpilledKeyframe;
+		std::shared_ptr<const ColdFrame>			m_pPrevSource;
+		std::shared_ptr<const ColdFrame>			m_pPrevSpilled;
+	};
+}
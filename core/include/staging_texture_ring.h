@@ -0,0 +1,139 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// StagingTextureRing
+	//-------------------------------------------------------------------------
+
+	// 読み出し用のステージングテクスチャを使い回すためのリング
+	/* @note:
+		ReadbackTexture のたびに STAGING テクスチャを生成・破棄すると、
+		ドライバ内での確保とページのコミットが毎回走る。
+		サイズ・フォーマットごとに使い終わったテクスチャを取っておき、次の読み出しで再利用する。
+		プロセス全体で共有するので、全ての操作はスレッドセーフ。
+	*/
+	class StagingTextureRing
+	{
+	public:
+		// プロセス共通のインスタンスを得る
+		static StagingTextureRing& Instance();
+
+		// コンストラクタ
+		// @note: capacityPerSize はサイズ・フォーマットごとに取っておく枚数の上限
+		explicit StagingTextureRing(std::size_t capacityPerSize);
+
+		// デストラクタ
+		~StagingTextureRing() = default;
+
+		// コピー禁止
+		StagingTextureRing(const StagingTextureRing&) = delete;
+		StagingTextureRing& operator=(const StagingTextureRing&) = delete;
+
+		// srcDesc と同じサイズ・フォーマットのステージングテクスチャを得る
+		// @note: 空きが無ければ生成する
+		wgc::com_ptr<ID3D11Texture2D> Acquire(const D3D11_TEXTURE2D_DESC& srcDesc);
+
+		// 使い終わったステージングテクスチャを返す
+		// @note: 上限を超えた分は破棄する
+		void Release(const wgc::com_ptr<ID3D11Texture2D>& pTexture);
+
+		// 取っておいたステージングテクスチャを全て破棄する
+		// @note: D3D11 デバイスを解放する前に呼ぶこと
+		void Clear();
+
+	private:
+		// サイズ・フォーマットの組
+		typedef std::tuple<UINT, UINT, DXGI_FORMAT> _KEY;
+
+		// テクスチャの desc からキーを得る
+		static _KEY _ToKey(const D3D11_TEXTURE2D_DESC& desc);
+
+		std::mutex												m_guard;
+		std::map<_KEY, std::vector<wgc::com_ptr<ID3D11Texture2D>>>	m_freeTextures;
+		std::size_t												m_capacityPerSize;
+	};
+
+	//-------------------------------------------------------------------------
+	// Readback Pipeline
+	//-------------------------------------------------------------------------
+
+	// 先行転送の対象
+	/* @note:
+		GPU に依存する処理（転送の発行・マップ）をここに閉じ込めて、
+		RunReadbackPipeline のスケジューリングを GPU 無しで動かせるようにする。
+	*/
+	class IReadbackBackend
+	{
+	public:
+		// デストラクタ
+		virtual ~IReadbackBackend() = default;
+
+		// index 番目の転送を発行する
+		// @note: 発行しなかった（空要素・キャンセル済み等）なら false を返す。完了待ちには並ばない
+		virtual bool Issue(std::size_t index) = 0;
+
+		// index 番目の転送が終わっていれば読み出しを済ませて true を返す
+		// @note: GPU を待たないこと。未完了なら false を返す
+		virtual bool TryComplete(std::size_t index) = 0;
+
+		// 発行済みの index 番目の転送が進むのを少し待つ
+		// @note: 終わるまで待たなくてよい。戻った後に TryComplete で確かめ直す
+		virtual void WaitForProgress(std::size_t index) = 0;
+	};
+
+	// ReadbackPipeline::Advance の結果
+	enum class ReadbackProgress
+	{
+		FINISHED,	// 全ての転送を完了させた
+		YIELDED,	// 完了させる数の上限に達した。すぐに続きを進められる
+		WAITING,	// 先頭の転送が GPU で終わっていない
+	};
+
+	// 0 ～ count - 1 番目の転送を、最大 depth 個先行して発行しながら順に完了させる
+	/* @note:
+		先頭の転送を読み出している（CPU で変換している）間も、後続の転送は GPU で進む。
+		完了は発行順に行う。GPU のコピーは発行順に終わるので、先頭だけ見ればよい。
+		Advance は GPU を待たずに戻るので、スレッドを占有せずに少しずつ進められる。
+	*/
+	class ReadbackPipeline
+	{
+	public:
+		// コンストラクタ
+		ReadbackPipeline(
+			IReadbackBackend& backend,
+			std::size_t count,
+			std::size_t depth
+		);
+
+		// デストラクタ
+		~ReadbackPipeline() = default;
+
+		// コピー禁止
+		ReadbackPipeline(const ReadbackPipeline&) = delete;
+		ReadbackPipeline& operator=(const ReadbackPipeline&) = delete;
+
+		// 進められるだけ進める
+		// @note: 最大 maxCompletions 個の転送を完了させるか、先頭の転送が未完了なら戻る
+		ReadbackProgress Advance(std::size_t maxCompletions);
+
+		// 先頭の転送が進むのを少し待つ
+		// @note: Advance が WAITING を返した後に呼ぶ
+		void WaitForProgress();
+
+	private:
+		IReadbackBackend&		m_backend;
+		std::size_t				m_count;
+		std::size_t				m_depth;
+		std::deque<std::size_t>	m_inFlight;		// 発行済み・未完了の転送
+		std::size_t				m_next;			// 次に発行する転送
+	};
+
+	// ReadbackPipeline を最後まで回す
+	// @note: 先頭の転送が未完了の間は backend.WaitForProgress で待つ
+	void RunReadbackPipeline(
+		IReadbackBackend& backend,
+		std::size_t count,
+		std::size_t depth
+	);
+}
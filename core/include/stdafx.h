@@ -8,6 +8,7 @@
 #define WIN32_LEARN_AND_MEAN
 #define NOMINMAX
 #include <Windows.h>
+#include <io.h>
 
 // winrt
 #include <winrt/base.h>
@@ -30,15 +31,21 @@
 
 // std
 #include <cstdint>
+#include <limits>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <deque>
+#include <map>
 #include <vector>
 #include <string>
 #include <atomic>
 #include <algorithm>
 #include <ranges>
 #include <future>
+#include <functional>
+#include <numeric>
+#include <span>
 #include <stacktrace>
 #include <stdexcept>
 #include <sstream>
@@ -52,6 +59,8 @@ namespace wgc
 	using winrt::guid_of;
 	using winrt::put_abi;
 	using winrt::get_activation_factory;
+	using winrt::implements;
+	using winrt::make_self;
 
 	// WinRT Foundation
 	using winrt::Windows::Foundation::TimeSpan;
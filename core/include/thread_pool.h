@@ -0,0 +1,177 @@
+﻿#pragma once
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Types
+	//-------------------------------------------------------------------------
+
+	// 仕事の優先度
+	// @note: 値が小さいほど先に実行する
+	enum class TaskPriority
+	{
+		INTERACTIVE,	// 呼び出し元が結果を待っている（GetFrameByTime 等）
+		BULK,			// まとめて処理する（スナップショット・書き出し等）
+	};
+
+	// 優先度の数
+	constexpr std::size_t NUM_TASK_PRIORITIES = 2;
+
+	//-------------------------------------------------------------------------
+	// ThreadPool
+	//-------------------------------------------------------------------------
+
+	// 常駐するワーカースレッドで仕事を分担するプール
+	/* @note:
+		ワーカーごとに優先度別の仕事の両端キューを持ち、自分のキューが空になったら他のワーカーの
+		キューの反対側から盗む（work stealing）。
+		１つだけ遅い仕事があっても、他のワーカーが残りを引き取るので全体が引きずられにくい。
+		どのキューでも INTERACTIVE の仕事を BULK の仕事より先に取り出す。
+		ParallelFor の呼び出し元スレッドも、完了を待つ間は自分の仕事を引き受ける。
+		なので、ワーカー上から ParallelFor を入れ子に呼んでもデッドロックしない。
+	*/
+	class ThreadPool
+	{
+	public:
+		// 統計
+		struct STATS
+		{
+			std::size_t										numWorkers;
+			std::vector<std::size_t>						queueDepths;	// ワーカーごとの積まれている仕事の数
+			std::array<std::size_t, NUM_TASK_PRIORITIES>	queuedTasks;	// 優先度ごとの積まれている仕事の数
+			std::uint64_t									executedTasks;	// 実行した仕事の数の累計
+			std::uint64_t									stolenTasks;	// 他のワーカーのキューから取った仕事の数の累計
+		};
+
+		// プロセス共通のインスタンスの設定を変える
+		/* @note:
+			最初に Instance を呼ぶ前にだけ変えられる。それ以降はエラー。
+			numWorkers を省略すると論理コア数 - 1（最低１）。呼び出し元スレッドが１本ぶん働くため。
+			affinityMask を省略すると OS 任せ。
+		*/
+		static void Configure(
+			std::optional<std::size_t> numWorkers,
+			std::optional<std::uint64_t> affinityMask
+		);
+
+		// プロセス共通のインスタンスを得る
+		static ThreadPool& Instance();
+
+		// 現在のスレッドの優先度を得る
+		// @note: TaskPriorityScope で設定されていなければ BULK
+		static TaskPriority GetCurrentPriority();
+
+		// コンストラクタ
+		/* @note:
+			numWorkers が 0 なら、全ての仕事を呼び出し元スレッドで実行する。
+			affinityMask を渡すと、全てのワーカーをそのコアに固定する。
+		*/
+		explicit ThreadPool(
+			std::size_t numWorkers,
+			std::optional<std::uint64_t> affinityMask = std::nullopt
+		);
+
+		// デストラクタ
+		// @note: キューに残った仕事を捨てずに実行しきってからスレッドを止める
+		~ThreadPool();
+
+		// コピー禁止
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// func(0) 〜 func(count - 1) を分担して実行し、全て終わるまで待つ
+		/* @note:
+			現在のスレッドの優先度で積む。
+			最初に起きた例外を呼び出し元スレッドで再送する。残りの仕事は実行せずに捨てる。
+		*/
+		void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func);
+
+		// func をワーカーで実行する
+		/* @note:
+			現在のスレッドの優先度で積み、完了（例外を含む）は future で受け取る。
+			ParallelFor の呼び出し元は Submit された仕事を引き受けない。
+			ただし実行中の仕事はワーカーを占有し、後から積まれた INTERACTIVE の仕事も待たされる。
+			GPU 待ちのように長く続く仕事は小さく刻み、続きを Submit し直すこと。
+			ワーカーがいなければ、その場で実行する。
+		*/
+		std::future<void> Submit(std::function<void()> func);
+
+		// ワーカー数を得る
+		std::size_t GetNumWorkers() const;
+
+		// 統計を得る
+		STATS GetStats() const;
+
+	private:
+		// 仕事
+		struct _TASK
+		{
+			std::function<void()>	func;
+			const void*				pGroup;		// ParallelFor の呼び出しごとの印（Submit なら nullptr）
+		};
+
+		// ワーカー１つ分の状態
+		struct _WORKER
+		{
+			mutable std::mutex										guard;
+			std::array<std::deque<_TASK>, NUM_TASK_PRIORITIES>		tasks;	// 持ち主は末尾から、盗む側は先頭から取る
+		};
+
+		// 仕事を index 番目のワーカーのキューに積む
+		void _Push(std::size_t index, TaskPriority priority, _TASK task);
+
+		// 仕事を１つ取り出す
+		/* @note:
+			優先度の高い順に、home 番目のワーカーのキュー --> 他のワーカーのキューの順に探す。
+			pGroup を渡すと、その ParallelFor の仕事だけを取り出す。
+		*/
+		bool _TryPop(std::size_t home, const void* pGroup, _TASK& outTask, TaskPriority& outPriority);
+
+		// 取り出した仕事を実行する
+		// @note: 実行中は仕事の優先度を現在のスレッドの優先度にする
+		void _Run(const _TASK& task, TaskPriority priority);
+
+		// ワーカーを起こす
+		void _Notify();
+
+		// ワーカースレッド
+		void _ThreadHandler(std::size_t index);
+
+		std::vector<std::unique_ptr<_WORKER>>	m_workers;
+		std::vector<std::thread>				m_threads;
+		std::optional<std::uint64_t>			m_affinityMask;
+		std::mutex								m_mutex;
+		std::condition_variable					m_cv;
+		std::atomic<std::size_t>				m_numQueued;		// 全キューに積まれている仕事の数
+		std::atomic<std::size_t>				m_nextHome;			// 次に仕事を積み始めるワーカー
+		std::atomic<std::uint64_t>				m_numExecuted;
+		std::atomic<std::uint64_t>				m_numStolen;
+		bool									m_isStopping;
+	};
+
+	//-------------------------------------------------------------------------
+	// TaskPriorityScope
+	//-------------------------------------------------------------------------
+
+	// スコープの間、現在のスレッドの優先度を差し替える
+	/* @note:
+		ThreadPool に積む仕事の優先度は、積んだスレッドの優先度で決まる。
+		入れ子にでき、スコープを抜けると元に戻る。
+	*/
+	class TaskPriorityScope
+	{
+	public:
+		// コンストラクタ
+		explicit TaskPriorityScope(TaskPriority priority);
+
+		// デストラクタ
+		~TaskPriorityScope();
+
+		// コピー禁止
+		TaskPriorityScope(const TaskPriorityScope&) = delete;
+		TaskPriorityScope& operator=(const TaskPriorityScope&) = delete;
+
+	private:
+		TaskPriority	m_prevPriority;
+	};
+}
@@ -24,6 +24,21 @@ namespace ayc
 
     // wchar --> char
     std::string WideToUtf8(std::wstring_view wide);
+
+    // uint8 の列どうしの平均絶対差を 0..1 で求める
+    /* @note:
+        分岐の無い uint8 の単純なループにして、コンパイラのベクトル化に任せる。
+    */
+    inline double MeanAbsoluteDifference(const std::uint8_t* pLhs, const std::uint8_t* pRhs, std::size_t size)
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            const int diff = static_cast<int>(pLhs[i]) - static_cast<int>(pRhs[i]);
+            sum += static_cast<std::uint32_t>(diff < 0 ? -diff : diff);
+        }
+        return size > 0 ? static_cast<double>(sum) / (static_cast<double>(size) * 255.0) : 0.0;
+    }
 }
 
 //-------------------------------------------------------------------------
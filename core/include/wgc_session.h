@@ -1,6 +1,9 @@
 ﻿#pragma once
 
 #include "frame_buffer.h"
+#include "nv12_texture.h"
+#include "replay_source.h"
+#include "scene_cut_index.h"
 #include "utils.h"
 
 namespace ayc
@@ -11,14 +14,27 @@ namespace ayc
 		// WGCSession 内部ステートクラス
 		/* @note:
 			WGCSession 内部のあちこちで共通してアクセスするものをまとめたクラス。
-			WinRT を触るコードを独立した単一スレッドに閉じ込める必要があるので、
+			WinRT を触るコードをキャプチャワーカーのスレッドに閉じ込める必要があるので、
 			致し方なくこんな面倒なことになっている。
 		*/
 		class WGCSessionState
 		{
 		public:
 			// コンストラクタ
-			WGCSessionState(double holdInSec);
+			/* @note:
+				sceneCutThreshold を指定すると、シーン切り替えの索引を作る。
+				frameFormat はフレームバッファに保持するテクスチャのフォーマット。
+			*/
+			WGCSessionState(
+				double holdInSec,
+				std::shared_ptr<MemoryAccount> pMemoryAccount,
+				bool isDedupEnabled,
+				std::optional<double> hotHoldInSec,
+				std::optional<SPILL_PARAM> spillParam,
+				std::optional<double> sceneCutThreshold,
+				FrameFormat frameFormat,
+				std::function<wgc::TimeSpan()> clock = nullptr
+			);
 
 			// デストラクタ
 			~WGCSessionState();
@@ -26,19 +42,50 @@ namespace ayc
 			// 後始末
 			void Close();
 
+			// キャプチャしたテクスチャをフレームバッファに詰める
+			/* @note:
+				シーン切り替えの記録・重複排除・縮小コピー（NV12 への変換）を経て FrameBuffer に追加する。
+				pSrcTex は呼び出し元の持ち物のままで、コピーを取ってから追加する。
+				キャプチャとリプレイで同じ経路を通すための共通入口。
+			*/
+			void PushCapturedFrame(
+				const wgc::com_ptr<ID3D11Texture2D>& pSrcTex,
+				const wgc::TimeSpan& timeSpan,
+				std::optional<std::size_t> maxWidth,
+				std::optional<std::size_t> maxHeight
+			);
+
+			// 受け取りを保留している署名を受け取る
+			/* @note:
+				署名は１フレーム遅れで受け取るので、最後のフレームの署名は次のフレームが来るまで保留される。
+				リプレイを流し終えた時など、もう次のフレームが来ない時に呼ぶ。
+			*/
+			void FlushPendingSignature();
+
 			// フレームバッファ
 			FrameBuffer& GetFrameBuffer();
 			const FrameBuffer& GetFrameBuffer() const;
 
-			// 終了通知イベント
-			const HANDLE& GetStopEvent() const;
+			// シーン切り替えの索引
+			// @note: 無効なら nullptr
+			const SceneCutIndex* GetSceneCutIndex() const;
 
 		private:
-			FrameBuffer	m_frameBuffer;
-			HANDLE		m_stopEvent;
+			FrameBuffer								m_frameBuffer;
+			std::unique_ptr<SceneCutIndex>			m_pSceneCutIndex;
+			FrameFormat								m_frameFormat;
+			std::unique_ptr<PendingFrameSignature>	m_pPendingSignature;	// 直前のフレームの受け取り待ちの署名
+			std::uint64_t							m_pendingSeq;			// 直前のフレームのシーケンス番号
+			wgc::TimeSpan							m_pendingTimeSpan;		// 直前のフレームのタイムスタンプ
 		};
+
+		// セッション１つ分の WinRT オブジェクト
+		// @note: 定義は WinRT を触るコードと一緒に cpp 側に閉じ込める
+		class WGCCaptureItem;
 	}
 
+	class ICaptureWorker;
+
 	// Windows.Graphics.Capture セッションクラス
 	class WGCSession
 	{
@@ -48,7 +95,34 @@ namespace ayc
 			HWND hwnd,
 			double holdInSec,
 			std::optional<std::size_t> maxWidth,
-			std::optional<std::size_t> maxHeight
+			std::optional<std::size_t> maxHeight,
+			double weight,
+			double minHoldInSec,
+			bool isDedupEnabled,
+			std::optional<double> hotHoldInSec,
+			std::optional<SPILL_PARAM> spillParam,
+			std::optional<double> sceneCutThreshold,
+			FrameFormat frameFormat
+		);
+
+		// コンストラクタ（リプレイ）
+		/* @note:
+			ウィンドウをキャプチャする代わりに Snapshot.Save で書き出したアーカイブを流す。
+			以降はキャプチャと同じ経路（重複排除・縮小・ホット/コールド層）を通る。
+		*/
+		WGCSession(
+			const std::string& archivePath,
+			const REPLAY_PARAM& replayParam,
+			double holdInSec,
+			std::optional<std::size_t> maxWidth,
+			std::optional<std::size_t> maxHeight,
+			double weight,
+			double minHoldInSec,
+			bool isDedupEnabled,
+			std::optional<double> hotHoldInSec,
+			std::optional<SPILL_PARAM> spillParam,
+			std::optional<double> sceneCutThreshold,
+			FrameFormat frameFormat
 		);
 
 		// デストラクタ
@@ -60,19 +134,56 @@ namespace ayc
 		// OS バージョン的に合法なら true を返す
 		static bool Available();
 
+		// キャプチャワーカースレッドの最大本数を設定する
+		// @note: 以降に開始したセッションから反映される
+		static void SetMaxCaptureThreads(std::size_t maxThreads);
+
+		// 稼働中のキャプチャワーカースレッドごとの担当セッション数を得る
+		static std::vector<std::size_t> GetCaptureThreadLoads();
+
 		// 単一フレームのコピーを得る
-		wgc::com_ptr<ID3D11Texture2D> CopyFrame(double relativeInSec);
+		// @note: コールド層のフレームなら pColdFrame が設定される
+		FRAME_SOURCE CopyFrame(double relativeInSec);
+
+		// afterSeq より新しいフレームの到着を待って取得する
+		// @note: afterSeq が std::nullopt なら呼び出し時点の最新フレームより新しいものを待つ
+		FrameBuffer::FRAME WaitFrame(
+			std::optional<std::uint64_t> afterSeq,
+			std::optional<double> timeoutInSec
+		);
 
 		// バックバッファのコピー（スナップショット）を得る
 		FreezedFrameBuffer CopyFrameBuffer(double durationInSec);
 
+		// 重複フレーム排除の統計情報を得る
+		FrameBuffer::DEDUP_STATS GetDedupStats();
+
+		// ホット層・コールド層の統計情報を得る
+		FrameBuffer::TIER_STATS GetTierStats();
+
+		// 直近 durationInSec 秒以内のシーン切り替えを得る
+		// @note: シーン切り替えの索引が無効ならエラー
+		std::vector<SCENE_CUT> GetSceneCuts(double durationInSec);
+
+		// メモリ使用量の記帳先を得る
+		std::shared_ptr<const MemoryAccount> GetMemoryAccount() const;
+
+		// リプレイを末尾まで流し終えたら true を返す
+		// @note: キャプチャのセッションなら常に false
+		bool IsReplayFinished() const;
+
 	private:
 		// 事前条件チェック
 		void _PreCondition();
 
 		bool m_isClosed;
+		std::shared_ptr<MemoryAccount> m_pMemoryAccount;
+		ScopedCall m_scopedMemoryAccount;	// 以降のメンバの生成に失敗しても、記帳先の登録を解除する
+		std::shared_ptr<ReplayClock> m_pReplayClock;
 		details::WGCSessionState m_state;
 		ExceptionTunnel m_exceptionTunnel;
-		std::thread m_wrtClosureThread;
+		std::shared_ptr<ICaptureWorker> m_pCaptureWorker;
+		std::unique_ptr<details::WGCCaptureItem> m_pCaptureItem;
+		std::unique_ptr<ReplaySource> m_pReplaySource;
 	};
 }
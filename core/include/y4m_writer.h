@@ -0,0 +1,177 @@
+﻿#pragma once
+
+#include "frame_subscription.h"
+
+namespace ayc
+{
+	//-------------------------------------------------------------------------
+	// Colour Conversion
+	//-------------------------------------------------------------------------
+
+	// YUV 変換の係数
+	enum class YuvMatrix
+	{
+		BT601,		// SD
+		BT709,		// HD
+	};
+
+	// BGR24 を I420（planar YUV 4:2:0, limited range）に変換する
+	/* @note:
+		輝度と、2x2 画素の平均から求める色差を、２行ずつ１回の走査でまとめて求める。
+		色差の位置は 2x2 の中心（Y4M の C420jpeg）。
+		幅・高さが奇数の場合、色差プレーンは切り上げたサイズで、端の画素を複製して平均する。
+		pY は width * height、pU / pV は ((width + 1) / 2) * ((height + 1) / 2) バイト。
+	*/
+	void ConvertBGRToI420(
+		std::uint8_t* pY,
+		std::uint8_t* pU,
+		std::uint8_t* pV,
+		const std::uint8_t* pSrc,
+		std::size_t width,
+		std::size_t height,
+		YuvMatrix matrix
+	);
+
+	//-------------------------------------------------------------------------
+	// Y4MWriter
+	//-------------------------------------------------------------------------
+
+	// Y4M（YUV4MPEG2）ストリームを書き出すクラス
+	/* @note:
+		変換は Append の呼び出し元スレッドで行い、書き出しは I/O スレッド１本で行う。
+		バッファを２枚持ち回すので、フレーム N の書き出し中にフレーム N+1 を変換できる。
+		各フレームは "FRAME" ヘッダと３プレーンを連続したバッファに並べ、WriteFile １回で書き出す。
+		ヘッダは最初のフレームのサイズで書き出し、以降はそのサイズのフレームしか受け付けない。
+	*/
+	class Y4MWriter
+	{
+	public:
+		// コンストラクタ（パス指定）
+		// @note: 既存のファイルは上書きする
+		Y4MWriter(
+			const std::string& path,
+			double fps,
+			YuvMatrix matrix
+		);
+
+		// コンストラクタ（ファイルディスクリプタ指定）
+		// @note: パイプなど呼び出し元が開いたものに書き出す。閉じるのは呼び出し元の責任
+		Y4MWriter(
+			int fd,
+			double fps,
+			YuvMatrix matrix
+		);
+
+		// デストラクタ
+		~Y4MWriter();
+
+		// コピー禁止
+		Y4MWriter(const Y4MWriter&) = delete;
+		Y4MWriter& operator=(const Y4MWriter&) = delete;
+
+		// フレームを１枚追加する
+		/* @note:
+			frameBuffer は BGR24 (stride = width * 3)。変換を終えた時点で参照しなくなる。
+			最初のフレームとサイズが違う場合は何もせずに false を返す。
+			I/O スレッドでエラーが起きていれば、ここで再送する。
+		*/
+		bool Append(
+			std::size_t width,
+			std::size_t height,
+			std::span<const std::uint8_t> frameBuffer
+		);
+
+		// 残りを書き出して閉じる
+		// @note: I/O スレッドでエラーが起きていれば、ここで再送する
+		void Close();
+
+		// 書き出したフレーム数
+		std::uint64_t GetNumFrames() const;
+
+	private:
+		// I/O スレッドを起動する
+		void _StartThread();
+
+		// 書き出しを行う BG スレッドハンドラ
+		void _WriteThreadHandler();
+
+		// I/O スレッドを止める
+		void _StopThread();
+
+		// I/O スレッドのエラーを再送する
+		// @note: m_guard をロックして呼ぶこと
+		void _RethrowError();
+
+		HANDLE									m_hFile;
+		bool									m_isOwned;
+		std::uint32_t							m_fpsNumerator;
+		std::uint32_t							m_fpsDenominator;
+		YuvMatrix								m_matrix;
+		std::size_t								m_width;
+		std::size_t								m_height;
+		std::uint64_t							m_numFrames;
+
+		mutable std::mutex						m_guard;
+		std::condition_variable					m_cv;
+		std::vector<std::vector<std::uint8_t>>	m_freeBuffers;
+		std::deque<std::vector<std::uint8_t>>	m_writeQueue;
+		bool									m_isFinishing;
+		std::exception_ptr						m_pError;
+		std::thread								m_writeThread;
+	};
+
+	//-------------------------------------------------------------------------
+	// Y4MFramePublisher
+	//-------------------------------------------------------------------------
+
+	// 書き出しの統計情報
+	struct Y4M_FRAME_PUBLISHER_STATS
+	{
+		std::uint64_t	written;		// 書き出したフレーム数
+		std::uint64_t	mismatched;		// 最初のフレームとサイズが違うため捨てたフレーム数
+		std::uint64_t	dropped;		// 書き出しが間に合わず捨てたフレーム数
+		bool			isFailed;		// 書き出しに失敗して止まった（パイプが閉じられた等）
+	};
+
+	// 新着フレームを Y4M ストリームに書き出すクラス
+	/* @note:
+		FrameDispatcher の購読者として振る舞い、BG スレッド上で変換・書き出しを行う。
+		書き出しに失敗した後も購読は続け、配送待ちを捨て続ける（BLOCK 指定で配送を詰まらせないため）。
+		GIL は一切触らない。
+	*/
+	class Y4MFramePublisher
+	{
+	public:
+		// コンストラクタ
+		Y4MFramePublisher(
+			const std::shared_ptr<FrameDispatcher>& pFrameDispatcher,
+			std::unique_ptr<Y4MWriter> pWriter,
+			std::size_t maxPending,
+			OverflowPolicy overflowPolicy
+		);
+
+		// デストラクタ
+		~Y4MFramePublisher();
+
+		// コピー禁止
+		Y4MFramePublisher(const Y4MFramePublisher&) = delete;
+		Y4MFramePublisher& operator=(const Y4MFramePublisher&) = delete;
+
+		// 書き出しを停止して、ストリームを閉じる
+		void Close();
+
+		// 統計情報を取得する
+		Y4M_FRAME_PUBLISHER_STATS GetStats() const;
+
+	private:
+		// BG スレッドハンドラ
+		void _ThreadHandler();
+
+		std::unique_ptr<Y4MWriter>				m_pWriter;
+		std::shared_ptr<FrameDispatcher>		m_pFrameDispatcher;
+		std::shared_ptr<FrameSubscriber>		m_pSubscriber;
+		std::atomic<std::uint64_t>				m_numMismatched;
+		std::atomic<bool>						m_isFailed;
+		std::thread								m_thread;
+	};
+}
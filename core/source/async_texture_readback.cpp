@@ -11,18 +11,150 @@
 // other
 #include "utils.h"
 #include "d3d11_system.h"
+#include "memory_tracker.h"
+#include "nv12_texture.h"
 
 //-----------------------------------------------------------------------------
-// Functions
+// Link-Local Constants
 //-----------------------------------------------------------------------------
 
+namespace
+{
+    // AsyncTextureReadback が先行して発行する転送の数
+    // @note: StagingTextureRing がサイズごとに取っておく枚数と揃える
+    const std::size_t READBACK_PIPELINE_DEPTH = 4;
+
+    // AsyncTextureReadback が ThreadPool の仕事１つで完了させる転送の数
+    // @note: 仕事の合間に INTERACTIVE の仕事が割り込めるよう、小さく刻む
+    const std::size_t READBACK_FRAMES_PER_TASK = 2;
+
+    // 転送の完了待ちで、yield だけで見張る時間
+    // @note: 1080p のコピーは大抵これより早く終わる。ここを過ぎたら sleep を挟む
+    const std::chrono::microseconds READBACK_WAIT_SPIN_TIME(200);
+
+    // 転送の完了待ちで、yield だけで終わらなかった時に挟む sleep の長さ
+    const std::chrono::microseconds READBACK_WAIT_SLEEP_TIME(1000);
+
+    // 転送の完了を１回に待つ最大の時間
+    // @note: AsyncTextureReadback は待ちきれなければ仕事を積み直し、その間に他の仕事を通す
+    const std::chrono::microseconds READBACK_STEP_MAX_WAIT(2000);
+
+    // 行を分けて並列に変換するフレームの最小画素数
+    // @note: これより小さいと、スレッドを起こすコストの方が高くつく
+    const std::size_t CONVERT_PARALLEL_MIN_PIXELS = 1920 * 1080;
+
+    // 並列変換で１つの仕事が受け持つ行数
+    // @note: NV12 の色差は２行で１行なので偶数にすること
+    const std::size_t CONVERT_ROWS_PER_TASK = 32;
+}
+
 //-----------------------------------------------------------------------------
-void ayc::ReadbackTexture(
-    std::size_t& outWidth,
-    std::size_t& outHeight,
-    std::string& outBuffer,
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // BGRA の行 [rowBegin, rowEnd) を BGR24 に変換する
+    // @note: アルファはここで捨てる
+    void _ConvertBGRARows(
+        std::uint8_t* pDst,
+        const std::uint8_t* pSrc,
+        std::size_t rowPitch,
+        std::size_t width,
+        std::size_t rowBegin,
+        std::size_t rowEnd
+    )
+    {
+        const std::size_t rowSizeInBytes = width * 3;
+        for (std::size_t v = rowBegin; v < rowEnd; ++v)
+        {
+            auto* pDstRow = pDst + (v * rowSizeInBytes);
+            const auto* pSrcRow = pSrc + (v * rowPitch);
+            for (std::size_t u = 0; u < width; ++u)
+            {
+                pDstRow[0] = pSrcRow[0];
+                pDstRow[1] = pSrcRow[1];
+                pDstRow[2] = pSrcRow[2];
+                pDstRow += 3;
+                pSrcRow += 4;
+            }
+        }
+    }
+
+    // NV12 の行 [rowBegin, rowEnd) を BGR24 に変換する
+    // @note: rowBegin は偶数であること
+    void _ConvertNV12Rows(
+        std::uint8_t* pDst,
+        const std::uint8_t* pSrc,
+        std::size_t rowPitch,
+        std::size_t width,
+        std::size_t height,
+        std::size_t rowBegin,
+        std::size_t rowEnd
+    )
+    {
+        // @note: 色差は偶数に切り上げた輝度の高さの後ろに詰めてある
+        const std::size_t lumaHeight = (height + 1) & ~std::size_t(1);
+        const auto* const pUV = pSrc + lumaHeight * rowPitch;
+        ayc::ConvertNV12ToBGR(
+            pDst + rowBegin * width * 3,
+            pSrc + rowBegin * rowPitch,
+            rowPitch,
+            pUV + (rowBegin / 2) * rowPitch,
+            rowPitch,
+            width,
+            rowEnd - rowBegin
+        );
+    }
+
+    // テクスチャを読み出した時の論理サイズを得る
+    // @note: NV12 のテクスチャは偶数に切り上げて詰めてあるので、記録しておいたサイズを使う。その場合は true を返す
+    bool _GetLogicalSize(
+        std::size_t& outWidth,
+        std::size_t& outHeight,
+        const D3D11_TEXTURE2D_DESC& desc,
+        const wgc::com_ptr<ID3D11Texture2D>& pTexture
+    )
+    {
+        outWidth = desc.Width;
+        outHeight = desc.Height;
+        return ayc::GetNV12TextureSize(outWidth, outHeight, pTexture);
+    }
+
+    // フレームを読み出した結果のサイズを得る
+    std::size_t _GetReadbackSizeInBytes(const ayc::FRAME_SOURCE& source)
+    {
+        if (source.pTexture)
+        {
+            D3D11_TEXTURE2D_DESC desc{};
+            source.pTexture->GetDesc(&desc);
+            std::size_t width = 0;
+            std::size_t height = 0;
+            _GetLogicalSize(width, height, desc, source.pTexture);
+            return width * height * 3;
+        }
+        if (source.pColdFrame)
+        {
+            return source.pColdFrame->GetRawSizeInBytes();
+        }
+        return 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// PendingTextureReadback
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::PendingTextureReadback::PendingTextureReadback(
     const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture
 )
+    : m_pStagingTexture()
+    , m_pCopyQuery()
+    , m_isFlushed(false)
+    , m_logicalWidth(0)
+    , m_logicalHeight(0)
+    , m_isNV12(false)
 {
     // nullptr チェック
     if (!pSourceTexture)
@@ -34,81 +166,243 @@ void ayc::ReadbackTexture(
     {
         pSourceTexture->GetDesc(&srcDesc);
     }
-    // 読み出し先テクスチャを生成
-    wgc::com_ptr<ID3D11Texture2D> stgTex;
+    // 論理サイズを解決
+    {
+        m_isNV12 = _GetLogicalSize(m_logicalWidth, m_logicalHeight, srcDesc, pSourceTexture);
+    }
+    // 読み出し先テクスチャを借りる
+    {
+        m_pStagingTexture = StagingTextureRing::Instance().Acquire(srcDesc);
+    }
+    // DEFAULT --> STAGING
+    // @note: 発行するだけで、完了は待たない
+    {
+        ayc::d3d11::Context()->CopyResource(m_pStagingTexture.get(), pSourceTexture.get());
+    }
+    // 完了を見張るイベントクエリを置く
+    // @note: 作れなければ TryReadback の Map で完了を確かめる
     {
-        // 記述
-        D3D11_TEXTURE2D_DESC stagingDesc = srcDesc;
+        const D3D11_QUERY_DESC desc{ D3D11_QUERY_EVENT, 0 };
+        if (SUCCEEDED(ayc::d3d11::Device()->CreateQuery(&desc, m_pCopyQuery.put())))
+        {
+            ayc::d3d11::Context()->End(m_pCopyQuery.get());
+        }
+        else
         {
-            stagingDesc.Usage = D3D11_USAGE_STAGING;
-            stagingDesc.BindFlags = 0;
-            stagingDesc.CPUAccessFlags = D3D10_CPU_ACCESS_READ;
-            stagingDesc.MiscFlags = 0;
+            m_pCopyQuery = nullptr;
         }
-        // 生成
-        const HRESULT result = ayc::d3d11::Device()->CreateTexture2D(
-            &stagingDesc,
-            nullptr,
-            stgTex.put()
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::PendingTextureReadback::~PendingTextureReadback()
+{
+    StagingTextureRing::Instance().Release(m_pStagingTexture);
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::PendingTextureReadback::TryReadback(std::uint8_t* pDst)
+{
+    // マップ
+    /* @note:
+        転送が終わっていなければ待たずに false を返す。
+        ブロッキングの Map は D3D11 のマルチスレッド保護のロックを握ったまま待つので、
+        その間キャプチャスレッドのコピーまで止めてしまう。
+    */
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    {
+        const HRESULT result = ayc::d3d11::Context()->Map(
+            m_pStagingTexture.get(),
+            0,
+            D3D11_MAP_READ,
+            D3D11_MAP_FLAG_DO_NOT_WAIT,
+            &mapped
         );
+        if (result == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            return false;
+        }
         if (result != S_OK)
         {
-            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11Device::CreateTexture2D", result);
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11DeviceContext::Map", result);
         }
     }
-    // DEFAULT --> STATING
+    // @note: 変換が例外を投げても、マップしたままリングに返さない
+    ScopedCall scopedUnmap([]() {}, [&]() { ayc::d3d11::Context()->Unmap(m_pStagingTexture.get(), 0); });
+
+    // STAGING --> システムメモリ
+    // @note: NV12 なら BGR に戻し、BGRA ならここでアルファを捨てる
     {
-        ayc::d3d11::Context()->CopyResource(stgTex.get(), pSourceTexture.get());
+        ConvertMappedTextureToBGR(
+            pDst,
+            static_cast<const std::uint8_t*>(mapped.pData),
+            mapped.RowPitch,
+            m_logicalWidth,
+            m_logicalHeight,
+            m_isNV12,
+            ThreadPool::Instance()
+        );
     }
-    // STAGING --> システムメモリ
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::PendingTextureReadback::WaitForCopy(std::chrono::microseconds maxWait)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    for (;;)
     {
+        if (_IsCopyDone())
+        {
+            return true;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - startTime;
+        if (elapsed >= maxWait)
+        {
+            return false;
+        }
+        if (elapsed < READBACK_WAIT_SPIN_TIME)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::this_thread::sleep_for(READBACK_WAIT_SLEEP_TIME);
+        }
+    }
+}
 
-        // エイリアス
-        const UINT width = srcDesc.Width;
-        const UINT height = srcDesc.Height;
-        const size_t bytesPerPixel = 3;
-        const size_t rowSizeInBytes = width * bytesPerPixel;
-        const size_t bufferSizeInBytes = rowSizeInBytes * height;
+//-----------------------------------------------------------------------------
+bool ayc::PendingTextureReadback::_IsCopyDone()
+{
+    // @note: 発行したコピーがコマンドバッファに溜まったままだと終わらないので、最初の１回だけ送り出す
+    const UINT flags = m_isFlushed ? D3D11_ASYNC_GETDATA_DONOTFLUSH : 0;
+    m_isFlushed = true;
 
-        // マップ
-        D3D11_MAPPED_SUBRESOURCE mapped{};
+    // クエリが無ければ完了を確かめられないので、送り出すだけ
+    // @note: WaitForCopy は maxWait まで待って戻り、終わったかは TryReadback の Map で確かめる
+    if (!m_pCopyQuery)
+    {
+        if (flags == 0)
         {
-            const HRESULT result = ayc::d3d11::Context()->Map(stgTex.get(), 0, D3D11_MAP_READ, 0, &mapped);
-            if (result != S_OK)
-            {
-                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11DeviceContext::Map", result);
-            }
+            ayc::d3d11::Context()->Flush();
         }
-        // コピー
-        // @note: ここでアルファを捨てる
+        return false;
+    }
+    BOOL isDone = FALSE;
+    const HRESULT result = ayc::d3d11::Context()->GetData(m_pCopyQuery.get(), &isDone, sizeof(isDone), flags);
+    if (FAILED(result))
+    {
+        throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11DeviceContext::GetData", result);
+    }
+    return result == S_OK && isDone;
+}
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+void ayc::ConvertMappedTextureToBGR(
+    std::uint8_t* pDst,
+    const std::uint8_t* pSrc,
+    std::size_t rowPitch,
+    std::size_t width,
+    std::size_t height,
+    bool isNV12,
+    ThreadPool& pool
+)
+{
+    const auto convertRows = [&](std::size_t rowBegin, std::size_t rowEnd)
+    {
+        if (isNV12)
         {
-            outBuffer.resize(bufferSizeInBytes);
-            auto const pDstBase = reinterpret_cast<std::uint8_t*>(outBuffer.data());
-            const auto* const pSrcBase = static_cast<const std::uint8_t*>(mapped.pData);
-            for (UINT v = 0; v < height; ++v)
-            {
-                auto* pDst = pDstBase + (v * rowSizeInBytes);
-                const auto* pSrc = pSrcBase + (v * mapped.RowPitch);
-                for (UINT u = 0; u < width; ++u)
-                {
-                    pDst[0] = pSrc[0];
-                    pDst[1] = pSrc[1];
-                    pDst[2] = pSrc[2];
-                    pDst += 3;
-                    pSrc += 4;
-                }
-            }
+            _ConvertNV12Rows(pDst, pSrc, rowPitch, width, height, rowBegin, rowEnd);
         }
-        // アンマップ
+        else
         {
-            ayc::d3d11::Context()->Unmap(stgTex.get(), 0);
+            _ConvertBGRARows(pDst, pSrc, rowPitch, width, rowBegin, rowEnd);
         }
+    };
+    // 小さいフレームはそのまま変換
+    if (width * height < CONVERT_PARALLEL_MIN_PIXELS || pool.GetNumWorkers() == 0)
+    {
+        convertRows(0, height);
+        return;
+    }
+    // 行を帯に分けて並列に変換
+    /* @note:
+        帯の数をスレッド数よりずっと多くしておき、遅れたスレッドの帯は他のスレッドが盗む。
+        帯ごとに書き込む範囲が重ならないので、同期は要らない。
+    */
+    const std::size_t numBands = (height + CONVERT_ROWS_PER_TASK - 1) / CONVERT_ROWS_PER_TASK;
+    pool.ParallelFor(numBands, [&](std::size_t band)
+    {
+        const std::size_t rowBegin = band * CONVERT_ROWS_PER_TASK;
+        convertRows(rowBegin, std::min(rowBegin + CONVERT_ROWS_PER_TASK, height));
+    });
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReadbackTexture(
+    std::size_t& outWidth,
+    std::size_t& outHeight,
+    std::string& outBuffer,
+    const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture
+)
+{
+    PendingTextureReadback pending(pSourceTexture);
+    outBuffer.resize(pending.GetWidth() * pending.GetHeight() * 3);
+    while (!pending.TryReadback(reinterpret_cast<std::uint8_t*>(outBuffer.data())))
+    {
+        pending.WaitForCopy(READBACK_STEP_MAX_WAIT);
+    }
+    outWidth = pending.GetWidth();
+    outHeight = pending.GetHeight();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReadbackTexture(
+    std::size_t& outWidth,
+    std::size_t& outHeight,
+    HostBuffer& outBuffer,
+    const wgc::com_ptr<ID3D11Texture2D>& pSourceTexture
+)
+{
+    PendingTextureReadback pending(pSourceTexture);
+    auto buffer = HostBuffer::Allocate(pending.GetWidth() * pending.GetHeight() * 3);
+    while (!pending.TryReadback(buffer.GetData()))
+    {
+        pending.WaitForCopy(READBACK_STEP_MAX_WAIT);
+    }
+    outWidth = pending.GetWidth();
+    outHeight = pending.GetHeight();
+    outBuffer = std::move(buffer);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReadbackFrame(
+    std::size_t& outWidth,
+    std::size_t& outHeight,
+    std::string& outBuffer,
+    const FRAME_SOURCE& source,
+    ColdFrameDecoder* pDecoder
+)
+{
+    // ホット層ならテクスチャから読み出す
+    if (source.pTexture)
+    {
+        ReadbackTexture(outWidth, outHeight, outBuffer, source.pTexture);
+        return;
     }
-    // サイズを書き戻す
+    // コールド層なら展開する
+    if (source.pColdFrame)
     {
-        outWidth = static_cast<std::size_t>(srcDesc.Width);
-        outHeight = static_cast<std::size_t>(srcDesc.Height);
+        ColdFrameDecoder localDecoder;
+        (pDecoder ? *pDecoder : localDecoder).Decode(outWidth, outHeight, outBuffer, source.pColdFrame);
+        return;
     }
+    throw MAKE_GENERAL_ERROR("NO Source Frame");
 }
 
 //-----------------------------------------------------------------------------
@@ -117,33 +411,55 @@ void ayc::ReadbackTexture(
 
 //-----------------------------------------------------------------------------
 ayc::AsyncTextureReadback::AsyncTextureReadback(
-    const std::vector<wgc::com_ptr<ID3D11Texture2D>>& sourceTextures
+    const std::vector<FRAME_SOURCE>& sources
 )
     : m_mutex()
     , m_cv()
     , m_jobs()
-    , m_thread()
+    , m_pPipeline()
+    , m_done()
+    , m_task()
+    , m_pMemoryTracker(MemoryTracker::Current())
+    , m_pArena()
+    , m_decoder()
 {
     // エントリーを生成
-    m_jobs.reserve(sourceTextures.size());
-    for (const auto& srcTex : sourceTextures)
+    // @note: 空要素以外にアリーナのスロットを順に割り当てる
+    m_jobs.reserve(sources.size());
+    std::size_t numSlots = 0;
+    for (const auto& source : sources)
     {
         m_jobs.emplace_back(_JOB{
-            srcTex,
+            source,
             /*result=*/{},
-            /*completed=*/false
+            /*status=*/_STATUS::PENDING,
+            /*pError=*/nullptr,
+            /*handlers=*/{},
+            /*pPending=*/nullptr,
+            /*slotIndex=*/source ? numSlots++ : 0,
+            /*numWaiters=*/0
         });
     }
-    // スレッド起動
+    // BG で読み出し開始
     {
-        m_thread = std::thread(std::bind(&AsyncTextureReadback::_ThreadHandler, this));
+        m_task = m_done.get_future();
+        ThreadPool::Instance().Submit(std::bind(&AsyncTextureReadback::_RunStep, this));
     }
 }
 
 //-----------------------------------------------------------------------------
 ayc::AsyncTextureReadback::~AsyncTextureReadback()
 {
-    m_thread.join();
+    m_task.wait();
+
+    // 読み出し結果の解放を記帳
+    for (const auto& job : m_jobs)
+    {
+        if (job.status == _STATUS::COMPLETED)
+        {
+            m_pMemoryTracker->RecordRelease(MemoryCategory::READBACK_BUFFER, static_cast<std::int64_t>(job.result.textureBuffer.GetSize()));
+        }
+    }
     m_jobs.clear();
 }
 
@@ -156,51 +472,340 @@ const ayc::AsyncTextureReadback::RESULT& ayc::AsyncTextureReadback::operator[](s
         throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Index Out of Range", index);
     }
     const auto& job = m_jobs[index];
-    if (!job.pSourceTexture)
+    if (!job.source)
     {
         throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Skipped Frame", index);
     }
     // 転送終了を待機する
     {
         std::unique_lock lock(m_mutex);
-        m_cv.wait(lock, [&] {return job.completed; });
+        m_cv.wait(lock, [&] {return _IsFinished(job); });
+    }
+    // 失敗・キャンセル済みならエラー
+    if (job.status == _STATUS::FAILED)
+    {
+        std::rethrow_exception(job.pError);
+    }
+    if (job.status == _STATUS::CANCELLED)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Cancelled Frame", index);
     }
     // 結果を返す
     return job.result;
 }
 
 //-----------------------------------------------------------------------------
-void ayc::AsyncTextureReadback::_ThreadHandler()
+void ayc::AsyncTextureReadback::OnCompleted(std::size_t index, CompletionHandler handler)
+{
+    // エラーチェック
+    if (index >= m_jobs.size())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Index Out of Range", index);
+    }
+    auto& job = m_jobs[index];
+    if (!job.source)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Skipped Frame", index);
+    }
+    // 転送中なら BG スレッドに任せる
+    {
+        std::scoped_lock lock(m_mutex);
+        if (!_IsFinished(job))
+        {
+            job.handlers.push_back(std::move(handler));
+            return;
+        }
+    }
+    // 転送済みならその場で呼ぶ
+    {
+        _InvokeHandler(job, handler);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::Retain(std::size_t index)
+{
+    // エラーチェック
+    if (index >= m_jobs.size())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Index Out of Range", index);
+    }
+    auto& job = m_jobs[index];
+    if (!job.source)
+    {
+        return;
+    }
+    std::scoped_lock lock(m_mutex);
+    job.numWaiters += 1;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::Release(std::size_t index)
 {
-    /* TODO
-        - アルファチャンネルいらない
-        - by::bytes に一発でコピーしたい
+    // エラーチェック
+    if (index >= m_jobs.size())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Index Out of Range", index);
+    }
+    auto& job = m_jobs[index];
+    if (!job.source)
+    {
+        return;
+    }
+
+    // 誰も待たなくなった未着手の転送はキャンセル済みとしてマーク
+    /* @note:
+        BG スレッドはキャンセル済みの転送を読み飛ばす。
+        登録済みのハンドラは BG スレッドの順番を待たずにここで呼ぶ。
     */
-    for (auto& job : m_jobs)
+    std::vector<CompletionHandler> handlers;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (job.numWaiters > 0)
+        {
+            job.numWaiters -= 1;
+        }
+        if (job.numWaiters > 0 || job.status != _STATUS::PENDING)
+        {
+            return;
+        }
+        job.status = _STATUS::CANCELLED;
+        handlers.swap(job.handlers);
+    }
+    m_cv.notify_all();
+    for (const auto& handler : handlers)
+    {
+        _InvokeHandler(job, handler);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ bool ayc::AsyncTextureReadback::_IsFinished(const _JOB& job)
+{
+    return (
+        job.status == _STATUS::COMPLETED ||
+        job.status == _STATUS::FAILED ||
+        job.status == _STATUS::CANCELLED
+    );
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ void ayc::AsyncTextureReadback::_InvokeHandler(const _JOB& job, const CompletionHandler& handler)
+{
+    // @note: ハンドラの例外で BG スレッドを落とさないように、ここで握りつぶす
+    try
     {
-        // null ならスキップ
-        /* @note:
-            事前に空要素を詰める処理を書くのがダルかったので、あえて nullptr を許容している。
-            なので、スキップするのが正しい。
-        */
-        const auto& pSrcTex = job.pSourceTexture;
-        if (!pSrcTex) {
-            continue;
-        }
-        // 読み出し
-        ReadbackTexture(
-            job.result.width,
-            job.result.height,
-            job.result.textureBuffer,
-            pSrcTex
+        handler(
+            job.status == _STATUS::COMPLETED ? &job.result : nullptr,
+            job.pError
         );
-        // 書き込み完了を通知
+    }
+    catch (const ayc::GeneralError& e)
+    {
+        WRITE_LOG_GENERAL_ERROR("In AsyncTextureReadback, completion handler failed.", e);
+    }
+    catch (const std::exception& e)
+    {
+        WRITE_LOG_CPP_EXCEPTION("In AsyncTextureReadback, completion handler failed.", e);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::_Finish(_JOB& job, std::exception_ptr pError)
+{
+    // 読み出し結果を記帳
+    if (!pError)
+    {
+        m_pMemoryTracker->RecordAllocation(MemoryCategory::READBACK_BUFFER, static_cast<std::int64_t>(job.result.textureBuffer.GetSize()));
+    }
+    // 書き込み完了を通知
+    std::vector<CompletionHandler> handlers;
+    {
+        std::scoped_lock lock(m_mutex);
+        job.status = pError ? _STATUS::FAILED : _STATUS::COMPLETED;
+        job.pError = pError;
+        handlers.swap(job.handlers);
+    }
+    m_cv.notify_all();
+    for (const auto& handler : handlers)
+    {
+        _InvokeHandler(job, handler);
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::AsyncTextureReadback::Issue(std::size_t index)
+{
+    // null ならスキップ
+    /* @note:
+        事前に空要素を詰める処理を書くのがダルかったので、あえて nullptr を許容している。
+        なので、スキップするのが正しい。
+    */
+    auto& job = m_jobs[index];
+    if (!job.source)
+    {
+        return false;
+    }
+    // キャンセル済みならスキップ
+    {
+        std::scoped_lock lock(m_mutex);
+        if (job.status == _STATUS::CANCELLED)
         {
-            std::scoped_lock lock(m_mutex);
-            job.completed = true;
+            return false;
+        }
+        job.status = _STATUS::RUNNING;
+    }
+    // ホット層ならステージングテクスチャへの転送を発行
+    // @note: コールド層は CPU で展開するだけなので、完了させる時にまとめて行う
+    if (job.source.pTexture)
+    {
+        try
+        {
+            job.pPending = std::make_unique<PendingTextureReadback>(job.source.pTexture);
+        }
+        catch (...)
+        {
+            _Finish(job, std::current_exception());
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::AsyncTextureReadback::TryComplete(std::size_t index)
+{
+    // 読み出し
+    // @note: 失敗は operator[] とハンドラに伝える
+    auto& job = m_jobs[index];
+    std::exception_ptr pError = nullptr;
+    try
+    {
+        if (job.pPending)
+        {
+            const std::size_t width = job.pPending->GetWidth();
+            const std::size_t height = job.pPending->GetHeight();
+            HostBuffer buffer(m_pArena, job.slotIndex, width * height * 3);
+            if (!job.pPending->TryReadback(buffer.GetData()))
+            {
+                return false;
+            }
+            job.result = RESULT{ width, height, std::move(buffer) };
+        }
+        else
+        {
+            const auto& pColdFrame = job.source.pColdFrame;
+            HostBuffer buffer(m_pArena, job.slotIndex, pColdFrame->GetRawSizeInBytes());
+            m_decoder.Decode(buffer.GetData(), pColdFrame);
+            job.result = RESULT{ pColdFrame->GetWidth(), pColdFrame->GetHeight(), std::move(buffer) };
+        }
+    }
+    catch (...)
+    {
+        pError = std::current_exception();
+    }
+    // ステージングテクスチャをリングに返してから通知
+    {
+        job.pPending.reset();
+        _Finish(job, pError);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::WaitForProgress(std::size_t index)
+{
+    // @note: コールド層の読み出しは TryComplete で必ず終わるので、待つのはホット層だけ
+    auto& job = m_jobs[index];
+    if (job.pPending)
+    {
+        job.pPending->WaitForCopy(READBACK_STEP_MAX_WAIT);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::_AcquireArena()
+{
+    // スロットのサイズは最大のフレームに合わせる
+    /* @note:
+        キャプチャ中にウィンドウサイズが変わると、フレームごとにサイズが違うことがある。
+        フレームごとに詰めるより、全スロットを揃えた方がアリーナを使い回しやすい。
+    */
+    std::size_t slotSize = 0;
+    std::size_t numSlots = 0;
+    for (const auto& job : m_jobs)
+    {
+        if (job.source)
+        {
+            slotSize = std::max(slotSize, _GetReadbackSizeInBytes(job.source));
+            numSlots += 1;
         }
-        m_cv.notify_all();
+    }
+    if (numSlots > 0)
+    {
+        m_pArena = HostArenaPool::Instance().Acquire(slotSize, numSlots);
     }
 }
 
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::_FailUnfinished(std::exception_ptr pError)
+{
+    for (auto& job : m_jobs)
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            if (!job.source || _IsFinished(job))
+            {
+                continue;
+            }
+            job.status = _STATUS::RUNNING;
+        }
+        job.pPending.reset();
+        _Finish(job, pError);
+    }
+}
 
+//-----------------------------------------------------------------------------
+void ayc::AsyncTextureReadback::_RunStep()
+{
+    /* @note:
+        ホット層のフレームは READBACK_PIPELINE_DEPTH 枚先まで転送を発行しておき、
+        先頭のフレームを変換している間も後続の転送を GPU で進める。
+        １回の仕事では READBACK_FRAMES_PER_TASK 枚だけ完了させ、続きは仕事を積み直して行う。
+        ワーカーを GPU 待ちで占有し続けないので、後から積まれた INTERACTIVE の仕事が先に実行される。
+        読み出しに使うステージングテクスチャは、生成元と同じ記帳先に記帳する。
+    */
+    MemoryTrackerScope trackerScope(m_pMemoryTracker);
+    try
+    {
+        // 初回は読み出し先を確保
+        if (!m_pPipeline)
+        {
+            _AcquireArena();
+            // @note: IReadbackBackend は private 継承なので、ここで変換してから渡す
+            IReadbackBackend& backend = *this;
+            m_pPipeline = std::make_unique<ReadbackPipeline>(backend, m_jobs.size(), READBACK_PIPELINE_DEPTH);
+        }
+        // 進められるだけ進める
+        const auto progress = m_pPipeline->Advance(READBACK_FRAMES_PER_TASK);
+        if (progress == ReadbackProgress::FINISHED)
+        {
+            m_pPipeline.reset();
+            m_done.set_value();
+            return;
+        }
+        // GPU 待ちなら少しだけ待ってから積み直す
+        if (progress == ReadbackProgress::WAITING)
+        {
+            m_pPipeline->WaitForProgress();
+        }
+        ThreadPool::Instance().Submit(std::bind(&AsyncTextureReadback::_RunStep, this));
+    }
+    catch (...)
+    {
+        // @note: 読み出し先を確保できない等で続けられなければ、残りの転送を全て失敗させる
+        _FailUnfinished(std::current_exception());
+        m_pPipeline.reset();
+        m_done.set_value();
+    }
+}
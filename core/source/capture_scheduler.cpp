@@ -0,0 +1,248 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "capture_scheduler.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// CaptureScheduler
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::CaptureScheduler::CaptureScheduler(
+    WorkerFactory workerFactory,
+    std::size_t maxWorkers
+)
+    : m_workerFactory(workerFactory)
+    , m_guard()
+    , m_entries()
+    , m_maxWorkers(0)
+{
+    SetMaxWorkers(maxWorkers);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::CaptureScheduler::SetMaxWorkers(std::size_t maxWorkers)
+{
+    // ワーカー数は正値じゃないとダメ
+    if (maxWorkers < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("maxWorkers must be positive", maxWorkers);
+    }
+    std::scoped_lock lock(m_guard);
+    m_maxWorkers = maxWorkers;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<ayc::ICaptureWorker> ayc::CaptureScheduler::Register()
+{
+    std::scoped_lock lock(m_guard);
+
+    // 最も暇なワーカーを探す
+    auto minIter = std::ranges::min_element(
+        m_entries,
+        /*_Pr=*/{},
+        [](const _ENTRY& e) { return e.numSessions; }
+    );
+    // 全員が仕事を抱えていて、まだワーカーを増やせるなら新規に起動する
+    /* @note:
+        ワーカーの起動（スレッド・アパートメントの初期化）は失敗しうる。
+        失敗した場合は何も登録せずに例外を再送する。
+    */
+    const bool needsNewWorker = (
+        minIter == m_entries.end() ||
+        (minIter->numSessions > 0 && m_entries.size() < m_maxWorkers)
+    );
+    if (needsNewWorker)
+    {
+        auto pWorker = m_workerFactory();
+        if (!pWorker)
+        {
+            throw MAKE_GENERAL_ERROR("Failed to create capture worker");
+        }
+        m_entries.emplace_back(_ENTRY{ pWorker, 0 });
+        minIter = std::prev(m_entries.end());
+    }
+    // 割り当て
+    minIter->numSessions += 1;
+    return minIter->pWorker;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::CaptureScheduler::Unregister(const std::shared_ptr<ICaptureWorker>& pWorker)
+{
+    // 担当セッション数を減らす
+    /* @note:
+        ワーカーの終了はスレッドの join を伴うので、ロックの外で行う。
+    */
+    std::shared_ptr<ICaptureWorker> pRetiredWorker;
+    {
+        std::scoped_lock lock(m_guard);
+        auto iter = std::ranges::find_if(
+            m_entries,
+            [&](const _ENTRY& e) { return e.pWorker == pWorker; }
+        );
+        if (iter == m_entries.end())
+        {
+            return;
+        }
+        iter->numSessions -= 1;
+        if (iter->numSessions == 0)
+        {
+            pRetiredWorker = std::move(iter->pWorker);
+            m_entries.erase(iter);
+        }
+    }
+    pRetiredWorker.reset();
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::size_t> ayc::CaptureScheduler::GetLoads() const
+{
+    std::scoped_lock lock(m_guard);
+    std::vector<std::size_t> loads;
+    loads.reserve(m_entries.size());
+    for (const auto& entry : m_entries)
+    {
+        loads.push_back(entry.numSessions);
+    }
+    return loads;
+}
+
+//-----------------------------------------------------------------------------
+// CaptureTaskQueue
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::CaptureTaskQueue::CaptureTaskQueue(std::size_t budgetPerSession)
+    : m_guard()
+    , m_sessions()
+    , m_numPending(0)
+    , m_budgetPerSession(budgetPerSession)
+{
+    // 予算は正値じゃないとダメ
+    if (budgetPerSession < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("budgetPerSession must be positive", budgetPerSession);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::CaptureTaskQueue::Push(const void* pSession, std::function<void(void)> task)
+{
+    std::scoped_lock lock(m_guard);
+    auto iter = std::ranges::find_if(
+        m_sessions,
+        [&](const _SESSION& s) { return s.pSession == pSession; }
+    );
+    // @note: 仕事を抱えていなかったセッションは巡回の末尾に並ぶ
+    if (iter == m_sessions.end())
+    {
+        m_sessions.push_back(_SESSION{ pSession, {} });
+        iter = std::prev(m_sessions.end());
+    }
+    iter->tasks.push_back(std::move(task));
+    m_numPending += 1;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::CaptureTaskQueue::Discard(const void* pSession)
+{
+    // @note: 仕事の破棄（キャプチャ済みの参照の解放）はロックの外で行う
+    std::deque<std::function<void(void)>> discarded;
+    {
+        std::scoped_lock lock(m_guard);
+        auto iter = std::ranges::find_if(
+            m_sessions,
+            [&](const _SESSION& s) { return s.pSession == pSession; }
+        );
+        if (iter == m_sessions.end())
+        {
+            return;
+        }
+        discarded.swap(iter->tasks);
+        m_numPending -= discarded.size();
+        m_sessions.erase(iter);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::CaptureTaskQueue::Clear()
+{
+    std::deque<_SESSION> discarded;
+    {
+        std::scoped_lock lock(m_guard);
+        discarded.swap(m_sessions);
+        m_numPending = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::CaptureTaskQueue::RunRound()
+{
+    // 巡回するセッション数を決める
+    std::size_t numSessions = 0;
+    {
+        std::scoped_lock lock(m_guard);
+        numSessions = m_sessions.size();
+    }
+    for (std::size_t i = 0; i < numSessions; ++i)
+    {
+        // 先頭のセッションから予算の分だけ取り出す
+        /* @note:
+            仕事が残ったセッションは末尾に回すので、次の巡回は別のセッションから始まる。
+        */
+        std::vector<std::function<void(void)>> tasks;
+        {
+            std::scoped_lock lock(m_guard);
+            if (m_sessions.empty())
+            {
+                break;
+            }
+            auto& session = m_sessions.front();
+            while (!session.tasks.empty() && tasks.size() < m_budgetPerSession)
+            {
+                tasks.push_back(std::move(session.tasks.front()));
+                session.tasks.pop_front();
+            }
+            m_numPending -= tasks.size();
+            if (!session.tasks.empty())
+            {
+                m_sessions.push_back(std::move(session));
+            }
+            m_sessions.pop_front();
+        }
+        // 実行
+        for (const auto& task : tasks)
+        {
+            try
+            {
+                task();
+            }
+            catch (const ayc::GeneralError& e)
+            {
+                WRITE_LOG_GENERAL_ERROR("In CaptureTaskQueue::RunRound, a session task has failed.", e);
+            }
+            catch (const std::exception& e)
+            {
+                WRITE_LOG_CPP_EXCEPTION("In CaptureTaskQueue::RunRound, a session task has failed.", e);
+            }
+        }
+    }
+    std::scoped_lock lock(m_guard);
+    return m_numPending > 0;
+}
+
+//-----------------------------------------------------------------------------
+std::size_t ayc::CaptureTaskQueue::GetNumPending() const
+{
+    std::scoped_lock lock(m_guard);
+    return m_numPending;
+}
@@ -0,0 +1,434 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "cold_frame_store.h"
+
+// other
+#include "lz_codec.h"
+#include "spill_store.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // バイト単位の差分を取る
+    // @note: 単純なループにしておけばコンパイラが SIMD 化してくれる
+    void _SubtractBytes(std::uint8_t* pDst, const std::uint8_t* pLho, const std::uint8_t* pRho, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            pDst[i] = static_cast<std::uint8_t>(pLho[i] - pRho[i]);
+        }
+    }
+
+    // バイト単位の差分を足し戻す
+    void _AddBytes(std::uint8_t* pDst, const std::uint8_t* pDelta, std::size_t size)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            pDst[i] = static_cast<std::uint8_t>(pDst[i] + pDelta[i]);
+        }
+    }
+
+    // バイト列のハッシュ値
+    // @note: 8 バイトずつ混ぜるだけの軽いハッシュ。一致判定は memcmp で確定させるので衝突しても壊れない。
+    std::uint64_t _HashBytes(const std::uint8_t* pData, std::size_t size)
+    {
+        std::uint64_t hash = 0x9E3779B97F4A7C15ull ^ size;
+        std::size_t pos = 0;
+        for (; pos + 8 <= size; pos += 8)
+        {
+            std::uint64_t value;
+            std::memcpy(&value, pData + pos, sizeof(value));
+            hash = (hash ^ value) * 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        for (; pos < size; ++pos)
+        {
+            hash = (hash ^ pData[pos]) * 0xC4CEB9FE1A85EC53ull;
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    // std::string をバイト列として扱う
+    std::uint8_t* _Bytes(std::string& buffer)
+    {
+        return reinterpret_cast<std::uint8_t*>(buffer.data());
+    }
+    const std::uint8_t* _Bytes(const std::string& buffer)
+    {
+        return reinterpret_cast<const std::uint8_t*>(buffer.data());
+    }
+
+    // タイルの範囲
+    struct _TILE_RECT
+    {
+        std::size_t x;
+        std::size_t y;
+        std::size_t width;
+        std::size_t height;
+    };
+
+    // タイルの範囲を解決する
+    _TILE_RECT _GetTileRect(std::size_t frameWidth, std::size_t frameHeight, std::size_t tileX, std::size_t tileY)
+    {
+        const std::size_t x = tileX * ayc::COLD_FRAME_TILE_SIZE;
+        const std::size_t y = tileY * ayc::COLD_FRAME_TILE_SIZE;
+        return _TILE_RECT{
+            x,
+            y,
+            std::min(ayc::COLD_FRAME_TILE_SIZE, frameWidth - x),
+            std::min(ayc::COLD_FRAME_TILE_SIZE, frameHeight - y)
+        };
+    }
+
+    // フレームからタイルを切り出して詰める
+    void _ExtractTile(std::string& outTile, const std::uint8_t* pFrame, std::size_t frameWidth, const _TILE_RECT& rect)
+    {
+        const std::size_t rowSizeInBytes = rect.width * BYTES_PER_PIXEL;
+        outTile.resize(rowSizeInBytes * rect.height);
+        for (std::size_t v = 0; v < rect.height; ++v)
+        {
+            std::memcpy(
+                _Bytes(outTile) + v * rowSizeInBytes,
+                pFrame + ((rect.y + v) * frameWidth + rect.x) * BYTES_PER_PIXEL,
+                rowSizeInBytes
+            );
+        }
+    }
+
+    // 詰めたタイルをフレームに書き戻す
+    void _StoreTile(std::uint8_t* pFrame, std::size_t frameWidth, const _TILE_RECT& rect, const std::uint8_t* pTile)
+    {
+        const std::size_t rowSizeInBytes = rect.width * BYTES_PER_PIXEL;
+        for (std::size_t v = 0; v < rect.height; ++v)
+        {
+            std::memcpy(
+                pFrame + ((rect.y + v) * frameWidth + rect.x) * BYTES_PER_PIXEL,
+                pTile + v * rowSizeInBytes,
+                rowSizeInBytes
+            );
+        }
+    }
+
+    // 詰めたタイルの差分をフレームに足し戻す
+    void _AddTile(std::uint8_t* pFrame, std::size_t frameWidth, const _TILE_RECT& rect, const std::uint8_t* pDelta)
+    {
+        const std::size_t rowSizeInBytes = rect.width * BYTES_PER_PIXEL;
+        for (std::size_t v = 0; v < rect.height; ++v)
+        {
+            _AddBytes(
+                pFrame + ((rect.y + v) * frameWidth + rect.x) * BYTES_PER_PIXEL,
+                pDelta + v * rowSizeInBytes,
+                rowSizeInBytes
+            );
+        }
+    }
+
+    // ２枚のフレームで同じ位置のタイルが一致するなら true を返す
+    bool _IsSameTile(const std::uint8_t* pLho, const std::uint8_t* pRho, std::size_t frameWidth, const _TILE_RECT& rect)
+    {
+        const std::size_t rowSizeInBytes = rect.width * BYTES_PER_PIXEL;
+        for (std::size_t v = 0; v < rect.height; ++v)
+        {
+            const std::size_t offset = ((rect.y + v) * frameWidth + rect.x) * BYTES_PER_PIXEL;
+            if (std::memcmp(pLho + offset, pRho + offset, rowSizeInBytes) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ColdFrame
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+std::span<const std::uint8_t> ayc::ColdFrame::_GetTile(std::size_t index) const
+{
+    // ディスクに書き出したフレームはマップ先のタイル表から引く
+    if (m_pSegment)
+    {
+        const std::uint8_t* const pBase = m_pSegment->GetData();
+        const auto* const pEntries = reinterpret_cast<const SPILL_TILE_ENTRY*>(
+            pBase + m_recordOffset + sizeof(SPILL_RECORD_HEADER)
+        );
+        const auto& entry = pEntries[index];
+        if (entry.sizeInBytes == 0)
+        {
+            return {};
+        }
+        return std::span<const std::uint8_t>(pBase + entry.offset, static_cast<std::size_t>(entry.sizeInBytes));
+    }
+    // メモリ上のフレーム
+    const auto& pTile = m_tiles[index];
+    if (!pTile)
+    {
+        return {};
+    }
+    return std::span<const std::uint8_t>(_Bytes(*pTile), pTile->size());
+}
+
+//-----------------------------------------------------------------------------
+// ColdFrameEncoder
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ColdFrameEncoder::ColdFrameEncoder()
+    : m_pKeyframe()
+    , m_keyframeBuffer()
+    , m_pPrevFrame()
+    , m_prevBuffer()
+    , m_numSinceKeyframe(0)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ayc::ColdFrame> ayc::ColdFrameEncoder::Encode(
+    std::size_t width,
+    std::size_t height,
+    const std::string& buffer
+)
+{
+    // パラメータチェック
+    if (buffer.size() != width * height * BYTES_PER_PIXEL)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Buffer size mismatch", buffer.size());
+    }
+    // キーフレームにするかどうか
+    /* @note:
+        サイズが変わったら差分は取れないので、キーフレームからやり直す。
+    */
+    const bool isKeyframe = (
+        !m_pKeyframe ||
+        m_pKeyframe->m_width != width ||
+        m_pKeyframe->m_height != height ||
+        m_numSinceKeyframe + 1 >= COLD_FRAME_KEYFRAME_INTERVAL
+    );
+    // 差分タイルを共有できる直前のフレーム
+    // @note: 同じキーフレームを参照している差分フレームに限る
+    const ColdFrame* const pPrevFrame = (
+        !isKeyframe && m_pPrevFrame && !m_pPrevFrame->IsKeyframe() ? m_pPrevFrame.get() : nullptr
+    );
+    // フレームを生成
+    auto pFrame = std::make_shared<ColdFrame>();
+    pFrame->m_width = width;
+    pFrame->m_height = height;
+    pFrame->m_numTilesX = (width + COLD_FRAME_TILE_SIZE - 1) / COLD_FRAME_TILE_SIZE;
+    pFrame->m_numTilesY = (height + COLD_FRAME_TILE_SIZE - 1) / COLD_FRAME_TILE_SIZE;
+    pFrame->m_pKeyframe = isKeyframe ? nullptr : m_pKeyframe;
+    const std::size_t numTiles = pFrame->m_numTilesX * pFrame->m_numTilesY;
+    pFrame->m_tileHashes.resize(numTiles);
+    pFrame->m_tiles.resize(numTiles);
+
+    // タイルごとに圧縮
+    /* @note:
+        タイルの行ごとにスレッドで分担する。
+        書き込み先はタイルごとに別の要素なので、ロックはいらない。
+    */
+    std::vector<std::size_t> rowStoredTiles(pFrame->m_numTilesY, 0);
+    std::vector<std::size_t> rowSizeInBytes(pFrame->m_numTilesY, 0);
+    ayc::ThreadPool::Instance().ParallelFor(
+        pFrame->m_numTilesY,
+        [&](std::size_t tileY)
+        {
+            std::string tile;
+            std::string keyTile;
+            std::string compressed;
+            for (std::size_t tileX = 0; tileX < pFrame->m_numTilesX; ++tileX)
+            {
+                const std::size_t tileIndex = tileY * pFrame->m_numTilesX + tileX;
+                const auto rect = _GetTileRect(width, height, tileX, tileY);
+                _ExtractTile(tile, _Bytes(buffer), width, rect);
+                const std::uint64_t hash = _HashBytes(_Bytes(tile), tile.size());
+                pFrame->m_tileHashes[tileIndex] = hash;
+
+                // キーフレームは全タイルをそのまま保持
+                if (isKeyframe)
+                {
+                    ayc::CompressLZ(compressed, _Bytes(tile), tile.size());
+                    pFrame->m_tiles[tileIndex] = std::make_shared<const std::string>(compressed);
+                    rowStoredTiles[tileY] += 1;
+                    rowSizeInBytes[tileY] += compressed.size();
+                    continue;
+                }
+                // キーフレームから変化していなければ保持しない
+                const bool isSameAsKeyframe = (
+                    hash == m_pKeyframe->m_tileHashes[tileIndex] &&
+                    _IsSameTile(_Bytes(buffer), _Bytes(m_keyframeBuffer), width, rect)
+                );
+                if (isSameAsKeyframe)
+                {
+                    continue;
+                }
+                // 直前のフレームと同じなら差分タイルを共有
+                const bool isSameAsPrev = (
+                    pPrevFrame &&
+                    pPrevFrame->m_tiles[tileIndex] &&
+                    hash == pPrevFrame->m_tileHashes[tileIndex] &&
+                    _IsSameTile(_Bytes(buffer), _Bytes(m_prevBuffer), width, rect)
+                );
+                if (isSameAsPrev)
+                {
+                    pFrame->m_tiles[tileIndex] = pPrevFrame->m_tiles[tileIndex];
+                    continue;
+                }
+                // キーフレームとの差分を保持
+                _ExtractTile(keyTile, _Bytes(m_keyframeBuffer), width, rect);
+                _SubtractBytes(_Bytes(keyTile), _Bytes(tile), _Bytes(keyTile), tile.size());
+                ayc::CompressLZ(compressed, _Bytes(keyTile), keyTile.size());
+                pFrame->m_tiles[tileIndex] = std::make_shared<const std::string>(compressed);
+                rowStoredTiles[tileY] += 1;
+                rowSizeInBytes[tileY] += compressed.size();
+            }
+        }
+    );
+    // サイズを集計
+    // @note: タイルの管理領域も含める
+    pFrame->m_numStoredTiles = std::accumulate(rowStoredTiles.cbegin(), rowStoredTiles.cend(), std::size_t(0));
+    pFrame->m_sizeInBytes = (
+        std::accumulate(rowSizeInBytes.cbegin(), rowSizeInBytes.cend(), std::size_t(0)) +
+        numTiles * (sizeof(std::uint64_t) + sizeof(std::shared_ptr<const std::string>))
+    );
+    // 次のフレームのために覚えておく
+    if (isKeyframe)
+    {
+        m_pKeyframe = pFrame;
+        m_keyframeBuffer.assign(buffer);
+        m_numSinceKeyframe = 0;
+    }
+    else
+    {
+        m_numSinceKeyframe += 1;
+    }
+    m_pPrevFrame = pFrame;
+    m_prevBuffer.assign(buffer);
+    return pFrame;
+}
+
+//-----------------------------------------------------------------------------
+// ColdFrameDecoder
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ColdFrameDecoder::ColdFrameDecoder()
+    : m_pCachedKeyframe()
+    , m_keyframeBuffer()
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ColdFrameDecoder::Decode(
+    std::size_t& outWidth,
+    std::size_t& outHeight,
+    std::string& outBuffer,
+    const std::shared_ptr<const ColdFrame>& pFrame
+)
+{
+    // nullptr チェック
+    if (!pFrame)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Cold Frame", pFrame);
+    }
+    // 展開
+    outBuffer.resize(pFrame->GetRawSizeInBytes());
+    Decode(_Bytes(outBuffer), pFrame);
+
+    // サイズを書き戻す
+    {
+        outWidth = pFrame->m_width;
+        outHeight = pFrame->m_height;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ColdFrameDecoder::Decode(
+    std::uint8_t* pDst,
+    const std::shared_ptr<const ColdFrame>& pFrame
+)
+{
+    // nullptr チェック
+    if (!pFrame)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Cold Frame", pFrame);
+    }
+    // エイリアス
+    const std::size_t width = pFrame->m_width;
+    const std::size_t height = pFrame->m_height;
+    const std::size_t numTilesX = pFrame->m_numTilesX;
+    const auto& pKeyframe = pFrame->IsKeyframe() ? pFrame : pFrame->m_pKeyframe;
+
+    // キーフレームを展開
+    /* @note:
+        前回と同じキーフレームなら展開済みのものを使い回す。
+        途中で失敗したらキャッシュは壊れているので、先に捨てておく。
+    */
+    if (m_pCachedKeyframe != pKeyframe)
+    {
+        m_pCachedKeyframe.reset();
+        m_keyframeBuffer.resize(pKeyframe->GetRawSizeInBytes());
+        ayc::ThreadPool::Instance().ParallelFor(
+            pKeyframe->m_numTilesY,
+            [&](std::size_t tileY)
+            {
+                std::string tile;
+                for (std::size_t tileX = 0; tileX < numTilesX; ++tileX)
+                {
+                    const auto payload = pKeyframe->_GetTile(tileY * numTilesX + tileX);
+                    const auto rect = _GetTileRect(width, height, tileX, tileY);
+                    tile.resize(rect.width * rect.height * BYTES_PER_PIXEL);
+                    ayc::DecompressLZ(_Bytes(tile), tile.size(), payload.data(), payload.size());
+                    _StoreTile(_Bytes(m_keyframeBuffer), width, rect, _Bytes(tile));
+                }
+            }
+        );
+        m_pCachedKeyframe = pKeyframe;
+    }
+    // 差分タイルを当てる
+    std::memcpy(pDst, m_keyframeBuffer.data(), m_keyframeBuffer.size());
+    if (!pFrame->IsKeyframe())
+    {
+        ayc::ThreadPool::Instance().ParallelFor(
+            pFrame->m_numTilesY,
+            [&](std::size_t tileY)
+            {
+                std::string delta;
+                for (std::size_t tileX = 0; tileX < numTilesX; ++tileX)
+                {
+                    const auto payload = pFrame->_GetTile(tileY * numTilesX + tileX);
+                    if (payload.empty())
+                    {
+                        continue;
+                    }
+                    const auto rect = _GetTileRect(width, height, tileX, tileY);
+                    delta.resize(rect.width * rect.height * BYTES_PER_PIXEL);
+                    ayc::DecompressLZ(_Bytes(delta), delta.size(), payload.data(), payload.size());
+                    _AddTile(pDst, width, rect, _Bytes(delta));
+                }
+            }
+        );
+    }
+}
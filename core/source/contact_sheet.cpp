@@ -0,0 +1,259 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "contact_sheet.h"
+
+// other
+#include "thread_pool.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 出力画像の一辺の上限
+    const std::size_t CONTACT_SHEET_MAX_DIMENSION = 32768;
+
+    // 重みの固定小数点のビット数
+    const int RESIZE_WEIGHT_BITS = 12;
+
+    // 横方向の結果に残す小数部のビット数
+    // @note: 縦方向で重みを掛けても 32 ビットに収まるよう、残りは丸めて落とす
+    const int RESIZE_INTERMEDIATE_BITS = 8;
+
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 出力画素１つが参照する入力の範囲と重み
+    struct _SPAN
+    {
+        std::size_t     first;          // 最初の入力画素
+        std::size_t     count;          // 入力画素数
+        std::size_t     weightOffset;   // 重み配列上の先頭位置
+    };
+
+    // 軸１本分の重み
+    struct _AXIS_WEIGHTS
+    {
+        std::vector<_SPAN>          spans;
+        std::vector<std::uint32_t>  weights;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    //-----------------------------------------------------------------------------
+    // 面積平均の重みを求める
+    /* @note:
+        出力画素 o は入力の [o * scale, (o + 1) * scale) を覆う。
+        重なった長さを累積してから固定小数点に丸めるので、重みの和は必ず 1 << RESIZE_WEIGHT_BITS になる。
+    */
+    _AXIS_WEIGHTS _MakeAxisWeights(std::size_t srcSize, std::size_t dstSize)
+    {
+        const double scale = static_cast<double>(srcSize) / dstSize;
+        const double one = static_cast<double>(1 << RESIZE_WEIGHT_BITS);
+        _AXIS_WEIGHTS axis;
+        axis.spans.reserve(dstSize);
+        for (std::size_t o = 0; o < dstSize; ++o)
+        {
+            const double begin = o * scale;
+            const double end = std::min((o + 1) * scale, static_cast<double>(srcSize));
+            const std::size_t first = std::min(static_cast<std::size_t>(begin), srcSize - 1);
+            const std::size_t last = std::clamp<std::size_t>(static_cast<std::size_t>(std::ceil(end)), first + 1, srcSize);
+            _SPAN span{ first, 0, axis.weights.size() };
+            double covered = 0.0;
+            std::int64_t prevFixed = 0;
+            for (std::size_t s = first; s < last; ++s)
+            {
+                covered += std::min(end, s + 1.0) - std::max(begin, static_cast<double>(s));
+                const auto fixed = static_cast<std::int64_t>(std::llround(covered / (end - begin) * one));
+                if (fixed > prevFixed)
+                {
+                    if (span.count == 0)
+                    {
+                        span.first = s;
+                    }
+                    span.count = s - span.first + 1;
+                    axis.weights.resize(span.weightOffset + span.count, 0);
+                    axis.weights.back() = static_cast<std::uint32_t>(fixed - prevFixed);
+                    prevFixed = fixed;
+                }
+            }
+            axis.spans.push_back(span);
+        }
+        return axis;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+void ayc::ResizeBGRArea(
+    std::uint8_t* pDst,
+    std::size_t dstWidth,
+    std::size_t dstHeight,
+    std::size_t dstStride,
+    const std::uint8_t* pSrc,
+    std::size_t srcWidth,
+    std::size_t srcHeight
+)
+{
+    if (dstWidth < 1 || dstHeight < 1 || srcWidth < 1 || srcHeight < 1)
+    {
+        return;
+    }
+    const auto horizontal = _MakeAxisWeights(srcWidth, dstWidth);
+    const auto vertical = _MakeAxisWeights(srcHeight, dstHeight);
+
+    // 横方向
+    /* @note:
+        縦方向で参照される入力行だけを処理する。
+        結果は小数部を RESIZE_INTERMEDIATE_BITS だけ残した値。
+    */
+    const std::size_t rowBegin = vertical.spans.front().first;
+    const std::size_t rowEnd = vertical.spans.back().first + vertical.spans.back().count;
+    const std::size_t tmpStride = dstWidth * BYTES_PER_PIXEL;
+    std::vector<std::uint32_t> tmp((rowEnd - rowBegin) * tmpStride);
+    {
+        const std::uint32_t round = 1u << (RESIZE_WEIGHT_BITS - RESIZE_INTERMEDIATE_BITS - 1);
+        for (std::size_t y = rowBegin; y < rowEnd; ++y)
+        {
+            const std::uint8_t* const pRow = pSrc + y * srcWidth * BYTES_PER_PIXEL;
+            std::uint32_t* const pTmp = tmp.data() + (y - rowBegin) * tmpStride;
+            for (std::size_t x = 0; x < dstWidth; ++x)
+            {
+                const auto& span = horizontal.spans[x];
+                const std::uint32_t* const pWeights = horizontal.weights.data() + span.weightOffset;
+                const std::uint8_t* const pPixels = pRow + span.first * BYTES_PER_PIXEL;
+                std::uint32_t b = 0;
+                std::uint32_t g = 0;
+                std::uint32_t r = 0;
+                for (std::size_t i = 0; i < span.count; ++i)
+                {
+                    b += pWeights[i] * pPixels[i * BYTES_PER_PIXEL + 0];
+                    g += pWeights[i] * pPixels[i * BYTES_PER_PIXEL + 1];
+                    r += pWeights[i] * pPixels[i * BYTES_PER_PIXEL + 2];
+                }
+                pTmp[x * BYTES_PER_PIXEL + 0] = (b + round) >> (RESIZE_WEIGHT_BITS - RESIZE_INTERMEDIATE_BITS);
+                pTmp[x * BYTES_PER_PIXEL + 1] = (g + round) >> (RESIZE_WEIGHT_BITS - RESIZE_INTERMEDIATE_BITS);
+                pTmp[x * BYTES_PER_PIXEL + 2] = (r + round) >> (RESIZE_WEIGHT_BITS - RESIZE_INTERMEDIATE_BITS);
+            }
+        }
+    }
+    // 縦方向
+    // @note: 行単位で重みを掛けて足し込むので、内側のループは連続したメモリを舐めるだけになる
+    {
+        const std::uint32_t round = 1u << (RESIZE_WEIGHT_BITS + RESIZE_INTERMEDIATE_BITS - 1);
+        std::vector<std::uint32_t> acc(tmpStride);
+        for (std::size_t y = 0; y < dstHeight; ++y)
+        {
+            const auto& span = vertical.spans[y];
+            const std::uint32_t* const pWeights = vertical.weights.data() + span.weightOffset;
+            std::fill(acc.begin(), acc.end(), round);
+            for (std::size_t i = 0; i < span.count; ++i)
+            {
+                const std::uint32_t weight = pWeights[i];
+                const std::uint32_t* const pTmp = tmp.data() + (span.first + i - rowBegin) * tmpStride;
+                for (std::size_t x = 0; x < tmpStride; ++x)
+                {
+                    acc[x] += weight * pTmp[x];
+                }
+            }
+            std::uint8_t* const pRow = pDst + y * dstStride;
+            for (std::size_t x = 0; x < tmpStride; ++x)
+            {
+                pRow[x] = static_cast<std::uint8_t>(std::min<std::uint32_t>(acc[x] >> (RESIZE_WEIGHT_BITS + RESIZE_INTERMEDIATE_BITS), 255));
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::CONTACT_SHEET ayc::MakeContactSheet(
+    const std::vector<CONTACT_SHEET_FRAME>& frames,
+    std::size_t numColumns,
+    std::size_t thumbWidth,
+    std::size_t thumbHeight
+)
+{
+    // パラメータチェック
+    if (frames.empty())
+    {
+        throw MAKE_GENERAL_ERROR("No frames for the contact sheet");
+    }
+    if (numColumns < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("numColumns must be positive", numColumns);
+    }
+    if (thumbWidth < 1 || thumbHeight < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid thumbnail size", thumbWidth * thumbHeight);
+    }
+    for (const auto& frame : frames)
+    {
+        if (frame.width < 1 || frame.height < 1 || frame.frameBuffer.size() < frame.width * frame.height * BYTES_PER_PIXEL)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid frame size", frame.width * frame.height);
+        }
+    }
+    // レイアウトを解決
+    // @note: フレーム数が列数に満たなければ、その分だけ幅を詰める
+    const std::size_t columns = std::min(numColumns, frames.size());
+    const std::size_t rows = (frames.size() + columns - 1) / columns;
+    if (columns * thumbWidth > CONTACT_SHEET_MAX_DIMENSION || rows * thumbHeight > CONTACT_SHEET_MAX_DIMENSION)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Contact sheet is too large", columns * thumbWidth * rows * thumbHeight);
+    }
+    CONTACT_SHEET sheet{ columns * thumbWidth, rows * thumbHeight, std::string() };
+    sheet.frameBuffer.assign(sheet.width * sheet.height * BYTES_PER_PIXEL, '\0');
+
+    // フレームごとに縮小して、セルに直接書き込む
+    // @note: セル同士は重ならないので、書き込みの排他は要らない
+    const std::size_t sheetStride = sheet.width * BYTES_PER_PIXEL;
+    auto* const pSheet = reinterpret_cast<std::uint8_t*>(sheet.frameBuffer.data());
+    ayc::ThreadPool::Instance().ParallelFor(
+        frames.size(),
+        [&](std::size_t i)
+        {
+            const auto& frame = frames[i];
+            const double fit = std::min(
+                static_cast<double>(thumbWidth) / frame.width,
+                static_cast<double>(thumbHeight) / frame.height
+            );
+            const std::size_t width = std::clamp<std::size_t>(static_cast<std::size_t>(std::lround(frame.width * fit)), 1, thumbWidth);
+            const std::size_t height = std::clamp<std::size_t>(static_cast<std::size_t>(std::lround(frame.height * fit)), 1, thumbHeight);
+            const std::size_t left = (i % columns) * thumbWidth + (thumbWidth - width) / 2;
+            const std::size_t top = (i / columns) * thumbHeight + (thumbHeight - height) / 2;
+            ResizeBGRArea(
+                pSheet + top * sheetStride + left * BYTES_PER_PIXEL,
+                width,
+                height,
+                sheetStride,
+                frame.frameBuffer.data(),
+                frame.width,
+                frame.height
+            );
+        }
+    );
+    return sheet;
+}
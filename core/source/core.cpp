@@ -10,6 +10,423 @@
 #include "d3d11_system.h"
 #include "wgc_session.h"
 #include "async_texture_readback.h"
+#include "contact_sheet.h"
+#include "frame_archive.h"
+#include "frame_pruner.h"
+#include "frame_subscription.h"
+#include "gif_encoder.h"
+#include "host_arena.h"
+#include "memory_arbiter.h"
+#include "memory_tracker.h"
+#include "shared_frame_ring.h"
+#include "thread_pool.h"
+#include "y4m_writer.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+namespace
+{
+    // 文字列から OverflowPolicy を解決する
+    ayc::OverflowPolicy _ParseOverflowPolicy(const std::string& overflow)
+    {
+        if (overflow == "drop_oldest")
+        {
+            return ayc::OverflowPolicy::DROP_OLDEST;
+        }
+        else if (overflow == "drop_newest")
+        {
+            return ayc::OverflowPolicy::DROP_NEWEST;
+        }
+        else if (overflow == "block")
+        {
+            return ayc::OverflowPolicy::BLOCK;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown overflow policy", overflow);
+    }
+
+    // 文字列から GifDither を解決する
+    ayc::GifDither _ParseGifDither(const std::string& dither)
+    {
+        if (dither == "none")
+        {
+            return ayc::GifDither::NONE;
+        }
+        else if (dither == "ordered")
+        {
+            return ayc::GifDither::ORDERED;
+        }
+        else if (dither == "floyd_steinberg")
+        {
+            return ayc::GifDither::FLOYD_STEINBERG;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown dither", dither);
+    }
+
+    // 文字列から GifPalette を解決する
+    ayc::GifPalette _ParseGifPalette(const std::string& palette)
+    {
+        if (palette == "global")
+        {
+            return ayc::GifPalette::GLOBAL;
+        }
+        else if (palette == "local")
+        {
+            return ayc::GifPalette::LOCAL;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown palette", palette);
+    }
+
+    // 文字列から YuvMatrix を解決する
+    ayc::YuvMatrix _ParseYuvMatrix(const std::string& matrix)
+    {
+        if (matrix == "bt601")
+        {
+            return ayc::YuvMatrix::BT601;
+        }
+        else if (matrix == "bt709")
+        {
+            return ayc::YuvMatrix::BT709;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown matrix", matrix);
+    }
+
+    // 文字列から FrameFormat を解決する
+    ayc::FrameFormat _ParseFrameFormat(const std::string& frameFormat)
+    {
+        if (frameFormat == "bgra")
+        {
+            return ayc::FrameFormat::BGRA;
+        }
+        else if (frameFormat == "nv12")
+        {
+            return ayc::FrameFormat::NV12;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown frame format", frameFormat);
+    }
+
+    // 文字列から FrameDiffMetric を解決する
+    ayc::FrameDiffMetric _ParseFrameDiffMetric(const std::string& metric)
+    {
+        if (metric == "sad")
+        {
+            return ayc::FrameDiffMetric::SAD;
+        }
+        else if (metric == "ssim")
+        {
+            return ayc::FrameDiffMetric::SSIM;
+        }
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown metric", metric);
+    }
+
+    // 書き出し先（パス or ファイルディスクリプタ）から Y4MWriter を生成する
+    std::unique_ptr<ayc::Y4MWriter> _CreateY4MWriter(
+        const std::variant<int, std::string>& target,
+        double fps,
+        ayc::YuvMatrix matrix
+    )
+    {
+        if (const auto* pFd = std::get_if<int>(&target))
+        {
+            return std::make_unique<ayc::Y4MWriter>(*pFd, fps, matrix);
+        }
+        return std::make_unique<ayc::Y4MWriter>(std::get<std::string>(target), fps, matrix);
+    }
+
+    // ディスクへの書き出し設定を組み立てる
+    // @note: spillDir が無ければ書き出さない
+    std::optional<ayc::SPILL_PARAM> _ToSpillParam(
+        const std::optional<std::string>& spillDir,
+        double spillAfterInSec,
+        std::uint64_t spillBudgetInBytes,
+        std::uint64_t spillSegmentSizeInBytes
+    )
+    {
+        if (!spillDir.has_value())
+        {
+            return std::nullopt;
+        }
+        return ayc::SPILL_PARAM{
+            spillDir.value(),
+            spillAfterInSec,
+            spillBudgetInBytes,
+            spillSegmentSizeInBytes
+        };
+    }
+
+    // 区分ごとの使用量を dict にする
+    py::dict _MemoryTrackerToDict(const ayc::MemoryTracker& tracker)
+    {
+        const std::pair<const char*, ayc::MemoryCategory> categories[] = {
+            { "frame_texture", ayc::MemoryCategory::FRAME_TEXTURE },
+            { "staging_texture", ayc::MemoryCategory::STAGING_TEXTURE },
+            { "readback_buffer", ayc::MemoryCategory::READBACK_BUFFER },
+            { "python_bytes", ayc::MemoryCategory::PYTHON_BYTES },
+        };
+        py::dict result;
+        for (const auto& [name, category] : categories)
+        {
+            const auto counters = tracker.GetCounters(category);
+            py::dict entry;
+            entry["current_bytes"] = counters.currentBytes;
+            entry["peak_bytes"] = counters.peakBytes;
+            entry["allocations"] = counters.allocations;
+            entry["releases"] = counters.releases;
+            entry["total_bytes"] = counters.totalBytes;
+            result[name] = entry;
+        }
+        return result;
+    }
+
+    // 記帳してから Python の bytes にする
+    /* @note:
+        bytes の解放は Python の GC 任せで追えないので、引き渡しとして件数と累計だけ記帳する。
+    */
+    py::bytes _ToBytes(const std::string& buffer, const std::shared_ptr<ayc::MemoryTracker>& pTracker)
+    {
+        (pTracker ? pTracker : ayc::MemoryTracker::Global())->RecordTransfer(
+            ayc::MemoryCategory::PYTHON_BYTES,
+            static_cast<std::int64_t>(buffer.size())
+        );
+        return py::bytes(buffer);
+    }
+
+    // 記帳してから Python の bytes にする
+    py::bytes _ToBytes(const ayc::HostBuffer& buffer, const std::shared_ptr<ayc::MemoryTracker>& pTracker)
+    {
+        (pTracker ? pTracker : ayc::MemoryTracker::Global())->RecordTransfer(
+            ayc::MemoryCategory::PYTHON_BYTES,
+            static_cast<std::int64_t>(buffer.GetSize())
+        );
+        return py::bytes(reinterpret_cast<const char*>(buffer.GetData()), buffer.GetSize());
+    }
+
+    // コピーせずに読み取り専用の memoryview にする
+    /* @note:
+        memoryview は HostBuffer のコピーを持つ Python オブジェクトを参照するので、
+        memoryview が生きている間はアリーナも解放されない。
+    */
+    py::memoryview _ToMemoryView(const ayc::HostBuffer& buffer)
+    {
+        return py::memoryview(py::cast(buffer));
+    }
+
+    // 記帳先の状態を dict にする
+    py::dict _MemoryAccountToDict(const ayc::MemoryAccount& account)
+    {
+        const auto limitBytes = account.GetLimitBytes();
+        py::dict result;
+        result["hwnd"] = account.GetId();
+        result["weight"] = account.GetWeight();
+        result["min_duration_in_sec"] = account.GetMinHoldInSec();
+        result["bytes"] = account.GetBytes();
+        result["floor_bytes"] = account.GetFloorBytes();
+        result["limit_bytes"] = (
+            limitBytes == ayc::MemoryAccount::NO_LIMIT ? py::object(py::none()) : py::int_(limitBytes)
+        );
+        result["categories"] = _MemoryTrackerToDict(*account.GetTracker());
+        return result;
+    }
+
+    // GIL を手放してから破棄される AsyncTextureReadback を生成する
+    /* @note:
+        AsyncTextureReadback の破棄は BG の読み出しの完了待ちを伴い、
+        BG の読み出しは完了ハンドラの中で GIL を取りに来る。
+        asyncio の Future 経由で最後の参照が GIL 保持中に手放されてもデッドロックしないように、
+        破棄の瞬間だけ GIL を解放する。
+    */
+    std::shared_ptr<ayc::AsyncTextureReadback> _NewAsyncTextureReadback(
+        const std::vector<ayc::FRAME_SOURCE>& sources
+    )
+    {
+        return std::shared_ptr<ayc::AsyncTextureReadback>(
+            new ayc::AsyncTextureReadback(sources),
+            [](ayc::AsyncTextureReadback* pReadback)
+            {
+                if (PyGILState_Check())
+                {
+                    py::gil_scoped_release gilRelease;
+                    delete pReadback;
+                }
+                else
+                {
+                    delete pReadback;
+                }
+            }
+        );
+    }
+
+    // 全ての転送を待つ参照を作る
+    /* @note:
+        スナップショット本体はどのフレームがいつ読まれるか分からないので、全ての転送の待ち手になる。
+        返した参照とそのコピーが全て無くなった時点で待つのをやめる。
+        それ以降は Future だけが待っている転送が残り、全ての Future がキャンセルされた未着手の転送は読み飛ばされる。
+    */
+    std::shared_ptr<ayc::AsyncTextureReadback> _RetainAllFrames(
+        const std::shared_ptr<ayc::AsyncTextureReadback>& pReadback
+    )
+    {
+        for (std::size_t i = 0; i < pReadback->GetSize(); ++i)
+        {
+            pReadback->Retain(i);
+        }
+        return std::shared_ptr<ayc::AsyncTextureReadback>(
+            pReadback.get(),
+            [pReadback](ayc::AsyncTextureReadback*)
+            {
+                for (std::size_t i = 0; i < pReadback->GetSize(); ++i)
+                {
+                    pReadback->Release(i);
+                }
+            }
+        );
+    }
+
+    // C++ 例外を Python の例外オブジェクトにする
+    /* @note:
+        例外トランスレータと同じ変換を通したいので、
+        ThrowGeneralErrorAsPython が投げた Python 例外を捕まえて取り出す。
+    */
+    py::object _ExceptionToPython(std::exception_ptr pError)
+    {
+        try
+        {
+            try
+            {
+                std::rethrow_exception(pError);
+            }
+            catch (const ayc::GeneralError& e)
+            {
+                ayc::ThrowGeneralErrorAsPython(e);
+            }
+            catch (const std::exception& e)
+            {
+                ayc::ThrowGeneralErrorAsPython(
+                    MAKE_GENERAL_ERROR_FROM_CPP_EXCEPTION("Unhandled C++ Exception", e)
+                );
+            }
+            catch (...)
+            {
+                ayc::ThrowGeneralErrorAsPython(
+                    MAKE_GENERAL_ERROR("Unhandled Unknown Exception")
+                );
+            }
+        }
+        catch (py::error_already_set& e)
+        {
+            return e.value();
+        }
+        return py::none();
+    }
+
+    // 非同期転送の完了を asyncio の Future に届ける
+    /* @note:
+        BG スレッドから Future を直接触ることはできないので、
+        loop.call_soon_threadsafe でイベントループのスレッドに結果の設定を依頼する。
+        call_soon_threadsafe はイベントループの self-pipe に書き込んでループを起こすので、
+        Python 側のスレッドは一切ブロックしない。
+
+        Future も転送の待ち手の１つとして Retain し、完了・キャンセルで Release する。
+        他に待ち手の無い未着手の転送は、Future のキャンセルでキャンセルされて無駄な転送を省く。
+        スナップショットの転送はスナップショット本体も待っているので、
+        Future を１つキャンセルしても同じフレームの GetFrame などには影響しない。
+        pReadback には _RetainAllFrames の参照ではなく、元の参照を渡すこと。
+    */
+    void _BindFuture(
+        py::object loop,
+        py::object future,
+        const std::shared_ptr<ayc::AsyncTextureReadback>& pReadback,
+        std::size_t index
+    )
+    {
+        const auto pMemoryTracker = pReadback->GetMemoryTracker();
+        // Future が待つのをやめたら転送に伝える
+        {
+            pReadback->Retain(index);
+            future.attr("add_done_callback")(
+                py::cpp_function(
+                    [pReadback, index](py::object /*doneFuture*/)
+                    {
+                        pReadback->Release(index);
+                    }
+                )
+            );
+        }
+        // 転送の完了を Future に伝える
+        /* @note:
+            ハンドラは GIL なしで破棄されうるので、
+            Python オブジェクトは GIL 保持中にハンドラ内で手放しておく。
+        */
+        auto pBinding = std::make_shared<std::pair<py::object, py::object>>(
+            std::move(loop),
+            std::move(future)
+        );
+        pReadback->OnCompleted(
+            index,
+            [pBinding, pMemoryTracker](const ayc::AsyncTextureReadback::RESULT* pResult, std::exception_ptr pError)
+            {
+                py::gil_scoped_acquire gilAcquire;
+                const auto loop = std::move(pBinding->first);
+                const auto future = std::move(pBinding->second);
+                if (!loop)
+                {
+                    return;
+                }
+                try
+                {
+                    if (pResult)
+                    {
+                        const auto setResult = py::cpp_function(
+                            [](py::object target, py::object value)
+                            {
+                                if (!target.attr("done")().cast<bool>())
+                                {
+                                    target.attr("set_result")(value);
+                                }
+                            }
+                        );
+                        loop.attr("call_soon_threadsafe")(
+                            setResult,
+                            future,
+                            py::make_tuple(
+                                pResult->width,
+                                pResult->height,
+                                _ToBytes(pResult->textureBuffer, pMemoryTracker)
+                            )
+                        );
+                    }
+                    else if (pError)
+                    {
+                        const auto setException = py::cpp_function(
+                            [](py::object target, py::object value)
+                            {
+                                if (!target.attr("done")().cast<bool>())
+                                {
+                                    target.attr("set_exception")(value);
+                                }
+                            }
+                        );
+                        loop.attr("call_soon_threadsafe")(
+                            setException,
+                            future,
+                            _ExceptionToPython(pError)
+                        );
+                    }
+                    else
+                    {
+                        // @note: 転送がキャンセルされたので Future もキャンセル
+                        loop.attr("call_soon_threadsafe")(future.attr("cancel"));
+                    }
+                }
+                catch (py::error_already_set& e)
+                {
+                    // @note: イベントループが閉じられている場合はここに来る。届け先が無いので捨てる。
+                    ayc::WriteLog("In _BindFuture, failed to notify event loop: {}", e.what());
+                }
+            }
+        );
+    }
+}
 
 //-----------------------------------------------------------------------------
 // Aynime Capture Definitions
@@ -22,6 +439,7 @@ namespace ayc
 
     class Session;
     class Snapshot;
+    class Subscription;
 
     //-------------------------------------------------------------------------
     // Session
@@ -30,6 +448,7 @@ namespace ayc
     class Session
     {
         friend class Snapshot;
+        friend class Subscription;
 
     public:
         //---------------------------------------------------------------------
@@ -37,23 +456,98 @@ namespace ayc
             uintptr_t hwnd,
             double holdInSec,
             std::optional<std::size_t> maxWidth,
-            std::optional<std::size_t> maxHeight
+            std::optional<std::size_t> maxHeight,
+            double weight,
+            double minHoldInSec,
+            bool deduplicate,
+            std::optional<double> hotHoldInSec,
+            std::optional<std::string> spillDir,
+            double spillAfterInSec,
+            std::uint64_t spillBudgetInBytes,
+            std::uint64_t spillSegmentSizeInBytes,
+            std::optional<double> sceneCutThreshold,
+            const std::string& frameFormat
         )
         : m_pWGCSession()
+        , m_pFrameDispatcher()
         {
             // D3D11 初期化
             {
                 ayc::d3d11::Initialize();
             }
+            // ディスクへの書き出し設定
+            const auto spillParam = _ToSpillParam(spillDir, spillAfterInSec, spillBudgetInBytes, spillSegmentSizeInBytes);
+            const auto resolvedFrameFormat = _ParseFrameFormat(frameFormat);
+
             // セッション開始
             if( ayc::WGCSession::Available() )
             {
                 m_pWGCSession.reset(
-                    new ayc::WGCSession(reinterpret_cast<HWND>(hwnd), holdInSec, maxWidth, maxHeight)
+                    new ayc::WGCSession(
+                        reinterpret_cast<HWND>(hwnd),
+                        holdInSec,
+                        maxWidth,
+                        maxHeight,
+                        weight,
+                        minHoldInSec,
+                        deduplicate,
+                        hotHoldInSec,
+                        spillParam,
+                        sceneCutThreshold,
+                        resolvedFrameFormat
+                    )
                 );
             }
         }
 
+        //---------------------------------------------------------------------
+        static Session Replay(
+            const std::string& archivePath,
+            double holdInSec,
+            bool realtime,
+            bool loop,
+            double speed,
+            std::optional<std::size_t> maxWidth,
+            std::optional<std::size_t> maxHeight,
+            double weight,
+            double minHoldInSec,
+            bool deduplicate,
+            std::optional<double> hotHoldInSec,
+            std::optional<std::string> spillDir,
+            double spillAfterInSec,
+            std::uint64_t spillBudgetInBytes,
+            std::uint64_t spillSegmentSizeInBytes,
+            std::optional<double> sceneCutThreshold,
+            const std::string& frameFormat
+        )
+        {
+            /* @note:
+                WGC を使わないので Available のチェックは要らない。
+                ただしテクスチャを上げるので D3D11 は初期化する。
+            */
+            // D3D11 初期化
+            {
+                ayc::d3d11::Initialize();
+            }
+            // セッション開始
+            return Session(
+                std::make_shared<ayc::WGCSession>(
+                    archivePath,
+                    ayc::REPLAY_PARAM{ realtime, loop, speed },
+                    holdInSec,
+                    maxWidth,
+                    maxHeight,
+                    weight,
+                    minHoldInSec,
+                    deduplicate,
+                    hotHoldInSec,
+                    _ToSpillParam(spillDir, spillAfterInSec, spillBudgetInBytes, spillSegmentSizeInBytes),
+                    sceneCutThreshold,
+                    _ParseFrameFormat(frameFormat)
+                )
+            );
+        }
+
         //---------------------------------------------------------------------
         ~Session() = default;
 
@@ -65,6 +559,13 @@ namespace ayc
                 しかし python は GC なので shared_ptr の参照カウントはアテにできない。
                 なので、明示的セッションを指定できるように Close を用意した。
             */
+            // @note: 配送スレッドがセッションを触っているので先に止める
+            if (m_pFrameDispatcher)
+            {
+                py::gil_scoped_release gilRelease;
+                m_pFrameDispatcher->Close();
+                m_pFrameDispatcher.reset();
+            }
             if (m_pWGCSession)
             {
                 m_pWGCSession->Close();
@@ -97,15 +598,19 @@ namespace ayc
                 {
                     throw MAKE_GENERAL_ERROR("Session Already Stopped");
                 }
-                // テクスチャを取得
-                const auto srcTex = m_pWGCSession->CopyFrame(timeInSec);
-                if (srcTex)
+                // フレームを取得
+                // @note: コールド層のフレームならここで展開する
+                // @note: 呼び出し元が結果を待っているので、変換はバルク処理より先に回してもらう
+                ayc::MemoryTrackerScope trackerScope(_GetMemoryTracker());
+                ayc::TaskPriorityScope priorityScope(ayc::TaskPriority::INTERACTIVE);
+                const auto source = m_pWGCSession->CopyFrame(timeInSec);
+                if (source)
                 {
-                    ReadbackTexture(
+                    ReadbackFrame(
                         width,
                         height,
                         textureBuffer,
-                        srcTex
+                        source
                     );
                 }
             }
@@ -123,225 +628,981 @@ namespace ayc
                 return py::make_tuple(
                     width,
                     height,
-                    py::bytes(textureBuffer)
+                    _ToBytes(textureBuffer, _GetMemoryTracker())
                 );
             }
         }
 
-    private:
-        std::shared_ptr<ayc::WGCSession> m_pWGCSession;
-    };
-
-    //-------------------------------------------------------------------------
-    // Snapshot
-    //-------------------------------------------------------------------------
-
-    class Snapshot
-    {
-    public:
         //---------------------------------------------------------------------
-        Snapshot(Session session, std::optional<double> fps, std::optional<double> durationInSec)
-        : m_pAsyncTextureReadback()
+        py::object GetFrameByTimeAsync(double timeInSec) const
         {
-            py::gil_scoped_release gilRelease;
+            /* @note:
+                asyncio から run_in_executor 無しで待てるように、
+                読み出しを BG スレッドに任せて asyncio.Future を返す。
+                結果は GetFrameByTime と同じ形式で Future に設定される。
+            */
+            // Future を生成
+            // @note: 実行中のイベントループが無ければ asyncio が RuntimeError を投げる
+            auto loop = py::module_::import("asyncio").attr("get_running_loop")();
+            auto future = loop.attr("create_future")();
 
-            // WGC セッションを解決
-            const auto& pWGCSession = session.m_pWGCSession;
+            // セッションが停止済みならエラー
+            const auto pWGCSession = m_pWGCSession;
             if (!pWGCSession)
             {
                 throw MAKE_GENERAL_ERROR("Session Already Stopped");
             }
-            // フレームバッファの要求区間長を解決
-            const auto requestRawDurationInSec = [&]()
+            // フレームを取得
+            ayc::FRAME_SOURCE source;
             {
-                if (durationInSec.has_value())
-                {
-                    return std::max(
-                        durationInSec.value(),
-                        0.0
-                    );
-                }
-                else
-                {
-                    return std::numeric_limits<double>::max();
-                }
-            }();
-            // 生のフレームバッファを得る
-            const auto rawFrameBuffer = pWGCSession->CopyFrameBuffer(
-                requestRawDurationInSec
-            );
-            // フレームバッファが空の場合
-            /* @note:
-                fps 指定がある場合のフローに通したくないので、
-                適当にクリアして早期リターンする。
-            */
-            if (rawFrameBuffer.GetSize() < 1)
+                py::gil_scoped_release gilRelease;
+                source = pWGCSession->CopyFrame(timeInSec);
+            }
+            // フレームバッファが空なら即座に完了
+            if (!source)
             {
-                m_indexUserToRaw.clear();
-                m_pAsyncTextureReadback.reset();
-                return;
+                future.attr("set_result")(
+                    py::make_tuple(
+                        py::none(),
+                        py::none(),
+                        py::none()
+                    )
+                );
+                return future;
             }
-            // 「ユーザー --> 生」のインデックスマップを解決
-            /* @note:
-                諸々の処理をした最終的なフレームバッファは、
-                ユーザー＝このライブラリの Caller が目にすることになる、
-                ってことでユーザーフレームバッファと命名。
-
-                VRAM からのダウンロードを非同期で行いたい都合で、
-                先にインデックスマップを解決する。
+            // 非同期転送をスタート
+            {
+                ayc::MemoryTrackerScope trackerScope(pWGCSession->GetMemoryAccount()->GetTracker());
+                ayc::TaskPriorityScope priorityScope(ayc::TaskPriority::INTERACTIVE);
+                const auto pReadback = _NewAsyncTextureReadback({ source });
+                _BindFuture(loop, future, pReadback, 0);
+            }
+            return future;
+        }
 
-                fps 指定がある場合は指定 fps でキャプチャしたかのように見えるように、
-                フレームの取捨選択を行う。
+        //---------------------------------------------------------------------
+        py::tuple WaitForNewFrame(
+            std::optional<double> timeoutInSec,
+            std::optional<std::uint64_t> afterSeq
+        ) const
+        {
+            /* @note:
+                GetFrameByTime をポーリングしなくて済むように、
+                PushFrame からの通知で新着フレームを待ち受ける。
+                タイムアウトは GetFrameByTime の空バッファと同様に None で通知する。
+            */
+            // セッションが停止済みならエラー
+            /* @note:
+                待機中に別スレッドから Close される可能性がある。
+                WGCSession の寿命を延ばすため、GIL 保持中に shared_ptr をコピーしておく。
             */
-            if (fps.has_value())
+            const auto pWGCSession = m_pWGCSession;
+            if (!pWGCSession)
             {
-                // 生フレームバッファの範囲（秒数）を解決
-                const auto [rawMinRelativesInSec, rawMaxRelativeInSec] = [&]()
-                    {
-                        auto [minIter, maxIter] = std::ranges::minmax_element
-                        (
-                            rawFrameBuffer,
-                            /*_Pr=*/{},
-                            [](auto const& x) { return x.relativeInSec; }
-                        );
-                        return std::make_pair(minIter->relativeInSec, maxIter->relativeInSec);
-                    }();
-                const auto rawDurationInSec = (
-                    rawMaxRelativeInSec - rawMinRelativesInSec
-                    );
-                // ユーザーフレームバッファの秒数を解決
-                const auto userDurationInSec = [&]()
-                {
-                    if (durationInSec.has_value())
-                    {
-                        return durationInSec.value();
-                    }
-                    else
-                    {
-                        return rawDurationInSec;
-                    }
-                }();
-                // ユーザーフレームバッファのフレーム数を解決
-                const auto numUserFrames = [&]()
-                {
-                    const auto fpsValue = fps.value();
-                    const auto result = std::round(userDurationInSec * fpsValue);
-                    return static_cast<std::size_t>(result);
-                }();
-                // マップを構築
-                {
-                    m_indexUserToRaw.clear();
-                    m_indexUserToRaw.reserve(numUserFrames);
-                    for (std::size_t i = 0; i < numUserFrames; ++i)
-                    {
-                        const auto rawObjRelativesInSec = (
-                            userDurationInSec * static_cast<double>(numUserFrames - i - 1) / static_cast<double>(numUserFrames)
-                        );
-                        const auto rawFrameIndex = rawFrameBuffer.GetFrameIndex(rawObjRelativesInSec);
-                        m_indexUserToRaw.push_back(rawFrameIndex);
-                    }
-                }
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
             }
-            else
+            // GIL Released
+            std::uint64_t seq = 0;
+            double timestampInSec = 0.0;
+            std::size_t width = 0;
+            std::size_t height = 0;
+            std::string textureBuffer = "";
             {
-                // @note: fps 指定が無い場合は恒等写像にする
-                m_indexUserToRaw.clear();
-                m_indexUserToRaw.reserve(rawFrameBuffer.GetSize());
-                for (std::size_t i = 0; i < rawFrameBuffer.GetSize(); ++i)
+                // 待機が長引く可能性があるので GIL 解放
+                py::gil_scoped_release gilRelease;
+
+                // 新着フレームを待機
+                ayc::MemoryTrackerScope trackerScope(pWGCSession->GetMemoryAccount()->GetTracker());
+                ayc::TaskPriorityScope priorityScope(ayc::TaskPriority::INTERACTIVE);
+                const auto frame = pWGCSession->WaitFrame(afterSeq, timeoutInSec);
+                if (frame.pTexture)
                 {
-                    m_indexUserToRaw.push_back(i);
-                }
+                    seq = frame.seq;
+                    timestampInSec = std::chrono::duration<double>(frame.timeSpan).count();
+                    ReadbackTexture(
+                        width,
+                        height,
+                        textureBuffer,
+                        frame.pTexture
+                    );
+                }
+            }
+            // python オブジェクトを返す
+            if (textureBuffer.empty())
+            {
+                return py::make_tuple(
+                    py::none(),
+                    py::none(),
+                    py::none(),
+                    py::none(),
+                    py::none()
+                );
+            }
+            else
+            {
+                return py::make_tuple(
+                    seq,
+                    timestampInSec,
+                    width,
+                    height,
+                    _ToBytes(textureBuffer, pWGCSession->GetMemoryAccount()->GetTracker())
+                );
+            }
+        }
+
+        //---------------------------------------------------------------------
+        std::unique_ptr<Subscription> Subscribe(
+            py::function callback,
+            std::size_t maxPending,
+            const std::string& overflow
+        );
+
+        //---------------------------------------------------------------------
+        std::unique_ptr<SharedFramePublisher> PublishSharedRing(
+            const std::string& name,
+            std::size_t numSlots,
+            std::size_t slotCapacityInBytes
+        )
+        {
+            /* @note:
+                フレームを bytes で pickle してプロセス間で受け渡すのは重いので、
+                名前付き共有メモリに直接書き出し、別プロセスからゼロコピーで読めるようにする。
+            */
+            return std::make_unique<SharedFramePublisher>(
+                _GetFrameDispatcher(),
+                name,
+                numSlots,
+                slotCapacityInBytes
+            );
+        }
+
+        //---------------------------------------------------------------------
+        std::unique_ptr<Y4MFramePublisher> StreamY4M(
+            const std::variant<int, std::string>& target,
+            double fps,
+            const std::string& matrix,
+            std::size_t maxPending,
+            const std::string& overflow
+        )
+        {
+            /* @note:
+                ffmpeg の stdin などに生の YUV を流し込めるよう、新着フレームを Y4M で書き出し続ける。
+                fps はヘッダに書くだけで、実際の到着間隔とは合わせない。
+            */
+            return std::make_unique<Y4MFramePublisher>(
+                _GetFrameDispatcher(),
+                _CreateY4MWriter(target, fps, _ParseYuvMatrix(matrix)),
+                maxPending,
+                _ParseOverflowPolicy(overflow)
+            );
+        }
+
+        //---------------------------------------------------------------------
+        py::dict GetMemoryUsage() const
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            return _MemoryAccountToDict(*m_pWGCSession->GetMemoryAccount());
+        }
+
+        //---------------------------------------------------------------------
+        py::dict GetDedupStats() const
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            const auto stats = m_pWGCSession->GetDedupStats();
+            py::dict result;
+            result["deduplicated_frames"] = stats.deduplicatedFrames;
+            result["saved_bytes"] = stats.savedBytes;
+            result["held_duplicates"] = stats.heldDuplicates;
+            result["held_saved_bytes"] = stats.heldSavedBytes;
+            return result;
+        }
+
+        //---------------------------------------------------------------------
+        std::vector<std::tuple<double, double>> GetSceneCuts(std::optional<double> durationInSec) const
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            // @note: 指定が無ければバッファ全体
+            const auto cuts = m_pWGCSession->GetSceneCuts(
+                durationInSec.value_or(std::numeric_limits<double>::infinity())
+            );
+            std::vector<std::tuple<double, double>> result;
+            result.reserve(cuts.size());
+            for (const auto& cut : cuts)
+            {
+                result.emplace_back(cut.relativeInSec, cut.score);
+            }
+            return result;
+        }
+
+        //---------------------------------------------------------------------
+        py::dict GetTierStats() const
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            const auto stats = m_pWGCSession->GetTierStats();
+            py::dict result;
+            result["hot_frames"] = stats.hotFrames;
+            result["cold_frames"] = stats.coldFrames;
+            result["hot_bytes"] = stats.hotBytes;
+            result["cold_bytes"] = stats.coldBytes;
+            result["cold_raw_bytes"] = stats.coldRawBytes;
+            result["cold_saved_bytes"] = stats.coldRawBytes - std::min(stats.coldBytes, stats.coldRawBytes);
+            result["cold_tiles"] = stats.coldTiles;
+            result["cold_stored_tiles"] = stats.coldStoredTiles;
+            result["spilled_frames"] = stats.spilledFrames;
+            result["spilled_bytes"] = stats.spilledBytes;
+            result["spill_disk_bytes"] = stats.spillDiskBytes;
+            result["compression_ratio"] = (
+                stats.coldBytes > 0 ?
+                py::object(py::float_(static_cast<double>(stats.coldRawBytes) / stats.coldBytes)) :
+                py::object(py::none())
+            );
+            return result;
+        }
+
+        //---------------------------------------------------------------------
+        bool IsReplayFinished() const
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            return m_pWGCSession->IsReplayFinished();
+        }
+
+    private:
+        //---------------------------------------------------------------------
+        explicit Session(const std::shared_ptr<ayc::WGCSession>& pWGCSession)
+        : m_pWGCSession(pWGCSession)
+        , m_pFrameDispatcher()
+        {
+            // nop
+        }
+
+        //---------------------------------------------------------------------
+        const std::shared_ptr<ayc::FrameDispatcher>& _GetFrameDispatcher()
+        {
+            // セッションが停止済みならエラー
+            if (!m_pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            // 配送クラスは最初の購読時に起動する
+            if (!m_pFrameDispatcher)
+            {
+                m_pFrameDispatcher = std::make_shared<ayc::FrameDispatcher>(m_pWGCSession);
+            }
+            return m_pFrameDispatcher;
+        }
+
+        //---------------------------------------------------------------------
+        std::shared_ptr<ayc::MemoryTracker> _GetMemoryTracker() const
+        {
+            // @note: 停止済みならプロセス全体の記帳先
+            if (!m_pWGCSession)
+            {
+                return ayc::MemoryTracker::Global();
+            }
+            return m_pWGCSession->GetMemoryAccount()->GetTracker();
+        }
+
+        std::shared_ptr<ayc::WGCSession>        m_pWGCSession;
+        std::shared_ptr<ayc::FrameDispatcher>   m_pFrameDispatcher;
+    };
+
+    //-------------------------------------------------------------------------
+    // Subscription
+    //-------------------------------------------------------------------------
+
+    class Subscription
+    {
+    public:
+        //---------------------------------------------------------------------
+        Subscription(
+            const std::shared_ptr<ayc::FrameDispatcher>& pFrameDispatcher,
+            const std::shared_ptr<ayc::MemoryTracker>& pMemoryTracker,
+            py::function callback,
+            std::size_t maxPending,
+            OverflowPolicy overflowPolicy
+        )
+        : m_pFrameDispatcher(pFrameDispatcher)
+        , m_pSubscriber()
+        , m_thread()
+        {
+            // 購読開始
+            {
+                m_pSubscriber = m_pFrameDispatcher->Subscribe(maxPending, overflowPolicy);
+            }
+            // 配送スレッド起動
+            /* @note:
+                コールバック内から Close されるケースに備えて、
+                スレッドは this ではなく必要なものを値で持つ。
+            */
+            {
+                m_thread = std::thread(
+                    &Subscription::_ThreadHandler,
+                    m_pSubscriber,
+                    pMemoryTracker,
+                    py::object(callback)
+                );
+            }
+        }
+
+        //---------------------------------------------------------------------
+        ~Subscription()
+        {
+            Close();
+        }
+
+        // コピー禁止
+        Subscription(const Subscription&) = delete;
+        Subscription& operator=(const Subscription&) = delete;
+
+        //---------------------------------------------------------------------
+        void Close()
+        {
+            // 購読終了
+            if (m_pFrameDispatcher)
+            {
+                m_pFrameDispatcher->Unsubscribe(m_pSubscriber);
+                m_pFrameDispatcher.reset();
+            }
+            else if (m_pSubscriber)
+            {
+                m_pSubscriber->Close();
+            }
+            // 配送スレッドの終了を待機
+            /* @note:
+                コールバック内から呼ばれた場合は自分自身を join できないので detach する。
+                配送スレッドは GIL を取りに来るので、待機中は GIL を解放する。
+            */
+            if (m_thread.joinable())
+            {
+                if (m_thread.get_id() == std::this_thread::get_id())
+                {
+                    m_thread.detach();
+                }
+                else
+                {
+                    py::gil_scoped_release gilRelease;
+                    m_thread.join();
+                }
+            }
+        }
+
+        //---------------------------------------------------------------------
+        py::dict GetStats() const
+        {
+            const auto stats = m_pSubscriber->GetStats();
+            py::dict result;
+            result["delivered"] = stats.delivered;
+            result["dropped"] = stats.dropped;
+            result["pending"] = stats.pending;
+            result["latest_lag_in_sec"] = stats.latestLagInSec;
+            result["max_lag_in_sec"] = stats.maxLagInSec;
+            return result;
+        }
+
+    private:
+        //---------------------------------------------------------------------
+        static void _ThreadHandler(
+            std::shared_ptr<ayc::FrameSubscriber> pSubscriber,
+            std::shared_ptr<ayc::MemoryTracker> pMemoryTracker,
+            py::object callback
+        )
+        {
+            // クローズされるまで到着順に配送
+            ayc::SUBSCRIBED_FRAME frame;
+            while (pSubscriber->Pop(frame))
+            {
+                {
+                    py::gil_scoped_acquire gilAcquire;
+                    try
+                    {
+                        callback(
+                            frame.seq,
+                            std::chrono::duration<double>(frame.timeSpan).count(),
+                            frame.pResult->width,
+                            frame.pResult->height,
+                            _ToBytes(frame.pResult->textureBuffer, pMemoryTracker)
+                        );
+                    }
+                    catch (const py::error_already_set& e)
+                    {
+                        // @note: コールバックの例外で配送を止めたくないので、ログだけ出して続行
+                        ayc::WriteLog("Exception in subscription callback\n{}", e.what());
+                    }
+                }
+                pSubscriber->MarkDelivered(frame);
+            }
+            // コールバックの参照は GIL を取ってから手放す
+            {
+                py::gil_scoped_acquire gilAcquire;
+                callback = py::object();
+            }
+        }
+
+        std::shared_ptr<ayc::FrameDispatcher>   m_pFrameDispatcher;
+        std::shared_ptr<ayc::FrameSubscriber>   m_pSubscriber;
+        std::thread                             m_thread;
+    };
+
+    //-------------------------------------------------------------------------
+    // Session (Subscription 依存部分)
+    //-------------------------------------------------------------------------
+
+    //---------------------------------------------------------------------
+    inline std::unique_ptr<Subscription> Session::Subscribe(
+        py::function callback,
+        std::size_t maxPending,
+        const std::string& overflow
+    )
+    {
+        return std::make_unique<Subscription>(
+            _GetFrameDispatcher(),
+            _GetMemoryTracker(),
+            callback,
+            maxPending,
+            _ParseOverflowPolicy(overflow)
+        );
+    }
+
+    //-------------------------------------------------------------------------
+    // Snapshot
+    //-------------------------------------------------------------------------
+
+    class Snapshot
+    {
+    public:
+        //---------------------------------------------------------------------
+        Snapshot(Session session, std::optional<double> fps, std::optional<double> durationInSec)
+        : m_pAsyncTextureReadback()
+        , m_pUnretainedTextureReadback()
+        , m_pMemoryTracker(session._GetMemoryTracker())
+        {
+            py::gil_scoped_release gilRelease;
+
+            // WGC セッションを解決
+            const auto& pWGCSession = session.m_pWGCSession;
+            if (!pWGCSession)
+            {
+                throw MAKE_GENERAL_ERROR("Session Already Stopped");
+            }
+            // @note: 転送結果・ステージングテクスチャはセッションに記帳する
+            ayc::MemoryTrackerScope trackerScope(m_pMemoryTracker);
+            // フレームバッファの要求区間長を解決
+            const auto requestRawDurationInSec = [&]()
+            {
+                if (durationInSec.has_value())
+                {
+                    return std::max(
+                        durationInSec.value(),
+                        0.0
+                    );
+                }
+                else
+                {
+                    return std::numeric_limits<double>::max();
+                }
+            }();
+            // 生のフレームバッファを得る
+            const auto rawFrameBuffer = pWGCSession->CopyFrameBuffer(
+                requestRawDurationInSec
+            );
+            // フレームバッファが空の場合
+            /* @note:
+                fps 指定がある場合のフローに通したくないので、
+                適当にクリアして早期リターンする。
+            */
+            if (rawFrameBuffer.GetSize() < 1)
+            {
+                m_indexUserToRaw.clear();
+                m_relativesInSec.clear();
+                m_pAsyncTextureReadback.reset();
+                return;
+            }
+            // 「ユーザー --> 生」のインデックスマップを解決
+            /* @note:
+                諸々の処理をした最終的なフレームバッファは、
+                ユーザー＝このライブラリの Caller が目にすることになる、
+                ってことでユーザーフレームバッファと命名。
+
+                VRAM からのダウンロードを非同期で行いたい都合で、
+                先にインデックスマップを解決する。
+
+                fps 指定がある場合は指定 fps でキャプチャしたかのように見えるように、
+                フレームの取捨選択を行う。
+            */
+            rawFrameBuffer.ResolveIndexMap(m_indexUserToRaw, m_relativesInSec, fps, durationInSec);
+
+            // 非同期転送をスタート
+            {
+                // 実際に使われる生フレームのインデックスを解決
+                /* @note:
+                    fps 指定がある場合、フレーム間引きされる可能性がある。
+                    転送フレーム数を最小化したいので、必要フレームだけ選択的に転送する。
+                */
+                std::vector<std::size_t> reqIndices = m_indexUserToRaw;
+                {
+                    std::sort(reqIndices.begin(), reqIndices.end());
+                    reqIndices.erase(
+                        std::unique(reqIndices.begin(), reqIndices.end()),
+                        reqIndices.end()
+                    );
+                }
+                // 転送をスタート
+                /* @note:
+                    隙間を詰めるとインデックスの辻褄合わせがクソだるいので、
+                    不要なフレームを nullptr でフィルすることで間引きを表現する。
+                */
+                {
+                    std::vector<ayc::FRAME_SOURCE> reqSources(
+                        rawFrameBuffer.GetSize()
+                    );
+                    for (auto reqIndex : reqIndices)
+                    {
+                        reqSources[reqIndex] = rawFrameBuffer[reqIndex];
+                    }
+                    m_pUnretainedTextureReadback = _NewAsyncTextureReadback(reqSources);
+                    m_pAsyncTextureReadback = _RetainAllFrames(m_pUnretainedTextureReadback);
+                }
+            }
+        }
+
+        //---------------------------------------------------------------------
+        ~Snapshot() = default;
+
+        //---------------------------------------------------------------------
+        void Exit()
+        {
+            /* @note:
+                AsyncTextureReadback の解放時に非同期処理待機がある。
+                まぁまぁ待たされるかもなので GIL を解放。
+            */
+            py::gil_scoped_release gilRelease;
+            m_indexUserToRaw.clear();
+            m_relativesInSec.clear();
+            m_pAsyncTextureReadback.reset();
+            m_pUnretainedTextureReadback.reset();
+        }
+
+        //---------------------------------------------------------------------
+        std::size_t GetSize() const
+        {
+            return m_indexUserToRaw.size();
+        }
+
+        //---------------------------------------------------------------------
+        py::tuple GetFrameBuffer(std::size_t frameIndex) const
+        {
+            // Python オブジェクトに固めて結果を返す
+            const auto result = _WaitFrame(frameIndex);
+            return py::make_tuple(
+                result.width,
+                result.height,
+                _ToBytes(result.textureBuffer, m_pMemoryTracker)
+            );
+        }
+
+        //---------------------------------------------------------------------
+        py::tuple GetFrameView(std::size_t frameIndex) const
+        {
+            // コピーせずに転送結果をそのまま見せる
+            // @note: Exit 後も memoryview が生きている間はアリーナが残る
+            const auto result = _WaitFrame(frameIndex);
+            return py::make_tuple(
+                result.width,
+                result.height,
+                _ToMemoryView(result.textureBuffer)
+            );
+        }
+
+        //---------------------------------------------------------------------
+        py::object GetFrameBufferAsync(std::size_t frameIndex) const
+        {
+            // Future を生成
+            auto loop = py::module_::import("asyncio").attr("get_running_loop")();
+            auto future = loop.attr("create_future")();
+
+            // エラーチェック
+            if (!m_pAsyncTextureReadback)
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot Already Destructed");
+            }
+            if (frameIndex >= m_indexUserToRaw.size())
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", frameIndex);
+            }
+            // 転送完了を Future に繋ぐ
+            // @note: 転送済みならこの場で Future が完了する
+            {
+                _BindFuture(loop, future, m_pUnretainedTextureReadback, m_indexUserToRaw[frameIndex]);
+            }
+            return future;
+        }
+
+        //---------------------------------------------------------------------
+        double GetFrameTime(std::size_t frameIndex) const
+        {
+            if (frameIndex >= m_relativesInSec.size())
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", frameIndex);
+            }
+            return m_relativesInSec[frameIndex];
+        }
+
+        //---------------------------------------------------------------------
+        void Save(const std::string& path, bool compress) const
+        {
+            /* @note:
+                転送完了を待ちながら先頭から順に Append し、圧縮と書き込みは FrameArchiveWriter の BG スレッドに任せる。
+                Append には転送結果のバッファをそのまま渡すので、フレームのコピーは発生しない。
+                fps 指定で同じ生フレームが続く場合は、アーカイブ上でもペイロードを共有する。
+            */
+            py::gil_scoped_release gilRelease;
+
+            // エラーチェック
+            // @note: 書き出し中に Exit されても転送結果が消えないよう、shared_ptr をコピーしておく
+            const auto pAsyncTextureReadback = m_pAsyncTextureReadback;
+            if (!pAsyncTextureReadback && !m_indexUserToRaw.empty())
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot Already Destructed");
+            }
+            // 書き出し
+            ayc::FrameArchiveWriter writer(path, m_indexUserToRaw.size(), compress);
+            for (std::size_t i = 0; i < m_indexUserToRaw.size(); ++i)
+            {
+                const auto& result = (*pAsyncTextureReadback)[m_indexUserToRaw[i]];
+                writer.Append(m_relativesInSec[i], result.width, result.height, result.textureBuffer.GetSpan());
+            }
+            writer.Close();
+        }
+
+        //---------------------------------------------------------------------
+        void ExportGif(
+            const std::string& path,
+            std::optional<double> fps,
+            std::size_t maxColors,
+            const std::string& dither,
+            const std::string& palette,
+            bool optimize
+        ) const
+        {
+            /* @note:
+                グローバルパレットは全フレームを見てから作るので、転送完了を全て待ってから書き出す。
+                転送結果のバッファをそのまま渡すので、フレームのコピーは発生しない。
+            */
+            // パラメータを解決
+            const ayc::GIF_PARAM param{
+                maxColors,
+                _ParseGifDither(dither),
+                _ParseGifPalette(palette),
+                optimize
+            };
+            py::gil_scoped_release gilRelease;
+
+            // エラーチェック
+            // @note: 書き出し中に Exit されても転送結果が消えないよう、shared_ptr をコピーしておく
+            const auto pAsyncTextureReadback = m_pAsyncTextureReadback;
+            if (!pAsyncTextureReadback || m_indexUserToRaw.empty())
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot is empty or already destructed");
+            }
+            // フレームを集める
+            const auto delaysInCs = ayc::ResolveGifDelaysInCs(m_relativesInSec, fps);
+            std::vector<ayc::GIF_FRAME> frames;
+            frames.reserve(m_indexUserToRaw.size());
+            for (std::size_t i = 0; i < m_indexUserToRaw.size(); ++i)
+            {
+                const auto& result = (*pAsyncTextureReadback)[m_indexUserToRaw[i]];
+                frames.push_back(ayc::GIF_FRAME{ result.width, result.height, result.textureBuffer.GetSpan(), delaysInCs[i] });
+            }
+            // 書き出し
+            ayc::WriteGif(path, frames, param);
+        }
+
+        //---------------------------------------------------------------------
+        void ExportY4M(
+            const std::variant<int, std::string>& target,
+            std::optional<double> fps,
+            const std::string& matrix
+        ) const
+        {
+            /* @note:
+                転送完了を待ちながら先頭から順に Append する。
+                変換は呼び出し元スレッド、書き込みは Y4MWriter の I/O スレッドで行うので両者は重なる。
+            */
+            // パラメータを解決
+            // @note: fps 指定が無ければ、フレーム時刻の平均間隔から求める
+            const auto yuvMatrix = _ParseYuvMatrix(matrix);
+            double resolvedFps = 30.0;
+            if (fps)
+            {
+                resolvedFps = *fps;
+            }
+            else if (m_relativesInSec.size() >= 2)
+            {
+                const double durationInSec = std::abs(m_relativesInSec.front() - m_relativesInSec.back());
+                if (durationInSec > 0.0)
+                {
+                    resolvedFps = (m_relativesInSec.size() - 1) / durationInSec;
+                }
+            }
+            py::gil_scoped_release gilRelease;
+
+            // エラーチェック
+            // @note: 書き出し中に Exit されても転送結果が消えないよう、shared_ptr をコピーしておく
+            const auto pAsyncTextureReadback = m_pAsyncTextureReadback;
+            if (!pAsyncTextureReadback || m_indexUserToRaw.empty())
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot is empty or already destructed");
+            }
+            // 書き出し
+            auto pWriter = _CreateY4MWriter(target, resolvedFps, yuvMatrix);
+            for (std::size_t i = 0; i < m_indexUserToRaw.size(); ++i)
+            {
+                const auto& result = (*pAsyncTextureReadback)[m_indexUserToRaw[i]];
+                if (!pWriter->Append(result.width, result.height, result.textureBuffer.GetSpan()))
+                {
+                    throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Frame size changed in the snapshot", i);
+                }
+            }
+            pWriter->Close();
+        }
+
+        //---------------------------------------------------------------------
+        py::tuple ContactSheet(
+            std::size_t numColumns,
+            std::size_t thumbWidth,
+            std::optional<std::size_t> thumbHeight,
+            std::optional<std::vector<std::size_t>> indices,
+            std::optional<std::size_t> count
+        ) const
+        {
+            /* @note:
+                レビュー UI 向けに、全フレームを Python 側に読み出して縮小する代わりに、
+                選んだフレームをネイティブで縮小して１枚に並べ、サムネイル解像度のデータだけを返す。
+            */
+            // 並べるフレームを選ぶ
+            // @note: count 指定なら先頭から末尾まで等間隔に選ぶ
+            std::vector<std::size_t> selected;
+            if (indices && count)
+            {
+                throw MAKE_GENERAL_ERROR("Specify either indices or count, not both");
+            }
+            else if (indices)
+            {
+                selected = std::move(indices.value());
+            }
+            else if (count)
+            {
+                const std::size_t numFrames = m_indexUserToRaw.size();
+                const std::size_t numSelected = std::min(count.value(), numFrames);
+                for (std::size_t i = 0; i < numSelected; ++i)
+                {
+                    selected.push_back(numSelected > 1 ? i * (numFrames - 1) / (numSelected - 1) : 0);
+                }
+            }
+            else
+            {
+                selected.resize(m_indexUserToRaw.size());
+                std::iota(selected.begin(), selected.end(), std::size_t(0));
             }
-            // 非同期転送をスタート
+            // GIL Released
+            ayc::CONTACT_SHEET sheet;
             {
-                // 実際に使われる生フレームのインデックスを解決
-                /* @note:
-                    fps 指定がある場合、フレーム間引きされる可能性がある。
-                    転送フレーム数を最小化したいので、必要フレームだけ選択的に転送する。
-                */
-                std::vector<std::size_t> reqIndices = m_indexUserToRaw;
+                py::gil_scoped_release gilRelease;
+
+                // エラーチェック
+                // @note: 処理中に Exit されても転送結果が消えないよう、shared_ptr をコピーしておく
+                const auto pAsyncTextureReadback = m_pAsyncTextureReadback;
+                if (!pAsyncTextureReadback || selected.empty())
                 {
-                    std::sort(reqIndices.begin(), reqIndices.end());
-                    reqIndices.erase(
-                        std::unique(reqIndices.begin(), reqIndices.end()),
-                        reqIndices.end()
-                    );
+                    throw MAKE_GENERAL_ERROR("Snapshot is empty or already destructed");
                 }
-                // 転送をスタート
-                /* @note:
-                    隙間を詰めるとインデックスの辻褄合わせがクソだるいので、
-                    不要なフレームを nullptr でフィルすることで間引きを表現する。
-                */
+                // フレームを集める
+                std::vector<ayc::CONTACT_SHEET_FRAME> frames;
+                frames.reserve(selected.size());
+                for (const auto frameIndex : selected)
                 {
-                    std::vector<wgc::com_ptr<ID3D11Texture2D>> reqTextures(
-                        rawFrameBuffer.GetSize()
-                    );
-                    for (auto reqIndex : reqIndices)
+                    if (frameIndex >= m_indexUserToRaw.size())
                     {
-                        reqTextures[reqIndex] = rawFrameBuffer[reqIndex];
+                        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", frameIndex);
                     }
-                    m_pAsyncTextureReadback.reset(
-                        new AsyncTextureReadback(reqTextures)
-                    );
+                    const auto& result = (*pAsyncTextureReadback)[m_indexUserToRaw[frameIndex]];
+                    frames.push_back(ayc::CONTACT_SHEET_FRAME{ result.width, result.height, result.textureBuffer.GetSpan() });
                 }
+                // セルの高さを解決
+                // @note: 指定が無ければ最初のフレームの縦横比に合わせる
+                const auto& first = frames.front();
+                const std::size_t resolvedThumbHeight = thumbHeight.value_or(
+                    std::max<std::size_t>(
+                        static_cast<std::size_t>(std::lround(static_cast<double>(thumbWidth) * first.height / std::max<std::size_t>(first.width, 1))),
+                        1
+                    )
+                );
+                // 縮小して並べる
+                sheet = ayc::MakeContactSheet(frames, numColumns, thumbWidth, resolvedThumbHeight);
             }
+            // Python オブジェクトに固めて結果を返す
+            return py::make_tuple(
+                sheet.width,
+                sheet.height,
+                _ToBytes(sheet.frameBuffer, m_pMemoryTracker)
+            );
         }
 
         //---------------------------------------------------------------------
-        ~Snapshot() = default;
-
-        //---------------------------------------------------------------------
-        void Exit()
+        std::vector<std::tuple<std::size_t, double>> PruneNearDuplicates(
+            double threshold,
+            const std::string& metric
+        ) const
         {
             /* @note:
-                AsyncTextureReadback の解放時に非同期処理待機がある。
-                まぁまぁ待たされるかもなので GIL を解放。
+                fps 指定のスナップショットは最近傍で水増ししたフレームや静止シーンが続きやすいので、
+                ほぼ同一のフレームを統合して表示時間を延ばした一覧を返す。
+                転送結果のバッファをそのまま渡すので、フレームのコピーは発生しない。
             */
+            // パラメータを解決
+            const ayc::PRUNE_PARAM param{ threshold, _ParseFrameDiffMetric(metric) };
             py::gil_scoped_release gilRelease;
-            m_indexUserToRaw.clear();
-            m_pAsyncTextureReadback.reset();
+
+            // エラーチェック
+            // @note: 処理中に Exit されても転送結果が消えないよう、shared_ptr をコピーしておく
+            const auto pAsyncTextureReadback = m_pAsyncTextureReadback;
+            if (!pAsyncTextureReadback && !m_indexUserToRaw.empty())
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot Already Destructed");
+            }
+            // フレームを集める
+            std::vector<ayc::PRUNE_FRAME> frames;
+            frames.reserve(m_indexUserToRaw.size());
+            for (std::size_t i = 0; i < m_indexUserToRaw.size(); ++i)
+            {
+                const auto& result = (*pAsyncTextureReadback)[m_indexUserToRaw[i]];
+                frames.push_back(ayc::PRUNE_FRAME{ result.width, result.height, result.textureBuffer.GetSpan() });
+            }
+            // 統合
+            std::vector<std::tuple<std::size_t, double>> prunedFrames;
+            for (const auto& prunedFrame : ayc::PruneNearDuplicateFrames(frames, m_relativesInSec, param))
+            {
+                prunedFrames.emplace_back(prunedFrame.frameIndex, prunedFrame.durationInSec);
+            }
+            return prunedFrames;
+        }
+
+    private:
+        //---------------------------------------------------------------------
+        AsyncTextureReadback::RESULT _WaitFrame(std::size_t frameIndex) const
+        {
+            // @note: 非同期の転送処理の完了を待機しないとなので GIL を解放
+            py::gil_scoped_release gilRelease;
+
+            // エラーチェック
+            if (!m_pAsyncTextureReadback)
+            {
+                throw MAKE_GENERAL_ERROR("Snapshot Already Destructed");
+            }
+            if (frameIndex >= m_indexUserToRaw.size())
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", frameIndex);
+            }
+            // フレームを取得
+            // @note: 転送結果はアリーナを共有するだけなので、コピーしても画素はコピーされない
+            return (*m_pAsyncTextureReadback)[m_indexUserToRaw[frameIndex]];
+        }
+
+        std::vector<std::size_t> m_indexUserToRaw;
+        std::vector<double> m_relativesInSec;
+        std::shared_ptr<AsyncTextureReadback> m_pAsyncTextureReadback;         // 全ての転送を待つ参照（_RetainAllFrames）
+        std::shared_ptr<AsyncTextureReadback> m_pUnretainedTextureReadback;    // Future に渡す元の参照
+        std::shared_ptr<ayc::MemoryTracker> m_pMemoryTracker;
+    };
+
+    //-------------------------------------------------------------------------
+    // ArchiveSnapshot
+    //-------------------------------------------------------------------------
+
+    class ArchiveSnapshot
+    {
+    public:
+        //---------------------------------------------------------------------
+        ArchiveSnapshot(const std::string& path)
+        : m_pArchive()
+        {
+            py::gil_scoped_release gilRelease;
+            m_pArchive = std::make_shared<ayc::FrameArchive>(path);
+        }
+
+        //---------------------------------------------------------------------
+        ~ArchiveSnapshot() = default;
+
+        //---------------------------------------------------------------------
+        void Exit()
+        {
+            m_pArchive.reset();
         }
 
         //---------------------------------------------------------------------
         std::size_t GetSize() const
         {
-            return m_indexUserToRaw.size();
+            return m_pArchive ? m_pArchive->GetSize() : 0;
         }
 
         //---------------------------------------------------------------------
         py::tuple GetFrameBuffer(std::size_t frameIndex) const
         {
             // GIL Released
-            ayc::AsyncTextureReadback::RESULT result;
+            std::size_t width = 0;
+            std::size_t height = 0;
+            std::string frameBuffer;
             {
-                // @note: 非同期の転送処理の完了を待機しないとなので GIL を解放
+                // @note: 圧縮されていれば展開するので GIL を解放
                 py::gil_scoped_release gilRelease;
-
-                // エラーチェック
-                if (!m_pAsyncTextureReadback)
-                {
-                    throw MAKE_GENERAL_ERROR("Snapshot Already Destructed");
-                }
-                if (frameIndex >= m_indexUserToRaw.size())
-                {
-                    throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", frameIndex);
-                }
-                // フレームを取得
-                {
-                    result = (*m_pAsyncTextureReadback)[m_indexUserToRaw[frameIndex]];
-                }
+                _GetArchive().ReadFrame(width, height, frameBuffer, frameIndex);
             }
             // Python オブジェクトに固めて結果を返す
             return py::make_tuple(
-                result.width,
-                result.height,
-                py::bytes(result.textureBuffer)
+                width,
+                height,
+                _ToBytes(frameBuffer, ayc::MemoryTracker::Global())
             );
         }
 
+        //---------------------------------------------------------------------
+        double GetFrameTime(std::size_t frameIndex) const
+        {
+            return _GetArchive().GetEntry(frameIndex).relativeInSec;
+        }
+
     private:
-        std::vector<std::size_t> m_indexUserToRaw;
-        std::shared_ptr<AsyncTextureReadback> m_pAsyncTextureReadback;
+        //---------------------------------------------------------------------
+        const ayc::FrameArchive& _GetArchive() const
+        {
+            if (!m_pArchive)
+            {
+                throw MAKE_GENERAL_ERROR("Archive Snapshot Already Closed");
+            }
+            return *m_pArchive;
+        }
+
+        std::shared_ptr<ayc::FrameArchive> m_pArchive;
     };
 }
 
@@ -403,20 +1664,205 @@ PYBIND11_MODULE(_aynime_capture, m) {
         "Set log output handle (Windows HANDLE)."
     );
 
+    // capture threads
+    m.def(
+        "set_capture_thread_count",
+        &ayc::WGCSession::SetMaxCaptureThreads,
+        py::arg("count"),
+        "Set the maximum number of capture threads shared by all sessions.\n"
+        "Takes effect for sessions started afterwards."
+    );
+    m.def(
+        "get_capture_thread_loads",
+        &ayc::WGCSession::GetCaptureThreadLoads,
+        "Return the number of sessions assigned to each running capture thread."
+    );
+
+    // thread pool
+    m.def(
+        "configure_thread_pool",
+        &ayc::ThreadPool::Configure,
+        py::arg("num_workers") = py::none(),
+        py::arg("affinity_mask") = py::none(),
+        "Configure the worker thread pool shared by all native CPU stages.\n"
+        "Must be called before the pool starts, i.e. before the first capture readback.\n"
+        "num_workers defaults to the number of logical cores - 1 (at least 1).\n"
+        "affinity_mask pins every worker to the given cores (bit i = logical core i)."
+    );
+    m.def(
+        "get_thread_pool_stats",
+        []() {
+            const auto stats = ayc::ThreadPool::Instance().GetStats();
+            py::dict queued;
+            queued["interactive"] = stats.queuedTasks[static_cast<std::size_t>(ayc::TaskPriority::INTERACTIVE)];
+            queued["bulk"] = stats.queuedTasks[static_cast<std::size_t>(ayc::TaskPriority::BULK)];
+            py::dict result;
+            result["num_workers"] = stats.numWorkers;
+            result["queue_depths"] = stats.queueDepths;
+            result["queued"] = queued;
+            result["executed"] = stats.executedTasks;
+            result["steals"] = stats.stolenTasks;
+            return result;
+        },
+        "Return the worker thread pool statistics\n"
+        "as {num_workers, queue_depths, queued, executed, steals}.\n"
+        "queue_depths is the number of queued tasks per worker,\n"
+        "queued maps interactive / bulk to the number of queued tasks of that priority,\n"
+        "executed and steals are cumulative counts of run tasks and tasks taken from another worker's queue.\n"
+        "Starts the pool if it has not started yet."
+    );
+
+    // host arena
+    m.def(
+        "configure_host_arena",
+        [](std::optional<bool> largePages, std::optional<std::size_t> maxPooledBytes) {
+            ayc::HostArenaPool::Instance().Configure(largePages, maxPooledBytes);
+        },
+        py::arg("large_pages") = py::none(),
+        py::arg("max_pooled_bytes") = py::none(),
+        "Configure the arenas that hold snapshot readback results in host memory.\n"
+        "large_pages allocates new arenas with large pages when SeLockMemoryPrivilege is granted,\n"
+        "falling back to normal pages otherwise.\n"
+        "max_pooled_bytes caps the total size of released arenas kept for reuse.\n"
+        "Omitted arguments keep their current values."
+    );
+    m.def(
+        "get_host_arena_stats",
+        []() {
+            const auto stats = ayc::HostArenaPool::Instance().GetStats();
+            py::dict result;
+            result["pooled_arenas"] = stats.pooledArenas;
+            result["pooled_bytes"] = stats.pooledBytes;
+            result["created"] = stats.createdArenas;
+            result["reused"] = stats.reusedArenas;
+            result["large_page_arenas"] = stats.largePageArenas;
+            return result;
+        },
+        "Return the host arena pool statistics\n"
+        "as {pooled_arenas, pooled_bytes, created, reused, large_page_arenas}.\n"
+        "pooled_* describe released arenas kept for reuse,\n"
+        "the others are cumulative counts of arenas created, reused and allocated with large pages."
+    );
+    py::class_<ayc::HostBuffer>(m, "HostBuffer", py::module_local(), py::buffer_protocol())
+        .def_buffer(
+            [](ayc::HostBuffer& buffer) {
+                return py::buffer_info(
+                    buffer.GetData(),
+                    static_cast<py::ssize_t>(buffer.GetSize()),
+                    /*readonly=*/true
+                );
+            }
+        );
+
+    // memory budget
+    m.def(
+        "set_memory_budget",
+        [](std::optional<std::int64_t> budgetInBytes) {
+            ayc::MemoryArbiter::Instance().SetBudget(budgetInBytes);
+        },
+        py::arg("budget_in_bytes"),
+        "Set the total frame buffer memory budget shared by all sessions.\n"
+        "When exceeded, frames of lower-weight sessions are evicted first.\n"
+        "Pass None to remove the budget."
+    );
+    m.def(
+        "get_memory_usage",
+        []() {
+            auto& arbiter = ayc::MemoryArbiter::Instance();
+            py::list sessions;
+            for (const auto& pAccount : arbiter.GetAccounts())
+            {
+                sessions.append(_MemoryAccountToDict(*pAccount));
+            }
+            py::dict result;
+            result["budget"] = arbiter.GetBudget();
+            result["total"] = arbiter.GetTotalBytes();
+            result["sessions"] = sessions;
+            result["categories"] = _MemoryTrackerToDict(*ayc::MemoryTracker::Global());
+            return result;
+        },
+        "Return the frame buffer memory usage of all sessions\n"
+        "as {budget, total, sessions, categories}.\n"
+        "categories maps frame_texture / staging_texture / readback_buffer / python_bytes\n"
+        "to {current_bytes, peak_bytes, allocations, releases, total_bytes} summed over the process.\n"
+        "python_bytes only counts allocations, as the bytes objects are freed by Python."
+    );
+
     // Session
     py::class_<ayc::Session>(m, "Session", py::module_local())
         .def(
-            py::init<uintptr_t, double, std::optional<std::size_t>, std::optional<std::size_t>>(),
+            py::init<
+                uintptr_t, double, std::optional<std::size_t>, std::optional<std::size_t>, double, double, bool, std::optional<double>,
+                std::optional<std::string>, double, std::uint64_t, std::uint64_t, std::optional<double>, const std::string&
+            >(),
             py::arg("hwnd"),
             py::arg("duration_in_sec"),
             py::arg("max_width") = py::none(),
             py::arg("max_height") = py::none(),
+            py::arg("weight") = 1.0,
+            py::arg("min_duration_in_sec") = 0.0,
+            py::arg("deduplicate") = false,
+            py::arg("hot_duration_in_sec") = py::none(),
+            py::arg("spill_dir") = py::none(),
+            py::arg("spill_after_in_sec") = 60.0,
+            py::arg("spill_budget_in_bytes") = std::uint64_t(4) << 30,
+            py::arg("spill_segment_size_in_bytes") = std::uint64_t(256) << 20,
+            py::arg("scene_cut_threshold") = py::none(),
+            py::arg("frame_format") = "bgra",
             "Create a capture session for the specified window.\n\n"
             "Args:\n"
             "    hwnd: Target window handle (HWND cast to int).\n"
             "    duration_in_sec: Seconds to keep frames in the buffer."
             "    max_width: Optional maximum capture width in pixels.\n"
-            "    max_height: Optional maximum capture height in pixels."
+            "    max_height: Optional maximum capture height in pixels.\n"
+            "    weight: Priority under the memory budget (higher keeps frames longer).\n"
+            "    min_duration_in_sec: Seconds of frames never evicted by the memory budget.\n"
+            "    deduplicate: Share the texture of frames identical to their predecessor.\n"
+            "    hot_duration_in_sec: Seconds to keep frames as GPU textures. Older frames are\n"
+            "        compressed into host memory in the background. None keeps all frames on GPU.\n"
+            "    spill_dir: Directory for temporary segment files. Compressed frames older than\n"
+            "        spill_after_in_sec are moved there in the background. Requires hot_duration_in_sec.\n"
+            "    spill_after_in_sec: Age in seconds at which compressed frames are spilled to disk.\n"
+            "    spill_budget_in_bytes: Total size limit of segment files. The oldest segment is\n"
+            "        discarded together with its frames when exceeded.\n"
+            "    spill_segment_size_in_bytes: Size of one segment file.\n"
+            "    scene_cut_threshold: Score (0-1) above which a frame starts a new scene.\n"
+            "        Enables GetSceneCuts. Around 0.25 suits typical footage. None disables detection.\n"
+            "    frame_format: Texture format of buffered frames. 'bgra' (4 bytes/pixel) or\n"
+            "        'nv12' (1.5 bytes/pixel, BT.709 full range). NV12 is converted once on arrival\n"
+            "        and back to BGR on readback, at the cost of chroma subsampling."
+        )
+        .def_static(
+            "Replay",
+            &ayc::Session::Replay,
+            py::arg("path"),
+            py::arg("duration_in_sec"),
+            py::arg("realtime") = true,
+            py::arg("loop") = false,
+            py::arg("speed") = 1.0,
+            py::arg("max_width") = py::none(),
+            py::arg("max_height") = py::none(),
+            py::arg("weight") = 1.0,
+            py::arg("min_duration_in_sec") = 0.0,
+            py::arg("deduplicate") = false,
+            py::arg("hot_duration_in_sec") = py::none(),
+            py::arg("spill_dir") = py::none(),
+            py::arg("spill_after_in_sec") = 60.0,
+            py::arg("spill_budget_in_bytes") = std::uint64_t(4) << 30,
+            py::arg("spill_segment_size_in_bytes") = std::uint64_t(256) << 20,
+            py::arg("scene_cut_threshold") = py::none(),
+            py::arg("frame_format") = "bgra",
+            "Create a session that replays an archive written by Snapshot.Save\n"
+            "instead of capturing a window. Frames go through the same buffer\n"
+            "as captured ones, so every Session API works unchanged.\n\n"
+            "Args:\n"
+            "    path: Archive file path.\n"
+            "    duration_in_sec: Seconds to keep frames in the buffer.\n"
+            "    realtime: Feed frames at their recorded intervals. If False, feed them\n"
+            "        as fast as possible on a virtual clock that follows the frame timestamps.\n"
+            "    loop: Restart from the first frame after the last one.\n"
+            "    speed: Playback speed multiplier.\n"
+            "    Other arguments are the same as the constructor."
         )
         .def(
             "Close",
@@ -430,6 +1876,208 @@ PYBIND11_MODULE(_aynime_capture, m) {
             "Return (width, height, frame_buffer) of the frame whose timestamp\n"
             "is closest to time_in_sec seconds before the latest frame.\n"
             "If frames buffer is empty, this function returns (None, None, None)."
+        )
+        .def(
+            "GetFrameByTimeAsync",
+            &ayc::Session::GetFrameByTimeAsync,
+            py::arg("time_in_sec"),
+            "Awaitable version of GetFrameByTime for asyncio.\n"
+            "Return an asyncio.Future completed from the readback thread.\n"
+            "Cancelling the future also cancels the pending readback."
+        )
+        .def(
+            "WaitForNewFrame",
+            &ayc::Session::WaitForNewFrame,
+            py::arg("timeout_in_sec") = py::none(),
+            py::arg("after_seq") = py::none(),
+            "Block until a frame newer than after_seq arrives, and return\n"
+            "(seq, timestamp_in_sec, width, height, frame_buffer) of the latest frame.\n"
+            "If after_seq is None, wait for a frame newer than the latest one at call time.\n"
+            "If timeout_in_sec elapses, this function returns (None, None, None, None, None)."
+        )
+        .def(
+            "Subscribe",
+            &ayc::Session::Subscribe,
+            py::arg("callback"),
+            py::arg("max_pending") = 4,
+            py::arg("overflow") = "drop_oldest",
+            "Start delivering every new frame to callback on a background thread.\n\n"
+            "Args:\n"
+            "    callback: Called as callback(seq, timestamp_in_sec, width, height, frame_buffer).\n"
+            "        queue.Queue.put can be passed to receive frames through a queue.\n"
+            "    max_pending: Maximum number of frames waiting for delivery.\n"
+            "    overflow: 'drop_oldest', 'drop_newest' or 'block'."
+        )
+        .def(
+            "PublishSharedRing",
+            &ayc::Session::PublishSharedRing,
+            py::arg("name"),
+            py::arg("num_slots") = 4,
+            py::arg("slot_size_in_bytes") = 3840 * 2160 * 3,
+            "Start publishing every new frame into a named shared-memory ring\n"
+            "that other processes can attach to with aynime_capture.shared_ring.\n\n"
+            "Args:\n"
+            "    name: Name of the shared memory (file mapping object).\n"
+            "    num_slots: Number of frames held by the ring.\n"
+            "    slot_size_in_bytes: Capacity of each slot. Larger frames are skipped."
+        )
+        .def(
+            "StreamY4M",
+            &ayc::Session::StreamY4M,
+            py::arg("target"),
+            py::arg("fps"),
+            py::arg("matrix") = "bt709",
+            py::arg("max_pending") = 8,
+            py::arg("overflow") = "drop_oldest",
+            "Start streaming every new frame as YUV4MPEG2 (4:2:0, limited range).\n"
+            "The frame size is fixed by the first frame; frames of other sizes are skipped.\n\n"
+            "Args:\n"
+            "    target: Output file path, or a file descriptor such as a pipe to ffmpeg's stdin.\n"
+            "    fps: Frame rate written to the header.\n"
+            "    matrix: 'bt601' or 'bt709'.\n"
+            "    max_pending: Maximum number of frames waiting for conversion.\n"
+            "    overflow: 'drop_oldest', 'drop_newest' or 'block'."
+        )
+        .def_property_readonly(
+            "memory_usage",
+            &ayc::Session::GetMemoryUsage,
+            "Frame buffer memory usage of this session\n"
+            "(hwnd, weight, min_duration_in_sec, bytes, floor_bytes, limit_bytes, categories).\n"
+            "categories has the same form as in get_memory_usage, for this session only."
+        )
+        .def_property_readonly(
+            "dedup_stats",
+            &ayc::Session::GetDedupStats,
+            "Duplicate-frame elimination statistics\n"
+            "(deduplicated_frames, saved_bytes, held_duplicates, held_saved_bytes)."
+        )
+        .def(
+            "GetSceneCuts",
+            &ayc::Session::GetSceneCuts,
+            py::arg("duration_in_sec") = py::none(),
+            "Return the scene cuts detected within the last duration_in_sec seconds\n"
+            "as a list of (relative_in_sec, score), oldest first.\n"
+            "relative_in_sec is the time of the first frame of the new scene, usable with\n"
+            "GetFrameByTime. The index is updated as frames arrive, so this is O(log n).\n"
+            "Requires scene_cut_threshold.\n\n"
+            "Args:\n"
+            "    duration_in_sec: Seconds to look back. None covers the whole buffer."
+        )
+        .def_property_readonly(
+            "tier_stats",
+            &ayc::Session::GetTierStats,
+            "Hot (GPU texture) / cold (compressed host memory) / spilled (disk) tier statistics\n"
+            "(hot_frames, cold_frames, hot_bytes, cold_bytes, cold_raw_bytes, cold_saved_bytes,\n"
+            " cold_tiles, cold_stored_tiles, compression_ratio,\n"
+            " spilled_frames, spilled_bytes, spill_disk_bytes)."
+        )
+        .def_property_readonly(
+            "replay_finished",
+            &ayc::Session::IsReplayFinished,
+            "True once a replay session has fed its last frame (never for loop=True).\n"
+            "Always False for capture sessions."
+        );
+
+    // Subscription
+    py::class_<ayc::Subscription>(m, "Subscription", py::module_local())
+        .def(
+            "__enter__",
+            [](ayc::Subscription& self) -> ayc::Subscription* { return &self; },
+            py::return_value_policy::reference_internal
+        )
+        .def(
+            "__exit__",
+            [](ayc::Subscription& subscription,
+                py::object, py::object, py::object) {
+                    subscription.Close();
+                    return false;
+            }
+        )
+        .def(
+            "Close",
+            &ayc::Subscription::Close,
+            "Stop delivering frames."
+        )
+        .def_property_readonly(
+            "stats",
+            &ayc::Subscription::GetStats,
+            "Delivery statistics (delivered, dropped, pending, latest_lag_in_sec, max_lag_in_sec)."
+        );
+
+    // SharedFramePublisher
+    py::class_<ayc::SharedFramePublisher>(m, "SharedRingPublisher", py::module_local())
+        .def(
+            "__enter__",
+            [](ayc::SharedFramePublisher& self) -> ayc::SharedFramePublisher* { return &self; },
+            py::return_value_policy::reference_internal
+        )
+        .def(
+            "__exit__",
+            [](ayc::SharedFramePublisher& publisher,
+                py::object, py::object, py::object) {
+                    py::gil_scoped_release gilRelease;
+                    publisher.Close();
+                    return false;
+            }
+        )
+        .def(
+            "Close",
+            &ayc::SharedFramePublisher::Close,
+            py::call_guard<py::gil_scoped_release>(),
+            "Stop publishing frames. Readers keep the shared memory alive while attached."
+        )
+        .def_property_readonly(
+            "name",
+            &ayc::SharedFramePublisher::GetName,
+            "Name of the shared memory."
+        )
+        .def_property_readonly(
+            "stats",
+            [](const ayc::SharedFramePublisher& publisher) {
+                const auto stats = publisher.GetStats();
+                py::dict result;
+                result["published"] = stats.published;
+                result["oversized"] = stats.oversized;
+                result["dropped"] = stats.dropped;
+                return result;
+            },
+            "Publishing statistics (published, oversized, dropped)."
+        );
+
+    // Y4MFramePublisher
+    py::class_<ayc::Y4MFramePublisher>(m, "Y4MStream", py::module_local())
+        .def(
+            "__enter__",
+            [](ayc::Y4MFramePublisher& self) -> ayc::Y4MFramePublisher* { return &self; },
+            py::return_value_policy::reference_internal
+        )
+        .def(
+            "__exit__",
+            [](ayc::Y4MFramePublisher& publisher,
+                py::object, py::object, py::object) {
+                    py::gil_scoped_release gilRelease;
+                    publisher.Close();
+                    return false;
+            }
+        )
+        .def(
+            "Close",
+            &ayc::Y4MFramePublisher::Close,
+            py::call_guard<py::gil_scoped_release>(),
+            "Stop streaming and flush the remaining frames. A file descriptor target is left open."
+        )
+        .def_property_readonly(
+            "stats",
+            [](const ayc::Y4MFramePublisher& publisher) {
+                const auto stats = publisher.GetStats();
+                py::dict result;
+                result["written"] = stats.written;
+                result["mismatched"] = stats.mismatched;
+                result["dropped"] = stats.dropped;
+                result["failed"] = stats.isFailed;
+                return result;
+            },
+            "Streaming statistics (written, mismatched, dropped, failed)."
         );
 
     // Snapshot
@@ -469,5 +2117,142 @@ PYBIND11_MODULE(_aynime_capture, m) {
             &ayc::Snapshot::GetFrameBuffer,
             py::arg("frame_index"),
             "Return (width, height, frame_buffer) for the given index."
+        )
+        .def(
+            "GetFrameView",
+            &ayc::Snapshot::GetFrameView,
+            py::arg("frame_index"),
+            "Return (width, height, frame_view) for the given index without copying.\n"
+            "frame_view is a read-only memoryview of the snapshot's host arena,\n"
+            "which stays valid after the snapshot exits until the view is released."
+        )
+        .def(
+            "GetFrameAsync",
+            &ayc::Snapshot::GetFrameBufferAsync,
+            py::arg("frame_index"),
+            "Awaitable version of GetFrame for asyncio.\n"
+            "Return an asyncio.Future completed from the readback thread.\n"
+            "Cancelling the future does not affect GetFrame on the same frame.\n"
+            "After the snapshot is closed, pending readbacks with no remaining futures are skipped."
+        )
+        .def(
+            "GetFrameTime",
+            &ayc::Snapshot::GetFrameTime,
+            py::arg("frame_index"),
+            "Return the seconds before the latest frame for the given index."
+        )
+        .def(
+            "Save",
+            &ayc::Snapshot::Save,
+            py::arg("path"),
+            py::arg("compress") = false,
+            "Write all frames to a seekable frame archive file.\n"
+            "Frames are compressed and written on background threads while readback proceeds.\n"
+            "The file can be opened with ArchiveSnapshot."
+        )
+        .def(
+            "ExportGif",
+            &ayc::Snapshot::ExportGif,
+            py::arg("path"),
+            py::arg("fps") = py::none(),
+            py::arg("max_colors") = 256,
+            py::arg("dither") = "ordered",
+            py::arg("palette") = "global",
+            py::arg("optimize") = true,
+            "Write all frames as a looping animated GIF.\n"
+            "Palette generation, dithering and LZW encoding run in parallel per frame.\n\n"
+            "Args:\n"
+            "    path: Output file path.\n"
+            "    fps: Playback frame rate. None uses the frame timestamps.\n"
+            "    max_colors: Palette size (2-256). One entry is reserved for transparency when optimize is True.\n"
+            "    dither: 'none', 'ordered' or 'floyd_steinberg'.\n"
+            "    palette: 'global' (one palette for all frames) or 'local' (one per frame).\n"
+            "    optimize: Store only the changed rectangle of each frame, with unchanged pixels transparent.\n"
+            "        Frames identical to their predecessor are merged into it."
+        )
+        .def(
+            "ExportY4M",
+            &ayc::Snapshot::ExportY4M,
+            py::arg("target"),
+            py::arg("fps") = py::none(),
+            py::arg("matrix") = "bt709",
+            "Write all frames as a YUV4MPEG2 (4:2:0, limited range) stream.\n"
+            "Colour conversion overlaps with writing on a background I/O thread.\n\n"
+            "Args:\n"
+            "    target: Output file path, or a file descriptor such as a pipe to ffmpeg's stdin.\n"
+            "    fps: Frame rate written to the header. None estimates it from the frame timestamps.\n"
+            "    matrix: 'bt601' or 'bt709'."
+        )
+        .def(
+            "ContactSheet",
+            &ayc::Snapshot::ContactSheet,
+            py::arg("columns"),
+            py::arg("thumb_width"),
+            py::arg("thumb_height") = py::none(),
+            py::arg("indices") = py::none(),
+            py::arg("count") = py::none(),
+            "Downsample the selected frames in parallel and tile them into one image.\n"
+            "Only the contact sheet itself is returned to Python.\n\n"
+            "Args:\n"
+            "    columns: Number of thumbnails per row.\n"
+            "    thumb_width: Width of each cell in pixels.\n"
+            "    thumb_height: Height of each cell. None follows the aspect ratio of the first frame.\n"
+            "    indices: Frame indices to include, in order.\n"
+            "    count: Number of frames picked at even intervals. Mutually exclusive with indices.\n"
+            "        If neither is given, every frame is included.\n\n"
+            "Returns:\n"
+            "    (width, height, frame_buffer) in BGR24, like GetFrame."
+        )
+        .def(
+            "PruneNearDuplicates",
+            &ayc::Snapshot::PruneNearDuplicates,
+            py::arg("threshold") = 0.01,
+            py::arg("metric") = "sad",
+            "Merge runs of nearly identical frames and return the remaining frames\n"
+            "as a list of (frame_index, duration_in_sec).\n"
+            "Frames are compared on a downsampled luma image against the first frame of each run,\n"
+            "so slow fades are not collapsed into a single frame.\n\n"
+            "Args:\n"
+            "    threshold: Maximum difference (0-1) for merging. 0 merges identical frames only.\n"
+            "    metric: 'sad' (mean absolute difference) or 'ssim' (1 - mean 8x8 block SSIM)."
+        );
+
+    // ArchiveSnapshot
+    py::class_<ayc::ArchiveSnapshot>(m, "ArchiveSnapshot", py::module_local())
+        .def(
+            py::init<std::string>(),
+            py::arg("path"),
+            "Open a frame archive written by Snapshot.Save.\n"
+            "The file is memory-mapped and frames are accessed in O(1) by index."
+        )
+        .def(
+            "__enter__",
+            [](ayc::ArchiveSnapshot& self) -> ayc::ArchiveSnapshot* { return &self; },
+            py::return_value_policy::reference_internal
+        )
+        .def(
+            "__exit__",
+            [](ayc::ArchiveSnapshot& snapshot,
+                py::object, py::object, py::object) {
+                    snapshot.Exit();
+                    return false;
+            }
+        )
+        .def_property_readonly(
+            "size",
+            &ayc::ArchiveSnapshot::GetSize,
+            "Number of frames in this archive."
+        )
+        .def(
+            "GetFrame",
+            &ayc::ArchiveSnapshot::GetFrameBuffer,
+            py::arg("frame_index"),
+            "Return (width, height, frame_buffer) for the given index."
+        )
+        .def(
+            "GetFrameTime",
+            &ayc::ArchiveSnapshot::GetFrameTime,
+            py::arg("frame_index"),
+            "Return the seconds before the latest frame for the given index."
         );
 }
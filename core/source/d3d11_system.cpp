@@ -10,6 +10,7 @@
 
 // other
 #include "utils.h"
+#include "staging_texture_ring.h"
 
 //-----------------------------------------------------------------------------
 // Link-Local Variables
@@ -83,6 +84,9 @@ void ayc::d3d11::Initialize()
 // 後始末
 void ayc::d3d11::Finalize()
 {
+    // 取っておいたステージングテクスチャを、デバイスより先に解放
+    StagingTextureRing::Instance().Clear();
+
     // 各インスタンスを解放
     s_d3dContext = nullptr;
     s_d3dDevice = nullptr;
@@ -0,0 +1,632 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "frame_archive.h"
+
+// other
+#include "lz_codec.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 書き出し待ちにできるフレームの最大枚数
+    // @note: 書き出しが追いつかない場合は Append で待たせる
+    const std::size_t FRAME_ARCHIVE_MAX_IN_FLIGHT = 16;
+
+    // WriteFile １回で書き込む最大バイト数
+    const std::uint64_t FRAME_ARCHIVE_WRITE_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // アライメント境界まで切り上げる
+    std::uint64_t _AlignUp(std::uint64_t value, std::uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // ファイルの書き込み位置を移動する
+    void _SeekTo(HANDLE hFile, std::uint64_t offsetInBytes)
+    {
+        LARGE_INTEGER distance{};
+        distance.QuadPart = static_cast<LONGLONG>(offsetInBytes);
+        if (!SetFilePointerEx(hFile, distance, nullptr, FILE_BEGIN))
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("SetFilePointerEx failed", HRESULT_FROM_WIN32(GetLastError()));
+        }
+    }
+
+    // 全バイトを書き込む
+    void _WriteAll(HANDLE hFile, const void* pData, std::uint64_t sizeInBytes)
+    {
+        auto pBytes = static_cast<const std::uint8_t*>(pData);
+        while (sizeInBytes > 0)
+        {
+            const auto chunkSize = static_cast<DWORD>(std::min(sizeInBytes, FRAME_ARCHIVE_WRITE_CHUNK_SIZE));
+            DWORD numWritten = 0;
+            if (!WriteFile(hFile, pBytes, chunkSize, &numWritten, nullptr))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("WriteFile failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+            if (numWritten == 0)
+            {
+                throw MAKE_GENERAL_ERROR("WriteFile wrote nothing");
+            }
+            pBytes += numWritten;
+            sizeInBytes -= numWritten;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// FrameArchiveWriter
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::FrameArchiveWriter::FrameArchiveWriter(
+    const std::string& path,
+    std::size_t numFrames,
+    bool isCompressed
+)
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_numFrames(numFrames)
+    , m_isCompressed(isCompressed)
+    , m_dataOffsetInBytes(0)
+    , m_writeOffsetInBytes(0)
+    , m_entries(numFrames)
+    , m_pLastFrameData(nullptr)
+    , m_guard()
+    , m_cv()
+    , m_writeQueue()
+    , m_numAppended(0)
+    , m_numInFlight(0)
+    , m_numCompressing(0)
+    , m_isFinishing(false)
+    , m_pError()
+    , m_writeThread()
+{
+    // パラメータチェック
+    if (path.empty())
+    {
+        throw MAKE_GENERAL_ERROR("path must not be empty");
+    }
+    if (numFrames > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("numFrames is too large", numFrames);
+    }
+    // レイアウトを解決
+    // @note: ヘッダとインデックスの領域は空けておき、Close で書き込む
+    {
+        const std::uint64_t indexEndInBytes = sizeof(FRAME_ARCHIVE_HEADER) + sizeof(FRAME_ARCHIVE_ENTRY) * numFrames;
+        m_dataOffsetInBytes = _AlignUp(indexEndInBytes, FRAME_ARCHIVE_PAYLOAD_ALIGNMENT);
+        m_writeOffsetInBytes = m_dataOffsetInBytes;
+    }
+    // ファイルを作成
+    {
+        m_hFile = CreateFileA(
+            path.c_str(),
+            GENERIC_WRITE,
+            0,
+            nullptr,
+            CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+            nullptr
+        );
+        if (m_hFile == INVALID_HANDLE_VALUE)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFile failed", HRESULT_FROM_WIN32(GetLastError()));
+        }
+    }
+    // スレッド起動
+    /* @note:
+        圧縮は Append のたびに ThreadPool に積むので、ここで起こすのは I/O スレッドだけ。
+        圧縮しない場合でも、Append の呼び出し元（転送完了待ち）と書き込みは並行に進む。
+    */
+    {
+        m_writeThread = std::thread(std::bind(&FrameArchiveWriter::_WriteThreadHandler, this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameArchiveWriter::~FrameArchiveWriter()
+{
+    _StopThreads();
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::Append(
+    double relativeInSec,
+    std::size_t width,
+    std::size_t height,
+    std::span<const std::uint8_t> frameBuffer
+)
+{
+    // パラメータチェック
+    if (frameBuffer.size() != width * height * BYTES_PER_PIXEL)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Frame buffer size mismatch", frameBuffer.size());
+    }
+    // 書き出し待ちに空きができるまで待つ
+    std::unique_lock<std::mutex> lock(m_guard);
+    m_cv.wait(lock, [&]() { return m_pError || m_numInFlight < FRAME_ARCHIVE_MAX_IN_FLIGHT; });
+    _RethrowError();
+    if (m_isFinishing)
+    {
+        throw MAKE_GENERAL_ERROR("Frame Archive Already Closed");
+    }
+    if (m_numAppended >= m_numFrames)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Too many frames appended", m_numFrames);
+    }
+    // 積む
+    // @note: 直前と同じバッファならペイロードを共有するので、圧縮せずに書き出しへ回す
+    _JOB job{
+        m_numAppended,
+        relativeInSec,
+        width,
+        height,
+        frameBuffer,
+        frameBuffer.data() == m_pLastFrameData,
+        FrameArchiveCompression::NONE,
+        std::string()
+    };
+    m_pLastFrameData = frameBuffer.data();
+    m_numAppended += 1;
+    m_numInFlight += 1;
+    if (!m_isCompressed || job.isDuplicate)
+    {
+        m_writeQueue.emplace(job.index, std::move(job));
+        lock.unlock();
+        m_cv.notify_all();
+        return;
+    }
+    // 圧縮を積む
+    /* @note:
+        ワーカーがいないプールはその場で実行するので、ロックを手放してから積む。
+        完了は m_numCompressing で待つので、future は捨ててよい。
+    */
+    m_numCompressing += 1;
+    lock.unlock();
+    try
+    {
+        ThreadPool::Instance().Submit(
+            [this, job = std::move(job)]() mutable { _CompressJob(std::move(job)); }
+        );
+    }
+    catch (...)
+    {
+        {
+            std::scoped_lock<std::mutex> errorLock(m_guard);
+            m_numCompressing -= 1;
+            if (!m_pError)
+            {
+                m_pError = std::current_exception();
+            }
+        }
+        m_cv.notify_all();
+        throw;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::Close()
+{
+    // 二重クローズは無視
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    // 残りを書き出す
+    {
+        _StopThreads();
+    }
+    // BG スレッドのエラーを再送
+    {
+        std::scoped_lock<std::mutex> lock(m_guard);
+        _RethrowError();
+    }
+    // インデックスを書き込む
+    // @note: Append されなかった分のエントリは書き込まない
+    {
+        _SeekTo(m_hFile, sizeof(FRAME_ARCHIVE_HEADER));
+        _WriteAll(m_hFile, m_entries.data(), sizeof(FRAME_ARCHIVE_ENTRY) * m_numAppended);
+    }
+    // ヘッダを書き込む
+    // @note: 最後に書き込むことで、書きかけのファイルを読み手が弾けるようにする
+    {
+        FRAME_ARCHIVE_HEADER header{};
+        header.magic = FRAME_ARCHIVE_MAGIC;
+        header.version = FRAME_ARCHIVE_VERSION;
+        header.numFrames = static_cast<std::uint32_t>(m_numAppended);
+        header.entrySizeInBytes = static_cast<std::uint32_t>(sizeof(FRAME_ARCHIVE_ENTRY));
+        header.indexOffsetInBytes = sizeof(FRAME_ARCHIVE_HEADER);
+        header.dataOffsetInBytes = m_dataOffsetInBytes;
+        header.fileSizeInBytes = sizeof(FRAME_ARCHIVE_HEADER) + sizeof(FRAME_ARCHIVE_ENTRY) * m_numAppended;
+        for (std::size_t i = 0; i < m_numAppended; ++i)
+        {
+            const auto& entry = m_entries[i];
+            header.fileSizeInBytes = std::max(header.fileSizeInBytes, entry.payloadOffsetInBytes + entry.payloadSizeInBytes);
+        }
+        _SeekTo(m_hFile, 0);
+        _WriteAll(m_hFile, &header, sizeof(header));
+    }
+    // 閉じる
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::_CompressJob(_JOB job)
+{
+    // 他でエラーが起きていれば圧縮しない
+    bool isSkipped = false;
+    {
+        std::scoped_lock<std::mutex> lock(m_guard);
+        isSkipped = (m_pError != nullptr);
+    }
+    // 圧縮
+    // @note: 縮まなかったフレームはそのまま書き出す
+    std::exception_ptr pError = nullptr;
+    if (!isSkipped)
+    {
+        try
+        {
+            CompressLZ(job.compressed, job.frameBuffer.data(), job.frameBuffer.size());
+            if (job.compressed.size() < job.frameBuffer.size())
+            {
+                job.compression = FrameArchiveCompression::LZ;
+            }
+            else
+            {
+                job.compressed = std::string();
+            }
+        }
+        catch (...)
+        {
+            pError = std::current_exception();
+        }
+    }
+    // 書き出しに回す
+    {
+        std::scoped_lock<std::mutex> lock(m_guard);
+        if (pError && !m_pError)
+        {
+            m_pError = pError;
+        }
+        if (!isSkipped && !pError)
+        {
+            m_writeQueue.emplace(job.index, std::move(job));
+        }
+        m_numCompressing -= 1;
+    }
+    m_cv.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::_WriteThreadHandler()
+{
+    // @note: 圧縮の完了順はばらばらなので、インデックス順に並べ直して書き出す
+    std::size_t nextIndex = 0;
+    for (;;)
+    {
+        // 次のフレームを待つ
+        _JOB job;
+        {
+            std::unique_lock<std::mutex> lock(m_guard);
+            m_cv.wait(
+                lock,
+                [&]()
+                {
+                    return (
+                        m_pError ||
+                        m_writeQueue.contains(nextIndex) ||
+                        (m_isFinishing && nextIndex == m_numAppended)
+                    );
+                }
+            );
+            const auto iter = m_writeQueue.find(nextIndex);
+            if (m_pError || iter == m_writeQueue.end())
+            {
+                break;
+            }
+            job = std::move(iter->second);
+            m_writeQueue.erase(iter);
+        }
+        // 書き出し
+        try
+        {
+            _WriteJob(job);
+        }
+        catch (...)
+        {
+            std::scoped_lock<std::mutex> lock(m_guard);
+            if (!m_pError)
+            {
+                m_pError = std::current_exception();
+            }
+            m_cv.notify_all();
+            break;
+        }
+        // 空きができたことを通知
+        {
+            std::scoped_lock<std::mutex> lock(m_guard);
+            m_numInFlight -= 1;
+        }
+        m_cv.notify_all();
+        nextIndex += 1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::_WriteJob(const _JOB& job)
+{
+    // @note: m_entries と書き込み位置は I/O スレッドだけが触る
+    auto& entry = m_entries[job.index];
+
+    // 直前と同じフレームならペイロードを共有
+    if (job.isDuplicate && job.index > 0)
+    {
+        entry = m_entries[job.index - 1];
+        entry.relativeInSec = job.relativeInSec;
+        return;
+    }
+    // エントリを埋める
+    const auto payload = (
+        job.compression == FrameArchiveCompression::LZ ?
+        std::span<const std::uint8_t>(reinterpret_cast<const std::uint8_t*>(job.compressed.data()), job.compressed.size()) :
+        job.frameBuffer
+    );
+    {
+        entry = FRAME_ARCHIVE_ENTRY{};
+        entry.relativeInSec = job.relativeInSec;
+        entry.width = static_cast<std::uint32_t>(job.width);
+        entry.height = static_cast<std::uint32_t>(job.height);
+        entry.stride = static_cast<std::uint32_t>(job.width * BYTES_PER_PIXEL);
+        entry.format = static_cast<std::uint32_t>(FrameArchiveFormat::BGR24);
+        entry.compression = static_cast<std::uint32_t>(job.compression);
+        entry.payloadOffsetInBytes = m_writeOffsetInBytes;
+        entry.payloadSizeInBytes = payload.size();
+        entry.rawSizeInBytes = job.frameBuffer.size();
+    }
+    // 書き込み
+    // @note: パディングは書き込まずにシークで飛ばす
+    {
+        _SeekTo(m_hFile, m_writeOffsetInBytes);
+        _WriteAll(m_hFile, payload.data(), payload.size());
+        m_writeOffsetInBytes = _AlignUp(m_writeOffsetInBytes + payload.size(), FRAME_ARCHIVE_PAYLOAD_ALIGNMENT);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::_StopThreads()
+{
+    // @note: スレッドは積まれた分を書き出し終えてから終了する
+    {
+        std::scoped_lock<std::mutex> lock(m_guard);
+        m_isFinishing = true;
+    }
+    m_cv.notify_all();
+    // 積んだ圧縮が終わるのを待つ
+    // @note: 圧縮は this を参照するので、エラーで打ち切った場合も待つ
+    {
+        std::unique_lock<std::mutex> lock(m_guard);
+        m_cv.wait(lock, [&]() { return m_numCompressing == 0; });
+    }
+    if (m_writeThread.joinable())
+    {
+        m_writeThread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchiveWriter::_RethrowError()
+{
+    if (m_pError)
+    {
+        std::rethrow_exception(m_pError);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// FrameArchive
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::FrameArchive::FrameArchive(const std::string& path)
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_hMapping(nullptr)
+    , m_pView(nullptr)
+    , m_numFrames(0)
+    , m_pEntries(nullptr)
+{
+    try
+    {
+        // ファイルを開く
+        {
+            m_hFile = CreateFileA(
+                path.c_str(),
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr
+            );
+            if (m_hFile == INVALID_HANDLE_VALUE)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFile failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+        }
+        // ファイルサイズを確認
+        std::uint64_t fileSizeInBytes = 0;
+        {
+            LARGE_INTEGER fileSize{};
+            if (!GetFileSizeEx(m_hFile, &fileSize))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("GetFileSizeEx failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+            fileSizeInBytes = static_cast<std::uint64_t>(fileSize.QuadPart);
+            if (fileSizeInBytes < sizeof(FRAME_ARCHIVE_HEADER))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Not a frame archive", path);
+            }
+        }
+        // 丸ごとマップ
+        {
+            m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_hMapping)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFileMapping failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+            m_pView = static_cast<const std::uint8_t*>(
+                MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0)
+            );
+            if (!m_pView)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("MapViewOfFile failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+        }
+        // ヘッダを検査
+        const auto& header = *reinterpret_cast<const FRAME_ARCHIVE_HEADER*>(m_pView);
+        {
+            if (header.magic != FRAME_ARCHIVE_MAGIC)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Not a frame archive", path);
+            }
+            if (header.version != FRAME_ARCHIVE_VERSION || header.entrySizeInBytes != sizeof(FRAME_ARCHIVE_ENTRY))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unsupported frame archive version", header.version);
+            }
+            const bool isIndexInFile = (
+                header.indexOffsetInBytes <= fileSizeInBytes &&
+                header.numFrames <= (fileSizeInBytes - header.indexOffsetInBytes) / sizeof(FRAME_ARCHIVE_ENTRY) &&
+                header.indexOffsetInBytes % alignof(FRAME_ARCHIVE_ENTRY) == 0
+            );
+            if (!isIndexInFile)
+            {
+                throw MAKE_GENERAL_ERROR("Corrupted Frame Archive");
+            }
+            m_numFrames = header.numFrames;
+            m_pEntries = reinterpret_cast<const FRAME_ARCHIVE_ENTRY*>(m_pView + header.indexOffsetInBytes);
+        }
+        // エントリを検査
+        /* @note:
+            ここで全て検査しておけば、ReadFrame は範囲外を読む心配なく O(1) で引ける。
+        */
+        for (std::size_t i = 0; i < m_numFrames; ++i)
+        {
+            const auto& entry = m_pEntries[i];
+            const auto compression = static_cast<FrameArchiveCompression>(entry.compression);
+            const bool isValid = (
+                entry.format == static_cast<std::uint32_t>(FrameArchiveFormat::BGR24) &&
+                entry.stride == static_cast<std::uint64_t>(entry.width) * BYTES_PER_PIXEL &&
+                entry.rawSizeInBytes == static_cast<std::uint64_t>(entry.stride) * entry.height &&
+                entry.payloadOffsetInBytes <= fileSizeInBytes &&
+                entry.payloadSizeInBytes <= fileSizeInBytes - entry.payloadOffsetInBytes &&
+                (
+                    (compression == FrameArchiveCompression::NONE && entry.payloadSizeInBytes == entry.rawSizeInBytes) ||
+                    (compression == FrameArchiveCompression::LZ)
+                )
+            );
+            if (!isValid)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Corrupted Frame Archive Entry", i);
+            }
+        }
+    }
+    catch (...)
+    {
+        _Close();
+        throw;
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameArchive::~FrameArchive()
+{
+    _Close();
+}
+
+//-----------------------------------------------------------------------------
+const ayc::FRAME_ARCHIVE_ENTRY& ayc::FrameArchive::GetEntry(std::size_t index) const
+{
+    if (index >= m_numFrames)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("frameIndex Out of Bounds.", index);
+    }
+    return m_pEntries[index];
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchive::ReadFrame(
+    std::size_t& width,
+    std::size_t& height,
+    std::string& frameBuffer,
+    std::size_t index
+) const
+{
+    const auto& entry = GetEntry(index);
+    const auto* pPayload = m_pView + entry.payloadOffsetInBytes;
+    width = entry.width;
+    height = entry.height;
+    frameBuffer.resize(entry.rawSizeInBytes);
+    if (static_cast<FrameArchiveCompression>(entry.compression) == FrameArchiveCompression::LZ)
+    {
+        DecompressLZ(
+            reinterpret_cast<std::uint8_t*>(frameBuffer.data()),
+            frameBuffer.size(),
+            pPayload,
+            entry.payloadSizeInBytes
+        );
+    }
+    else
+    {
+        std::memcpy(frameBuffer.data(), pPayload, frameBuffer.size());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameArchive::_Close()
+{
+    if (m_pView)
+    {
+        UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+    m_numFrames = 0;
+    m_pEntries = nullptr;
+}
@@ -9,8 +9,26 @@
 #include "frame_buffer.h"
 
 // other
+#include "async_texture_readback.h"
 #include "utils.h"
 
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+	// コールド層に移すフレームが無い時に、次に確認するまでの間隔
+	const auto DEMOTE_POLL_INTERVAL = std::chrono::milliseconds(100);
+
+	// WaitFrame で時間を区切って待つタイムアウトの上限
+	/* @note:
+		これより長い（inf を含む）タイムアウトは無期限の待機として扱う。
+		巨大な値を steady_clock の tick に変換するとオーバーフローするため。
+	*/
+	const double WAIT_FRAME_MAX_TIMEOUT_IN_SEC = 60.0 * 60.0 * 24.0 * 365.0;
+}
+
 //-----------------------------------------------------------------------------
 // Link-Local Functions
 //-----------------------------------------------------------------------------
@@ -51,43 +69,289 @@ namespace
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-ayc::FrameBuffer::FrameBuffer(double holdInSec)
+ayc::FrameBuffer::FrameBuffer(
+	double holdInSec,
+	std::shared_ptr<MemoryAccount> pMemoryAccount,
+	bool isDedupEnabled,
+	std::optional<double> hotHoldInSec,
+	std::optional<SPILL_PARAM> spillParam,
+	std::function<wgc::TimeSpan()> clock
+)
 : m_guard()
+, m_cv()
 , m_impl()
 , m_holdInSec(holdInSec)
+, m_latestSeq(0)
+, m_isClosed(false)
+, m_sizeInBytes(0)
+, m_evictedKeyframes()
+, m_pMemoryAccount(pMemoryAccount)
+, m_isDedupEnabled(isDedupEnabled)
+, m_numDeduplicated(0)
+, m_dedupSavedBytes(0)
+, m_hotHoldInSec(hotHoldInSec)
+, m_demoteCV()
+, m_demoteThread()
+, m_pSpillStore()
+, m_spillThread()
+, m_clock(clock ? std::move(clock) : std::function<wgc::TimeSpan()>(NowFromQPC))
 {
 	// 保持秒数は正値じゃないとダメ
 	if (holdInSec <= 0.0)
 	{
 		throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("holdInSec must be semi-positive", holdInSec);
 	}
+	if (hotHoldInSec.has_value() && hotHoldInSec.value() <= 0.0)
+	{
+		throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("hotHoldInSec must be semi-positive", hotHoldInSec.value());
+	}
+	// ディスクへの書き出しはコールド層のフレームが対象
+	if (spillParam.has_value())
+	{
+		if (!hotHoldInSec.has_value())
+		{
+			throw MAKE_GENERAL_ERROR("Spilling to disk requires hotHoldInSec");
+		}
+		m_pSpillStore = std::make_unique<SpillStore>(spillParam.value());
+	}
+	// コールド層・ディスクへの移動スレッドを起動
+	if (hotHoldInSec.has_value())
+	{
+		m_demoteThread = std::thread(std::bind(&FrameBuffer::_DemoteThreadHandler, this));
+	}
+	if (m_pSpillStore)
+	{
+		m_spillThread = std::thread(std::bind(&FrameBuffer::_SpillThreadHandler, this));
+	}
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::~FrameBuffer()
+{
+	_StopBackgroundThreads();
 }
 
 //-----------------------------------------------------------------------------
 void ayc::FrameBuffer::Clear()
 {
-	std::scoped_lock<std::mutex> lock(m_guard);
-	m_impl.clear();
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+		m_impl.clear();
+		m_evictedKeyframes.clear();
+		m_sizeInBytes = 0;
+	}
+	if (m_pMemoryAccount)
+	{
+		MemoryArbiter::Instance().Update(*m_pMemoryAccount, 0, 0);
+	}
 }
 
 //-----------------------------------------------------------------------------
-void ayc::FrameBuffer::PushFrame(
+void ayc::FrameBuffer::Close()
+{
+	// コールド層・ディスクへの移動を止める
+	{
+		_StopBackgroundThreads();
+	}
+	// クローズ済みとしてマークしてフレームを全削除
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+		m_impl.clear();
+		m_evictedKeyframes.clear();
+		m_sizeInBytes = 0;
+		m_isClosed = true;
+	}
+	if (m_pMemoryAccount)
+	{
+		MemoryArbiter::Instance().Update(*m_pMemoryAccount, 0, 0);
+	}
+	// WaitFrame で待機中のスレッドを起こす
+	m_cv.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t ayc::FrameBuffer::PushFrame(
 	const wgc::com_ptr<ID3D11Texture2D>& pTexture,
-	const wgc::TimeSpan& timeSpan
+	const wgc::TimeSpan& timeSpan,
+	std::shared_ptr<const FRAME_SIGNATURE> pSignature
+)
+{
+	// フレームのサイズを解決
+	const std::size_t sizeInBytes = [&]() -> std::size_t {
+		if (!pTexture)
+		{
+			return 0;
+		}
+		return GetTextureSizeInBytes(pTexture);
+	}();
+	// テクスチャの生成・解放を記帳
+	// @note: テクスチャはスナップショットと共有されるので、フレームの削除ではなくテクスチャの解放で記帳が戻る
+	{
+		TrackTexture(pTexture, MemoryCategory::FRAME_TEXTURE, _GetMemoryTracker());
+	}
+	// 追加
+	return _PushFrame(FRAME{ pTexture, timeSpan, 0, sizeInBytes, std::move(pSignature), nullptr });
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::FrameBuffer::ResolveSignature(
+	std::uint64_t seq,
+	std::shared_ptr<const FRAME_SIGNATURE> pSignature
 )
+{
+	// 直前のフレームと内容を比較
+	/* @note:
+		重複フレームはテクスチャを共有し、サイズはゼロとして記帳する。
+		共有元のフレームが削除される時に、サイズは後続の共有フレームに引き継がれる。
+		手放すコピーの解放はロックの外で行う。
+	*/
+	wgc::com_ptr<ID3D11Texture2D> pReleasedTexture;
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+
+		// 削除済みなら何もしない
+		const auto iter = std::lower_bound(
+			m_impl.begin(),
+			m_impl.end(),
+			seq,
+			[](const FRAME& f, std::uint64_t value) { return f.seq < value; }
+		);
+		if (iter == m_impl.end() || iter->seq != seq)
+		{
+			return false;
+		}
+		iter->pSignature = std::move(pSignature);
+
+		// どちらもホット層で、まだ共有していない場合だけ畳む
+		// @note: 後続がこのフレームのテクスチャを共有していたら、付け替えられないので畳まない
+		if (!m_isDedupEnabled || !iter->pSignature || iter == m_impl.begin())
+		{
+			return false;
+		}
+		const auto prev = std::prev(iter);
+		const auto next = std::next(iter);
+		const bool isDuplicate = (
+			iter->pTexture &&
+			prev->pTexture &&
+			iter->pTexture != prev->pTexture &&
+			(next == m_impl.end() || next->pTexture != iter->pTexture) &&
+			prev->pSignature &&
+			*prev->pSignature == *iter->pSignature
+		);
+		if (!isDuplicate)
+		{
+			return false;
+		}
+		// 直前のフレームのテクスチャを共有させる
+		m_sizeInBytes -= iter->sizeInBytes;
+		pReleasedTexture = std::move(iter->pTexture);
+		iter->pTexture = prev->pTexture;
+		iter->sizeInBytes = 0;
+
+		// 統計を更新
+		m_numDeduplicated += 1;
+		m_dedupSavedBytes += GetTextureSizeInBytes(iter->pTexture);
+	}
+	// 使用量を記帳
+	{
+		_UpdateMemoryAccount(_Now());
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::DEDUP_STATS ayc::FrameBuffer::GetDedupStats() const
+{
+	std::scoped_lock<std::mutex> lock(m_guard);
+	DEDUP_STATS stats{ m_numDeduplicated, m_dedupSavedBytes, 0, 0 };
+	std::size_t ownerSizeInBytes = 0;
+	for (auto iter = m_impl.cbegin(); iter != m_impl.cend(); ++iter)
+	{
+		const bool isDuplicate = (
+			iter != m_impl.cbegin() &&
+			_IsSharedWith(*iter, *std::prev(iter))
+		);
+		if (isDuplicate)
+		{
+			stats.heldDuplicates += 1;
+			stats.heldSavedBytes += ownerSizeInBytes;
+		}
+		else
+		{
+			ownerSizeInBytes = iter->sizeInBytes;
+		}
+	}
+	return stats;
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::TIER_STATS ayc::FrameBuffer::GetTierStats() const
+{
+	std::scoped_lock<std::mutex> lock(m_guard);
+	TIER_STATS stats{};
+	for (auto iter = m_impl.cbegin(); iter != m_impl.cend(); ++iter)
+	{
+		const bool isShared = (
+			iter != m_impl.cbegin() &&
+			_IsSharedWith(*iter, *std::prev(iter))
+		);
+		if (iter->pColdFrame && iter->pColdFrame->IsSpilled())
+		{
+			stats.spilledFrames += 1;
+			if (!isShared)
+			{
+				stats.spilledBytes += iter->pColdFrame->GetSpilledSizeInBytes();
+			}
+		}
+		else if (iter->pColdFrame)
+		{
+			stats.coldFrames += 1;
+			if (!isShared)
+			{
+				stats.coldBytes += iter->pColdFrame->GetSizeInBytes();
+				stats.coldRawBytes += iter->pColdFrame->GetRawSizeInBytes();
+				stats.coldTiles += iter->pColdFrame->GetNumTiles();
+				stats.coldStoredTiles += iter->pColdFrame->GetNumStoredTiles();
+			}
+		}
+		else
+		{
+			stats.hotFrames += 1;
+			stats.hotBytes += iter->sizeInBytes;
+		}
+	}
+	if (m_pSpillStore)
+	{
+		stats.spillDiskBytes = m_pSpillStore->GetStats().diskBytes;
+	}
+	return stats;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t ayc::FrameBuffer::_PushFrame(FRAME frame)
 {
 	// 「現在」を確定させる
-	const wgc::TimeSpan nowInTS = []() {
-		return NowFromQPC();
+	const wgc::TimeSpan nowInTS = [&]() {
+		return _Now();
 	}();
+	// メモリ予算による上限を解決
+	const std::int64_t limitInBytes = m_pMemoryAccount ? m_pMemoryAccount->GetLimitBytes() : MemoryAccount::NO_LIMIT;
+	const double minHoldInSec = m_pMemoryAccount ? m_pMemoryAccount->GetMinHoldInSec() : m_holdInSec;
+
 	// バッファにフレームを追加＆バッファから賞味期限切れのフレームを削除
 	/* @note:
 		「フレームなし」はできるだけ避けたいので、
 		１フレームだけは削除せずに残す。
+		メモリ予算の上限を超えている場合は、最低保持秒数より古いフレームも削除する。
 	*/
+	std::uint64_t seq = 0;
 	{
 		std::scoped_lock<std::mutex> lock(m_guard);
-		m_impl.emplace_back(FRAME{ pTexture, timeSpan });
+		m_latestSeq += 1;
+		seq = m_latestSeq;
+		frame.seq = seq;
+		m_sizeInBytes += frame.sizeInBytes;
+		m_impl.emplace_back(std::move(frame));
 		for (;;)
 		{
 			if (m_impl.size() <= 1)
@@ -95,21 +359,436 @@ void ayc::FrameBuffer::PushFrame(
 				break;
 			}
 			const double frontRelativeInSec = toDurationInSec(nowInTS, m_impl.front().timeSpan);
-			if (frontRelativeInSec <= m_holdInSec)
+			const bool isExpired = frontRelativeInSec > m_holdInSec;
+			const bool isOverLimit = (
+				static_cast<std::int64_t>(m_sizeInBytes) > limitInBytes &&
+				frontRelativeInSec > minHoldInSec
+			);
+			if (!isExpired && !isOverLimit)
+			{
+				break;
+			}
+			_PopFrontFrame();
+		}
+	}
+	// 使用量を記帳
+	{
+		_UpdateMemoryAccount(nowInTS);
+	}
+	// 新着フレームを待機中のスレッドに通知
+	/* @note:
+		待機側が起きてすぐロックを取れるように、ロック解放後に通知する。
+	*/
+	m_cv.notify_all();
+	return seq;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_PopFrontFrame()
+{
+	/* @note:
+		後続がテクスチャを共有しているなら、サイズはそちらに引き継ぐ。
+		キーフレームは後続の差分フレームが参照している間はメモリに残るので、記帳を戻すのは参照が無くなってから。
+	*/
+	const auto& front = m_impl.front();
+	if (m_impl.size() > 1 && _IsSharedWith(m_impl[1], front))
+	{
+		m_impl[1].sizeInBytes += front.sizeInBytes;
+	}
+	else if (front.pColdFrame && front.pColdFrame->IsKeyframe())
+	{
+		m_evictedKeyframes.push_back(_EVICTED_KEYFRAME{ front.pColdFrame.get(), front.sizeInBytes });
+	}
+	else
+	{
+		m_sizeInBytes -= front.sizeInBytes;
+	}
+	m_impl.pop_front();
+	_ReleaseEvictedKeyframes();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_ReleaseEvictedKeyframes()
+{
+	// @note: 差分フレームはキーフレームの直後に並ぶので、参照が残っていれば大抵は先頭で見つかる
+	std::erase_if(m_evictedKeyframes, [this](const _EVICTED_KEYFRAME& evicted)
+	{
+		const bool isReferenced = std::any_of(
+			m_impl.cbegin(),
+			m_impl.cend(),
+			[&](const FRAME& f) { return f.pColdFrame && f.pColdFrame->GetKeyframe().get() == evicted.pKeyframe; }
+		);
+		if (isReferenced)
+		{
+			return false;
+		}
+		m_sizeInBytes -= evicted.sizeInBytes;
+		return true;
+	});
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_UpdateMemoryAccount(const wgc::TimeSpan& nowInTS)
+{
+	// 記帳先が無ければ何もしない
+	if (!m_pMemoryAccount)
+	{
+		return;
+	}
+	// 全体と最低保持秒数ぶんの使用量を集計
+	const double minHoldInSec = m_pMemoryAccount->GetMinHoldInSec();
+	std::size_t totalSizeInBytes = 0;
+	std::size_t floorSizeInBytes = 0;
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+		for (auto iter = m_impl.crbegin(); iter != m_impl.crend(); ++iter)
+		{
+			if (toDurationInSec(nowInTS, iter->timeSpan) > minHoldInSec)
 			{
 				break;
 			}
-			m_impl.pop_front();
+			floorSizeInBytes += iter->sizeInBytes;
 		}
+		totalSizeInBytes = m_sizeInBytes;
+	}
+	// 記帳
+	{
+		MemoryArbiter::Instance().Update(
+			*m_pMemoryAccount,
+			static_cast<std::int64_t>(totalSizeInBytes),
+			static_cast<std::int64_t>(floorSizeInBytes)
+		);
 	}
 }
 
 //-----------------------------------------------------------------------------
-wgc::com_ptr<ID3D11Texture2D> ayc::FrameBuffer::GetFrame(double relativeInSec) const
+/*static*/ bool ayc::FrameBuffer::_IsSharedWith(const FRAME& frame, const FRAME& prevFrame)
+{
+	if (frame.pTexture)
+	{
+		return frame.pTexture == prevFrame.pTexture;
+	}
+	return frame.pColdFrame && frame.pColdFrame == prevFrame.pColdFrame;
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::Impl::const_iterator ayc::FrameBuffer::_FindDemoteTarget(const wgc::TimeSpan& nowInTS) const
+{
+	// 最も古いホット層のフレームを探す
+	/* @note:
+		コールド層には古い順に移すので、ホット層のフレームは後ろに固まっている。
+		最新フレームは WaitFrame で返すために必ずホット層に残す。
+	*/
+	const auto iter = std::find_if(
+		m_impl.cbegin(),
+		m_impl.cend(),
+		[](const FRAME& f) { return static_cast<bool>(f.pTexture); }
+	);
+	if (iter == m_impl.cend() || std::next(iter) == m_impl.cend())
+	{
+		return m_impl.cend();
+	}
+	// ホット層の保持秒数を過ぎていなければまだ移さない
+	if (toDurationInSec(nowInTS, iter->timeSpan) <= m_hotHoldInSec.value())
+	{
+		return m_impl.cend();
+	}
+	return iter;
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::Impl::const_iterator ayc::FrameBuffer::_FindSpillTarget(const wgc::TimeSpan& nowInTS) const
+{
+	// ディスクに書き出していない最も古いコールド層のフレームを探す
+	// @note: ディスクにも古い順に書き出すので、書き出し済みのフレームは先頭に固まっている
+	const auto iter = std::find_if(
+		m_impl.cbegin(),
+		m_impl.cend(),
+		[](const FRAME& f) { return f.pColdFrame && !f.pColdFrame->IsSpilled(); }
+	);
+	if (iter == m_impl.cend())
+	{
+		return m_impl.cend();
+	}
+	// 書き出すまでの秒数を過ぎていなければまだ書き出さない
+	if (toDurationInSec(nowInTS, iter->timeSpan) <= m_pSpillStore->GetParam().spillAfterInSec)
+	{
+		return m_impl.cend();
+	}
+	return iter;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_ReplaceWithColdFrame(
+	std::uint64_t seq,
+	const FRAME_SOURCE& expected,
+	const std::shared_ptr<const ColdFrame>& pColdFrame
+)
+{
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+
+		// 読み出し中に削除・移動されていないか確認
+		const auto iter = std::lower_bound(
+			m_impl.begin(),
+			m_impl.end(),
+			seq,
+			[](const FRAME& f, std::uint64_t value) { return f.seq < value; }
+		);
+		const bool isFound = (
+			iter != m_impl.end() &&
+			iter->seq == seq &&
+			iter->pTexture == expected.pTexture &&
+			iter->pColdFrame == expected.pColdFrame
+		);
+		if (!isFound)
+		{
+			return;
+		}
+		// 差し替え前のサイズを精算
+		/* @note:
+			後続が同じテクスチャ・コールドフレームを共有しているなら、サイズはそちらに引き継ぐ。
+			ディスクに書き出したキーフレームは、まだ書き出していない差分フレームが参照している間はメモリに残る。
+		*/
+		const auto next = std::next(iter);
+		if (next != m_impl.end() && next->pTexture == iter->pTexture && next->pColdFrame == iter->pColdFrame)
+		{
+			next->sizeInBytes += iter->sizeInBytes;
+		}
+		else if (iter->pColdFrame && iter->pColdFrame->IsKeyframe())
+		{
+			m_evictedKeyframes.push_back(_EVICTED_KEYFRAME{ iter->pColdFrame.get(), iter->sizeInBytes });
+		}
+		else
+		{
+			m_sizeInBytes -= iter->sizeInBytes;
+		}
+		// コールドフレームに差し替え
+		// @note: 前のフレームとコールドフレームを共有しているなら、サイズはゼロとして記帳する
+		iter->pTexture = nullptr;
+		iter->pColdFrame = pColdFrame;
+		const bool isShared = (
+			iter != m_impl.begin() &&
+			_IsSharedWith(*iter, *std::prev(iter))
+		);
+		iter->sizeInBytes = isShared ? 0 : pColdFrame->GetSizeInBytes();
+		m_sizeInBytes += iter->sizeInBytes;
+		_ReleaseEvictedKeyframes();
+	}
+	// 使用量を記帳
+	{
+		_UpdateMemoryAccount(_Now());
+	}
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_EvictRetiredFrames(std::uint64_t retiredSegmentId)
+{
+	// 破棄済みセグメントに書き出したフレームを削除
+	// @note: ディスクには古い順に書き出すので、該当フレームは先頭に固まっている
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+		while (m_impl.size() > 1)
+		{
+			const auto& pColdFrame = m_impl.front().pColdFrame;
+			const bool isRetired = (
+				pColdFrame &&
+				pColdFrame->IsSpilled() &&
+				pColdFrame->GetSegmentId() <= retiredSegmentId
+			);
+			if (!isRetired)
+			{
+				break;
+			}
+			_PopFrontFrame();
+		}
+	}
+	// 使用量を記帳
+	{
+		_UpdateMemoryAccount(_Now());
+	}
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_StopBackgroundThreads()
+{
+	// @note: スレッドはクローズ済みのマークを見て終了する
+	{
+		std::scoped_lock<std::mutex> lock(m_guard);
+		m_isClosed = true;
+	}
+	m_demoteCV.notify_all();
+	if (m_demoteThread.joinable())
+	{
+		m_demoteThread.join();
+	}
+	if (m_spillThread.joinable())
+	{
+		m_spillThread.join();
+	}
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_DemoteThreadHandler()
+{
+	/* @note:
+		読み出しと圧縮はロックの外で行い、差し替える時だけロックを取る。
+		重複排除でテクスチャを共有しているフレームは、コールドフレームも共有させる。
+		直前に移したテクスチャは、それを共有するフレームがホット層に残っている間だけ覚えておく。
+		覚えたままだと、バッファから消えたテクスチャを次に移すまで生かし続けてしまう。
+	*/
+	MemoryTrackerScope trackerScope(_GetMemoryTracker());
+	ColdFrameEncoder encoder;
+	wgc::com_ptr<ID3D11Texture2D> pLastTexture;
+	std::shared_ptr<const ColdFrame> pLastColdFrame;
+	std::string buffer;
+	for (;;)
+	{
+		// 移すべきフレームを待つ
+		FRAME target{};
+		{
+			std::unique_lock<std::mutex> lock(m_guard);
+			if (m_isClosed)
+			{
+				break;
+			}
+			// 直前に移したテクスチャを共有するフレームがもうホット層に無ければ手放す
+			// @note: ホット層は後ろに固まっていて、共有するフレームは連続するので、先頭だけ見ればよい
+			const auto firstHot = std::find_if(
+				m_impl.cbegin(),
+				m_impl.cend(),
+				[](const FRAME& f) { return static_cast<bool>(f.pTexture); }
+			);
+			if (pLastTexture && (firstHot == m_impl.cend() || firstHot->pTexture != pLastTexture))
+			{
+				// @note: 解放はロックの外で行う
+				lock.unlock();
+				pLastTexture = nullptr;
+				pLastColdFrame = nullptr;
+				continue;
+			}
+			const auto iter = _FindDemoteTarget(_Now());
+			if (iter == m_impl.cend())
+			{
+				m_demoteCV.wait_for(lock, DEMOTE_POLL_INTERVAL);
+				continue;
+			}
+			target = *iter;
+		}
+		// 読み出して圧縮
+		/* @note:
+			失敗した場合はそれ以降の移動を諦め、ホット層のまま保持を続ける。
+		*/
+		if (target.pTexture != pLastTexture)
+		{
+			try
+			{
+				std::size_t width = 0;
+				std::size_t height = 0;
+				ReadbackTexture(width, height, buffer, target.pTexture);
+				pLastColdFrame = encoder.Encode(width, height, buffer);
+				pLastTexture = target.pTexture;
+			}
+			catch (const ayc::GeneralError& e)
+			{
+				WRITE_LOG_GENERAL_ERROR("In FrameBuffer, failed to demote frame.", e);
+				break;
+			}
+			catch (const std::exception& e)
+			{
+				WRITE_LOG_CPP_EXCEPTION("In FrameBuffer, failed to demote frame.", e);
+				break;
+			}
+		}
+		// 差し替え
+		{
+			_ReplaceWithColdFrame(target.seq, FRAME_SOURCE{ target.pTexture, nullptr }, pLastColdFrame);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameBuffer::_SpillThreadHandler()
+{
+	/* @note:
+		ディスク I/O はこのスレッドだけで行い、キャプチャ側のスレッドは一切ディスクに触れない。
+		書き込みはマップ先へのコピーなので、実際の書き出しは OS に任せる（ライトビハインド）。
+		重複排除でコールドフレームを共有しているフレームは、書き出し後も共有させる。
+		直前に書き出したコールドフレームは、_DemoteThreadHandler と同じく共有するフレームが残っている間だけ覚えておく。
+	*/
+	std::shared_ptr<const ColdFrame> pLastSource;
+	std::shared_ptr<const ColdFrame> pLastSpilled;
+	for (;;)
+	{
+		// 書き出すべきフレームを待つ
+		FRAME target{};
+		{
+			std::unique_lock<std::mutex> lock(m_guard);
+			if (m_isClosed)
+			{
+				break;
+			}
+			// 直前に書き出したコールドフレームを共有するフレームがもう残っていなければ手放す
+			const auto firstUnspilled = std::find_if(
+				m_impl.cbegin(),
+				m_impl.cend(),
+				[](const FRAME& f) { return f.pColdFrame && !f.pColdFrame->IsSpilled(); }
+			);
+			if (pLastSource && (firstUnspilled == m_impl.cend() || firstUnspilled->pColdFrame != pLastSource))
+			{
+				// @note: 解放はロックの外で行う
+				lock.unlock();
+				pLastSource = nullptr;
+				pLastSpilled = nullptr;
+				continue;
+			}
+			const auto iter = _FindSpillTarget(_Now());
+			if (iter == m_impl.cend())
+			{
+				m_demoteCV.wait_for(lock, DEMOTE_POLL_INTERVAL);
+				continue;
+			}
+			target = *iter;
+		}
+		// 書き出し
+		/* @note:
+			失敗した場合はそれ以降の書き出しを諦め、コールド層のまま保持を続ける。
+		*/
+		if (target.pColdFrame != pLastSource)
+		{
+			try
+			{
+				pLastSpilled = m_pSpillStore->Spill(target.pColdFrame, target.timeSpan);
+				pLastSource = target.pColdFrame;
+			}
+			catch (const ayc::GeneralError& e)
+			{
+				WRITE_LOG_GENERAL_ERROR("In FrameBuffer, failed to spill frame.", e);
+				break;
+			}
+			catch (const std::exception& e)
+			{
+				WRITE_LOG_CPP_EXCEPTION("In FrameBuffer, failed to spill frame.", e);
+				break;
+			}
+		}
+		// 差し替え
+		{
+			_ReplaceWithColdFrame(target.seq, FRAME_SOURCE{ nullptr, target.pColdFrame }, pLastSpilled);
+		}
+		// 上限を超えて破棄したセグメントのフレームを手放す
+		{
+			_EvictRetiredFrames(m_pSpillStore->GetRetiredSegmentId());
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+ayc::FRAME_SOURCE ayc::FrameBuffer::GetFrame(double relativeInSec) const
 {
 	// 「現在」を確定させる
-	const wgc::TimeSpan nowInTS = []() {
-		return NowFromQPC();
+	const wgc::TimeSpan nowInTS = [&]() {
+		return _Now();
 	}();
 	// 相対時刻が最も近いフレームを選択する
 	/* @note:
@@ -121,7 +800,7 @@ wgc::com_ptr<ID3D11Texture2D> ayc::FrameBuffer::GetFrame(double relativeInSec) c
 		std::scoped_lock<std::mutex> lock(m_guard);
 		if (m_impl.empty())
 		{
-			return wgc::com_ptr<ID3D11Texture2D>(nullptr);
+			return FRAME_SOURCE{};
 		}
 		result = *_FindMinElement(
 			m_impl.cbegin(),
@@ -132,7 +811,57 @@ wgc::com_ptr<ID3D11Texture2D> ayc::FrameBuffer::GetFrame(double relativeInSec) c
 			}
 		);
 	}
-	return result.pTexture;
+	return FRAME_SOURCE{ result.pTexture, result.pColdFrame };
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t ayc::FrameBuffer::GetLatestSequence() const
+{
+	std::scoped_lock<std::mutex> lock(m_guard);
+	return m_latestSeq;
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::FRAME ayc::FrameBuffer::WaitFrame(
+	std::uint64_t afterSeq,
+	std::optional<double> timeoutInSec
+) const
+{
+	// 待機解除条件
+	/* @note:
+		クローズされた場合も待機は解除する。
+		フレームが全削除された場合に備えて、空でないことも条件にする。
+	*/
+	const auto isReady = [&]()
+	{
+		return m_isClosed || (m_latestSeq > afterSeq && !m_impl.empty());
+	};
+	// 新着フレームを待機
+	/* @note:
+		タイムアウト・クローズは GetFrame と同様に nullptr で通知する。
+	*/
+	std::unique_lock<std::mutex> lock(m_guard);
+	if (timeoutInSec.has_value() && !(timeoutInSec.value() > WAIT_FRAME_MAX_TIMEOUT_IN_SEC))
+	{
+		// @note: NaN・負の値は待たずに確認だけする
+		const double clampedInSec = std::isnan(timeoutInSec.value()) ? 0.0 : std::max(timeoutInSec.value(), 0.0);
+		const auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(clampedInSec)
+		);
+		if (!m_cv.wait_for(lock, timeout, isReady))
+		{
+			return FRAME{};
+		}
+	}
+	else
+	{
+		m_cv.wait(lock, isReady);
+	}
+	if (m_isClosed)
+	{
+		return FRAME{};
+	}
+	return m_impl.back();
 }
 
 
@@ -155,9 +884,9 @@ ayc::FreezedFrameBuffer::FreezedFrameBuffer(
 : m_impl()
 {
 	// 「現在」を確定させる
-	const wgc::TimeSpan nowInTS = []()
+	const wgc::TimeSpan nowInTS = [&]()
 	{
-		return NowFromQPC();
+		return frameBuffer._Now();
 	}();
 	// スナップショット時間長を解決
 	const auto actualDuration = std::min(
@@ -180,13 +909,13 @@ ayc::FreezedFrameBuffer::FreezedFrameBuffer(
 			{
 				continue;
 			}
-			m_impl.emplace_back(FRAME{ frame.pTexture, relativeInSec });
+			m_impl.emplace_back(FRAME{ frame.pTexture, frame.pColdFrame, relativeInSec });
 		}
 		if (m_impl.empty() and !srcImpl.empty())
 		{
 			const auto frame = srcImpl.back();
 			const auto relativeInSec = toDurationInSec(nowInTS, frame.timeSpan);
-			m_impl.emplace_back(FRAME{ frame.pTexture, relativeInSec });
+			m_impl.emplace_back(FRAME{ frame.pTexture, frame.pColdFrame, relativeInSec });
 		}
 	}
 	// フレームを時刻で降順にソート
@@ -214,9 +943,87 @@ std::size_t ayc::FreezedFrameBuffer::GetFrameIndex(double relativeInSec) const
 }
 
 //-----------------------------------------------------------------------------
-wgc::com_ptr<ID3D11Texture2D> ayc::FreezedFrameBuffer::operator [](std::size_t index) const
+void ayc::FreezedFrameBuffer::ResolveIndexMap(
+	std::vector<std::size_t>& outIndexUserToRaw,
+	std::vector<double>& outRelativesInSec,
+	std::optional<double> fps,
+	std::optional<double> durationInSec
+) const
+{
+	outIndexUserToRaw.clear();
+	outRelativesInSec.clear();
+
+	// 空なら空のマップ
+	if (m_impl.empty())
+	{
+		return;
+	}
+	// fps 指定が無い場合は恒等写像にする
+	if (!fps.has_value())
+	{
+		outIndexUserToRaw.reserve(m_impl.size());
+		outRelativesInSec.reserve(m_impl.size());
+		for (const auto& frame : m_impl)
+		{
+			outIndexUserToRaw.push_back(outIndexUserToRaw.size());
+			outRelativesInSec.push_back(frame.relativeInSec);
+		}
+		return;
+	}
+	// 生フレームバッファの範囲（秒数）を解決
+	const auto [rawMinRelativesInSec, rawMaxRelativeInSec] = [&]()
+		{
+			auto [minIter, maxIter] = std::ranges::minmax_element
+			(
+				m_impl,
+				/*_Pr=*/{},
+				[](auto const& x) { return x.relativeInSec; }
+			);
+			return std::make_pair(minIter->relativeInSec, maxIter->relativeInSec);
+		}();
+	const auto rawDurationInSec = (
+		rawMaxRelativeInSec - rawMinRelativesInSec
+		);
+	// ユーザーフレームバッファの秒数を解決
+	const auto userDurationInSec = [&]()
+	{
+		if (durationInSec.has_value())
+		{
+			return durationInSec.value();
+		}
+		else
+		{
+			return rawDurationInSec;
+		}
+	}();
+	// ユーザーフレームバッファのフレーム数を解決
+	const auto numUserFrames = [&]()
+	{
+		const auto fpsValue = fps.value();
+		const auto result = std::round(userDurationInSec * fpsValue);
+		return static_cast<std::size_t>(result);
+	}();
+	// マップを構築
+	{
+		outIndexUserToRaw.reserve(numUserFrames);
+		outRelativesInSec.reserve(numUserFrames);
+		for (std::size_t i = 0; i < numUserFrames; ++i)
+		{
+			const auto rawObjRelativesInSec = (
+				userDurationInSec * static_cast<double>(numUserFrames - i - 1) / static_cast<double>(numUserFrames)
+			);
+			const auto rawFrameIndex = GetFrameIndex(rawObjRelativesInSec);
+			outIndexUserToRaw.push_back(rawFrameIndex);
+			outRelativesInSec.push_back(rawObjRelativesInSec);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+ayc::FRAME_SOURCE ayc::FreezedFrameBuffer::operator [](std::size_t index) const
 {
-	return m_impl[index].pTexture;
+	const auto& frame = m_impl[index];
+	return FRAME_SOURCE{ frame.pTexture, frame.pColdFrame };
 }
 
 
@@ -0,0 +1,263 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "frame_pruner.h"
+
+// other
+#include "thread_pool.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 縮小後の長辺の最大画素数
+    const std::size_t PRUNE_THUMBNAIL_MAX_DIMENSION = 128;
+
+    // SSIM を求めるブロックの一辺
+    const std::size_t PRUNE_SSIM_BLOCK_SIZE = 8;
+
+    // SSIM の安定化定数 (K1 = 0.01, K2 = 0.03, L = 255)
+    const double PRUNE_SSIM_C1 = (0.01 * 255.0) * (0.01 * 255.0);
+    const double PRUNE_SSIM_C2 = (0.03 * 255.0) * (0.03 * 255.0);
+
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    //-----------------------------------------------------------------------------
+    // 1 - ブロックごとの SSIM の平均
+    // @note: 端の欠けたブロックも、欠けたなりの画素数で求める
+    double _ComputeSSIMDistance(const ayc::FRAME_THUMBNAIL& lhs, const ayc::FRAME_THUMBNAIL& rhs)
+    {
+        const std::size_t width = lhs.width;
+        const std::size_t height = lhs.height;
+        double ssimSum = 0.0;
+        std::size_t numBlocks = 0;
+        for (std::size_t by = 0; by < height; by += PRUNE_SSIM_BLOCK_SIZE)
+        {
+            const std::size_t yEnd = std::min(by + PRUNE_SSIM_BLOCK_SIZE, height);
+            for (std::size_t bx = 0; bx < width; bx += PRUNE_SSIM_BLOCK_SIZE)
+            {
+                const std::size_t xEnd = std::min(bx + PRUNE_SSIM_BLOCK_SIZE, width);
+                std::uint32_t sumL = 0;
+                std::uint32_t sumR = 0;
+                std::uint32_t sumLL = 0;
+                std::uint32_t sumRR = 0;
+                std::uint32_t sumLR = 0;
+                for (std::size_t y = by; y < yEnd; ++y)
+                {
+                    const std::uint8_t* const pL = lhs.luma.data() + y * width;
+                    const std::uint8_t* const pR = rhs.luma.data() + y * width;
+                    for (std::size_t x = bx; x < xEnd; ++x)
+                    {
+                        const std::uint32_t l = pL[x];
+                        const std::uint32_t r = pR[x];
+                        sumL += l;
+                        sumR += r;
+                        sumLL += l * l;
+                        sumRR += r * r;
+                        sumLR += l * r;
+                    }
+                }
+                const double n = static_cast<double>((yEnd - by) * (xEnd - bx));
+                const double meanL = sumL / n;
+                const double meanR = sumR / n;
+                const double varL = sumLL / n - meanL * meanL;
+                const double varR = sumRR / n - meanR * meanR;
+                const double cov = sumLR / n - meanL * meanR;
+                ssimSum += (
+                    ((2.0 * meanL * meanR + PRUNE_SSIM_C1) * (2.0 * cov + PRUNE_SSIM_C2)) /
+                    ((meanL * meanL + meanR * meanR + PRUNE_SSIM_C1) * (varL + varR + PRUNE_SSIM_C2))
+                );
+                numBlocks += 1;
+            }
+        }
+        if (numBlocks == 0)
+        {
+            return 0.0;
+        }
+        return std::clamp(1.0 - ssimSum / numBlocks, 0.0, 1.0);
+    }
+
+    //-----------------------------------------------------------------------------
+    // 各フレームの表示時間を解決する
+    // @note: 末尾のフレームは平均フレーム間隔だけ表示する。フレームが１枚なら 0
+    std::vector<double> _ResolveDurationsInSec(const std::vector<double>& relativesInSec)
+    {
+        const std::size_t numFrames = relativesInSec.size();
+        std::vector<double> startsInSec(numFrames + 1, 0.0);
+        for (std::size_t i = 0; i < numFrames; ++i)
+        {
+            startsInSec[i] = std::max(relativesInSec.front() - relativesInSec[i], i > 0 ? startsInSec[i - 1] : 0.0);
+        }
+        if (numFrames > 0)
+        {
+            const double durationInSec = startsInSec[numFrames - 1];
+            startsInSec[numFrames] = (
+                numFrames > 1 ? durationInSec * numFrames / (numFrames - 1) : durationInSec
+            );
+        }
+        std::vector<double> durationsInSec(numFrames);
+        for (std::size_t i = 0; i < numFrames; ++i)
+        {
+            durationsInSec[i] = startsInSec[i + 1] - startsInSec[i];
+        }
+        return durationsInSec;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::FRAME_THUMBNAIL ayc::MakeFrameThumbnail(const PRUNE_FRAME& frame)
+{
+    // パラメータチェック
+    if (frame.frameBuffer.size() < frame.width * frame.height * BYTES_PER_PIXEL)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Frame buffer is too small", frame.frameBuffer.size());
+    }
+    // 縮小率を解決
+    const std::size_t longSide = std::max(frame.width, frame.height);
+    const std::size_t blockSize = std::max<std::size_t>(
+        (longSide + PRUNE_THUMBNAIL_MAX_DIMENSION - 1) / PRUNE_THUMBNAIL_MAX_DIMENSION, 1
+    );
+    FRAME_THUMBNAIL thumbnail{};
+    thumbnail.srcWidth = frame.width;
+    thumbnail.srcHeight = frame.height;
+    thumbnail.width = (frame.width + blockSize - 1) / blockSize;
+    thumbnail.height = (frame.height + blockSize - 1) / blockSize;
+    thumbnail.luma.resize(thumbnail.width * thumbnail.height);
+
+    // 行ごとに輝度を求め、ブロック単位で足し込む
+    /* @note:
+        輝度は BT.601 の係数を 8 ビット固定小数点にしたもの（比較用なので厳密さは要らない）。
+        1 行分の輝度を先にまとめて求めることで、内側のループを分岐の無い形に保つ。
+    */
+    const auto* const pSrc = frame.frameBuffer.data();
+    std::vector<std::uint32_t> rowLuma(frame.width);
+    std::vector<std::uint64_t> blockSums(thumbnail.width);
+    for (std::size_t ty = 0; ty < thumbnail.height; ++ty)
+    {
+        std::fill(blockSums.begin(), blockSums.end(), 0);
+        const std::size_t yBegin = ty * blockSize;
+        const std::size_t yEnd = std::min(yBegin + blockSize, frame.height);
+        for (std::size_t y = yBegin; y < yEnd; ++y)
+        {
+            const std::uint8_t* const pRow = pSrc + y * frame.width * BYTES_PER_PIXEL;
+            for (std::size_t x = 0; x < frame.width; ++x)
+            {
+                const std::uint8_t* const pPixel = pRow + x * BYTES_PER_PIXEL;
+                rowLuma[x] = 29u * pPixel[0] + 150u * pPixel[1] + 77u * pPixel[2];
+            }
+            for (std::size_t tx = 0; tx < thumbnail.width; ++tx)
+            {
+                const std::size_t xBegin = tx * blockSize;
+                const std::size_t xEnd = std::min(xBegin + blockSize, frame.width);
+                std::uint32_t sum = 0;
+                for (std::size_t x = xBegin; x < xEnd; ++x)
+                {
+                    sum += rowLuma[x];
+                }
+                blockSums[tx] += sum;
+            }
+        }
+        for (std::size_t tx = 0; tx < thumbnail.width; ++tx)
+        {
+            const std::size_t xBegin = tx * blockSize;
+            const std::size_t xEnd = std::min(xBegin + blockSize, frame.width);
+            const std::uint64_t divisor = static_cast<std::uint64_t>((yEnd - yBegin) * (xEnd - xBegin)) << 8;
+            thumbnail.luma[ty * thumbnail.width + tx] = static_cast<std::uint8_t>(
+                (blockSums[tx] + divisor / 2) / divisor
+            );
+        }
+    }
+    return thumbnail;
+}
+
+//-----------------------------------------------------------------------------
+double ayc::ComputeFrameDifference(
+    const FRAME_THUMBNAIL& lhs,
+    const FRAME_THUMBNAIL& rhs,
+    FrameDiffMetric metric
+)
+{
+    // サイズが違えば別物
+    if (lhs.srcWidth != rhs.srcWidth || lhs.srcHeight != rhs.srcHeight)
+    {
+        return 1.0;
+    }
+    switch (metric)
+    {
+    case FrameDiffMetric::SAD:
+        return MeanAbsoluteDifference(lhs.luma.data(), rhs.luma.data(), lhs.luma.size());
+    case FrameDiffMetric::SSIM:
+        return _ComputeSSIMDistance(lhs, rhs);
+    }
+    throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown metric", static_cast<int>(metric));
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ayc::PRUNED_FRAME> ayc::PruneNearDuplicateFrames(
+    const std::vector<PRUNE_FRAME>& frames,
+    const std::vector<double>& relativesInSec,
+    const PRUNE_PARAM& param
+)
+{
+    // パラメータチェック
+    if (!(param.threshold >= 0.0 && param.threshold <= 1.0))
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("threshold must be in [0, 1]", param.threshold);
+    }
+    if (frames.size() != relativesInSec.size())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Mismatched number of timestamps", relativesInSec.size());
+    }
+    if (frames.empty())
+    {
+        return {};
+    }
+    // 縮小
+    std::vector<FRAME_THUMBNAIL> thumbnails(frames.size());
+    ayc::ThreadPool::Instance().ParallelFor(
+        frames.size(),
+        [&](std::size_t i)
+        {
+            thumbnails[i] = MakeFrameThumbnail(frames[i]);
+        }
+    );
+    // 先頭から順に、代表フレームと比べて統合する
+    const auto durationsInSec = _ResolveDurationsInSec(relativesInSec);
+    std::vector<PRUNED_FRAME> prunedFrames;
+    prunedFrames.push_back(PRUNED_FRAME{ 0, 1, durationsInSec[0] });
+    for (std::size_t i = 1; i < frames.size(); ++i)
+    {
+        auto& current = prunedFrames.back();
+        const double diff = ComputeFrameDifference(thumbnails[current.frameIndex], thumbnails[i], param.metric);
+        if (diff <= param.threshold)
+        {
+            current.numMerged += 1;
+            current.durationInSec += durationsInSec[i];
+        }
+        else
+        {
+            prunedFrames.push_back(PRUNED_FRAME{ i, 1, durationsInSec[i] });
+        }
+    }
+    return prunedFrames;
+}
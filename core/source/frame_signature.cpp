@@ -0,0 +1,432 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "frame_signature.h"
+
+// other
+#include "d3d11_system.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Compute Shader
+//-----------------------------------------------------------------------------
+namespace
+{
+    // コンピュートシェーダーを生成する
+    wgc::com_ptr<ID3D11ComputeShader> _CreateComputeShader()
+    {
+        // シェーダーソースコード
+        /* @note:
+            １スレッドグループ＝１タイル。
+            画素値と位置を混ぜたハッシュをタイル内で足し合わせる。
+            位置を混ぜるのは、タイル内で画素が入れ替わっただけの変化も拾うため。
+            ハッシュは混ぜ方の違う２つを足し合わせ、タイルごとに下位・上位の順に並べる。
+            同じ走査でタイル内の輝度（BT.601 の 8 ビット固定小数点）も足し合わせ、
+            ハッシュの後ろに書き出す。
+        */
+        const char hlslSourceCode[] = R"(
+            Texture2D<float4>         SourceTex      : register(t0);
+            RWStructuredBuffer<uint>  TileSignatures : register(u0);
+
+            groupshared uint g_tileHash;
+            groupshared uint g_tileHash2;
+            groupshared uint g_tileLuma;
+
+            uint Hash(uint x)
+            {
+                x ^= x >> 16;
+                x *= 0x7feb352du;
+                x ^= x >> 15;
+                x *= 0x846ca68bu;
+                x ^= x >> 16;
+                return x;
+            }
+
+            uint Hash2(uint x)
+            {
+                x ^= x >> 16;
+                x *= 0x85ebca6bu;
+                x ^= x >> 13;
+                x *= 0xc2b2ae35u;
+                x ^= x >> 16;
+                return x;
+            }
+
+            [numthreads(16, 16, 1)]
+            void main(
+                uint3 groupId          : SV_GroupID,
+                uint3 dispatchThreadId : SV_DispatchThreadID,
+                uint  groupIndex       : SV_GroupIndex
+            )
+            {
+                uint width;
+                uint height;
+                SourceTex.GetDimensions(width, height);
+
+                if (groupIndex == 0)
+                {
+                    g_tileHash = 0;
+                    g_tileHash2 = 0;
+                    g_tileLuma = 0;
+                }
+                GroupMemoryBarrierWithGroupSync();
+
+                if (dispatchThreadId.x < width && dispatchThreadId.y < height)
+                {
+                    const uint4 c = (uint4)round(SourceTex.Load(int3(dispatchThreadId.xy, 0)) * 255.0f);
+                    const uint packed = c.r | (c.g << 8) | (c.b << 16);
+                    InterlockedAdd(g_tileHash, Hash(packed ^ Hash(groupIndex + 1)));
+                    InterlockedAdd(g_tileHash2, Hash2(packed + Hash2(groupIndex + 0x9e3779b9u)));
+                    InterlockedAdd(g_tileLuma, (c.r * 77 + c.g * 150 + c.b * 29 + 128) >> 8);
+                }
+                GroupMemoryBarrierWithGroupSync();
+
+                if (groupIndex == 0)
+                {
+                    const uint numTilesX = (width + 15) / 16;
+                    const uint numTiles = numTilesX * ((height + 15) / 16);
+                    const uint tileIndex = groupId.y * numTilesX + groupId.x;
+                    TileSignatures[tileIndex * 2] = g_tileHash;
+                    TileSignatures[tileIndex * 2 + 1] = g_tileHash2;
+                    TileSignatures[numTiles * 2 + tileIndex] = g_tileLuma;
+                }
+            }
+        )";
+        // シェーダーコンパイル
+        wgc::com_ptr<ID3DBlob> pBlob;
+        wgc::com_ptr<ID3DBlob> pErrors;
+        {
+            const auto result = D3DCompile(
+                hlslSourceCode,
+                sizeof(hlslSourceCode),
+                "frame_signature_cs",
+                /*pDefines=*/nullptr,
+                /*pInclude=*/nullptr,
+                "main",
+                "cs_5_0",
+                D3DCOMPILE_OPTIMIZATION_LEVEL3,
+                /*Flags2=*/0,
+                pBlob.put(),
+                pErrors.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to D3DCompile", result);
+            }
+        }
+        // シェーダーオブジェクトを生成
+        wgc::com_ptr<ID3D11ComputeShader> pComputeShader;
+        {
+            const auto result = ayc::d3d11::Device()->CreateComputeShader(
+                pBlob->GetBufferPointer(),
+                pBlob->GetBufferSize(),
+                /*pClassLinkage=*/nullptr,
+                pComputeShader.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateComputeShader", result);
+            }
+        }
+        return pComputeShader;
+    }
+
+    // コンピュートシェーダーを取得する
+    ID3D11ComputeShader* _GetComputeShader()
+    {
+        static auto pShader = _CreateComputeShader();
+        return pShader.get();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+namespace
+{
+    // タイル１つあたりの uint の数（チェックサムの下位・上位、輝度）
+    const std::size_t SIGNATURE_UINTS_PER_TILE = 3;
+
+    // 使い回すために取っておく読み出し用バッファの数
+    // @note: 読み出し待ちはセッションごとに１つなので、同時に走るセッション数くらいあれば足りる
+    const std::size_t SIGNATURE_STAGING_BUFFER_POOL_SIZE = 8;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Variables
+//-----------------------------------------------------------------------------
+namespace
+{
+    // 署名の書き出し先バッファ
+    /* @note:
+        要素数はタイル数の３倍（チェックサム、輝度の順）。
+        毎フレーム生成し直すのは無駄なので、タイル数が変わるまで使い回す。
+        読み出し用バッファは読み出し待ちの署名ごとに要るので、返ってきたものを取っておいて使い回す。
+        キャプチャワーカーは複数スレッドありうるので、発行全体を s_guard で直列化する。
+        （コンピュートシェーダーのステートを他スレッドに上書きされないようにする意味もある）
+    */
+    struct _SIGNATURE_BUFFERS
+    {
+        std::size_t                                 numTiles;
+        wgc::com_ptr<ID3D11Buffer>                  pBuffer;
+        wgc::com_ptr<ID3D11UnorderedAccessView>     pUAV;
+        std::vector<wgc::com_ptr<ID3D11Buffer>>     freeStagingBuffers;
+    };
+    std::mutex s_guard;
+    _SIGNATURE_BUFFERS s_buffers{};
+
+    // 書き出し先バッファを必要なら作り直す
+    void _PrepareSignatureBuffers(std::size_t numTiles)
+    {
+        // エイリアス
+        auto pDevice = ayc::d3d11::Device().get();
+
+        // 使い回せるなら何もしない
+        if (s_buffers.numTiles == numTiles)
+        {
+            return;
+        }
+        // GPU 側バッファ
+        _SIGNATURE_BUFFERS buffers{};
+        buffers.numTiles = numTiles;
+        {
+            D3D11_BUFFER_DESC desc{};
+            {
+                desc.ByteWidth = static_cast<UINT>(numTiles * SIGNATURE_UINTS_PER_TILE * sizeof(std::uint32_t));
+                desc.Usage = D3D11_USAGE_DEFAULT;
+                desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+                desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+                desc.StructureByteStride = sizeof(std::uint32_t);
+            }
+            const auto result = pDevice->CreateBuffer(&desc, nullptr, buffers.pBuffer.put());
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateBuffer", result);
+            }
+        }
+        // UAV
+        {
+            D3D11_UNORDERED_ACCESS_VIEW_DESC desc{};
+            {
+                desc.Format = DXGI_FORMAT_UNKNOWN;
+                desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+                desc.Buffer.FirstElement = 0;
+                desc.Buffer.NumElements = static_cast<UINT>(numTiles * SIGNATURE_UINTS_PER_TILE);
+            }
+            const auto result = pDevice->CreateUnorderedAccessView(
+                buffers.pBuffer.get(),
+                &desc,
+                buffers.pUAV.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateUnorderedAccessView", result);
+            }
+        }
+        s_buffers = std::move(buffers);
+    }
+
+    // 読み出し用バッファを得る
+    // @note: s_guard をロックして呼ぶこと
+    wgc::com_ptr<ID3D11Buffer> _AcquireStagingBuffer()
+    {
+        // 取っておいたものがあれば使い回す
+        if (!s_buffers.freeStagingBuffers.empty())
+        {
+            auto pStagingBuffer = std::move(s_buffers.freeStagingBuffers.back());
+            s_buffers.freeStagingBuffers.pop_back();
+            return pStagingBuffer;
+        }
+        // 無ければ生成
+        D3D11_BUFFER_DESC desc{};
+        {
+            desc.ByteWidth = static_cast<UINT>(s_buffers.numTiles * SIGNATURE_UINTS_PER_TILE * sizeof(std::uint32_t));
+            desc.Usage = D3D11_USAGE_STAGING;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            desc.StructureByteStride = sizeof(std::uint32_t);
+        }
+        wgc::com_ptr<ID3D11Buffer> pStagingBuffer;
+        const auto result = ayc::d3d11::Device()->CreateBuffer(&desc, nullptr, pStagingBuffer.put());
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateBuffer", result);
+        }
+        return pStagingBuffer;
+    }
+
+    // 読み出し用バッファを返す
+    // @note: タイル数が変わっていたら使い回せないので捨てる
+    void _ReleaseStagingBuffer(wgc::com_ptr<ID3D11Buffer> pStagingBuffer, std::size_t numTiles)
+    {
+        std::scoped_lock lock(s_guard);
+        if (s_buffers.numTiles == numTiles &&
+            s_buffers.freeStagingBuffers.size() < SIGNATURE_STAGING_BUFFER_POOL_SIZE)
+        {
+            s_buffers.freeStagingBuffers.push_back(std::move(pStagingBuffer));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// PendingFrameSignature
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::PendingFrameSignature::PendingFrameSignature(
+    const wgc::com_ptr<ID3D11Texture2D>& pSrcTex
+)
+    : m_pSignature()
+    , m_pStagingBuffer()
+{
+    // エイリアス
+    auto pDevice = ayc::d3d11::Device().get();
+    auto pContext = ayc::d3d11::Context().get();
+
+    // nullptr チェック
+    if (!pSrcTex)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Source Texture", pSrcTex);
+    }
+    // タイル数を解決
+    D3D11_TEXTURE2D_DESC srcDesc{};
+    {
+        pSrcTex->GetDesc(&srcDesc);
+    }
+    m_pSignature = std::make_shared<FRAME_SIGNATURE>();
+    {
+        m_pSignature->width = srcDesc.Width;
+        m_pSignature->height = srcDesc.Height;
+        m_pSignature->numTilesX = (srcDesc.Width + FRAME_SIGNATURE_TILE_SIZE - 1) / FRAME_SIGNATURE_TILE_SIZE;
+        m_pSignature->numTilesY = (srcDesc.Height + FRAME_SIGNATURE_TILE_SIZE - 1) / FRAME_SIGNATURE_TILE_SIZE;
+    }
+    const std::size_t numTiles = static_cast<std::size_t>(m_pSignature->numTilesX) * m_pSignature->numTilesY;
+    if (numTiles == 0)
+    {
+        return;
+    }
+    // コピー元 SRV を作成
+    wgc::com_ptr<ID3D11ShaderResourceView> pSrcSRV;
+    {
+        // desc
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+        {
+            srvDesc.Format = srcDesc.Format;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MostDetailedMip = 0;
+            srvDesc.Texture2D.MipLevels = 1;
+        }
+        // 生成
+        {
+            const auto result = pDevice->CreateShaderResourceView(
+                pSrcTex.get(),
+                &srvDesc,
+                pSrcSRV.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateShaderResourceView", result);
+            }
+        }
+    }
+    // ここから先は直列化
+    std::scoped_lock lock(s_guard);
+    _PrepareSignatureBuffers(numTiles);
+    m_pStagingBuffer = _AcquireStagingBuffer();
+
+    // Dispatch
+    {
+        // CS
+        {
+            ID3D11ShaderResourceView* srvs[] = { pSrcSRV.get() };
+            pContext->CSSetShaderResources(0, 1, srvs);
+            ID3D11UnorderedAccessView* uavs[] = { s_buffers.pUAV.get() };
+            pContext->CSSetUnorderedAccessViews(0, 1, uavs, nullptr);
+            pContext->CSSetShader(_GetComputeShader(), nullptr, 0);
+        }
+        // Dispatch
+        {
+            pContext->Dispatch(m_pSignature->numTilesX, m_pSignature->numTilesY, 1);
+        }
+        // 後始末
+        {
+            ID3D11ShaderResourceView* nullSRV[] = { nullptr };
+            pContext->CSSetShaderResources(0, 1, nullSRV);
+            ID3D11UnorderedAccessView* nullUAV[] = { nullptr };
+            pContext->CSSetUnorderedAccessViews(0, 1, nullUAV, nullptr);
+        }
+    }
+    // GPU --> 読み出し用バッファ
+    /* @note:
+        発行するだけで、完了は待たない。
+        書き出し先バッファは次の Dispatch で上書きされるが、GPU 上ではこのコピーの後に実行される。
+    */
+    {
+        pContext->CopyResource(m_pStagingBuffer.get(), s_buffers.pBuffer.get());
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::PendingFrameSignature::~PendingFrameSignature()
+{
+    if (m_pStagingBuffer)
+    {
+        const std::size_t numTiles = static_cast<std::size_t>(m_pSignature->numTilesX) * m_pSignature->numTilesY;
+        _ReleaseStagingBuffer(std::move(m_pStagingBuffer), numTiles);
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ayc::FRAME_SIGNATURE> ayc::PendingFrameSignature::Resolve()
+{
+    // 読み出し済み（タイルが無い場合を含む）なら、そのまま返す
+    if (!m_pStagingBuffer)
+    {
+        return m_pSignature;
+    }
+    // エイリアス
+    auto pContext = ayc::d3d11::Context().get();
+    const std::size_t numTiles = static_cast<std::size_t>(m_pSignature->numTilesX) * m_pSignature->numTilesY;
+
+    // マップ
+    /* @note:
+        まず待たずに試し、終わっていなければ送り出してから待つ。
+        発行から１フレーム経っていれば、待つことはまず無い。
+    */
+    D3D11_MAPPED_SUBRESOURCE mapped{};
+    {
+        HRESULT result = pContext->Map(m_pStagingBuffer.get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (result == DXGI_ERROR_WAS_STILL_DRAWING)
+        {
+            pContext->Flush();
+            result = pContext->Map(m_pStagingBuffer.get(), 0, D3D11_MAP_READ, 0, &mapped);
+        }
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11DeviceContext::Map", result);
+        }
+    }
+    // 読み出し用バッファ --> システムメモリ
+    {
+        ScopedCall scopedUnmap([]() {}, [&]() { pContext->Unmap(m_pStagingBuffer.get(), 0); });
+
+        const auto* const pTiles = static_cast<const std::uint32_t*>(mapped.pData);
+        m_pSignature->tiles.resize(numTiles);
+        for (std::size_t i = 0; i < numTiles; ++i)
+        {
+            m_pSignature->tiles[i] = (static_cast<std::uint64_t>(pTiles[i * 2 + 1]) << 32) | pTiles[i * 2];
+        }
+        m_pSignature->tileLumas.assign(pTiles + numTiles * 2, pTiles + numTiles * 3);
+    }
+    // 読み出し用バッファを返す
+    {
+        _ReleaseStagingBuffer(std::move(m_pStagingBuffer), numTiles);
+        m_pStagingBuffer = nullptr;
+    }
+    return m_pSignature;
+}
+
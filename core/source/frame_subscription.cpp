@@ -0,0 +1,283 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "frame_subscription.h"
+
+// other
+#include "utils.h"
+#include "wgc_session.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 新着フレーム待機のタイムアウト
+    // @note: この間隔で停止要求をチェックする
+    const double DISPATCHER_WAIT_TIMEOUT_IN_SEC = 0.1;
+}
+
+//-----------------------------------------------------------------------------
+// FrameSubscriber
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::FrameSubscriber::FrameSubscriber(
+    std::size_t maxPending,
+    OverflowPolicy overflowPolicy
+)
+    : m_guard()
+    , m_cv()
+    , m_queue()
+    , m_maxPending(maxPending)
+    , m_overflowPolicy(overflowPolicy)
+    , m_isClosed(false)
+    , m_stats{}
+{
+    // キュー長は正値じゃないとダメ
+    if (maxPending < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("maxPending must be positive", maxPending);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameSubscriber::Push(const SUBSCRIBED_FRAME& frame)
+{
+    {
+        std::unique_lock lock(m_guard);
+
+        // 溢れる場合は指定の挙動に従う
+        if (m_queue.size() >= m_maxPending)
+        {
+            switch (m_overflowPolicy)
+            {
+            case OverflowPolicy::DROP_OLDEST:
+                m_queue.pop_front();
+                m_stats.dropped += 1;
+                break;
+            case OverflowPolicy::DROP_NEWEST:
+                m_stats.dropped += 1;
+                return;
+            case OverflowPolicy::BLOCK:
+                m_cv.wait(lock, [&] { return m_isClosed || m_queue.size() < m_maxPending; });
+                break;
+            }
+        }
+        // クローズ済みなら捨てる
+        if (m_isClosed)
+        {
+            return;
+        }
+        // キューに詰める
+        m_queue.push_back(frame);
+        m_stats.pending = m_queue.size();
+    }
+    m_cv.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::FrameSubscriber::Pop(SUBSCRIBED_FRAME& outFrame)
+{
+    {
+        std::unique_lock lock(m_guard);
+        m_cv.wait(lock, [&] { return m_isClosed || !m_queue.empty(); });
+        if (m_isClosed)
+        {
+            return false;
+        }
+        outFrame = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_stats.pending = m_queue.size();
+    }
+    // @note: BLOCK で待機中のディスパッチャを起こす
+    m_cv.notify_all();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameSubscriber::MarkDelivered(const SUBSCRIBED_FRAME& frame)
+{
+    const auto lagInSec = toDurationInSec(NowFromQPC(), frame.timeSpan);
+    std::scoped_lock lock(m_guard);
+    m_stats.delivered += 1;
+    m_stats.latestLagInSec = lagInSec;
+    m_stats.maxLagInSec = std::max(m_stats.maxLagInSec, lagInSec);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameSubscriber::Close()
+{
+    {
+        std::scoped_lock lock(m_guard);
+        m_isClosed = true;
+        m_queue.clear();
+        m_stats.pending = 0;
+    }
+    m_cv.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+ayc::SUBSCRIBER_STATS ayc::FrameSubscriber::GetStats() const
+{
+    std::scoped_lock lock(m_guard);
+    return m_stats;
+}
+
+//-----------------------------------------------------------------------------
+// FrameDispatcher
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::FrameDispatcher::FrameDispatcher(const std::shared_ptr<WGCSession>& pWGCSession)
+    : m_pWGCSession(pWGCSession)
+    , m_guard()
+    , m_subscribers()
+    , m_isStopping(false)
+    , m_thread()
+{
+    // nullptr チェック
+    if (!pWGCSession)
+    {
+        throw MAKE_GENERAL_ERROR("Session Already Stopped");
+    }
+    // スレッド起動
+    {
+        m_thread = std::thread(std::bind(&FrameDispatcher::_ThreadHandler, this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameDispatcher::~FrameDispatcher()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<ayc::FrameSubscriber> ayc::FrameDispatcher::Subscribe(
+    std::size_t maxPending,
+    OverflowPolicy overflowPolicy
+)
+{
+    auto pSubscriber = std::make_shared<FrameSubscriber>(maxPending, overflowPolicy);
+    {
+        // @note: 停止の確認と追加を同じロックの中で行う。間に Close が割り込むと、追加した購読者が誰にもクローズされない
+        std::scoped_lock lock(m_guard);
+        if (m_isStopping)
+        {
+            throw MAKE_GENERAL_ERROR("FrameDispatcher Already Closed");
+        }
+        m_subscribers.push_back(pSubscriber);
+    }
+    return pSubscriber;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameDispatcher::Unsubscribe(const std::shared_ptr<FrameSubscriber>& pSubscriber)
+{
+    // @note: 先にクローズしておかないと、BLOCK で待機中のディスパッチャが起きない
+    if (pSubscriber)
+    {
+        pSubscriber->Close();
+    }
+    std::scoped_lock lock(m_guard);
+    std::erase(m_subscribers, pSubscriber);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameDispatcher::Close()
+{
+    // スレッドに停止を要求
+    m_isStopping = true;
+
+    // 全購読者をクローズ
+    {
+        std::scoped_lock lock(m_guard);
+        for (const auto& pSubscriber : m_subscribers)
+        {
+            pSubscriber->Close();
+        }
+        m_subscribers.clear();
+    }
+    // スレッド終了を待機
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    // セッションへの参照を切る
+    {
+        m_pWGCSession.reset();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::FrameDispatcher::_ThreadHandler()
+{
+    try
+    {
+        // @note: 読み出しに使うステージングテクスチャはセッションに記帳する
+        MemoryTrackerScope trackerScope(m_pWGCSession->GetMemoryAccount()->GetTracker());
+
+        // @note: 0 から始めることで、起動時点の最新フレームから配送対象にする
+        std::uint64_t lastSeq = 0;
+        while (!m_isStopping)
+        {
+            // 新着フレームを待機
+            const auto frame = m_pWGCSession->WaitFrame(lastSeq, DISPATCHER_WAIT_TIMEOUT_IN_SEC);
+            if (!frame.pTexture)
+            {
+                continue;
+            }
+            lastSeq = frame.seq;
+
+            // 配送先のリストを確定させる
+            std::vector<std::shared_ptr<FrameSubscriber>> subscribers;
+            {
+                std::scoped_lock lock(m_guard);
+                subscribers = m_subscribers;
+            }
+            if (subscribers.empty())
+            {
+                continue;
+            }
+            // 読み出しは１フレームにつき１回だけ
+            auto pResult = std::make_shared<AsyncTextureReadback::RESULT>();
+            ReadbackTexture(
+                pResult->width,
+                pResult->height,
+                pResult->textureBuffer,
+                frame.pTexture
+            );
+            // 全購読者に配る
+            const SUBSCRIBED_FRAME subscribedFrame{ frame.seq, frame.timeSpan, std::move(pResult) };
+            for (const auto& pSubscriber : subscribers)
+            {
+                pSubscriber->Push(subscribedFrame);
+            }
+        }
+    }
+    catch (const ayc::GeneralError& e)
+    {
+        // @note: セッション側で起きたエラーは Session 側の呼び出しで再送されるので、ここではログだけ出す
+        WRITE_LOG_GENERAL_ERROR("In FrameDispatcher::_ThreadHandler, dispatching has stopped.", e);
+    }
+    catch (const std::exception& e)
+    {
+        WRITE_LOG_CPP_EXCEPTION("In FrameDispatcher::_ThreadHandler, dispatching has stopped.", e);
+    }
+    // 配送が止まったことを購読者に知らせる
+    {
+        std::scoped_lock lock(m_guard);
+        m_isStopping = true;
+        for (const auto& pSubscriber : m_subscribers)
+        {
+            pSubscriber->Close();
+        }
+    }
+}
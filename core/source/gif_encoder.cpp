@@ -0,0 +1,1009 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "gif_encoder.h"
+
+// other
+#include "thread_pool.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 一度に処理するフレーム数（スレッドあたり）
+    // @note: 減色後のインデックスを溜め込みすぎないための上限
+    const std::size_t GIF_BATCH_FRAMES_PER_THREAD = 2;
+
+    // ヒストグラムのチャンネルあたりのビット数
+    const std::size_t GIF_HISTOGRAM_BITS = 5;
+
+    // ヒストグラムのビン数
+    const std::size_t GIF_HISTOGRAM_SIZE = std::size_t(1) << (GIF_HISTOGRAM_BITS * 3);
+
+    // k-means で仕上げる最大反復回数
+    const std::size_t GIF_KMEANS_ITERATIONS = 4;
+
+    // 表示時間の下限（1/100 秒）
+    // @note: これより短いとブラウザ等が 1/10 秒に引き延ばしてしまう
+    const std::uint32_t GIF_MIN_DELAY_IN_CS = 2;
+
+    // 表示時間の上限（1/100 秒）
+    const std::uint32_t GIF_MAX_DELAY_IN_CS = 0xFFFF;
+
+    // フレームが１枚しか無い場合の表示時間（1/100 秒）
+    const std::uint32_t GIF_SINGLE_FRAME_DELAY_IN_CS = 10;
+
+    // 画像サイズの上限
+    const std::size_t GIF_MAX_DIMENSION = 0xFFFF;
+
+    // LZW の符号の最大ビット数
+    const std::size_t GIF_LZW_MAX_CODE_SIZE = 12;
+
+    // LZW 辞書のハッシュテーブルのサイズ
+    // @note: 辞書の最大エントリ数 4096 の倍にして、衝突を抑える
+    const std::size_t GIF_LZW_HASH_SIZE = 8192;
+
+    // データサブブロックの最大バイト数
+    const std::size_t GIF_SUB_BLOCK_SIZE = 255;
+
+    // WriteFile １回で書き込む最大バイト数
+    const std::uint64_t GIF_WRITE_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+
+    // 未解決のパレットインデックス
+    const std::uint16_t GIF_NO_INDEX = 0xFFFF;
+
+    // 8x8 の Bayer 行列
+    const int GIF_BAYER_8X8[64] =
+    {
+         0, 32,  8, 40,  2, 34, 10, 42,
+        48, 16, 56, 24, 50, 18, 58, 26,
+        12, 44,  4, 36, 14, 46,  6, 38,
+        60, 28, 52, 20, 62, 30, 54, 22,
+         3, 35, 11, 43,  1, 33,  9, 41,
+        51, 19, 59, 27, 49, 17, 57, 25,
+        15, 47,  7, 39, 13, 45,  5, 37,
+        63, 31, 55, 23, 61, 29, 53, 21,
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // パレット（R, G, B の順）
+    using _PALETTE = std::vector<std::array<std::uint8_t, 3>>;
+
+    // ヒストグラムのビン
+    struct _COLOR_BIN
+    {
+        std::uint64_t   count;
+        std::uint64_t   sum[3];     // @note: R, G, B の順
+    };
+    using _HISTOGRAM = std::vector<_COLOR_BIN>;
+
+    // パレット生成の対象になる色
+    struct _COLOR_ENTRY
+    {
+        double          color[3];   // @note: ビン内の平均色
+        std::uint64_t   count;
+    };
+
+    // メディアンカットの箱
+    struct _COLOR_BOX
+    {
+        std::size_t     begin;
+        std::size_t     end;
+        std::uint64_t   count;
+        std::size_t     axis;       // @note: 最も広がっている軸
+        double          extent;     // @note: その軸の広がり
+    };
+
+    // 符号化済みのフレーム
+    struct _ENCODED_FRAME
+    {
+        bool            isEmpty;            // @note: 直前のフレームから変化が無い
+        bool            hasTransparency;
+        std::uint8_t    transparentIndex;
+        std::string     body;               // @note: イメージディスクリプタ以降
+    };
+
+    // 色 --> パレットインデックスの対応表
+    /* @note:
+        ヒストグラムと同じ粒度のビンごとに、最も近いパレット色を初めて引いたときに解決する。
+        フレーム１枚に現れる色はビン全体のごく一部なので、全ビンを先に解決するより速い。
+        スレッド間では共有しないこと。
+    */
+    class _ColorMapper
+    {
+    public:
+        explicit _ColorMapper(const _PALETTE& palette)
+            : m_palette(palette)
+            , m_table(GIF_HISTOGRAM_SIZE, GIF_NO_INDEX)
+        {
+            // nop
+        }
+
+        std::uint8_t Map(int r, int g, int b)
+        {
+            const std::size_t bin = (
+                (static_cast<std::size_t>(r) >> (8 - GIF_HISTOGRAM_BITS) << (GIF_HISTOGRAM_BITS * 2)) |
+                (static_cast<std::size_t>(g) >> (8 - GIF_HISTOGRAM_BITS) << GIF_HISTOGRAM_BITS) |
+                (static_cast<std::size_t>(b) >> (8 - GIF_HISTOGRAM_BITS))
+            );
+            auto& index = m_table[bin];
+            if (index == GIF_NO_INDEX)
+            {
+                index = _FindNearest(bin);
+            }
+            return static_cast<std::uint8_t>(index);
+        }
+
+    private:
+        std::uint16_t _FindNearest(std::size_t bin) const
+        {
+            // @note: ビンの中心色で探す
+            const int mask = (1 << GIF_HISTOGRAM_BITS) - 1;
+            const int half = 1 << (7 - GIF_HISTOGRAM_BITS);
+            const int r = ((static_cast<int>(bin >> (GIF_HISTOGRAM_BITS * 2)) & mask) << (8 - GIF_HISTOGRAM_BITS)) + half;
+            const int g = ((static_cast<int>(bin >> GIF_HISTOGRAM_BITS) & mask) << (8 - GIF_HISTOGRAM_BITS)) + half;
+            const int b = ((static_cast<int>(bin) & mask) << (8 - GIF_HISTOGRAM_BITS)) + half;
+            std::uint16_t bestIndex = 0;
+            int bestDistance = std::numeric_limits<int>::max();
+            for (std::size_t i = 0; i < m_palette.size(); ++i)
+            {
+                const int dr = r - m_palette[i][0];
+                const int dg = g - m_palette[i][1];
+                const int db = b - m_palette[i][2];
+                const int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = static_cast<std::uint16_t>(i);
+                }
+            }
+            return bestIndex;
+        }
+
+        const _PALETTE&             m_palette;
+        std::vector<std::uint16_t>  m_table;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 値を 0 〜 255 に収める
+    int _Clamp8(int value)
+    {
+        return std::clamp(value, 0, 255);
+    }
+
+    // 色数を表すのに必要なカラーテーブルのビット数（1 〜 8）
+    std::size_t _ColorTableBits(std::size_t numColors)
+    {
+        std::size_t bits = 1;
+        while ((std::size_t(1) << bits) < numColors)
+        {
+            bits += 1;
+        }
+        return bits;
+    }
+
+    // リトルエンディアンの 16bit 値を追記する
+    void _AppendU16(std::string& out, std::size_t value)
+    {
+        out.push_back(static_cast<char>(value & 0xFF));
+        out.push_back(static_cast<char>((value >> 8) & 0xFF));
+    }
+
+    // カラーテーブルを追記する
+    // @note: 2^bits 色に満たない分はゼロで埋める
+    void _AppendColorTable(std::string& out, const _PALETTE& palette, std::size_t bits)
+    {
+        const std::size_t numEntries = std::size_t(1) << bits;
+        for (std::size_t i = 0; i < numEntries; ++i)
+        {
+            const auto color = i < palette.size() ? palette[i] : std::array<std::uint8_t, 3>{ 0, 0, 0 };
+            out.append(reinterpret_cast<const char*>(color.data()), color.size());
+        }
+    }
+
+    // 全バイトを書き込む
+    void _WriteAll(HANDLE hFile, const void* pData, std::uint64_t sizeInBytes)
+    {
+        auto pBytes = static_cast<const std::uint8_t*>(pData);
+        while (sizeInBytes > 0)
+        {
+            const auto chunkSize = static_cast<DWORD>(std::min(sizeInBytes, GIF_WRITE_CHUNK_SIZE));
+            DWORD numWritten = 0;
+            if (!WriteFile(hFile, pBytes, chunkSize, &numWritten, nullptr))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("WriteFile failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+            if (numWritten == 0)
+            {
+                throw MAKE_GENERAL_ERROR("WriteFile wrote nothing");
+            }
+            pBytes += numWritten;
+            sizeInBytes -= numWritten;
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    // フレームの色をヒストグラムに足し込む
+    void _AccumulateHistogram(_HISTOGRAM& histogram, const ayc::GIF_FRAME& frame)
+    {
+        const auto* pSrc = frame.frameBuffer.data();
+        const std::size_t numPixels = frame.width * frame.height;
+        for (std::size_t i = 0; i < numPixels; ++i, pSrc += BYTES_PER_PIXEL)
+        {
+            const std::size_t bin = (
+                (static_cast<std::size_t>(pSrc[2]) >> (8 - GIF_HISTOGRAM_BITS) << (GIF_HISTOGRAM_BITS * 2)) |
+                (static_cast<std::size_t>(pSrc[1]) >> (8 - GIF_HISTOGRAM_BITS) << GIF_HISTOGRAM_BITS) |
+                (static_cast<std::size_t>(pSrc[0]) >> (8 - GIF_HISTOGRAM_BITS))
+            );
+            auto& colorBin = histogram[bin];
+            colorBin.count += 1;
+            colorBin.sum[0] += pSrc[2];
+            colorBin.sum[1] += pSrc[1];
+            colorBin.sum[2] += pSrc[0];
+        }
+    }
+
+    // 箱の統計を解決する
+    _COLOR_BOX _MakeColorBox(const std::vector<_COLOR_ENTRY>& entries, std::size_t begin, std::size_t end)
+    {
+        _COLOR_BOX box{ begin, end, 0, 0, 0.0 };
+        double minColor[3] = { 255.0, 255.0, 255.0 };
+        double maxColor[3] = { 0.0, 0.0, 0.0 };
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            box.count += entries[i].count;
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                minColor[c] = std::min(minColor[c], entries[i].color[c]);
+                maxColor[c] = std::max(maxColor[c], entries[i].color[c]);
+            }
+        }
+        for (std::size_t c = 0; c < 3; ++c)
+        {
+            if (maxColor[c] - minColor[c] > box.extent)
+            {
+                box.extent = maxColor[c] - minColor[c];
+                box.axis = c;
+            }
+        }
+        return box;
+    }
+
+    // ヒストグラムからパレットを作る
+    /* @note:
+        メディアンカットで色空間を「画素数 x 広がり」の大きい箱から順に分割して初期値を作り、
+        k-means で各色をその色に割り当てられた画素の重心に寄せる。
+        対象はヒストグラムの空でないビンだけなので、画素数に依らず高々 32768 要素で済む。
+    */
+    _PALETTE _BuildPalette(const _HISTOGRAM& histogram, std::size_t maxColors)
+    {
+        // 空でないビンを集める
+        std::vector<_COLOR_ENTRY> entries;
+        for (const auto& colorBin : histogram)
+        {
+            if (colorBin.count == 0)
+            {
+                continue;
+            }
+            _COLOR_ENTRY entry{};
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                entry.color[c] = static_cast<double>(colorBin.sum[c]) / static_cast<double>(colorBin.count);
+            }
+            entry.count = colorBin.count;
+            entries.push_back(entry);
+        }
+        if (entries.empty())
+        {
+            return _PALETTE{ { 0, 0, 0 } };
+        }
+        // メディアンカット
+        std::vector<_COLOR_BOX> boxes{ _MakeColorBox(entries, 0, entries.size()) };
+        while (boxes.size() < maxColors)
+        {
+            // 分割する箱を選ぶ
+            auto iter = boxes.end();
+            double bestScore = 0.0;
+            for (auto i = boxes.begin(); i != boxes.end(); ++i)
+            {
+                const double score = static_cast<double>(i->count) * i->extent;
+                if (i->end - i->begin >= 2 && score > bestScore)
+                {
+                    bestScore = score;
+                    iter = i;
+                }
+            }
+            if (iter == boxes.end())
+            {
+                break;
+            }
+            // 最も広がっている軸で、画素数の中央で分割する
+            const auto box = *iter;
+            std::sort(
+                entries.begin() + box.begin,
+                entries.begin() + box.end,
+                [&](const auto& a, const auto& b) { return a.color[box.axis] < b.color[box.axis]; }
+            );
+            std::size_t split = box.begin + 1;
+            {
+                std::uint64_t accumulated = entries[box.begin].count;
+                while (split < box.end - 1 && accumulated * 2 < box.count)
+                {
+                    accumulated += entries[split].count;
+                    split += 1;
+                }
+            }
+            *iter = _MakeColorBox(entries, box.begin, split);
+            boxes.push_back(_MakeColorBox(entries, split, box.end));
+        }
+        // 箱の重心を初期値にする
+        std::vector<std::array<double, 3>> centroids(boxes.size());
+        for (std::size_t k = 0; k < boxes.size(); ++k)
+        {
+            double sum[3] = { 0.0, 0.0, 0.0 };
+            for (std::size_t i = boxes[k].begin; i < boxes[k].end; ++i)
+            {
+                for (std::size_t c = 0; c < 3; ++c)
+                {
+                    sum[c] += entries[i].color[c] * static_cast<double>(entries[i].count);
+                }
+            }
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                centroids[k][c] = sum[c] / static_cast<double>(boxes[k].count);
+            }
+        }
+        // k-means で仕上げる
+        // @note: 割り当てが変わらなくなったら打ち切る
+        std::vector<std::size_t> assignments(entries.size(), boxes.size());
+        for (std::size_t iteration = 0; iteration < GIF_KMEANS_ITERATIONS; ++iteration)
+        {
+            bool isChanged = false;
+            std::vector<std::array<double, 4>> sums(centroids.size(), { 0.0, 0.0, 0.0, 0.0 });
+            for (std::size_t i = 0; i < entries.size(); ++i)
+            {
+                const auto& entry = entries[i];
+                std::size_t bestIndex = 0;
+                double bestDistance = std::numeric_limits<double>::max();
+                for (std::size_t k = 0; k < centroids.size(); ++k)
+                {
+                    const double dr = entry.color[0] - centroids[k][0];
+                    const double dg = entry.color[1] - centroids[k][1];
+                    const double db = entry.color[2] - centroids[k][2];
+                    const double distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        bestIndex = k;
+                    }
+                }
+                if (assignments[i] != bestIndex)
+                {
+                    assignments[i] = bestIndex;
+                    isChanged = true;
+                }
+                const double weight = static_cast<double>(entry.count);
+                for (std::size_t c = 0; c < 3; ++c)
+                {
+                    sums[bestIndex][c] += entry.color[c] * weight;
+                }
+                sums[bestIndex][3] += weight;
+            }
+            if (!isChanged)
+            {
+                break;
+            }
+            // @note: 誰も割り当てられなかった色はそのまま残す
+            for (std::size_t k = 0; k < centroids.size(); ++k)
+            {
+                if (sums[k][3] > 0.0)
+                {
+                    for (std::size_t c = 0; c < 3; ++c)
+                    {
+                        centroids[k][c] = sums[k][c] / sums[k][3];
+                    }
+                }
+            }
+        }
+        // 8bit に丸める
+        _PALETTE palette(centroids.size());
+        for (std::size_t k = 0; k < centroids.size(); ++k)
+        {
+            for (std::size_t c = 0; c < 3; ++c)
+            {
+                palette[k][c] = static_cast<std::uint8_t>(_Clamp8(static_cast<int>(std::lround(centroids[k][c]))));
+            }
+        }
+        return palette;
+    }
+
+    //-----------------------------------------------------------------------------
+    // フレームをパレットインデックスに置き換える
+    void _MapFrame(
+        std::vector<std::uint8_t>& indices,
+        const ayc::GIF_FRAME& frame,
+        const _PALETTE& palette,
+        ayc::GifDither dither
+    )
+    {
+        // エイリアス
+        const std::size_t width = frame.width;
+        const std::size_t height = frame.height;
+        const auto* const pSrc = frame.frameBuffer.data();
+
+        _ColorMapper mapper(palette);
+        indices.resize(width * height);
+        switch (dither)
+        {
+        case ayc::GifDither::NONE:
+            {
+                for (std::size_t i = 0; i < width * height; ++i)
+                {
+                    const auto* p = pSrc + i * BYTES_PER_PIXEL;
+                    indices[i] = mapper.Map(p[2], p[1], p[0]);
+                }
+            }
+            break;
+        case ayc::GifDither::ORDERED:
+            {
+                // しきい値の振れ幅
+                // @note: パレット色の平均的な間隔の半分程度。色数が少ないほど大きく揺らす
+                const double amplitude = 128.0 / std::cbrt(static_cast<double>(palette.size()));
+                int offsets[64];
+                for (std::size_t i = 0; i < 64; ++i)
+                {
+                    offsets[i] = static_cast<int>(std::lround(((GIF_BAYER_8X8[i] + 0.5) / 64.0 - 0.5) * amplitude));
+                }
+                for (std::size_t y = 0; y < height; ++y)
+                {
+                    const int* const pRowOffsets = offsets + (y & 7) * 8;
+                    const auto* p = pSrc + y * width * BYTES_PER_PIXEL;
+                    auto* pDest = indices.data() + y * width;
+                    for (std::size_t x = 0; x < width; ++x, p += BYTES_PER_PIXEL)
+                    {
+                        const int offset = pRowOffsets[x & 7];
+                        pDest[x] = mapper.Map(_Clamp8(p[2] + offset), _Clamp8(p[1] + offset), _Clamp8(p[0] + offset));
+                    }
+                }
+            }
+            break;
+        case ayc::GifDither::FLOYD_STEINBERG:
+            {
+                // 誤差は 16 倍して整数で持つ
+                // @note: 左右に１画素ずつ余白を持たせ、端の判定を省く
+                std::vector<int> currErrors((width + 2) * 3, 0);
+                std::vector<int> nextErrors((width + 2) * 3, 0);
+                for (std::size_t y = 0; y < height; ++y)
+                {
+                    // @note: 行ごとに走査方向を反転して、誤差の偏りを抑える
+                    const bool isReversed = (y & 1) != 0;
+                    std::fill(nextErrors.begin(), nextErrors.end(), 0);
+                    for (std::size_t i = 0; i < width; ++i)
+                    {
+                        const std::size_t x = isReversed ? width - 1 - i : i;
+                        const std::size_t ahead = isReversed ? x : x + 2;
+                        const std::size_t behind = isReversed ? x + 2 : x;
+                        const auto* p = pSrc + (y * width + x) * BYTES_PER_PIXEL;
+                        const int* e = currErrors.data() + (x + 1) * 3;
+                        const int r = _Clamp8(p[2] + e[0] / 16);
+                        const int g = _Clamp8(p[1] + e[1] / 16);
+                        const int b = _Clamp8(p[0] + e[2] / 16);
+                        const auto index = mapper.Map(r, g, b);
+                        indices[y * width + x] = index;
+                        const int errors[3] = { r - palette[index][0], g - palette[index][1], b - palette[index][2] };
+                        for (std::size_t c = 0; c < 3; ++c)
+                        {
+                            currErrors[ahead * 3 + c] += errors[c] * 7;
+                            nextErrors[behind * 3 + c] += errors[c] * 3;
+                            nextErrors[(x + 1) * 3 + c] += errors[c] * 5;
+                            nextErrors[ahead * 3 + c] += errors[c] * 1;
+                        }
+                    }
+                    std::swap(currErrors, nextErrors);
+                }
+            }
+            break;
+        default:
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Unknown dither", static_cast<int>(dither));
+        }
+    }
+
+    //-----------------------------------------------------------------------------
+    // LZW で符号化して、データサブブロックとして追記する
+    /* @note:
+        辞書は「接頭辞の符号 x 次の１文字」をキーにしたハッシュテーブルで持つ。
+        辞書が満杯（4096 符号）になったらクリア符号を出して作り直す。
+        作り直しのたびにテーブルを消すと遅いので、世代番号で無効化する。
+    */
+    void _AppendLZW(std::string& out, const std::uint8_t* pIndices, std::size_t numIndices, std::size_t minCodeSize)
+    {
+        // 辞書
+        struct _SLOT
+        {
+            std::uint32_t   generation;
+            std::uint32_t   key;
+            std::uint16_t   code;
+        };
+        std::vector<_SLOT> slots(GIF_LZW_HASH_SIZE, _SLOT{ 0, 0, 0 });
+        std::uint32_t generation = 1;
+
+        // 符号の書き出し
+        std::uint8_t block[GIF_SUB_BLOCK_SIZE];
+        std::size_t blockSize = 0;
+        std::uint32_t bitBuffer = 0;
+        std::size_t numBits = 0;
+        const auto flushBlock = [&]()
+        {
+            if (blockSize > 0)
+            {
+                out.push_back(static_cast<char>(blockSize));
+                out.append(reinterpret_cast<const char*>(block), blockSize);
+                blockSize = 0;
+            }
+        };
+        const auto writeCode = [&](std::uint32_t code, std::size_t codeSize)
+        {
+            bitBuffer |= code << numBits;
+            numBits += codeSize;
+            while (numBits >= 8)
+            {
+                block[blockSize++] = static_cast<std::uint8_t>(bitBuffer & 0xFF);
+                bitBuffer >>= 8;
+                numBits -= 8;
+                if (blockSize == GIF_SUB_BLOCK_SIZE)
+                {
+                    flushBlock();
+                }
+            }
+        };
+
+        // 符号化
+        const std::uint32_t clearCode = std::uint32_t(1) << minCodeSize;
+        const std::uint32_t endCode = clearCode + 1;
+        std::size_t codeSize = minCodeSize + 1;
+        std::uint32_t nextCode = endCode + 1;
+        out.push_back(static_cast<char>(minCodeSize));
+        writeCode(clearCode, codeSize);
+        if (numIndices > 0)
+        {
+            std::uint32_t prefix = pIndices[0];
+            for (std::size_t i = 1; i < numIndices; ++i)
+            {
+                const std::uint32_t suffix = pIndices[i];
+                const std::uint32_t key = (prefix << 8) | suffix;
+                std::size_t slot = (key * 2654435761u) & (GIF_LZW_HASH_SIZE - 1);
+                bool isFound = false;
+                while (slots[slot].generation == generation)
+                {
+                    if (slots[slot].key == key)
+                    {
+                        isFound = true;
+                        break;
+                    }
+                    slot = (slot + 1) & (GIF_LZW_HASH_SIZE - 1);
+                }
+                if (isFound)
+                {
+                    prefix = slots[slot].code;
+                    continue;
+                }
+                // 一致が途切れたので接頭辞を出力して、辞書に追加する
+                // @note: 追加した符号が今のビット数で表せなくなったら、次からビット数を増やす
+                writeCode(prefix, codeSize);
+                const std::uint32_t code = nextCode++;
+                slots[slot] = _SLOT{ generation, key, static_cast<std::uint16_t>(code) };
+                if (code >= (std::uint32_t(1) << codeSize) && codeSize < GIF_LZW_MAX_CODE_SIZE)
+                {
+                    codeSize += 1;
+                }
+                if (code == (std::uint32_t(1) << GIF_LZW_MAX_CODE_SIZE) - 1)
+                {
+                    writeCode(clearCode, codeSize);
+                    generation += 1;
+                    codeSize = minCodeSize + 1;
+                    nextCode = endCode + 1;
+                }
+                prefix = suffix;
+            }
+            writeCode(prefix, codeSize);
+        }
+        writeCode(endCode, codeSize);
+        if (numBits > 0)
+        {
+            writeCode(0, 8 - numBits);
+        }
+        flushBlock();
+        out.push_back(0);
+    }
+
+    //-----------------------------------------------------------------------------
+    // フレームを１枚符号化する
+    /* @note:
+        直前のフレームが渡されたら、表示上の色が変わった画素を囲む矩形だけを書き出し、
+        矩形内で色が変わっていない画素は透過にする。
+        直前のフレームは「そのフレームを描いた後の画面」と一致する
+        （透過にした画素は、もともと同じ色だった画素だけなので）ため、
+        フレームごとに独立して並列に符号化できる。
+    */
+    void _EncodeFrame(
+        _ENCODED_FRAME& encoded,
+        const ayc::GIF_FRAME& frame,
+        const std::vector<std::uint8_t>& indices,
+        const _PALETTE& palette,
+        const std::vector<std::uint8_t>* pPrevIndices,
+        const _PALETTE* pPrevPalette,
+        bool isLocalPalette,
+        bool isDeltaEnabled
+    )
+    {
+        // エイリアス
+        const std::size_t width = frame.width;
+        const std::size_t height = frame.height;
+
+        // 変化した矩形を解決
+        std::size_t left = 0;
+        std::size_t top = 0;
+        std::size_t right = width;
+        std::size_t bottom = height;
+        std::vector<std::uint8_t> changed;
+        if (pPrevIndices)
+        {
+            changed.resize(width * height);
+            left = width;
+            top = height;
+            right = 0;
+            bottom = 0;
+            for (std::size_t y = 0; y < height; ++y)
+            {
+                for (std::size_t x = 0; x < width; ++x)
+                {
+                    const std::size_t i = y * width + x;
+                    const bool isChanged = palette[indices[i]] != (*pPrevPalette)[(*pPrevIndices)[i]];
+                    changed[i] = isChanged;
+                    if (isChanged)
+                    {
+                        left = std::min(left, x);
+                        top = std::min(top, y);
+                        right = std::max(right, x + 1);
+                        bottom = std::max(bottom, y + 1);
+                    }
+                }
+            }
+            if (right <= left)
+            {
+                encoded.isEmpty = true;
+                return;
+            }
+        }
+        // 矩形内のインデックスを集める
+        // @note: 透過色はパレットの直後に予約してある
+        const std::uint8_t transparentIndex = static_cast<std::uint8_t>(palette.size());
+        std::vector<std::uint8_t> rectIndices((right - left) * (bottom - top));
+        {
+            auto* pDest = rectIndices.data();
+            for (std::size_t y = top; y < bottom; ++y)
+            {
+                for (std::size_t x = left; x < right; ++x)
+                {
+                    const std::size_t i = y * width + x;
+                    *pDest++ = (pPrevIndices && !changed[i]) ? transparentIndex : indices[i];
+                }
+            }
+        }
+        // イメージディスクリプタ
+        const std::size_t tableBits = _ColorTableBits(palette.size() + (isDeltaEnabled ? 1 : 0));
+        encoded.isEmpty = false;
+        encoded.hasTransparency = pPrevIndices != nullptr;
+        encoded.transparentIndex = transparentIndex;
+        encoded.body.clear();
+        encoded.body.push_back(0x2C);
+        _AppendU16(encoded.body, left);
+        _AppendU16(encoded.body, top);
+        _AppendU16(encoded.body, right - left);
+        _AppendU16(encoded.body, bottom - top);
+        if (isLocalPalette)
+        {
+            encoded.body.push_back(static_cast<char>(0x80 | (tableBits - 1)));
+            _AppendColorTable(encoded.body, palette, tableBits);
+        }
+        else
+        {
+            encoded.body.push_back(0);
+        }
+        // 画像データ
+        // @note: GIF の LZW は最小符号長が２ビット以上
+        _AppendLZW(encoded.body, rectIndices.data(), rectIndices.size(), std::max<std::size_t>(tableBits, 2));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+std::vector<std::uint32_t> ayc::ResolveGifDelaysInCs(
+    const std::vector<double>& relativesInSec,
+    std::optional<double> fps
+)
+{
+    // パラメータチェック
+    if (fps.has_value() && !(fps.value() > 0.0))
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("fps must be positive", fps.value());
+    }
+    const std::size_t numFrames = relativesInSec.size();
+    if (numFrames == 0)
+    {
+        return {};
+    }
+    // 各フレームの表示開始時刻
+    // @note: 末尾のフレームは平均フレーム間隔だけ表示する
+    std::vector<double> startsInSec(numFrames + 1);
+    for (std::size_t i = 0; i < numFrames; ++i)
+    {
+        startsInSec[i] = (
+            fps.has_value()
+            ? static_cast<double>(i) / fps.value()
+            : std::max(relativesInSec.front() - relativesInSec[i], i > 0 ? startsInSec[i - 1] : 0.0)
+        );
+    }
+    {
+        const double durationInSec = startsInSec[numFrames - 1];
+        startsInSec[numFrames] = (
+            fps.has_value() ? durationInSec + 1.0 / fps.value() :
+            numFrames > 1 && durationInSec > 0.0 ? durationInSec * numFrames / (numFrames - 1) :
+            durationInSec + GIF_SINGLE_FRAME_DELAY_IN_CS / 100.0
+        );
+    }
+    // 1/100 秒単位に丸める
+    // @note: 丸め誤差と下限で延びた分を次のフレームに持ち越して、全体の長さを合わせる
+    std::vector<std::uint32_t> delaysInCs(numFrames);
+    std::int64_t elapsedInCs = 0;
+    for (std::size_t i = 0; i < numFrames; ++i)
+    {
+        const auto endInCs = static_cast<std::int64_t>(std::llround(startsInSec[i + 1] * 100.0));
+        const auto delayInCs = std::clamp<std::int64_t>(endInCs - elapsedInCs, GIF_MIN_DELAY_IN_CS, GIF_MAX_DELAY_IN_CS);
+        delaysInCs[i] = static_cast<std::uint32_t>(delayInCs);
+        elapsedInCs += delayInCs;
+    }
+    return delaysInCs;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::WriteGif(
+    const std::string& path,
+    const std::vector<GIF_FRAME>& frames,
+    const GIF_PARAM& param
+)
+{
+    // パラメータチェック
+    if (path.empty())
+    {
+        throw MAKE_GENERAL_ERROR("path must not be empty");
+    }
+    if (frames.empty())
+    {
+        throw MAKE_GENERAL_ERROR("No frames to write");
+    }
+    if (param.maxColors < 2 || param.maxColors > 256)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("maxColors must be in [2, 256]", param.maxColors);
+    }
+    std::size_t screenWidth = 0;
+    std::size_t screenHeight = 0;
+    for (const auto& frame : frames)
+    {
+        if (frame.width < 1 || frame.height < 1 || frame.width > GIF_MAX_DIMENSION || frame.height > GIF_MAX_DIMENSION)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid frame size", frame.width * frame.height);
+        }
+        if (frame.frameBuffer.size() < frame.width * frame.height * BYTES_PER_PIXEL)
+        {
+            throw MAKE_GENERAL_ERROR("Frame buffer is too small");
+        }
+        screenWidth = std::max(screenWidth, frame.width);
+        screenHeight = std::max(screenHeight, frame.height);
+    }
+    // 設定を解決
+    // @note: 差分化する場合は１色を透過色に充てる
+    const bool isLocalPalette = param.palette == GifPalette::LOCAL;
+    const std::size_t numColors = param.maxColors - (param.isDeltaEnabled ? 1 : 0);
+
+    // グローバルパレット
+    // @note: ヒストグラムはフレームごとに並列に作り、まとめて足し込む
+    _PALETTE globalPalette;
+    if (!isLocalPalette)
+    {
+        _HISTOGRAM histogram(GIF_HISTOGRAM_SIZE, _COLOR_BIN{});
+        std::mutex histogramGuard;
+        ayc::ThreadPool::Instance().ParallelFor(
+            frames.size(),
+            [&](std::size_t i)
+            {
+                _HISTOGRAM frameHistogram(GIF_HISTOGRAM_SIZE, _COLOR_BIN{});
+                _AccumulateHistogram(frameHistogram, frames[i]);
+                std::scoped_lock lock(histogramGuard);
+                for (std::size_t bin = 0; bin < GIF_HISTOGRAM_SIZE; ++bin)
+                {
+                    histogram[bin].count += frameHistogram[bin].count;
+                    for (std::size_t c = 0; c < 3; ++c)
+                    {
+                        histogram[bin].sum[c] += frameHistogram[bin].sum[c];
+                    }
+                }
+            }
+        );
+        globalPalette = _BuildPalette(histogram, numColors);
+    }
+    // ファイルを開く
+    HANDLE hFile = CreateFileA(
+        path.c_str(),
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+    );
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFile failed", HRESULT_FROM_WIN32(GetLastError()));
+    }
+    ScopedCall scopedClose([]() {}, [&]() { CloseHandle(hFile); });
+
+    // ヘッダ
+    {
+        std::string header = "GIF89a";
+        _AppendU16(header, screenWidth);
+        _AppendU16(header, screenHeight);
+        if (isLocalPalette)
+        {
+            header.push_back(static_cast<char>(0x70));
+            header.push_back(0);
+            header.push_back(0);
+        }
+        else
+        {
+            const std::size_t tableBits = _ColorTableBits(globalPalette.size() + (param.isDeltaEnabled ? 1 : 0));
+            header.push_back(static_cast<char>(0x80 | 0x70 | (tableBits - 1)));
+            header.push_back(0);
+            header.push_back(0);
+            _AppendColorTable(header, globalPalette, tableBits);
+        }
+        // @note: NETSCAPE2.0 拡張で無限ループにする
+        header.append("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+        _WriteAll(hFile, header.data(), header.size());
+    }
+    // 書き出し待ちのフレーム
+    /* @note:
+        直前から変化の無いフレームは書き出さず、表示時間を前のフレームに足し込む。
+        なので、次に書き出すフレームが決まるまで１枚手元に置いておく。
+        フレームのサイズが変わる場合は、前のフレームを背景に戻してから描かせる。
+    */
+    struct _PENDING_FRAME
+    {
+        _ENCODED_FRAME      encoded;
+        std::size_t         width;
+        std::size_t         height;
+        std::uint32_t       delayInCs;
+    };
+    std::optional<_PENDING_FRAME> pending;
+    const auto writePending = [&](std::optional<std::pair<std::size_t, std::size_t>> nextSize)
+    {
+        const auto& frame = pending.value();
+        const bool isResized = nextSize.has_value() && nextSize.value() != std::make_pair(frame.width, frame.height);
+        const std::uint8_t disposal = isResized ? 2 : 1;
+        std::string control = "\x21\xF9\x04";
+        control.push_back(static_cast<char>((disposal << 2) | (frame.encoded.hasTransparency ? 1 : 0)));
+        _AppendU16(control, std::min(frame.delayInCs, GIF_MAX_DELAY_IN_CS));
+        control.push_back(static_cast<char>(frame.encoded.hasTransparency ? frame.encoded.transparentIndex : 0));
+        control.push_back(0);
+        _WriteAll(hFile, control.data(), control.size());
+        _WriteAll(hFile, frame.encoded.body.data(), frame.encoded.body.size());
+    };
+
+    // 一定枚数ずつ、減色 --> 符号化 --> 書き出し
+    // @note: 呼び出し元スレッドも１本ぶん働く
+    const std::size_t numThreads = ayc::ThreadPool::Instance().GetNumWorkers() + 1;
+    const std::size_t batchSize = numThreads * GIF_BATCH_FRAMES_PER_THREAD;
+    std::vector<std::uint8_t> prevIndices;
+    _PALETTE prevPalette;
+    for (std::size_t batchBegin = 0; batchBegin < frames.size(); batchBegin += batchSize)
+    {
+        const std::size_t batchEnd = std::min(batchBegin + batchSize, frames.size());
+        const std::size_t numBatchFrames = batchEnd - batchBegin;
+
+        // 減色
+        std::vector<std::vector<std::uint8_t>> indices(numBatchFrames);
+        std::vector<_PALETTE> localPalettes(isLocalPalette ? numBatchFrames : 0);
+        ayc::ThreadPool::Instance().ParallelFor(
+            numBatchFrames,
+            [&](std::size_t i)
+            {
+                const auto& frame = frames[batchBegin + i];
+                if (isLocalPalette)
+                {
+                    _HISTOGRAM histogram(GIF_HISTOGRAM_SIZE, _COLOR_BIN{});
+                    _AccumulateHistogram(histogram, frame);
+                    localPalettes[i] = _BuildPalette(histogram, numColors);
+                }
+                _MapFrame(indices[i], frame, isLocalPalette ? localPalettes[i] : globalPalette, param.dither);
+            }
+        );
+        // 符号化
+        // @note: 差分化はサイズが同じ直前のフレームに対してだけ行う
+        std::vector<_ENCODED_FRAME> encoded(numBatchFrames);
+        ayc::ThreadPool::Instance().ParallelFor(
+            numBatchFrames,
+            [&](std::size_t i)
+            {
+                const std::size_t frameIndex = batchBegin + i;
+                const auto& frame = frames[frameIndex];
+                const auto& palette = isLocalPalette ? localPalettes[i] : globalPalette;
+                const std::vector<std::uint8_t>* pPrevIndices = nullptr;
+                const _PALETTE* pPrevPalette = nullptr;
+                if (param.isDeltaEnabled && frameIndex > 0)
+                {
+                    const auto& prevFrame = frames[frameIndex - 1];
+                    if (prevFrame.width == frame.width && prevFrame.height == frame.height)
+                    {
+                        pPrevIndices = i > 0 ? &indices[i - 1] : &prevIndices;
+                        pPrevPalette = !isLocalPalette ? &globalPalette : i > 0 ? &localPalettes[i - 1] : &prevPalette;
+                    }
+                }
+                _EncodeFrame(encoded[i], frame, indices[i], palette, pPrevIndices, pPrevPalette, isLocalPalette, param.isDeltaEnabled);
+            }
+        );
+        // 書き出し
+        for (std::size_t i = 0; i < numBatchFrames; ++i)
+        {
+            const auto& frame = frames[batchBegin + i];
+            if (encoded[i].isEmpty)
+            {
+                pending->delayInCs += frame.delayInCs;
+                continue;
+            }
+            if (pending.has_value())
+            {
+                writePending(std::make_pair(frame.width, frame.height));
+            }
+            pending = _PENDING_FRAME{ std::move(encoded[i]), frame.width, frame.height, frame.delayInCs };
+        }
+        // 次のバッチの差分化に使う
+        prevIndices = std::move(indices.back());
+        if (isLocalPalette)
+        {
+            prevPalette = std::move(localPalettes.back());
+        }
+    }
+    writePending(std::nullopt);
+
+    // トレイラ
+    {
+        const char trailer = 0x3B;
+        _WriteAll(hFile, &trailer, 1);
+    }
+}
@@ -0,0 +1,360 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "host_arena.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // HostArenaPool が取っておくアリーナの合計サイズの既定の上限
+    // @note: 1080p の BGR24 で 170 枚ほど。数秒のスナップショット１つ分は使い回せる
+    const std::size_t HOST_ARENA_POOL_DEFAULT_MAX_BYTES = std::size_t(1) << 30;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // ページサイズを得る
+    std::size_t _GetPageSize()
+    {
+        static const std::size_t s_pageSize = []()
+        {
+            SYSTEM_INFO info{};
+            GetSystemInfo(&info);
+            return static_cast<std::size_t>(info.dwPageSize);
+        }();
+        return s_pageSize;
+    }
+
+    // value を alignment の倍数に切り上げる
+    std::size_t _AlignUp(std::size_t value, std::size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // 大きいページを使えるようにする
+    /* @note:
+        大きいページの確保には SeLockMemoryPrivilege が要る。
+        ユーザーに権限が割り当てられていなければ有効にできないので、その時は false を返す。
+        結果はプロセスで１回だけ求めて覚えておく。
+    */
+    bool _EnableLargePages()
+    {
+        static const bool s_isEnabled = []()
+        {
+            if (GetLargePageMinimum() == 0)
+            {
+                return false;
+            }
+            HANDLE hToken = nullptr;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken))
+            {
+                return false;
+            }
+            TOKEN_PRIVILEGES privileges{};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            const bool isEnabled = (
+                LookupPrivilegeValueW(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+                AdjustTokenPrivileges(hToken, FALSE, &privileges, 0, nullptr, nullptr) &&
+                GetLastError() == ERROR_SUCCESS
+            );
+            CloseHandle(hToken);
+            if (!isEnabled)
+            {
+                ayc::WriteLog("In HostArena, large pages are unavailable (SeLockMemoryPrivilege is not granted). Using normal pages.");
+            }
+            return isEnabled;
+        }();
+        return s_isEnabled;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// HostArena
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::HostArena::HostArena(
+    std::size_t slotSize,
+    std::size_t numSlots,
+    bool useLargePages
+)
+    : m_pMemory(nullptr)
+    , m_slotSize(_AlignUp(std::max<std::size_t>(slotSize, 1), _GetPageSize()))
+    , m_numSlots(numSlots)
+    , m_sizeInBytes(0)
+    , m_isLargePages(false)
+{
+    // エラーチェック
+    if (numSlots < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("numSlots must be positive", numSlots);
+    }
+    if (m_slotSize > std::numeric_limits<std::size_t>::max() / numSlots)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Arena size overflow", numSlots);
+    }
+    const std::size_t sizeInBytes = m_slotSize * numSlots;
+
+    // 大きいページで確保
+    // @note: 物理メモリが断片化していると失敗することがあるので、その時は通常のページに落とす
+    if (useLargePages && _EnableLargePages())
+    {
+        const std::size_t largeSizeInBytes = _AlignUp(sizeInBytes, GetLargePageMinimum());
+        m_pMemory = static_cast<std::uint8_t*>(VirtualAlloc(
+            nullptr,
+            largeSizeInBytes,
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+            PAGE_READWRITE
+        ));
+        if (m_pMemory)
+        {
+            m_sizeInBytes = largeSizeInBytes;
+            m_isLargePages = true;
+            return;
+        }
+    }
+    // 通常のページで確保
+    {
+        m_pMemory = static_cast<std::uint8_t*>(VirtualAlloc(
+            nullptr,
+            sizeInBytes,
+            MEM_RESERVE | MEM_COMMIT,
+            PAGE_READWRITE
+        ));
+        if (!m_pMemory)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Failed to VirtualAlloc", sizeInBytes);
+        }
+        m_sizeInBytes = sizeInBytes;
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::HostArena::~HostArena()
+{
+    if (m_pMemory)
+    {
+        VirtualFree(m_pMemory, 0, MEM_RELEASE);
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::uint8_t* ayc::HostArena::GetSlot(std::size_t index) const
+{
+    if (index >= m_numSlots)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Slot Index Out of Range", index);
+    }
+    return m_pMemory + index * m_slotSize;
+}
+
+//-----------------------------------------------------------------------------
+// HostArenaPool
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::HostArenaPool& ayc::HostArenaPool::Instance()
+{
+    static HostArenaPool s_instance(HOST_ARENA_POOL_DEFAULT_MAX_BYTES);
+    return s_instance;
+}
+
+//-----------------------------------------------------------------------------
+ayc::HostArenaPool::HostArenaPool(std::size_t maxPooledBytes)
+    : m_guard()
+    , m_freeArenas()
+    , m_pooledBytes(0)
+    , m_maxPooledBytes(maxPooledBytes)
+    , m_useLargePages(false)
+    , m_numCreated(0)
+    , m_numReused(0)
+    , m_numLargePages(0)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<ayc::HostArena> ayc::HostArenaPool::Acquire(std::size_t slotSize, std::size_t numSlots)
+{
+    // @note: 最後の参照が外れたらプールに戻す
+    const auto wrap = [this](std::unique_ptr<HostArena> pArena)
+    {
+        return std::shared_ptr<HostArena>(
+            pArena.release(),
+            [this](HostArena* pReleased) { _Release(pReleased); }
+        );
+    };
+    const std::size_t alignedSlotSize = _AlignUp(std::max<std::size_t>(slotSize, 1), _GetPageSize());
+
+    // 条件に合うものがあれば、一番小さいものを使い回す
+    bool useLargePages = false;
+    {
+        std::scoped_lock lock(m_guard);
+        auto bestIter = m_freeArenas.end();
+        for (auto iter = m_freeArenas.begin(); iter != m_freeArenas.end(); ++iter)
+        {
+            const auto& pArena = *iter;
+            if (pArena->GetSlotSize() != alignedSlotSize ||
+                pArena->GetNumSlots() < numSlots ||
+                pArena->GetNumSlots() > numSlots * 2)
+            {
+                continue;
+            }
+            if (bestIter == m_freeArenas.end() || pArena->GetNumSlots() < (*bestIter)->GetNumSlots())
+            {
+                bestIter = iter;
+            }
+        }
+        if (bestIter != m_freeArenas.end())
+        {
+            auto pArena = std::move(*bestIter);
+            m_freeArenas.erase(bestIter);
+            m_pooledBytes -= pArena->GetSizeInBytes();
+            m_numReused += 1;
+            return wrap(std::move(pArena));
+        }
+        useLargePages = m_useLargePages;
+    }
+    // 無ければ生成
+    // @note: 確保は大きくなりうるので、ロックの外で行う
+    auto pArena = std::make_unique<HostArena>(alignedSlotSize, numSlots, useLargePages);
+    {
+        std::scoped_lock lock(m_guard);
+        m_numCreated += 1;
+        m_numLargePages += pArena->IsLargePages() ? 1 : 0;
+    }
+    return wrap(std::move(pArena));
+}
+
+//-----------------------------------------------------------------------------
+void ayc::HostArenaPool::Configure(
+    std::optional<bool> useLargePages,
+    std::optional<std::size_t> maxPooledBytes
+)
+{
+    std::vector<std::unique_ptr<HostArena>> trimmed;
+    {
+        std::scoped_lock lock(m_guard);
+        if (useLargePages)
+        {
+            m_useLargePages = *useLargePages;
+        }
+        if (maxPooledBytes)
+        {
+            m_maxPooledBytes = *maxPooledBytes;
+            trimmed = _TrimLocked();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::HostArenaPool::Clear()
+{
+    // @note: アリーナの解放はロックの外で行う
+    std::deque<std::unique_ptr<HostArena>> freeArenas;
+    {
+        std::scoped_lock lock(m_guard);
+        freeArenas.swap(m_freeArenas);
+        m_pooledBytes = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::HostArenaPool::STATS ayc::HostArenaPool::GetStats() const
+{
+    std::scoped_lock lock(m_guard);
+    return STATS{
+        m_freeArenas.size(),
+        m_pooledBytes,
+        m_numCreated,
+        m_numReused,
+        m_numLargePages
+    };
+}
+
+//-----------------------------------------------------------------------------
+void ayc::HostArenaPool::_Release(HostArena* pArena)
+{
+    std::unique_ptr<HostArena> pReleased(pArena);
+    std::vector<std::unique_ptr<HostArena>> trimmed;
+    {
+        std::scoped_lock lock(m_guard);
+        if (pReleased->GetSizeInBytes() > m_maxPooledBytes)
+        {
+            return;
+        }
+        m_pooledBytes += pReleased->GetSizeInBytes();
+        m_freeArenas.push_back(std::move(pReleased));
+        trimmed = _TrimLocked();
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::unique_ptr<ayc::HostArena>> ayc::HostArenaPool::_TrimLocked()
+{
+    std::vector<std::unique_ptr<HostArena>> trimmed;
+    while (m_pooledBytes > m_maxPooledBytes && !m_freeArenas.empty())
+    {
+        m_pooledBytes -= m_freeArenas.front()->GetSizeInBytes();
+        trimmed.push_back(std::move(m_freeArenas.front()));
+        m_freeArenas.pop_front();
+    }
+    return trimmed;
+}
+
+//-----------------------------------------------------------------------------
+// HostBuffer
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::HostBuffer::HostBuffer() noexcept
+    : m_pArena()
+    , m_pData(nullptr)
+    , m_size(0)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+ayc::HostBuffer::HostBuffer(
+    std::shared_ptr<HostArena> pArena,
+    std::size_t slotIndex,
+    std::size_t size
+)
+    : m_pArena(std::move(pArena))
+    , m_pData(nullptr)
+    , m_size(size)
+{
+    // エラーチェック
+    if (!m_pArena)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Host Arena", m_pArena);
+    }
+    if (size > m_pArena->GetSlotSize())
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Buffer is larger than the slot", size);
+    }
+    m_pData = m_pArena->GetSlot(slotIndex);
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::HostBuffer ayc::HostBuffer::Allocate(std::size_t size)
+{
+    return HostBuffer(HostArenaPool::Instance().Acquire(size, 1), 0, size);
+}
@@ -0,0 +1,249 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "lz_codec.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // ハッシュテーブルのビット数
+    const std::size_t LZ_HASH_BITS = 14;
+
+    // 一致とみなす最短の長さ
+    const std::size_t LZ_MIN_MATCH = 4;
+
+    // 参照できる最大の距離
+    const std::size_t LZ_MAX_OFFSET = 65535;
+
+    // 末尾は必ずこのバイト数以上をリテラルで終える
+    // @note: 展開側で末尾を読み越さないための余白
+    const std::size_t LZ_LAST_LITERALS = 5;
+
+    // 一致探索を打ち切る末尾からの距離
+    const std::size_t LZ_MATCH_FIND_LIMIT = 12;
+
+    // 一致が見つからない時に探索の歩幅を広げるペース
+    // @note: 圧縮できないデータで時間を食いすぎないため
+    const std::size_t LZ_SKIP_TRIGGER = 6;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 4 バイト読む
+    std::uint32_t _Read32(const std::uint8_t* p)
+    {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // 4 バイトのハッシュ値
+    std::size_t _HashLZ(std::uint32_t value)
+    {
+        return static_cast<std::size_t>((value * 2654435761u) >> (32 - LZ_HASH_BITS));
+    }
+
+    // 15 を超えた長さを 255 刻みで書き出す
+    void _WriteLength(std::string& out, std::size_t length)
+    {
+        while (length >= 255)
+        {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    // 15 を超えた長さを読む
+    std::size_t _ReadLength(const std::uint8_t* pSrc, std::size_t srcSize, std::size_t& pos)
+    {
+        std::size_t length = 0;
+        for (;;)
+        {
+            if (pos >= srcSize)
+            {
+                throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+            }
+            const std::uint8_t value = pSrc[pos++];
+            length += value;
+            if (value != 255)
+            {
+                return length;
+            }
+        }
+    }
+
+    // シーケンス（リテラル列＋一致）を１つ書き出す
+    // @note: matchLength がゼロなら末尾のシーケンスとしてリテラル列だけを書き出す
+    void _WriteSequence(
+        std::string& out,
+        const std::uint8_t* pLiterals,
+        std::size_t numLiterals,
+        std::size_t offset,
+        std::size_t matchLength
+    )
+    {
+        // トークン
+        {
+            const std::size_t literalCode = std::min<std::size_t>(numLiterals, 15);
+            const std::size_t matchCode = matchLength > 0 ? std::min<std::size_t>(matchLength - LZ_MIN_MATCH, 15) : 0;
+            out.push_back(static_cast<char>((literalCode << 4) | matchCode));
+        }
+        // リテラル列
+        {
+            if (numLiterals >= 15)
+            {
+                _WriteLength(out, numLiterals - 15);
+            }
+            out.append(reinterpret_cast<const char*>(pLiterals), numLiterals);
+        }
+        // 一致
+        if (matchLength > 0)
+        {
+            out.push_back(static_cast<char>(offset & 0xFF));
+            out.push_back(static_cast<char>(offset >> 8));
+            if (matchLength - LZ_MIN_MATCH >= 15)
+            {
+                _WriteLength(out, matchLength - LZ_MIN_MATCH - 15);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+void ayc::CompressLZ(std::string& out, const std::uint8_t* pSrc, std::size_t srcSize)
+{
+    out.clear();
+    out.reserve(srcSize / 8 + 16);
+    std::size_t anchor = 0;
+    if (srcSize >= LZ_MATCH_FIND_LIMIT)
+    {
+        std::vector<std::uint32_t> table(std::size_t(1) << LZ_HASH_BITS, 0);
+        const std::size_t matchLimit = srcSize - LZ_LAST_LITERALS;
+        const std::size_t searchLimit = srcSize - LZ_MATCH_FIND_LIMIT;
+        std::size_t numMisses = 0;
+        std::size_t pos = 0;
+        while (pos <= searchLimit)
+        {
+            // 候補を引く
+            const std::uint32_t value = _Read32(pSrc + pos);
+            const std::size_t hash = _HashLZ(value);
+            std::size_t ref = table[hash];
+            table[hash] = static_cast<std::uint32_t>(pos);
+            const bool isMatch = (
+                ref < pos &&
+                pos - ref <= LZ_MAX_OFFSET &&
+                _Read32(pSrc + ref) == value
+            );
+            if (!isMatch)
+            {
+                pos += 1 + (numMisses++ >> LZ_SKIP_TRIGGER);
+                continue;
+            }
+            // 一致を前後に伸ばす
+            while (pos > anchor && ref > 0 && pSrc[pos - 1] == pSrc[ref - 1])
+            {
+                --pos;
+                --ref;
+            }
+            std::size_t matchLength = LZ_MIN_MATCH;
+            while (pos + matchLength < matchLimit && pSrc[ref + matchLength] == pSrc[pos + matchLength])
+            {
+                ++matchLength;
+            }
+            // 書き出し
+            _WriteSequence(out, pSrc + anchor, pos - anchor, pos - ref, matchLength);
+            pos += matchLength;
+            anchor = pos;
+            numMisses = 0;
+        }
+    }
+    _WriteSequence(out, pSrc + anchor, srcSize - anchor, 0, 0);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::DecompressLZ(std::uint8_t* pDst, std::size_t dstSize, const std::uint8_t* pSrc, std::size_t srcSize)
+{
+    std::size_t srcPos = 0;
+    std::size_t dstPos = 0;
+    for (;;)
+    {
+        // トークン
+        if (srcPos >= srcSize)
+        {
+            throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+        }
+        const std::uint8_t token = pSrc[srcPos++];
+
+        // リテラル列
+        std::size_t numLiterals = token >> 4;
+        if (numLiterals == 15)
+        {
+            numLiterals += _ReadLength(pSrc, srcSize, srcPos);
+        }
+        if (numLiterals > srcSize - srcPos || numLiterals > dstSize - dstPos)
+        {
+            throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+        }
+        std::memcpy(pDst + dstPos, pSrc + srcPos, numLiterals);
+        srcPos += numLiterals;
+        dstPos += numLiterals;
+
+        // 末尾のシーケンスはリテラル列だけ
+        if (srcPos == srcSize)
+        {
+            break;
+        }
+        // 一致
+        if (srcSize - srcPos < 2)
+        {
+            throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+        }
+        const std::size_t offset = pSrc[srcPos] | (static_cast<std::size_t>(pSrc[srcPos + 1]) << 8);
+        srcPos += 2;
+        std::size_t matchLength = (token & 0x0F) + LZ_MIN_MATCH;
+        if ((token & 0x0F) == 15)
+        {
+            matchLength += _ReadLength(pSrc, srcSize, srcPos);
+        }
+        if (offset == 0 || offset > dstPos || matchLength > dstSize - dstPos)
+        {
+            throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+        }
+        // @note: 距離が一致長より短い場合は重なるので、重ならない幅ずつ倍々にコピーする
+        const std::uint8_t* pRef = pDst + dstPos - offset;
+        std::uint8_t* pOut = pDst + dstPos;
+        std::size_t remaining = matchLength;
+        while (remaining > 0)
+        {
+            const std::size_t chunk = std::min<std::size_t>(remaining, static_cast<std::size_t>(pOut - pRef));
+            std::memcpy(pOut, pRef, chunk);
+            pOut += chunk;
+            remaining -= chunk;
+        }
+        dstPos += matchLength;
+    }
+    if (dstPos != dstSize)
+    {
+        throw MAKE_GENERAL_ERROR("Corrupted LZ Stream");
+    }
+}
@@ -0,0 +1,282 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "memory_arbiter.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 上限を緩める判定に使う予算の余裕率
+    /* @note:
+        予算ギリギリで上限の締め・緩めを繰り返さないように、
+        合計使用量が予算のこの割合を下回った時だけ緩める。
+    */
+    const double MEMORY_ARBITER_RELAX_RATIO = 0.9;
+}
+
+//-----------------------------------------------------------------------------
+// MemoryAccount
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::MemoryAccount::MemoryAccount(
+    std::uint64_t id,
+    double weight,
+    double minHoldInSec
+)
+    : m_id(id)
+    , m_weight(weight)
+    , m_minHoldInSec(minHoldInSec)
+    , m_bytes(0)
+    , m_floorBytes(0)
+    , m_limitBytes(NO_LIMIT)
+    , m_pTracker(std::make_shared<MemoryTracker>(MemoryTracker::Global()))
+{
+    // 重みは正値じゃないとダメ
+    if (weight <= 0.0)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("weight must be positive", weight);
+    }
+    // 最低保持秒数は負値じゃダメ
+    if (minHoldInSec < 0.0)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("minHoldInSec must be non-negative", minHoldInSec);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// MemoryArbiter
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::MemoryArbiter& ayc::MemoryArbiter::Instance()
+{
+    static MemoryArbiter s_instance;
+    return s_instance;
+}
+
+//-----------------------------------------------------------------------------
+ayc::MemoryArbiter::MemoryArbiter()
+    : m_guard()
+    , m_accounts()
+    , m_budgetBytes(MemoryAccount::NO_LIMIT)
+    , m_totalBytes(0)
+    , m_numLimited(0)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryArbiter::SetBudget(std::optional<std::int64_t> budgetBytes)
+{
+    // 予算は正値じゃないとダメ
+    if (budgetBytes.has_value() && budgetBytes.value() <= 0)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("budgetBytes must be positive", budgetBytes.value());
+    }
+    m_budgetBytes = budgetBytes.value_or(MemoryAccount::NO_LIMIT);
+
+    // 予算変更を反映
+    // @note: 再配分中のスレッドがあっても、待ってでもその場で反映する
+    std::scoped_lock lock(m_guard);
+    _RebalanceLocked();
+}
+
+//-----------------------------------------------------------------------------
+std::optional<std::int64_t> ayc::MemoryArbiter::GetBudget() const
+{
+    const auto budgetBytes = m_budgetBytes.load();
+    if (budgetBytes == MemoryAccount::NO_LIMIT)
+    {
+        return std::nullopt;
+    }
+    return budgetBytes;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<ayc::MemoryAccount> ayc::MemoryArbiter::Register(
+    std::uint64_t id,
+    double weight,
+    double minHoldInSec
+)
+{
+    auto pAccount = std::make_shared<MemoryAccount>(id, weight, minHoldInSec);
+    std::scoped_lock lock(m_guard);
+    m_accounts.push_back(pAccount);
+    return pAccount;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryArbiter::Unregister(const std::shared_ptr<MemoryAccount>& pAccount)
+{
+    if (!pAccount)
+    {
+        return;
+    }
+    // 使用量を合計から差し引く
+    {
+        const auto bytes = pAccount->m_bytes.exchange(0);
+        m_totalBytes -= bytes;
+    }
+    // 登録解除して、空いた分を他のセッションに回す
+    // @note: 再配分中のスレッドがあっても、待ってでもその場で反映する
+    {
+        std::scoped_lock lock(m_guard);
+        std::erase(m_accounts, pAccount);
+        _RebalanceLocked();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryArbiter::Update(
+    MemoryAccount& account,
+    std::int64_t bytes,
+    std::int64_t floorBytes
+)
+{
+    // 記帳
+    const auto delta = bytes - account.m_bytes.exchange(bytes, std::memory_order_relaxed);
+    account.m_floorBytes.store(floorBytes, std::memory_order_relaxed);
+    const auto totalBytes = m_totalBytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+
+    // 必要な時だけ再配分
+    const auto budgetBytes = m_budgetBytes.load(std::memory_order_relaxed);
+    const auto relaxBytes = static_cast<std::int64_t>(
+        static_cast<double>(budgetBytes) * MEMORY_ARBITER_RELAX_RATIO
+    );
+    const bool isOverBudget = totalBytes > budgetBytes;
+    const bool canRelax = m_numLimited.load(std::memory_order_relaxed) > 0 && totalBytes < relaxBytes;
+    if (isOverBudget || canRelax)
+    {
+        _TryRebalance();
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<std::shared_ptr<ayc::MemoryAccount>> ayc::MemoryArbiter::GetAccounts() const
+{
+    std::scoped_lock lock(m_guard);
+    return m_accounts;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryArbiter::_TryRebalance()
+{
+    // 他のスレッドが再配分中なら任せる
+    /* @note:
+        PushFrame をロック待ちで止めたくないので try_lock。
+    */
+    std::unique_lock lock(m_guard, std::try_to_lock);
+    if (!lock.owns_lock())
+    {
+        return;
+    }
+    _RebalanceLocked();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryArbiter::_RebalanceLocked()
+{
+    // 予算なしなら上限を全て外す
+    const auto budgetBytes = m_budgetBytes.load();
+    if (budgetBytes == MemoryAccount::NO_LIMIT)
+    {
+        for (const auto& pAccount : m_accounts)
+        {
+            pAccount->m_limitBytes = MemoryAccount::NO_LIMIT;
+        }
+        m_numLimited = 0;
+        return;
+    }
+    // 重みの昇順に並べる
+    auto accounts = m_accounts;
+    std::ranges::stable_sort(
+        accounts,
+        /*_Pr=*/{},
+        [](const auto& pAccount) { return pAccount->GetWeight(); }
+    );
+    // 上限適用後の合計使用量を見積もる
+    /* @note:
+        上限を課してから実際にフレームが削られるのは次の PushFrame なので、
+        記帳済みの使用量ではなく上限でクリップした値で判断する。
+    */
+    std::int64_t totalBytes = 0;
+    for (const auto& pAccount : accounts)
+    {
+        totalBytes += std::min(pAccount->GetBytes(), pAccount->GetLimitBytes());
+    }
+    if (totalBytes > budgetBytes)
+    {
+        // 超過分を重みの小さいセッションから順に削る
+        /* @note:
+            最低保持秒数ぶん（floor）は削らない。
+            全員 floor に張り付いている場合は予算超過を許容する。
+        */
+        auto excessBytes = totalBytes - budgetBytes;
+        for (const auto& pAccount : accounts)
+        {
+            if (excessBytes <= 0)
+            {
+                break;
+            }
+            const auto bytes = std::min(pAccount->GetBytes(), pAccount->GetLimitBytes());
+            const auto reducibleBytes = std::max<std::int64_t>(
+                bytes - pAccount->GetFloorBytes(),
+                0
+            );
+            const auto cutBytes = std::min(excessBytes, reducibleBytes);
+            if (cutBytes > 0)
+            {
+                pAccount->m_limitBytes = bytes - cutBytes;
+                excessBytes -= cutBytes;
+            }
+        }
+    }
+    else
+    {
+        // 余裕分を上限のかかっているセッションに重みに応じて配る
+        double limitedWeight = 0.0;
+        for (const auto& pAccount : accounts)
+        {
+            if (pAccount->GetLimitBytes() != MemoryAccount::NO_LIMIT)
+            {
+                limitedWeight += pAccount->GetWeight();
+            }
+        }
+        const auto slackBytes = static_cast<double>(budgetBytes - totalBytes);
+        for (const auto& pAccount : accounts)
+        {
+            const auto limitBytes = pAccount->GetLimitBytes();
+            if (limitBytes == MemoryAccount::NO_LIMIT)
+            {
+                continue;
+            }
+            const auto shareBytes = static_cast<std::int64_t>(
+                slackBytes * pAccount->GetWeight() / limitedWeight
+            );
+            // @note: 上限を予算以上に緩めるなら、もはや上限は不要
+            const auto newLimitBytes = limitBytes + shareBytes;
+            pAccount->m_limitBytes = (
+                newLimitBytes >= budgetBytes ? MemoryAccount::NO_LIMIT : newLimitBytes
+            );
+        }
+    }
+    // 上限のかかっているセッション数を数え直す
+    {
+        m_numLimited = static_cast<std::size_t>(std::ranges::count_if(
+            m_accounts,
+            [](const auto& pAccount) { return pAccount->GetLimitBytes() != MemoryAccount::NO_LIMIT; }
+        ));
+    }
+}
@@ -0,0 +1,229 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "memory_tracker.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 解放を検知するオブジェクトを持たせるプライベートデータの GUID
+    // {3C1E6A52-8D0B-4F7A-B5E4-27D9A1C6F803}
+    const GUID MEMORY_TRACKER_TEXTURE_GUID = { 0x3c1e6a52, 0x8d0b, 0x4f7a, { 0xb5, 0xe4, 0x27, 0xd9, 0xa1, 0xc6, 0xf8, 0x03 } };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // テクスチャの解放を検知するオブジェクト
+    /* @note:
+        テクスチャが破棄されるとプライベートデータのインターフェースが Release されるので、
+        デストラクタで解放を記帳する。
+    */
+    struct _TextureReleaseHook : wgc::implements<_TextureReleaseHook, ::IUnknown>
+    {
+        _TextureReleaseHook(
+            std::shared_ptr<ayc::MemoryTracker> pTracker,
+            ayc::MemoryCategory category,
+            std::int64_t bytes
+        )
+        : pTracker(std::move(pTracker))
+        , category(category)
+        , bytes(bytes)
+        , isArmed(false)
+        {
+            // nop
+        }
+
+        ~_TextureReleaseHook()
+        {
+            if (isArmed)
+            {
+                pTracker->RecordRelease(category, bytes);
+            }
+        }
+
+        std::shared_ptr<ayc::MemoryTracker>   pTracker;
+        ayc::MemoryCategory                   category;
+        std::int64_t                          bytes;
+        bool                                  isArmed;    // 生成を記帳済みなら true
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Variables
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 現在のスレッドの記帳先
+    // @note: nullptr なら Global
+    thread_local std::shared_ptr<ayc::MemoryTracker> t_pCurrentTracker;
+}
+
+//-----------------------------------------------------------------------------
+// MemoryTracker
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/*static*/ const std::shared_ptr<ayc::MemoryTracker>& ayc::MemoryTracker::Global()
+{
+    static const auto s_pInstance = std::make_shared<MemoryTracker>();
+    return s_pInstance;
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ std::shared_ptr<ayc::MemoryTracker> ayc::MemoryTracker::Current()
+{
+    return t_pCurrentTracker ? t_pCurrentTracker : Global();
+}
+
+//-----------------------------------------------------------------------------
+ayc::MemoryTracker::MemoryTracker(std::shared_ptr<MemoryTracker> pParent)
+    : m_pParent(std::move(pParent))
+    , m_counters()
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryTracker::RecordAllocation(MemoryCategory category, std::int64_t bytes)
+{
+    auto& counters = m_counters[static_cast<std::size_t>(category)];
+    const auto currentBytes = counters.currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.totalBytes.fetch_add(static_cast<std::uint64_t>(bytes), std::memory_order_relaxed);
+
+    // 最大値を更新
+    // @note: 他のスレッドがより大きい値を書き込んだら諦める
+    auto peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    while (peakBytes < currentBytes)
+    {
+        if (counters.peakBytes.compare_exchange_weak(peakBytes, currentBytes, std::memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    if (m_pParent)
+    {
+        m_pParent->RecordAllocation(category, bytes);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryTracker::RecordRelease(MemoryCategory category, std::int64_t bytes)
+{
+    auto& counters = m_counters[static_cast<std::size_t>(category)];
+    counters.currentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters.releases.fetch_add(1, std::memory_order_relaxed);
+    if (m_pParent)
+    {
+        m_pParent->RecordRelease(category, bytes);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::MemoryTracker::RecordTransfer(MemoryCategory category, std::int64_t bytes)
+{
+    auto& counters = m_counters[static_cast<std::size_t>(category)];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    counters.totalBytes.fetch_add(static_cast<std::uint64_t>(bytes), std::memory_order_relaxed);
+    if (m_pParent)
+    {
+        m_pParent->RecordTransfer(category, bytes);
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::MemoryTracker::COUNTERS ayc::MemoryTracker::GetCounters(MemoryCategory category) const
+{
+    const auto& counters = m_counters[static_cast<std::size_t>(category)];
+    return COUNTERS{
+        counters.currentBytes.load(std::memory_order_relaxed),
+        counters.peakBytes.load(std::memory_order_relaxed),
+        counters.allocations.load(std::memory_order_relaxed),
+        counters.releases.load(std::memory_order_relaxed),
+        counters.totalBytes.load(std::memory_order_relaxed)
+    };
+}
+
+//-----------------------------------------------------------------------------
+// MemoryTrackerScope
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::MemoryTrackerScope::MemoryTrackerScope(std::shared_ptr<MemoryTracker> pTracker)
+    : m_pPrevTracker(t_pCurrentTracker)
+{
+    if (pTracker)
+    {
+        t_pCurrentTracker = std::move(pTracker);
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::MemoryTrackerScope::~MemoryTrackerScope()
+{
+    t_pCurrentTracker = std::move(m_pPrevTracker);
+}
+
+//-----------------------------------------------------------------------------
+// Functions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+std::size_t ayc::GetTextureSizeInBytes(const wgc::com_ptr<ID3D11Texture2D>& pTexture)
+{
+    D3D11_TEXTURE2D_DESC desc{};
+    pTexture->GetDesc(&desc);
+    const std::size_t bytesPerTexel = (desc.Format == DXGI_FORMAT_R8_UNORM) ? 1 : 4;
+    return static_cast<std::size_t>(desc.Width) * desc.Height * bytesPerTexel;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::TrackTexture(
+    const wgc::com_ptr<ID3D11Texture2D>& pTexture,
+    MemoryCategory category,
+    const std::shared_ptr<MemoryTracker>& pTracker
+)
+{
+    if (!pTexture || !pTracker)
+    {
+        return;
+    }
+    // 記帳済みなら何もしない
+    // @note: 重複排除・リプレイで同じテクスチャが何度も PushFrame されることがある
+    {
+        UINT dataSize = 0;
+        if (pTexture->GetPrivateData(MEMORY_TRACKER_TEXTURE_GUID, &dataSize, nullptr) == S_OK)
+        {
+            return;
+        }
+    }
+    // 解放を検知するオブジェクトを持たせる
+    /* @note:
+        プライベートデータを持てないテクスチャ（ベンチマークのモック等）は記帳しない。
+        持たせられた時だけ生成を記帳し、解放の記帳を有効にする。
+    */
+    const auto bytes = static_cast<std::int64_t>(GetTextureSizeInBytes(pTexture));
+    const auto pHook = wgc::make_self<_TextureReleaseHook>(pTracker, category, bytes);
+    if (pTexture->SetPrivateDataInterface(MEMORY_TRACKER_TEXTURE_GUID, pHook.as<::IUnknown>().get()) != S_OK)
+    {
+        return;
+    }
+    pHook->isArmed = true;
+    pTracker->RecordAllocation(category, bytes);
+}
@@ -0,0 +1,473 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "nv12_texture.h"
+
+// other
+#include "d3d11_system.h"
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 論理サイズを記録するプライベートデータの GUID
+    // {909197F2-4F6B-4118-9667-CF498C616365}
+    const GUID NV12_TEXTURE_SIZE_GUID = { 0x909197f2, 0x4f6b, 0x4118, { 0x96, 0x67, 0xcf, 0x49, 0x8c, 0x61, 0x63, 0x65 } };
+
+    // 逆変換の係数の固定小数点ビット数
+    const int NV12_COEFF_BITS = 14;
+
+    // BT.709 full range の逆変換係数（1 << NV12_COEFF_BITS 倍）
+    const int NV12_COEFF_VR = 25802;    // 1.5748
+    const int NV12_COEFF_UG = 3069;     // 0.1873
+    const int NV12_COEFF_VG = 7670;     // 0.4681
+    const int NV12_COEFF_UB = 30402;    // 1.8556
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // シェーダーに渡す定数
+    struct _NV12_PARAMS
+    {
+        UINT width;         // 論理サイズ
+        UINT height;
+        UINT lumaHeight;    // 輝度面の行数（偶数に切り上げ）
+        UINT padding;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Shader
+//-----------------------------------------------------------------------------
+namespace
+{
+    // 頂点シェーダーを生成する
+    wgc::com_ptr<ID3D11VertexShader> _CreateVertexShader()
+    {
+        // シェーダーソースコード
+        // @note: 3 つの頂点だけで画面全体を覆う三角形
+        const char hlslSourceCode[] = R"(
+            float4 main(uint vertexId : SV_VertexID) : SV_POSITION
+            {
+                float2 pos = float2((vertexId == 2) ? 3.0f : -1.0f, (vertexId == 1) ? 3.0f : -1.0f);
+                return float4(pos, 0.0f, 1.0f);
+            }
+        )";
+        // シェーダーコンパイル
+        wgc::com_ptr<ID3DBlob> pBlob;
+        wgc::com_ptr<ID3DBlob> pErrors;
+        {
+            const auto result = D3DCompile(
+                hlslSourceCode,
+                sizeof(hlslSourceCode),
+                "nv12_texture_vs",
+                /*pDefines=*/nullptr,
+                /*pInclude=*/nullptr,
+                "main",
+                "vs_5_0",
+                D3DCOMPILE_OPTIMIZATION_LEVEL3,
+                /*Flags2=*/0,
+                pBlob.put(),
+                pErrors.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to D3DCompile", result);
+            }
+        }
+        // シェーダーオブジェクトを生成
+        wgc::com_ptr<ID3D11VertexShader> pVertexShader;
+        {
+            const auto result = ayc::d3d11::Device()->CreateVertexShader(
+                pBlob->GetBufferPointer(),
+                pBlob->GetBufferSize(),
+                /*pClassLinkage=*/nullptr,
+                pVertexShader.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateVertexShader", result);
+            }
+        }
+        return pVertexShader;
+    }
+
+    // 頂点シェーダーを取得する
+    ID3D11VertexShader* _GetVertexShader()
+    {
+        static auto pShader = _CreateVertexShader();
+        return pShader.get();
+    }
+
+    // ピクセルシェーダーを生成する
+    wgc::com_ptr<ID3D11PixelShader> _CreatePixelShader()
+    {
+        // シェーダーソースコード
+        /* @note:
+            出力先は R8_UNORM で、上から輝度面、色差面の順に詰める。
+            色差は 2x2 画素の中心でバイリニアサンプルする。
+            等倍なら４画素の平均そのものになり、縮小時は縮小と平均を１回のサンプルで兼ねる。
+        */
+        const char hlslSourceCode[] = R"(
+            cbuffer Params : register(b0)
+            {
+                uint2 DestSize;
+                uint  LumaHeight;
+                uint  Padding;
+            };
+
+            Texture2D    SourceTex   : register(t0);
+            SamplerState LinearClamp : register(s0);
+
+            float3 ToYUV(float3 rgb)
+            {
+                float y = dot(rgb, float3(0.2126f, 0.7152f, 0.0722f));
+                return float3(y, (rgb.b - y) / 1.8556f + 0.5f, (rgb.r - y) / 1.5748f + 0.5f);
+            }
+
+            float main(float4 position : SV_POSITION) : SV_TARGET
+            {
+                uint2 pos = uint2(position.xy);
+                if (pos.y < LumaHeight)
+                {
+                    float2 uv = (float2(pos) + 0.5f) / float2(DestSize);
+                    return ToYUV(SourceTex.Sample(LinearClamp, uv).rgb).x;
+                }
+                uint2 block = uint2(pos.x / 2, pos.y - LumaHeight);
+                float2 uv = (float2(block * 2) + 1.0f) / float2(DestSize);
+                float3 yuv = ToYUV(SourceTex.Sample(LinearClamp, uv).rgb);
+                return (pos.x & 1) ? yuv.z : yuv.y;
+            }
+        )";
+        // シェーダーコンパイル
+        wgc::com_ptr<ID3DBlob> pBlob;
+        wgc::com_ptr<ID3DBlob> pErrors;
+        {
+            const auto result = D3DCompile(
+                hlslSourceCode,
+                sizeof(hlslSourceCode),
+                "nv12_texture_ps",
+                /*pDefines=*/nullptr,
+                /*pInclude=*/nullptr,
+                "main",
+                "ps_5_0",
+                D3DCOMPILE_OPTIMIZATION_LEVEL3,
+                /*Flags2=*/0,
+                pBlob.put(),
+                pErrors.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to D3DCompile", result);
+            }
+        }
+        // シェーダーオブジェクトを生成
+        wgc::com_ptr<ID3D11PixelShader> pPixelShader;
+        {
+            const auto result = ayc::d3d11::Device()->CreatePixelShader(
+                pBlob->GetBufferPointer(),
+                pBlob->GetBufferSize(),
+                /*pClassLinkage=*/nullptr,
+                pPixelShader.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreatePixelShader", result);
+            }
+        }
+        return pPixelShader;
+    }
+
+    // ピクセルシェーダーを取得する
+    ID3D11PixelShader* _GetPixelShader()
+    {
+        static auto pShader = _CreatePixelShader();
+        return pShader.get();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+wgc::com_ptr<ID3D11Texture2D> ayc::ConvertTextureToNV12(
+    const wgc::com_ptr<ID3D11Texture2D>& pSrcTex,
+    UINT destWidth,
+    UINT destHeight
+)
+{
+    // エイリアス
+    auto pDevice = ayc::d3d11::Device().get();
+    auto pContext = ayc::d3d11::Context().get();
+
+    // nullptr チェック
+    if (!pSrcTex)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Source Texture", pSrcTex);
+    }
+    // コピー元 desc
+    D3D11_TEXTURE2D_DESC srcDesc{};
+    {
+        pSrcTex->GetDesc(&srcDesc);
+    }
+    // 詰め方を解決
+    // @note: 色差は 2x2 画素で１組なので、幅・高さを偶数に切り上げる
+    const _NV12_PARAMS params{
+        destWidth,
+        destHeight,
+        (destHeight + 1) & ~1u,
+        0
+    };
+    const UINT packedWidth = (destWidth + 1) & ~1u;
+    const UINT packedHeight = params.lumaHeight + params.lumaHeight / 2;
+
+    // コピー先テクスチャを生成
+    wgc::com_ptr<ID3D11Texture2D> pDestTex;
+    {
+        // 記述
+        D3D11_TEXTURE2D_DESC destDesc{};
+        {
+            destDesc.Width = packedWidth;
+            destDesc.Height = packedHeight;
+            destDesc.MipLevels = 1;
+            destDesc.ArraySize = 1;
+            destDesc.Format = DXGI_FORMAT_R8_UNORM;
+            destDesc.SampleDesc.Count = 1;
+            destDesc.SampleDesc.Quality = 0;
+            destDesc.Usage = D3D11_USAGE_DEFAULT;
+            destDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+            destDesc.CPUAccessFlags = 0;
+            destDesc.MiscFlags = 0;
+        }
+        // 生成
+        const auto result = pDevice->CreateTexture2D(
+            &destDesc,
+            nullptr,
+            pDestTex.put()
+        );
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateTexure2D", result);
+        }
+    }
+    // 論理サイズを記録
+    {
+        const UINT logicalSize[] = { destWidth, destHeight };
+        const auto result = pDestTex->SetPrivateData(NV12_TEXTURE_SIZE_GUID, sizeof(logicalSize), logicalSize);
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to SetPrivateData", result);
+        }
+    }
+    // 定数バッファ
+    wgc::com_ptr<ID3D11Buffer> pParamBuffer;
+    {
+        // 記述
+        D3D11_BUFFER_DESC desc{};
+        {
+            desc.ByteWidth = sizeof(_NV12_PARAMS);
+            desc.Usage = D3D11_USAGE_IMMUTABLE;
+            desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        }
+        // 初期データ
+        D3D11_SUBRESOURCE_DATA initialData{};
+        {
+            initialData.pSysMem = &params;
+        }
+        // 生成
+        const auto result = pDevice->CreateBuffer(&desc, &initialData, pParamBuffer.put());
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateBuffer", result);
+        }
+    }
+    // コピー元 SRV を作成
+    wgc::com_ptr<ID3D11ShaderResourceView> pSrcSRV;
+    {
+        // desc
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc{};
+        {
+            srvDesc.Format = srcDesc.Format;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MostDetailedMip = 0;
+            srvDesc.Texture2D.MipLevels = 1;
+        }
+        // 生成
+        {
+            const auto result = pDevice->CreateShaderResourceView(
+                pSrcTex.get(),
+                &srvDesc,
+                pSrcSRV.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateShaderResourceView", result);
+            }
+        }
+    }
+    // コピー先 RTV を作成
+    wgc::com_ptr<ID3D11RenderTargetView> pDestRTV;
+    {
+        const auto result = pDevice->CreateRenderTargetView(
+            pDestTex.get(), nullptr, pDestRTV.put()
+        );
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateRenderTargetView", result);
+        }
+    }
+    // サンプラーステート
+    wgc::com_ptr<ID3D11SamplerState> pSampler;
+    {
+        // desc
+        D3D11_SAMPLER_DESC sampDesc{};
+        {
+            sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+            sampDesc.AddressU = sampDesc.AddressV = sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+            sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+        }
+        // 生成
+        {
+            const auto result = pDevice->CreateSamplerState(&sampDesc, pSampler.put());
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateSamplerState", result);
+            }
+        }
+    }
+    // Draw
+    {
+        // VS
+        {
+            pContext->VSSetShader(_GetVertexShader(), nullptr, 0);
+        }
+        // RS
+        {
+            D3D11_VIEWPORT vp{};
+            vp.TopLeftX = 0.0f;
+            vp.TopLeftY = 0.0f;
+            vp.Width = static_cast<float>(packedWidth);
+            vp.Height = static_cast<float>(packedHeight);
+            vp.MinDepth = 0.0f;
+            vp.MaxDepth = 1.0f;
+            pContext->RSSetViewports(1, &vp);
+        }
+        // PS
+        {
+            ID3D11Buffer* cbs[] = { pParamBuffer.get() };
+            pContext->PSSetConstantBuffers(0, 1, cbs);
+            ID3D11ShaderResourceView* srvs[] = { pSrcSRV.get() };
+            pContext->PSSetShaderResources(0, 1, srvs);
+            ID3D11SamplerState* samps[] = { pSampler.get() };
+            pContext->PSSetSamplers(0, 1, samps);
+            pContext->PSSetShader(_GetPixelShader(), nullptr, 0);
+        }
+        // OM
+        {
+            ID3D11RenderTargetView* rtvs[] = { pDestRTV.get() };
+            pContext->OMSetRenderTargets(1, rtvs, nullptr);
+        }
+        // Draw
+        {
+            pContext->Draw(3, 0);
+        }
+        // 後始末
+        {
+            ID3D11ShaderResourceView* nullSRV[] = { nullptr };
+            pContext->PSSetShaderResources(0, 1, nullSRV);
+            ID3D11Buffer* nullCB[] = { nullptr };
+            pContext->PSSetConstantBuffers(0, 1, nullCB);
+        }
+    }
+    // コピー先を返す
+    return pDestTex;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::GetNV12TextureSize(
+    std::size_t& outWidth,
+    std::size_t& outHeight,
+    const wgc::com_ptr<ID3D11Texture2D>& pTexture
+)
+{
+    // プライベートデータが無ければ NV12 ではない
+    UINT logicalSize[2] = {};
+    UINT dataSize = sizeof(logicalSize);
+    if (!pTexture || pTexture->GetPrivateData(NV12_TEXTURE_SIZE_GUID, &dataSize, logicalSize) != S_OK)
+    {
+        return false;
+    }
+    if (dataSize != sizeof(logicalSize))
+    {
+        return false;
+    }
+    outWidth = logicalSize[0];
+    outHeight = logicalSize[1];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ConvertNV12ToBGR(
+    std::uint8_t* pDst,
+    const std::uint8_t* pY,
+    std::size_t yStride,
+    const std::uint8_t* pUV,
+    std::size_t uvStride,
+    std::size_t width,
+    std::size_t height
+)
+{
+    /* @note:
+        固定小数点で１行ずつ変換する。
+        色差の寄与は２画素で共通なので、１組ごとに求めて２画素に足す。
+        分岐の無い素直なループにして、ベクトル化はコンパイラに任せる。
+    */
+    const int round = 1 << (NV12_COEFF_BITS - 1);
+    const std::size_t numPairs = width / 2;
+    for (std::size_t v = 0; v < height; ++v)
+    {
+        const auto* const pYRow = pY + v * yStride;
+        const auto* const pUVRow = pUV + (v / 2) * uvStride;
+        auto* const pDstRow = pDst + v * width * 3;
+
+        // ２画素ずつ
+        const auto convertPair = [&](std::size_t cx, std::size_t numPixels)
+        {
+            const int u = pUVRow[cx * 2 + 0] - 128;
+            const int w = pUVRow[cx * 2 + 1] - 128;
+            const int dr = NV12_COEFF_VR * w + round;
+            const int dg = -NV12_COEFF_UG * u - NV12_COEFF_VG * w + round;
+            const int db = NV12_COEFF_UB * u + round;
+            for (std::size_t i = 0; i < numPixels; ++i)
+            {
+                const int y = pYRow[cx * 2 + i] << NV12_COEFF_BITS;
+                auto* const p = pDstRow + (cx * 2 + i) * 3;
+                p[0] = static_cast<std::uint8_t>(std::clamp((y + db) >> NV12_COEFF_BITS, 0, 255));
+                p[1] = static_cast<std::uint8_t>(std::clamp((y + dg) >> NV12_COEFF_BITS, 0, 255));
+                p[2] = static_cast<std::uint8_t>(std::clamp((y + dr) >> NV12_COEFF_BITS, 0, 255));
+            }
+        };
+        for (std::size_t cx = 0; cx < numPairs; ++cx)
+        {
+            convertPair(cx, 2);
+        }
+        // 幅が奇数なら最後の１画素
+        if (width % 2 != 0)
+        {
+            convertPair(numPairs, 1);
+        }
+    }
+}
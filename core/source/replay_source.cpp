@@ -0,0 +1,356 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "replay_source.h"
+
+// other
+#include "d3d11_system.h"
+#include "wgc_session.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // フレームが１枚しかない場合のループ間隔
+    const double REPLAY_SINGLE_FRAME_INTERVAL_IN_SEC = 1.0 / 60.0;
+
+    // 再生速度の下限
+    const double REPLAY_MIN_SPEED = 1.0 / 1024.0;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // アーカイブのエントリ順にタイムスタンプを集める
+    std::vector<double> _CollectRelativesInSec(const ayc::FrameArchive& archive)
+    {
+        std::vector<double> relativesInSec(archive.GetSize());
+        for (std::size_t i = 0; i < relativesInSec.size(); ++i)
+        {
+            relativesInSec[i] = archive.GetEntry(i).relativeInSec;
+        }
+        return relativesInSec;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ReplaySchedule
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ReplaySchedule::ReplaySchedule(
+    const std::vector<double>& relativesInSec,
+    double speed,
+    bool isLooped
+)
+    : m_offsetsInSec()
+    , m_loopDurationInSec(0.0)
+    , m_speed(speed)
+    , m_isLooped(isLooped)
+    , m_nextIndex(0)
+    , m_numLoops(0)
+{
+    // パラメータチェック
+    if (!(speed >= REPLAY_MIN_SPEED) || !std::isfinite(speed))
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid speed", speed);
+    }
+    if (relativesInSec.empty())
+    {
+        return;
+    }
+    // 再生開始からのオフセットに変換
+    /* @note:
+        アーカイブは古い順に並んでいるので、先頭が最も大きい relativeInSec を持つ。
+        壊れたタイムスタンプで時間が巻き戻らないよう、単調非減少に揃える。
+    */
+    const double maxRelativeInSec = relativesInSec.front();
+    m_offsetsInSec.reserve(relativesInSec.size());
+    for (const auto relativeInSec : relativesInSec)
+    {
+        const double offsetInSec = std::max(0.0, maxRelativeInSec - relativeInSec);
+        m_offsetsInSec.push_back(
+            m_offsetsInSec.empty() ? offsetInSec : std::max(m_offsetsInSec.back(), offsetInSec)
+        );
+    }
+    // １周の秒数
+    // @note: 末尾から先頭に戻る間隔は平均フレーム間隔とする
+    const double durationInSec = m_offsetsInSec.back();
+    const double intervalInSec = (
+        m_offsetsInSec.size() > 1 && durationInSec > 0.0
+        ? durationInSec / static_cast<double>(m_offsetsInSec.size() - 1)
+        : REPLAY_SINGLE_FRAME_INTERVAL_IN_SEC
+    );
+    m_loopDurationInSec = durationInSec + intervalInSec;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::ReplaySchedule::Next(REPLAY_STEP& step)
+{
+    // 末尾まで流した
+    if (m_nextIndex >= m_offsetsInSec.size())
+    {
+        if (!m_isLooped || m_offsetsInSec.empty())
+        {
+            return false;
+        }
+        m_nextIndex = 0;
+        m_numLoops += 1;
+    }
+    // 次のフレーム
+    const double offsetInSec = m_loopDurationInSec * static_cast<double>(m_numLoops) + m_offsetsInSec[m_nextIndex];
+    step.frameIndex = m_nextIndex;
+    step.offsetInSec = offsetInSec / m_speed;
+    m_nextIndex += 1;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// ReplayClock
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ReplayClock::ReplayClock(bool isVirtual)
+    : m_isVirtual(isVirtual)
+    , m_nowInTicks(isVirtual ? NowFromQPC().count() : 0)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+wgc::TimeSpan ayc::ReplayClock::Now() const
+{
+    if (!m_isVirtual)
+    {
+        return NowFromQPC();
+    }
+    return wgc::TimeSpan(m_nowInTicks.load(std::memory_order_acquire));
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReplayClock::Advance(const wgc::TimeSpan& nowInTS)
+{
+    // @note: 時刻は戻さない
+    if (!m_isVirtual)
+    {
+        return;
+    }
+    auto current = m_nowInTicks.load(std::memory_order_relaxed);
+    while (current < nowInTS.count())
+    {
+        if (m_nowInTicks.compare_exchange_weak(current, nowInTS.count(), std::memory_order_acq_rel))
+        {
+            break;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ReplaySource
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ReplaySource::ReplaySource(
+    const std::string& path,
+    const REPLAY_PARAM& param,
+    const std::shared_ptr<ReplayClock>& pClock,
+    details::WGCSessionState& state,
+    ExceptionTunnel& exceptionTunnel,
+    std::optional<std::size_t> maxWidth,
+    std::optional<std::size_t> maxHeight
+)
+    : m_archive(path)
+    , m_schedule(_CollectRelativesInSec(m_archive), param.speed, param.isLooped)
+    , m_param(param)
+    , m_pClock(pClock)
+    , m_state(state)
+    , m_exceptionTunnel(exceptionTunnel)
+    , m_maxWidth(maxWidth)
+    , m_maxHeight(maxHeight)
+    , m_guard()
+    , m_cv()
+    , m_isClosed(false)
+    , m_isFinished(false)
+    , m_thread()
+{
+    // パラメータチェック
+    if (!m_pClock)
+    {
+        throw MAKE_GENERAL_ERROR("NO Replay Clock");
+    }
+    if (m_archive.GetSize() == 0)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Archive has no frames", path);
+    }
+    // スレッド起動
+    {
+        m_thread = std::thread(std::bind(&ReplaySource::_ThreadHandler, this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::ReplaySource::~ReplaySource()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReplaySource::Close()
+{
+    // 停止を通知
+    {
+        std::lock_guard<std::mutex> lock(m_guard);
+        m_isClosed = true;
+    }
+    m_cv.notify_all();
+
+    // スレッド終了を待機
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReplaySource::_ThreadHandler()
+{
+    try
+    {
+        // 基準時刻
+        /* @note:
+            タイムスタンプは「再生開始時点の現在」にオフセットを足したものとする。
+            待たずに流す場合は、仮想時刻をタイムスタンプに合わせて進めてから追加する。
+        */
+        const auto startInTS = m_pClock->Now();
+        const auto steadyStart = std::chrono::steady_clock::now();
+
+        // 流す
+        std::size_t width = 0;
+        std::size_t height = 0;
+        std::string frameBuffer;
+        REPLAY_STEP step{};
+        while (m_schedule.Next(step))
+        {
+            // 展開してテクスチャに上げる
+            // @note: 待ち時間の前に済ませておき、実時間で流す場合の遅れを減らす
+            m_archive.ReadFrame(width, height, frameBuffer, step.frameIndex);
+            const auto pTexture = _CreateTexture(width, height, frameBuffer);
+
+            // 流す時刻まで待つ
+            {
+                std::unique_lock<std::mutex> lock(m_guard);
+                if (m_param.isRealtime)
+                {
+                    const auto deadline = steadyStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        std::chrono::duration<double>(step.offsetInSec)
+                    );
+                    m_cv.wait_until(lock, deadline, [this] { return m_isClosed; });
+                }
+                if (m_isClosed)
+                {
+                    return;
+                }
+            }
+            // 追加
+            const auto timeSpan = startInTS + std::chrono::duration_cast<wgc::TimeSpan>(
+                std::chrono::duration<double>(step.offsetInSec)
+            );
+            m_pClock->Advance(timeSpan);
+            m_state.PushCapturedFrame(pTexture, timeSpan, m_maxWidth, m_maxHeight);
+        }
+        // @note: 最後のフレームの署名は次のフレームを待たずに受け取る
+        m_state.FlushPendingSignature();
+        m_isFinished = true;
+    }
+    catch (const GeneralError& e)
+    {
+        m_isFinished = true;
+        m_exceptionTunnel.ThrowIn(e);
+    }
+    catch (const std::exception& e)
+    {
+        m_isFinished = true;
+        m_exceptionTunnel.ThrowIn(
+            MAKE_GENERAL_ERROR_FROM_CPP_EXCEPTION("Unhandled C++ Exception", e)
+        );
+    }
+    catch (...)
+    {
+        m_isFinished = true;
+        m_exceptionTunnel.ThrowIn(
+            MAKE_GENERAL_ERROR("Unhandled Unknown Exception")
+        );
+    }
+}
+
+//-----------------------------------------------------------------------------
+wgc::com_ptr<ID3D11Texture2D> ayc::ReplaySource::_CreateTexture(
+    std::size_t width,
+    std::size_t height,
+    const std::string& frameBuffer
+)
+{
+    // BGR24 --> BGRA32
+    // @note: キャプチャ経路のテクスチャに合わせる
+    std::vector<std::uint8_t> pixels(width * height * 4);
+    {
+        const auto* pSrc = reinterpret_cast<const std::uint8_t*>(frameBuffer.data());
+        auto* pDest = pixels.data();
+        for (std::size_t i = 0; i < width * height; ++i)
+        {
+            pDest[0] = pSrc[0];
+            pDest[1] = pSrc[1];
+            pDest[2] = pSrc[2];
+            pDest[3] = 0xFF;
+            pSrc += 3;
+            pDest += 4;
+        }
+    }
+    // 生成
+    wgc::com_ptr<ID3D11Texture2D> pTexture;
+    {
+        // 記述
+        D3D11_TEXTURE2D_DESC desc{};
+        {
+            desc.Width = static_cast<UINT>(width);
+            desc.Height = static_cast<UINT>(height);
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+            desc.SampleDesc.Count = 1;
+            desc.SampleDesc.Quality = 0;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            desc.CPUAccessFlags = 0;
+            desc.MiscFlags = 0;
+        }
+        // 初期データ
+        D3D11_SUBRESOURCE_DATA initialData{};
+        {
+            initialData.pSysMem = pixels.data();
+            initialData.SysMemPitch = static_cast<UINT>(width * 4);
+            initialData.SysMemSlicePitch = 0;
+        }
+        // 生成
+        const HRESULT result = ayc::d3d11::Device()->CreateTexture2D(
+            &desc,
+            &initialData,
+            pTexture.put()
+        );
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11Device::CreateTexture2D", result);
+        }
+    }
+    return pTexture;
+}
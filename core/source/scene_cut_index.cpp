@@ -0,0 +1,168 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "scene_cut_index.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // タイル輝度のヒストグラムのビン数
+    const std::size_t SCENE_CUT_HISTOGRAM_BINS = 32;
+}
+
+//-----------------------------------------------------------------------------
+// SceneCutIndex
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::SceneCutIndex::SceneCutIndex(
+    double holdInSec,
+    double threshold,
+    std::function<wgc::TimeSpan()> clock
+)
+    : m_guard()
+    , m_cuts()
+    , m_prevFeature()
+    , m_latestScore(0.0)
+    , m_holdInSec(holdInSec)
+    , m_threshold(threshold)
+    , m_clock(clock ? std::move(clock) : std::function<wgc::TimeSpan()>(NowFromQPC))
+{
+    // パラメータチェック
+    if (!(threshold >= 0.0 && threshold <= 1.0))
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("threshold must be in [0, 1]", threshold);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::SceneCutIndex::Push(
+    const std::shared_ptr<const FRAME_SIGNATURE>& pSignature,
+    const wgc::TimeSpan& timeSpan
+)
+{
+    // 特徴量はロックの外で求める
+    auto feature = _MakeFeature(*pSignature);
+
+    std::lock_guard<std::mutex> lock(m_guard);
+
+    // 直前のフレームとの差
+    // @note: 最初のフレームは切り替えとみなさない
+    const double score = m_prevFeature ? _ComputeScore(*m_prevFeature, feature) : 0.0;
+    m_prevFeature = std::move(feature);
+    m_latestScore = score;
+    if (score > m_threshold)
+    {
+        m_cuts.push_back(_ENTRY{ timeSpan, score });
+    }
+    // 保持期間を過ぎた記録を捨てる
+    while (!m_cuts.empty() && toDurationInSec(timeSpan, m_cuts.front().timeSpan) > m_holdInSec)
+    {
+        m_cuts.pop_front();
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ayc::SCENE_CUT> ayc::SceneCutIndex::GetCuts(double durationInSec) const
+{
+    // @note: 保持期間より長い指定（無限大を含む）は保持期間に丸める
+    const auto nowInTS = m_clock();
+    const auto beginInTS = nowInTS - std::chrono::duration_cast<wgc::TimeSpan>(
+        std::chrono::duration<double>(std::clamp(durationInSec, 0.0, m_holdInSec))
+    );
+
+    std::lock_guard<std::mutex> lock(m_guard);
+
+    // 範囲の先頭を二分探索
+    const auto it = std::lower_bound(
+        m_cuts.begin(),
+        m_cuts.end(),
+        beginInTS,
+        [](const _ENTRY& entry, const wgc::TimeSpan& t) { return entry.timeSpan < t; }
+    );
+    std::vector<SCENE_CUT> cuts;
+    cuts.reserve(std::distance(it, m_cuts.end()));
+    for (auto i = it; i != m_cuts.end(); ++i)
+    {
+        cuts.push_back(SCENE_CUT{ std::max(toDurationInSec(nowInTS, i->timeSpan), 0.0), i->score });
+    }
+    return cuts;
+}
+
+//-----------------------------------------------------------------------------
+double ayc::SceneCutIndex::GetLatestScore() const
+{
+    std::lock_guard<std::mutex> lock(m_guard);
+    return m_latestScore;
+}
+
+//-----------------------------------------------------------------------------
+ayc::SceneCutIndex::_FEATURE ayc::SceneCutIndex::_MakeFeature(const FRAME_SIGNATURE& signature)
+{
+    _FEATURE feature{};
+    feature.width = signature.width;
+    feature.height = signature.height;
+    feature.tileMeans.resize(signature.tileLumas.size());
+    feature.histogram.assign(SCENE_CUT_HISTOGRAM_BINS, 0);
+    feature.numPixels = 0;
+
+    // タイルごとの平均輝度と、画素数で重み付けしたヒストグラム
+    // @note: 右端・下端のタイルは欠けている分だけ画素数が少ない
+    for (std::uint32_t ty = 0; ty < signature.numTilesY; ++ty)
+    {
+        const std::uint32_t tileHeight = std::min(FRAME_SIGNATURE_TILE_SIZE, signature.height - ty * FRAME_SIGNATURE_TILE_SIZE);
+        for (std::uint32_t tx = 0; tx < signature.numTilesX; ++tx)
+        {
+            const std::uint32_t tileWidth = std::min(FRAME_SIGNATURE_TILE_SIZE, signature.width - tx * FRAME_SIGNATURE_TILE_SIZE);
+            const std::uint32_t numPixels = tileWidth * tileHeight;
+            const std::size_t index = static_cast<std::size_t>(ty) * signature.numTilesX + tx;
+            const std::uint32_t mean = (signature.tileLumas[index] + numPixels / 2) / numPixels;
+            feature.tileMeans[index] = static_cast<std::uint8_t>(std::min<std::uint32_t>(mean, 255));
+            feature.histogram[feature.tileMeans[index] * SCENE_CUT_HISTOGRAM_BINS / 256] += numPixels;
+            feature.numPixels += numPixels;
+        }
+    }
+    return feature;
+}
+
+//-----------------------------------------------------------------------------
+double ayc::SceneCutIndex::_ComputeScore(const _FEATURE& lhs, const _FEATURE& rhs)
+{
+    // サイズが変われば別シーン
+    if (lhs.width != rhs.width || lhs.height != rhs.height || lhs.numPixels == 0)
+    {
+        return 1.0;
+    }
+    // タイル輝度の平均絶対差
+    const double gridDistance = MeanAbsoluteDifference(lhs.tileMeans.data(), rhs.tileMeans.data(), lhs.tileMeans.size());
+    // ヒストグラムの差（1 次元の Earth Mover's Distance）
+    /* @note:
+        ビンごとの差を足すだけだと、全体が１ビン明るくなっただけでも最大の差になってしまう。
+        累積ヒストグラムの差を足せば、分布がずれた距離に比例した値になる。
+    */
+    double histogramDistance = 0.0;
+    {
+        std::int64_t lhsCumulative = 0;
+        std::int64_t rhsCumulative = 0;
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i + 1 < SCENE_CUT_HISTOGRAM_BINS; ++i)
+        {
+            lhsCumulative += lhs.histogram[i];
+            rhsCumulative += rhs.histogram[i];
+            sum += static_cast<std::uint64_t>(std::abs(lhsCumulative - rhsCumulative));
+        }
+        histogramDistance = static_cast<double>(sum) / (static_cast<double>(lhs.numPixels) * (SCENE_CUT_HISTOGRAM_BINS - 1));
+    }
+    return std::clamp((gridDistance + histogramDistance) * 0.5, 0.0, 1.0);
+}
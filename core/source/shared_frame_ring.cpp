@@ -0,0 +1,293 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "shared_frame_ring.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // ピクセルデータ領域の先頭アライメント
+    const std::size_t SHARED_FRAME_RING_DATA_ALIGNMENT = 4096;
+
+    // 書き出し待ちにできるフレームの最大枚数
+    // @note: 書き出しが追いつかない場合は古いものから捨てる
+    const std::size_t SHARED_FRAME_PUBLISHER_MAX_PENDING = 2;
+}
+
+//-----------------------------------------------------------------------------
+// SharedFrameRing
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::SharedFrameRing::SharedFrameRing(
+    const std::string& name,
+    std::size_t numSlots,
+    std::size_t slotCapacityInBytes
+)
+    : m_name(name)
+    , m_hMapping(nullptr)
+    , m_pView(nullptr)
+    , m_numSlots(numSlots)
+    , m_slotCapacityInBytes(slotCapacityInBytes)
+    , m_nextSlot(0)
+{
+    // パラメータチェック
+    if (name.empty())
+    {
+        throw MAKE_GENERAL_ERROR("name must not be empty");
+    }
+    if (numSlots < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("numSlots must be positive", numSlots);
+    }
+    if (slotCapacityInBytes < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("slotCapacityInBytes must be positive", slotCapacityInBytes);
+    }
+    // レイアウトを解決
+    const std::size_t descEndInBytes = sizeof(SHARED_FRAME_RING_HEADER) + sizeof(SHARED_FRAME_SLOT) * numSlots;
+    const std::size_t dataOffsetInBytes = (
+        (descEndInBytes + SHARED_FRAME_RING_DATA_ALIGNMENT - 1) / SHARED_FRAME_RING_DATA_ALIGNMENT * SHARED_FRAME_RING_DATA_ALIGNMENT
+    );
+    const std::uint64_t totalSizeInBytes = dataOffsetInBytes + static_cast<std::uint64_t>(slotCapacityInBytes) * numSlots;
+
+    // 名前付き共有メモリを生成
+    /* @note:
+        同名の共有メモリが既にあると、読み手とレイアウトが食い違う恐れがあるのでエラーにする。
+    */
+    {
+        m_hMapping = CreateFileMappingA(
+            INVALID_HANDLE_VALUE,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(totalSizeInBytes >> 32),
+            static_cast<DWORD>(totalSizeInBytes & 0xFFFFFFFF),
+            name.c_str()
+        );
+        if (!m_hMapping)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFileMapping failed", HRESULT_FROM_WIN32(GetLastError()));
+        }
+        if (GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle(m_hMapping);
+            m_hMapping = nullptr;
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Shared memory already exists", name);
+        }
+    }
+    // マップ
+    {
+        m_pView = static_cast<std::uint8_t*>(
+            MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)
+        );
+        if (!m_pView)
+        {
+            const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            CloseHandle(m_hMapping);
+            m_hMapping = nullptr;
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("MapViewOfFile failed", hr);
+        }
+    }
+    // ヘッダを書き込む
+    /* @note:
+        生成直後の共有メモリはゼロ埋めされているので、スロットは全て「空（seq = 0）」になっている。
+        magic は最後に書き込み、読み手が書きかけのヘッダを見ないようにする。
+    */
+    {
+        auto& header = *reinterpret_cast<SHARED_FRAME_RING_HEADER*>(m_pView);
+        header.version = SHARED_FRAME_RING_VERSION;
+        header.numSlots = static_cast<std::uint32_t>(numSlots);
+        header.slotDescSizeInBytes = static_cast<std::uint32_t>(sizeof(SHARED_FRAME_SLOT));
+        header.slotCapacityInBytes = slotCapacityInBytes;
+        header.dataOffsetInBytes = dataOffsetInBytes;
+        header.latestSeq = 0;
+        std::atomic_ref<std::uint32_t>(header.magic).store(SHARED_FRAME_RING_MAGIC, std::memory_order_release);
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::SharedFrameRing::~SharedFrameRing()
+{
+    // @note: 読み手がアタッチ中なら、共有メモリ自体は最後の読み手が閉じるまで残る
+    if (m_pView)
+    {
+        UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::SharedFrameRing::Publish(
+    std::uint64_t seq,
+    wgc::TimeSpan timeSpan,
+    std::size_t width,
+    std::size_t height,
+    std::size_t stride,
+    SharedFrameFormat format,
+    const void* pData,
+    std::size_t sizeInBytes
+)
+{
+    // スロットに収まらないならスキップ
+    if (sizeInBytes > m_slotCapacityInBytes)
+    {
+        return false;
+    }
+    // 書き込み先スロットを決める
+    const auto slotIndex = m_nextSlot;
+    m_nextSlot = (m_nextSlot + 1) % m_numSlots;
+    auto& slot = _GetSlot(slotIndex);
+
+    // seqlock で保護しながら書き込む
+    /* @note:
+        lock を奇数にしている間は書き込み中。
+        読み手は読み出し前後の lock を比較して、書き込みと重なったら読み直す。
+    */
+    {
+        std::atomic_ref<std::uint64_t> lock(slot.lock);
+        const auto lockValue = lock.load(std::memory_order_relaxed);
+        lock.store(lockValue + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.seq = seq;
+        slot.timestamp = timeSpan.count();
+        slot.width = static_cast<std::uint32_t>(width);
+        slot.height = static_cast<std::uint32_t>(height);
+        slot.stride = static_cast<std::uint32_t>(stride);
+        slot.format = static_cast<std::uint32_t>(format);
+        slot.sizeInBytes = sizeInBytes;
+        std::memcpy(_GetSlotData(slotIndex), pData, sizeInBytes);
+
+        lock.store(lockValue + 2, std::memory_order_release);
+    }
+    // 最新フレームを更新
+    {
+        auto& header = *reinterpret_cast<SHARED_FRAME_RING_HEADER*>(m_pView);
+        std::atomic_ref<std::uint64_t>(header.latestSeq).store(seq, std::memory_order_release);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+ayc::SHARED_FRAME_SLOT& ayc::SharedFrameRing::_GetSlot(std::size_t index)
+{
+    auto* const pSlots = reinterpret_cast<SHARED_FRAME_SLOT*>(m_pView + sizeof(SHARED_FRAME_RING_HEADER));
+    return pSlots[index];
+}
+
+//-----------------------------------------------------------------------------
+std::uint8_t* ayc::SharedFrameRing::_GetSlotData(std::size_t index)
+{
+    const auto& header = *reinterpret_cast<const SHARED_FRAME_RING_HEADER*>(m_pView);
+    return m_pView + header.dataOffsetInBytes + index * m_slotCapacityInBytes;
+}
+
+//-----------------------------------------------------------------------------
+// SharedFramePublisher
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::SharedFramePublisher::SharedFramePublisher(
+    const std::shared_ptr<FrameDispatcher>& pFrameDispatcher,
+    const std::string& name,
+    std::size_t numSlots,
+    std::size_t slotCapacityInBytes
+)
+    : m_ring(name, numSlots, slotCapacityInBytes)
+    , m_pFrameDispatcher(pFrameDispatcher)
+    , m_pSubscriber()
+    , m_numPublished(0)
+    , m_numOversized(0)
+    , m_thread()
+{
+    // 購読開始
+    {
+        m_pSubscriber = m_pFrameDispatcher->Subscribe(
+            SHARED_FRAME_PUBLISHER_MAX_PENDING,
+            OverflowPolicy::DROP_OLDEST
+        );
+    }
+    // スレッド起動
+    {
+        m_thread = std::thread(std::bind(&SharedFramePublisher::_ThreadHandler, this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::SharedFramePublisher::~SharedFramePublisher()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::SharedFramePublisher::Close()
+{
+    // 購読終了
+    if (m_pFrameDispatcher)
+    {
+        m_pFrameDispatcher->Unsubscribe(m_pSubscriber);
+        m_pFrameDispatcher.reset();
+    }
+    // スレッド終了を待機
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::SHARED_FRAME_PUBLISHER_STATS ayc::SharedFramePublisher::GetStats() const
+{
+    return SHARED_FRAME_PUBLISHER_STATS{
+        m_numPublished.load(),
+        m_numOversized.load(),
+        m_pSubscriber->GetStats().dropped
+    };
+}
+
+//-----------------------------------------------------------------------------
+void ayc::SharedFramePublisher::_ThreadHandler()
+{
+    // クローズされるまで到着順に書き出す
+    SUBSCRIBED_FRAME frame;
+    while (m_pSubscriber->Pop(frame))
+    {
+        // @note: ReadbackTexture はアルファを捨てた BGR を詰めて書き出す
+        const auto& result = *frame.pResult;
+        const bool isPublished = m_ring.Publish(
+            frame.seq,
+            frame.timeSpan,
+            result.width,
+            result.height,
+            result.width * 3,
+            SharedFrameFormat::BGR24,
+            result.textureBuffer.GetData(),
+            result.textureBuffer.GetSize()
+        );
+        if (isPublished)
+        {
+            m_numPublished += 1;
+        }
+        else
+        {
+            m_numOversized += 1;
+        }
+        m_pSubscriber->MarkDelivered(frame);
+    }
+}
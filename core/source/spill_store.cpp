@@ -0,0 +1,438 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "spill_store.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // レコードの先頭アライメント
+    const std::uint64_t SPILL_RECORD_ALIGNMENT = 8;
+
+    // セグメントファイル１つの最小サイズ
+    const std::uint64_t SPILL_MIN_SEGMENT_SIZE = 1024 * 1024;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // アライメントに切り上げる
+    std::uint64_t _AlignUp(std::uint64_t value)
+    {
+        return (value + SPILL_RECORD_ALIGNMENT - 1) / SPILL_RECORD_ALIGNMENT * SPILL_RECORD_ALIGNMENT;
+    }
+
+    // セグメントファイルの通し番号を払い出す
+    // @note: ファイル名の重複を避けるため、全セッションで通し番号にする
+    std::uint64_t _NextSegmentId()
+    {
+        static std::atomic<std::uint64_t> s_nextId(1);
+        return s_nextId++;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// SpillSegment
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::SpillSegment::SpillSegment(
+    const std::string& path,
+    std::uint64_t id,
+    std::uint64_t capacityInBytes
+)
+    : m_id(id)
+    , m_hFile(INVALID_HANDLE_VALUE)
+    , m_hMapping(nullptr)
+    , m_pView(nullptr)
+    , m_capacityInBytes(capacityInBytes)
+    , m_usedInBytes(0)
+    , m_numRecords(0)
+{
+    // ファイルを作成
+    /* @note:
+        一時ファイルとして作成し、閉じたら消えるようにする。
+        FILE_ATTRIBUTE_TEMPORARY なのでキャッシュマネージャーはなるべくディスクに書かずに済ませようとするが、
+        メモリが逼迫すればページアウトされるので、物理メモリを超える量を保持できる。
+    */
+    {
+        m_hFile = CreateFileA(
+            path.c_str(),
+            GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_DELETE,
+            nullptr,
+            CREATE_NEW,
+            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+            nullptr
+        );
+        if (m_hFile == INVALID_HANDLE_VALUE)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFile failed", HRESULT_FROM_WIN32(GetLastError()));
+        }
+    }
+    // ファイルマッピングを作成
+    // @note: ここでファイルが capacityInBytes まで確保される
+    {
+        m_hMapping = CreateFileMappingA(
+            m_hFile,
+            nullptr,
+            PAGE_READWRITE,
+            static_cast<DWORD>(capacityInBytes >> 32),
+            static_cast<DWORD>(capacityInBytes & 0xFFFFFFFF),
+            nullptr
+        );
+        if (!m_hMapping)
+        {
+            const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            CloseHandle(m_hFile);
+            m_hFile = INVALID_HANDLE_VALUE;
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFileMapping failed", hr);
+        }
+    }
+    // マップ
+    {
+        m_pView = static_cast<std::uint8_t*>(
+            MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)
+        );
+        if (!m_pView)
+        {
+            const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            CloseHandle(m_hMapping);
+            m_hMapping = nullptr;
+            CloseHandle(m_hFile);
+            m_hFile = INVALID_HANDLE_VALUE;
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("MapViewOfFile failed", hr);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::SpillSegment::~SpillSegment()
+{
+    if (m_pView)
+    {
+        UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::uint8_t* ayc::SpillSegment::Allocate(std::uint64_t sizeInBytes, std::uint64_t& outOffset)
+{
+    if (m_capacityInBytes - m_usedInBytes < sizeInBytes)
+    {
+        return nullptr;
+    }
+    outOffset = m_usedInBytes;
+    m_usedInBytes += sizeInBytes;
+    return m_pView + outOffset;
+}
+
+//-----------------------------------------------------------------------------
+// SpillStore
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::SpillStore::SpillStore(const SPILL_PARAM& param)
+    : m_guard()
+    , m_param(param)
+    , m_segments()
+    , m_retiredSegmentId(0)
+    , m_numRetired(0)
+    , m_pKeyframeSource()
+    , m_pSpilledKeyframe()
+    , m_pPrevSource()
+    , m_pPrevSpilled()
+{
+    // パラメータチェック
+    if (param.directory.empty())
+    {
+        throw MAKE_GENERAL_ERROR("directory must not be empty");
+    }
+    if (param.spillAfterInSec <= 0.0)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("spillAfterInSec must be semi-positive", param.spillAfterInSec);
+    }
+    if (param.segmentSizeInBytes < SPILL_MIN_SEGMENT_SIZE)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("segmentSizeInBytes is too small", param.segmentSizeInBytes);
+    }
+    if (param.budgetInBytes < param.segmentSizeInBytes)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("budgetInBytes must be at least segmentSizeInBytes", param.budgetInBytes);
+    }
+    // 末尾の区切り文字は落としておく
+    while (m_param.directory.size() > 1 && (m_param.directory.back() == '\\' || m_param.directory.back() == '/'))
+    {
+        m_param.directory.pop_back();
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ayc::ColdFrame> ayc::SpillStore::Spill(
+    const std::shared_ptr<const ColdFrame>& pFrame,
+    const wgc::TimeSpan& timeSpan
+)
+{
+    // nullptr チェック
+    if (!pFrame)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("NO Cold Frame", pFrame);
+    }
+    // 書き出し済みならそのまま
+    if (pFrame->IsSpilled())
+    {
+        return pFrame;
+    }
+    std::scoped_lock lock(m_guard);
+
+    // エイリアス
+    const auto& pKeyframeSource = pFrame->IsKeyframe() ? pFrame : pFrame->m_pKeyframe;
+
+    // 差分フレームならキーフレームが同じセグメントに書き出されている必要がある
+    const auto needsKeyframe = [&]()
+    {
+        return (
+            !pFrame->IsKeyframe() &&
+            !(
+                m_pKeyframeSource == pKeyframeSource &&
+                m_pSpilledKeyframe &&
+                m_pSpilledKeyframe->m_segmentId == m_segments.back()->GetId()
+            )
+        );
+    };
+    // 書き込みサイズの上限を見積もる
+    const auto estimateSize = [](const ColdFrame& frame)
+    {
+        std::uint64_t sizeInBytes = sizeof(SPILL_RECORD_HEADER) + sizeof(SPILL_TILE_ENTRY) * frame.GetNumTiles();
+        for (const auto& pTile : frame.m_tiles)
+        {
+            sizeInBytes += pTile ? pTile->size() : 0;
+        }
+        return _AlignUp(sizeInBytes);
+    };
+    // 収まるセグメントを用意する
+    // @note: 空のセグメントにも収まらないならエラー
+    for (;;)
+    {
+        if (!m_segments.empty())
+        {
+            const auto& pSegment = m_segments.back();
+            const std::uint64_t requiredInBytes = (
+                estimateSize(*pFrame) +
+                (needsKeyframe() ? estimateSize(*pKeyframeSource) : 0)
+            );
+            if (pSegment->GetCapacityInBytes() - pSegment->GetUsedInBytes() >= requiredInBytes)
+            {
+                break;
+            }
+            if (pSegment->GetUsedInBytes() == 0)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Frame is too large for a spill segment", requiredInBytes);
+            }
+        }
+        _OpenSegment();
+    }
+    const auto& pSegment = m_segments.back();
+
+    // キーフレームを先に書き出す
+    // @note: 索引には載せない
+    if (needsKeyframe())
+    {
+        m_pSpilledKeyframe = _WriteRecord(*pSegment, pSegment, *pKeyframeSource, nullptr, timeSpan);
+        m_pKeyframeSource = pKeyframeSource;
+        m_pPrevSource.reset();
+        m_pPrevSpilled.reset();
+    }
+    // 本体を書き出す
+    auto pSpilled = _WriteRecord(
+        *pSegment,
+        pSegment,
+        *pFrame,
+        pFrame->IsKeyframe() ? nullptr : m_pSpilledKeyframe,
+        timeSpan
+    );
+    pSegment->CountRecord();
+    if (pFrame->IsKeyframe())
+    {
+        m_pKeyframeSource = pFrame;
+        m_pSpilledKeyframe = pSpilled;
+    }
+    m_pPrevSource = pFrame;
+    m_pPrevSpilled = pSpilled;
+    return pSpilled;
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t ayc::SpillStore::GetRetiredSegmentId() const
+{
+    std::scoped_lock lock(m_guard);
+    return m_retiredSegmentId;
+}
+
+//-----------------------------------------------------------------------------
+ayc::SPILL_STATS ayc::SpillStore::GetStats() const
+{
+    std::scoped_lock lock(m_guard);
+    SPILL_STATS stats{ m_segments.size(), 0, 0, 0, m_numRetired };
+    for (const auto& pSegment : m_segments)
+    {
+        stats.diskBytes += pSegment->GetCapacityInBytes();
+        stats.usedBytes += pSegment->GetUsedInBytes();
+        stats.records += pSegment->GetNumRecords();
+    }
+    return stats;
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ayc::ColdFrame> ayc::SpillStore::_WriteRecord(
+    SpillSegment& segment,
+    const std::shared_ptr<const SpillSegment>& pSegment,
+    const ColdFrame& frame,
+    const std::shared_ptr<const ColdFrame>& pSpilledKeyframe,
+    const wgc::TimeSpan& timeSpan
+)
+{
+    // エイリアス
+    const std::size_t numTiles = frame.GetNumTiles();
+
+    // 直前に書き出したフレームとタイルを共有できるか
+    /* @note:
+        同じセグメント内で、同じキーフレームを参照する差分フレーム同士に限る。
+        共有しているタイルは直前のレコードのデータを指すだけにする。
+    */
+    const bool canSharePrev = (
+        !frame.IsKeyframe() &&
+        m_pPrevSource &&
+        m_pPrevSpilled &&
+        m_pPrevSpilled->m_segmentId == segment.GetId() &&
+        m_pPrevSource->m_pKeyframe == frame.m_pKeyframe
+    );
+    const auto* const pPrevEntries = canSharePrev ? reinterpret_cast<const SPILL_TILE_ENTRY*>(
+        segment.GetData() + m_pPrevSpilled->m_recordOffset + sizeof(SPILL_RECORD_HEADER)
+    ) : nullptr;
+    const auto isSharedTile = [&](std::size_t index)
+    {
+        return canSharePrev && frame.m_tiles[index] && m_pPrevSource->m_tiles[index] == frame.m_tiles[index];
+    };
+    // サイズを解決
+    std::uint64_t sizeInBytes = sizeof(SPILL_RECORD_HEADER) + sizeof(SPILL_TILE_ENTRY) * numTiles;
+    for (std::size_t i = 0; i < numTiles; ++i)
+    {
+        if (frame.m_tiles[i] && !isSharedTile(i))
+        {
+            sizeInBytes += frame.m_tiles[i]->size();
+        }
+    }
+    sizeInBytes = _AlignUp(sizeInBytes);
+
+    // 追記先を確保
+    std::uint64_t recordOffset = 0;
+    std::uint8_t* const pRecord = segment.Allocate(sizeInBytes, recordOffset);
+    if (!pRecord)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Spill segment overflow", sizeInBytes);
+    }
+    // ヘッダ
+    {
+        auto& header = *reinterpret_cast<SPILL_RECORD_HEADER*>(pRecord);
+        header.magic = SPILL_RECORD_MAGIC;
+        header.isKeyframe = frame.IsKeyframe() ? 1 : 0;
+        header.timestamp = timeSpan.count();
+        header.width = static_cast<std::uint32_t>(frame.m_width);
+        header.height = static_cast<std::uint32_t>(frame.m_height);
+        header.numTilesX = static_cast<std::uint32_t>(frame.m_numTilesX);
+        header.numTilesY = static_cast<std::uint32_t>(frame.m_numTilesY);
+        header.keyframeOffset = pSpilledKeyframe ? pSpilledKeyframe->m_recordOffset : 0;
+        header.recordSizeInBytes = sizeInBytes;
+    }
+    // タイル表とタイルのデータ
+    {
+        auto* const pEntries = reinterpret_cast<SPILL_TILE_ENTRY*>(pRecord + sizeof(SPILL_RECORD_HEADER));
+        std::uint64_t dataOffset = recordOffset + sizeof(SPILL_RECORD_HEADER) + sizeof(SPILL_TILE_ENTRY) * numTiles;
+        for (std::size_t i = 0; i < numTiles; ++i)
+        {
+            const auto& pTile = frame.m_tiles[i];
+            if (!pTile)
+            {
+                pEntries[i] = SPILL_TILE_ENTRY{ 0, 0 };
+            }
+            else if (isSharedTile(i))
+            {
+                pEntries[i] = pPrevEntries[i];
+            }
+            else
+            {
+                std::memcpy(pRecord + (dataOffset - recordOffset), pTile->data(), pTile->size());
+                pEntries[i] = SPILL_TILE_ENTRY{ dataOffset, pTile->size() };
+                dataOffset += pTile->size();
+            }
+        }
+    }
+    // セグメントを参照するコールドフレームを生成
+    auto pSpilled = std::make_shared<ColdFrame>();
+    pSpilled->m_width = frame.m_width;
+    pSpilled->m_height = frame.m_height;
+    pSpilled->m_numTilesX = frame.m_numTilesX;
+    pSpilled->m_numTilesY = frame.m_numTilesY;
+    pSpilled->m_pKeyframe = pSpilledKeyframe;
+    pSpilled->m_numStoredTiles = frame.m_numStoredTiles;
+    pSpilled->m_sizeInBytes = sizeof(ColdFrame);
+    pSpilled->m_pSegment = pSegment;
+    pSpilled->m_segmentId = segment.GetId();
+    pSpilled->m_recordOffset = recordOffset;
+    pSpilled->m_spilledSizeInBytes = static_cast<std::size_t>(sizeInBytes);
+    return pSpilled;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::SpillStore::_OpenSegment()
+{
+    // 上限を超える分は古いセグメントから破棄
+    /* @note:
+        破棄したセグメントを参照しているコールドフレームが残っている間は、
+        マップもファイルも残り続ける。FrameBuffer は GetRetiredSegmentId を見て該当フレームを手放す。
+    */
+    while (
+        !m_segments.empty() &&
+        (m_segments.size() + 1) * m_param.segmentSizeInBytes > m_param.budgetInBytes
+    )
+    {
+        m_retiredSegmentId = m_segments.front()->GetId();
+        m_numRetired += 1;
+        m_segments.pop_front();
+    }
+    // 新しいセグメントを開く
+    const std::uint64_t id = _NextSegmentId();
+    const std::string path = std::format(
+        "{}\\aynime_capture_{}_{}.spill",
+        m_param.directory,
+        GetCurrentProcessId(),
+        id
+    );
+    m_segments.emplace_back(std::make_shared<SpillSegment>(path, id, m_param.segmentSizeInBytes));
+}
@@ -0,0 +1,209 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "staging_texture_ring.h"
+
+// other
+#include "utils.h"
+#include "d3d11_system.h"
+#include "memory_tracker.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // サイズ・フォーマットごとに取っておくステージングテクスチャの枚数
+    // @note: スナップショットの先行転送の深さと同じだけあれば、定常状態で生成が起きない
+    const std::size_t STAGING_RING_CAPACITY_PER_SIZE = 4;
+}
+
+//-----------------------------------------------------------------------------
+// StagingTextureRing
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::StagingTextureRing& ayc::StagingTextureRing::Instance()
+{
+    static StagingTextureRing s_instance(STAGING_RING_CAPACITY_PER_SIZE);
+    return s_instance;
+}
+
+//-----------------------------------------------------------------------------
+ayc::StagingTextureRing::StagingTextureRing(std::size_t capacityPerSize)
+    : m_guard()
+    , m_freeTextures()
+    , m_capacityPerSize(capacityPerSize)
+{
+    // nop
+}
+
+//-----------------------------------------------------------------------------
+wgc::com_ptr<ID3D11Texture2D> ayc::StagingTextureRing::Acquire(const D3D11_TEXTURE2D_DESC& srcDesc)
+{
+    // 空きがあれば使い回す
+    {
+        std::scoped_lock lock(m_guard);
+        const auto iter = m_freeTextures.find(_ToKey(srcDesc));
+        if (iter != m_freeTextures.end() && !iter->second.empty())
+        {
+            auto pTexture = std::move(iter->second.back());
+            iter->second.pop_back();
+            return pTexture;
+        }
+    }
+    // 無ければ生成
+    wgc::com_ptr<ID3D11Texture2D> pTexture;
+    {
+        // 記述
+        D3D11_TEXTURE2D_DESC stagingDesc = srcDesc;
+        {
+            stagingDesc.Usage = D3D11_USAGE_STAGING;
+            stagingDesc.BindFlags = 0;
+            stagingDesc.CPUAccessFlags = D3D10_CPU_ACCESS_READ;
+            stagingDesc.MiscFlags = 0;
+        }
+        // 生成
+        const HRESULT result = ayc::d3d11::Device()->CreateTexture2D(
+            &stagingDesc,
+            nullptr,
+            pTexture.put()
+        );
+        if (result != S_OK)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to ID3D11Device::CreateTexture2D", result);
+        }
+        // @note: 解放はリングから追い出されてテクスチャが破棄された時に記帳される
+        TrackTexture(pTexture, MemoryCategory::STAGING_TEXTURE, MemoryTracker::Current());
+    }
+    return pTexture;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::StagingTextureRing::Release(const wgc::com_ptr<ID3D11Texture2D>& pTexture)
+{
+    if (!pTexture)
+    {
+        return;
+    }
+    D3D11_TEXTURE2D_DESC desc{};
+    pTexture->GetDesc(&desc);
+
+    // @note: 上限を超えた分は取っておかない。呼び出し元の参照が最後なら、そこで破棄される
+    std::scoped_lock lock(m_guard);
+    auto& freeTextures = m_freeTextures[_ToKey(desc)];
+    if (freeTextures.size() < m_capacityPerSize)
+    {
+        freeTextures.push_back(pTexture);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::StagingTextureRing::Clear()
+{
+    // @note: テクスチャの破棄はロックの外で行う
+    std::map<_KEY, std::vector<wgc::com_ptr<ID3D11Texture2D>>> freeTextures;
+    {
+        std::scoped_lock lock(m_guard);
+        freeTextures.swap(m_freeTextures);
+    }
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::StagingTextureRing::_KEY ayc::StagingTextureRing::_ToKey(const D3D11_TEXTURE2D_DESC& desc)
+{
+    return _KEY{ desc.Width, desc.Height, desc.Format };
+}
+
+//-----------------------------------------------------------------------------
+// Readback Pipeline
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::ReadbackPipeline::ReadbackPipeline(
+    IReadbackBackend& backend,
+    std::size_t count,
+    std::size_t depth
+)
+    : m_backend(backend)
+    , m_count(count)
+    , m_depth(depth)
+    , m_inFlight()
+    , m_next(0)
+{
+    // エラーチェック
+    if (depth < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("depth must be positive", depth);
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::ReadbackProgress ayc::ReadbackPipeline::Advance(std::size_t maxCompletions)
+{
+    std::size_t numCompleted = 0;
+    while (m_next < m_count || !m_inFlight.empty())
+    {
+        // 空きがある限り先行して発行
+        while (m_next < m_count && m_inFlight.size() < m_depth)
+        {
+            const std::size_t index = m_next++;
+            if (m_backend.Issue(index))
+            {
+                m_inFlight.push_back(index);
+            }
+        }
+        if (m_inFlight.empty())
+        {
+            continue;
+        }
+        // 上限に達していれば、発行だけ済ませて戻る
+        if (numCompleted >= maxCompletions)
+        {
+            return ReadbackProgress::YIELDED;
+        }
+        // 先頭が終わっていれば完了させる
+        if (!m_backend.TryComplete(m_inFlight.front()))
+        {
+            return ReadbackProgress::WAITING;
+        }
+        m_inFlight.pop_front();
+        numCompleted += 1;
+    }
+    return ReadbackProgress::FINISHED;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ReadbackPipeline::WaitForProgress()
+{
+    if (!m_inFlight.empty())
+    {
+        m_backend.WaitForProgress(m_inFlight.front());
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::RunReadbackPipeline(
+    IReadbackBackend& backend,
+    std::size_t count,
+    std::size_t depth
+)
+{
+    ReadbackPipeline pipeline(backend, count, depth);
+    for (;;)
+    {
+        const auto progress = pipeline.Advance(std::numeric_limits<std::size_t>::max());
+        if (progress == ReadbackProgress::FINISHED)
+        {
+            return;
+        }
+        // 終わっていなければ少し待つ
+        pipeline.WaitForProgress();
+    }
+}
@@ -0,0 +1,451 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "thread_pool.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // プロセス共通のプールのデフォルトのワーカー数の上限
+    // @note: 行単位の変換はメモリ帯域で頭打ちになるので、これ以上増やしても速くならない
+    const std::size_t THREAD_POOL_MAX_DEFAULT_WORKERS = 15;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Types
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // プロセス共通のプールの設定
+    struct _CONFIG
+    {
+        std::size_t                     numWorkers;
+        std::optional<std::uint64_t>    affinityMask;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Variables
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // プロセス共通のプールの設定
+    // @note: Instance を呼ぶまでの間だけ Configure で変えられる
+    std::mutex s_configGuard;
+    std::optional<std::size_t> s_configNumWorkers;
+    std::optional<std::uint64_t> s_configAffinityMask;
+    bool s_isConfigFrozen = false;
+
+    // 現在のスレッドの優先度
+    thread_local ayc::TaskPriority t_currentPriority = ayc::TaskPriority::BULK;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // プロセス共通のプールの設定を確定する
+    _CONFIG _FreezeConfig()
+    {
+        std::scoped_lock lock(s_configGuard);
+        s_isConfigFrozen = true;
+        const std::size_t numDefaultWorkers = std::clamp<std::size_t>(
+            std::max<std::size_t>(std::thread::hardware_concurrency(), 1) - 1,
+            1,
+            THREAD_POOL_MAX_DEFAULT_WORKERS
+        );
+        return _CONFIG{
+            s_configNumWorkers.value_or(numDefaultWorkers),
+            s_configAffinityMask
+        };
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ThreadPool
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+/*static*/ void ayc::ThreadPool::Configure(
+    std::optional<std::size_t> numWorkers,
+    std::optional<std::uint64_t> affinityMask
+)
+{
+    // パラメータチェック
+    // @note: Submit した仕事を実行するワーカーが最低１本は要る
+    if (numWorkers && *numWorkers < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("numWorkers must be positive", *numWorkers);
+    }
+    if (affinityMask && *affinityMask == 0)
+    {
+        throw MAKE_GENERAL_ERROR("affinityMask must not be empty");
+    }
+    std::scoped_lock lock(s_configGuard);
+    if (s_isConfigFrozen)
+    {
+        throw MAKE_GENERAL_ERROR("Thread Pool Already Started");
+    }
+    s_configNumWorkers = numWorkers;
+    s_configAffinityMask = affinityMask;
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::ThreadPool& ayc::ThreadPool::Instance()
+{
+    static const _CONFIG s_config = _FreezeConfig();
+    static ThreadPool s_instance(s_config.numWorkers, s_config.affinityMask);
+    return s_instance;
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ ayc::TaskPriority ayc::ThreadPool::GetCurrentPriority()
+{
+    return t_currentPriority;
+}
+
+//-----------------------------------------------------------------------------
+ayc::ThreadPool::ThreadPool(
+    std::size_t numWorkers,
+    std::optional<std::uint64_t> affinityMask
+)
+    : m_workers()
+    , m_threads()
+    , m_affinityMask(affinityMask)
+    , m_mutex()
+    , m_cv()
+    , m_numQueued(0)
+    , m_nextHome(0)
+    , m_numExecuted(0)
+    , m_numStolen(0)
+    , m_isStopping(false)
+{
+    m_workers.reserve(numWorkers);
+    for (std::size_t i = 0; i < numWorkers; ++i)
+    {
+        m_workers.push_back(std::make_unique<_WORKER>());
+    }
+    // スレッド起動
+    // @note: 途中で失敗したら、起動済みのスレッドを止めてから再送する
+    try
+    {
+        m_threads.reserve(numWorkers);
+        for (std::size_t i = 0; i < numWorkers; ++i)
+        {
+            m_threads.emplace_back([this, i]() { _ThreadHandler(i); });
+        }
+    }
+    catch (...)
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            m_isStopping = true;
+        }
+        m_cv.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+        throw;
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& func)
+{
+    // ワーカーがいなければ呼び出し元で実行
+    if (m_workers.empty() || count <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            func(i);
+        }
+        return;
+    }
+    // 完了待ちの状態
+    // @note: 全ての仕事が終わるまで戻らないので、仕事からはスタック上の変数を参照してよい
+    std::atomic<std::size_t> remaining(count);
+    std::atomic<bool> isCancelled(false);
+    std::mutex errorGuard;
+    std::exception_ptr pError = nullptr;
+    std::mutex doneGuard;
+    std::condition_variable doneCv;
+
+    // 仕事を積む
+    /* @note:
+        連続した範囲ごとにワーカーへ配る。隣り合う行が同じスレッドに乗るのでキャッシュに優しい。
+        例外が起きた後の仕事は実行せず、完了の数だけ数える。
+    */
+    const void* const pGroup = &remaining;
+    const TaskPriority priority = GetCurrentPriority();
+    const std::size_t numWorkers = m_workers.size();
+    const std::size_t home = m_nextHome.fetch_add(1, std::memory_order_relaxed) % numWorkers;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::size_t worker = (home + (i * numWorkers) / count) % numWorkers;
+        _Push(worker, priority, _TASK{
+            [&, i]()
+            {
+                if (!isCancelled.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        func(i);
+                    }
+                    catch (...)
+                    {
+                        std::scoped_lock lock(errorGuard);
+                        if (!pError)
+                        {
+                            pError = std::current_exception();
+                        }
+                        isCancelled = true;
+                    }
+                }
+                // @note: 呼び出し元が戻ってスタック上の状態を破棄するのは、このロックを手放した後
+                std::scoped_lock lock(doneGuard);
+                if (remaining.fetch_sub(1) == 1)
+                {
+                    doneCv.notify_all();
+                }
+            },
+            pGroup
+        });
+    }
+    _Notify();
+
+    // 完了を待つ間、呼び出し元も自分の仕事を引き受ける
+    while (remaining.load() > 0)
+    {
+        _TASK task;
+        TaskPriority taskPriority = priority;
+        if (_TryPop(home, pGroup, task, taskPriority))
+        {
+            _Run(task, taskPriority);
+            continue;
+        }
+        std::unique_lock lock(doneGuard);
+        doneCv.wait(lock, [&]() { return remaining.load() == 0; });
+    }
+    // 最後の仕事が通知し終えるのを待つ
+    {
+        std::scoped_lock lock(doneGuard);
+    }
+    // 例外を再送
+    if (pError)
+    {
+        std::rethrow_exception(pError);
+    }
+}
+
+//-----------------------------------------------------------------------------
+std::future<void> ayc::ThreadPool::Submit(std::function<void()> func)
+{
+    // @note: std::function はコピーできる必要があるので、packaged_task は shared_ptr で持つ
+    const auto pTask = std::make_shared<std::packaged_task<void()>>(std::move(func));
+    auto future = pTask->get_future();
+
+    // ワーカーがいなければその場で実行
+    if (m_workers.empty())
+    {
+        (*pTask)();
+        return future;
+    }
+    const std::size_t home = m_nextHome.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+    _Push(home, GetCurrentPriority(), _TASK{ [pTask]() { (*pTask)(); }, nullptr });
+    _Notify();
+    return future;
+}
+
+//-----------------------------------------------------------------------------
+std::size_t ayc::ThreadPool::GetNumWorkers() const
+{
+    return m_workers.size();
+}
+
+//-----------------------------------------------------------------------------
+ayc::ThreadPool::STATS ayc::ThreadPool::GetStats() const
+{
+    STATS stats{
+        m_workers.size(),
+        std::vector<std::size_t>(m_workers.size(), 0),
+        {},
+        m_numExecuted.load(std::memory_order_relaxed),
+        m_numStolen.load(std::memory_order_relaxed)
+    };
+    for (std::size_t i = 0; i < m_workers.size(); ++i)
+    {
+        const auto& worker = *m_workers[i];
+        std::scoped_lock lock(worker.guard);
+        for (std::size_t priority = 0; priority < NUM_TASK_PRIORITIES; ++priority)
+        {
+            const std::size_t depth = worker.tasks[priority].size();
+            stats.queueDepths[i] += depth;
+            stats.queuedTasks[priority] += depth;
+        }
+    }
+    return stats;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ThreadPool::_Push(std::size_t index, TaskPriority priority, _TASK task)
+{
+    auto& worker = *m_workers[index];
+    std::scoped_lock lock(worker.guard);
+    worker.tasks[static_cast<std::size_t>(priority)].push_back(std::move(task));
+    m_numQueued.fetch_add(1);
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::ThreadPool::_TryPop(std::size_t home, const void* pGroup, _TASK& outTask, TaskPriority& outPriority)
+{
+    const std::size_t numWorkers = m_workers.size();
+    for (std::size_t priority = 0; priority < NUM_TASK_PRIORITIES; ++priority)
+    {
+        for (std::size_t k = 0; k < numWorkers; ++k)
+        {
+            auto& worker = *m_workers[(home + k) % numWorkers];
+            std::scoped_lock lock(worker.guard);
+            auto& tasks = worker.tasks[priority];
+            if (tasks.empty())
+            {
+                continue;
+            }
+            // 取り出す仕事を探す
+            // @note: 自分のキューなら末尾から、他のワーカーのキューなら先頭から
+            std::deque<_TASK>::iterator iter;
+            if (k == 0)
+            {
+                const auto riter = std::find_if(
+                    tasks.rbegin(),
+                    tasks.rend(),
+                    [&](const _TASK& task) { return !pGroup || task.pGroup == pGroup; }
+                );
+                iter = (riter == tasks.rend()) ? tasks.end() : std::prev(riter.base());
+            }
+            else
+            {
+                iter = std::find_if(
+                    tasks.begin(),
+                    tasks.end(),
+                    [&](const _TASK& task) { return !pGroup || task.pGroup == pGroup; }
+                );
+            }
+            if (iter == tasks.end())
+            {
+                continue;
+            }
+            outTask = std::move(*iter);
+            outPriority = static_cast<TaskPriority>(priority);
+            tasks.erase(iter);
+            m_numQueued.fetch_sub(1);
+            if (k != 0)
+            {
+                m_numStolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ThreadPool::_Run(const _TASK& task, TaskPriority priority)
+{
+    // @note: 仕事は例外を外に出さない（ParallelFor・Submit が捕まえて呼び出し元に返す）
+    TaskPriorityScope priorityScope(priority);
+    task.func();
+    m_numExecuted.fetch_add(1, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ThreadPool::_Notify()
+{
+    // @note: 待機側は m_mutex の下で m_numQueued を見るので、ロックを経由して通知の取りこぼしを防ぐ
+    {
+        std::scoped_lock lock(m_mutex);
+    }
+    m_cv.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::ThreadPool::_ThreadHandler(std::size_t index)
+{
+    // コアに固定
+    // @note: 失敗しても動作には影響しないので、ログだけ残して続ける
+    if (m_affinityMask)
+    {
+        if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(*m_affinityMask)) == 0)
+        {
+            ayc::WriteLog("In ThreadPool, failed to set thread affinity mask: {}", GetLastError());
+        }
+    }
+    for (;;)
+    {
+        // 仕事があれば実行
+        _TASK task;
+        TaskPriority priority = TaskPriority::BULK;
+        if (_TryPop(index, nullptr, task, priority))
+        {
+            _Run(task, priority);
+            continue;
+        }
+        // 無ければ積まれるまで待つ
+        // @note: 停止要求が来ても、積まれている仕事は実行しきる
+        std::unique_lock lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_isStopping || m_numQueued.load() > 0; });
+        if (m_isStopping && m_numQueued.load() == 0)
+        {
+            break;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TaskPriorityScope
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::TaskPriorityScope::TaskPriorityScope(TaskPriority priority)
+    : m_prevPriority(t_currentPriority)
+{
+    t_currentPriority = priority;
+}
+
+//-----------------------------------------------------------------------------
+ayc::TaskPriorityScope::~TaskPriorityScope()
+{
+    t_currentPriority = m_prevPriority;
+}
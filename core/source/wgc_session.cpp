@@ -12,6 +12,9 @@
 #include "d3d11_system.h"
 #include "utils.h"
 #include "resize_texture.h"
+#include "nv12_texture.h"
+#include "capture_scheduler.h"
+#include "frame_signature.h"
 
 
 //-----------------------------------------------------------------------------
@@ -40,6 +43,13 @@ namespace
 {
     // フレームプールのバックバッファの枚数
     const std::int32_t WGC_FRAME_POOL_NUM_BUFFERS = 3;
+
+    // キャプチャワーカースレッドの最大本数の初期値
+    const std::size_t CAPTURE_SCHEDULER_DEFAULT_MAX_WORKERS = 2;
+
+    // キャプチャワーカーが１巡回でセッション１つあたりに実行する仕事の数
+    // @note: フレーム到着は１セッションにつき１件に畳むので、１件で全セッションに１フレームずつ回る
+    const std::size_t CAPTURE_WORKER_TASK_BUDGET_PER_SESSION = 1;
 }
 
 //-----------------------------------------------------------------------------
@@ -124,6 +134,7 @@ namespace
         // コンストラクタ
         _OnFrameArrived
         (
+            ayc::ICaptureWorker& worker,
             const wgc::IDirect3DDevice& wrtDevice,
             ayc::details::WGCSessionState& state,
             ayc::ExceptionTunnel& exceptionTunnel,
@@ -131,12 +142,15 @@ namespace
             std::optional<std::size_t> maxWidth,
             std::optional<std::size_t> maxHeight
         )
-        : m_wrtDevice(wrtDevice)
+        : m_worker(worker)
+        , m_wrtDevice(wrtDevice)
         , m_state(state)
         , m_exceptionTunnel(exceptionTunnel)
         , m_latestContentSize(initialContentSize)
         , m_maxWidth(maxWidth)
         , m_maxHeight(maxHeight)
+        , m_hasFailed(false)
+        , m_isPosted(false)
         {
             // nop
         }
@@ -148,21 +162,55 @@ namespace
         }
 
         // ハンドラ
+        /* @note:
+            ここでは処理せず、フレームの取り出しをキャプチャワーカーに投入するだけ。
+            ワーカーはセッション単位のラウンドロビンで処理するので、
+            高フレームレートのセッションが同じワーカーの他のセッションを待たせ続けることはない。
+            処理は常に最新のフレームだけを使うので、未処理の投入があれば追加しない。
+            ハンドラも投入した仕事もワーカースレッド上で動くので、m_isPosted にロックは要らない。
+        */
         void Handler(
             const wgc::Direct3D11CaptureFramePool& sender,
             const wgc::WinRTIInspectable& args
         )
         {
+            if (m_hasFailed || m_isPosted)
+            {
+                return;
+            }
+            m_isPosted = true;
+            m_worker.Post(
+                this,
+                [this, sender]()
+                {
+                    m_isPosted = false;
+                    _Process(sender);
+                }
+            );
+        }
+
+    private:
+        // 最新のフレームを取り出してフレームバッファに詰める
+        void _Process(const wgc::Direct3D11CaptureFramePool& sender)
+        {
+            /* @note:
+                ワーカースレッドは他のセッションと共有しているので、例外でループを止めることはできない。
+                例外は一度だけトンネルに入れて、以降のフレームは無視する。
+                トンネル内の例外は WGCSession 側の呼び出しで再送される。
+            */
+            if (m_hasFailed)
+            {
+                return;
+            }
             try
             {
-                // @todo _WinRTClosureThreadHandler 側でまとめてハンドルできるつもりだけど本当？
                 // アパートメントタイプをデバッグ用にダンプ
                 {
                     static bool s_hasShown = false;
                     if (!s_hasShown)
                     {
                         ayc::WriteLog(
-                            ayc::ComApartmenTypeDiagnosticInfo("_OnFrameArrived::Handler")
+                            ayc::ComApartmenTypeDiagnosticInfo("_OnFrameArrived::_Process")
                         );
                         s_hasShown = true;
                     }
@@ -239,78 +287,47 @@ namespace
                         throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to GetInterface", result);
                     }
                 }
-                // フレームプール desc
-                D3D11_TEXTURE2D_DESC cfpDesc{};
-                {
-                    pCFPTex->GetDesc(&cfpDesc);
-                }
-                // コピー後サイズを解決
-                const auto [optimalWidth, optimalHeight] = _ResolveOptimalFrameSize(
-                    cfpDesc.Width,
-                    cfpDesc.Height,
-                    m_maxWidth,
-                    m_maxHeight
-                );
-                // フレームバッファ用にテクスチャのコピーを取る
-                /* @note:
-                    スケーリング不要ならシンプルにコピー。
-                    スケーリングが必要ならシェーダー起動。
-                */
-                wgc::com_ptr<ID3D11Texture2D> pFBTex;
-                if (cfpDesc.Width == optimalWidth && cfpDesc.Height == optimalHeight)
-                {
-                    // コピー先を生成
-                    {
-                        const HRESULT result = ayc::d3d11::Device()->CreateTexture2D(
-                            &cfpDesc,
-                            /*pInitialData=*/nullptr,
-                            pFBTex.put()
-                        );
-                        if (result != S_OK)
-                        {
-                            throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateTexture2D", result);
-                        }
-                    }
-                    // コピー
-                    {
-                        ayc::d3d11::Context()->CopyResource(pFBTex.get(), pCFPTex.get());
-                    }
-                }
-                else
-                {
-                    // リサイズ兼コピー
-                    pFBTex = ayc::ResizeTexture(pCFPTex, optimalWidth, optimalHeight);
-                }
                 // フレームバッファに詰める
                 {
-                    m_state.GetFrameBuffer().PushFrame(pFBTex, frame.SystemRelativeTime());
+                    m_state.PushCapturedFrame(
+                        pCFPTex,
+                        frame.SystemRelativeTime(),
+                        m_maxWidth,
+                        m_maxHeight
+                    );
                 }
             }
             catch (const ayc::GeneralError& e)
             {
+                m_hasFailed = true;
                 m_exceptionTunnel.ThrowIn(e);
             }
             catch (const std::exception& e)
             {
+                m_hasFailed = true;
                 m_exceptionTunnel.ThrowIn(
                     MAKE_GENERAL_ERROR_FROM_CPP_EXCEPTION("Unhandled C++ Exception", e)
                 );
             }
             catch (const winrt::hresult_error& e)
             {
+                m_hasFailed = true;
                 m_exceptionTunnel.ThrowIn(
                     MAKE_GENERAL_ERROR_FROM_WINRT_EXCEPTION("Unhandled WinRT Exception", e)
                 );
             }
             catch (...)
             {
+                m_hasFailed = true;
                 m_exceptionTunnel.ThrowIn(
                     MAKE_GENERAL_ERROR("Unhandled Unknown Exception")
                 );
             }
         }
 
-    private:
+        // 担当キャプチャワーカー
+        ayc::ICaptureWorker&            m_worker;
+
         // 親のメンバ変数への参照
         const wgc::IDirect3DDevice&     m_wrtDevice;
         ayc::details::WGCSessionState&  m_state;
@@ -320,6 +337,12 @@ namespace
         wgc::SizeInt32	            m_latestContentSize;
         std::optional<std::size_t>  m_maxWidth;
         std::optional<std::size_t>  m_maxHeight;
+
+        // 失敗済みフラグ
+        bool                        m_hasFailed;
+
+        // ワーカーに投入済みで未処理なら true
+        bool                        m_isPosted;
     };
 
     //-----------------------------------------------------------------------------
@@ -458,34 +481,18 @@ namespace
     }
 
     //-----------------------------------------------------------------------------
-    // WniRT 閉じ込め部分初期化パラメータ
-    struct _WINRT_CLOSURE_INIT_PARAM
-    {
-        HWND hwnd;
-        std::optional<std::size_t> maxWidth;
-        std::optional<std::size_t> maxHeight;
-        ayc::details::WGCSessionState& state;
-    };
-
-    //-----------------------------------------------------------------------------
-    // WinRT 関係の一切を閉じ込めるためのクラス
+    // キャプチャワーカー上の WinRT 環境を閉じ込めるためのクラス
     /* @note:
-        例外発生時も含めたすべてのコントロールパスで正常にデストラクト・続行できることを保証したかった。
-        なので RAII 的なことが支度で、致し方なくクラス化している。
+        アパートメントと DispatcherQueue はワーカースレッド１本につき１つだけ用意し、
+        そのスレッドに割り当てられた全セッションで共有する。
+        例外発生時も含めて正常にデストラクトできるよう RAII 的にクラス化している。
     */
-    class _WinRTClosureConcrete
+    class _CaptureWorkerConcrete
     {
     public:
         // コンストラクタ
-        _WinRTClosureConcrete(const _WINRT_CLOSURE_INIT_PARAM& param)
-            : m_state(param.state)
-            , m_exceptionTunnel()
-            , m_wrtDevice(nullptr)
-            , m_dqc(nullptr)
-            , m_pOnFrameArrived(nullptr)
-            , m_framePool(nullptr)
-            , m_captureSession(nullptr)
-            , m_revoker()
+        _CaptureWorkerConcrete()
+            : m_dqc(nullptr)
         {
             // WinRT 初期化
             {
@@ -496,29 +503,9 @@ namespace
             // アパートメントタイプをデバッグ用にダンプ
             {
                 ayc::WriteLog(
-                    ayc::ComApartmenTypeDiagnosticInfo("ayc::_WinRTClosureConcrete::_WinRTClosureConcrete")
+                    ayc::ComApartmenTypeDiagnosticInfo("ayc::_CaptureWorkerConcrete::_CaptureWorkerConcrete")
                 );
             }
-            // WinRT D3D11 Device
-            {
-                const auto dxgiDevice = TRY_WINRT_RET((
-                    [&]() { return ayc::d3d11::Device().as<IDXGIDevice>(); }
-                    ));
-                const HRESULT result = TRY_WINRT_RET((
-                    [&]()
-                    {
-                        return CreateDirect3D11DeviceFromDXGIDevice
-                        (
-                            dxgiDevice.get(),
-                            reinterpret_cast<wgc::GlobalIInspectable**>(wgc::put_abi(m_wrtDevice))
-                        );
-                    }
-                    ));
-                if (result != S_OK)
-                {
-                    throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateDirect3D11DeviceFromDXGIDevice.", result);
-                }
-            }
             // DispatcherQueueController 生成
             {
                 const DispatcherQueueOptions dqo{
@@ -545,148 +532,16 @@ namespace
                     throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateDispatcherQueueController", result);
                 }
             }
-            // キャプチャアイテム生成
-            wgc::GraphicsCaptureItem captureItem{ nullptr };
-            {
-                // interop 取得
-                const auto interop = TRY_WINRT_RET((
-                    ([&]() { return wgc::get_activation_factory<wgc::GraphicsCaptureItem, IGraphicsCaptureItemInterop>(); })
-                ));
-                // 指定のウィンドウに対してアイテムを生成
-                const HRESULT result = TRY_WINRT_RET((
-                    [&]()
-                    {
-                        return interop->CreateForWindow(
-                            param.hwnd,
-                            wgc::guid_of<wgc::GraphicsCaptureItem>(),
-                            wgc::put_abi(captureItem)
-                        );
-                    }
-                ));
-                if (result != S_OK)
-                {
-                    throw MAKE_GENERAL_ERROR_FROM_HRESULT("Faield to CreateForWindow", result);
-                }
-                if (!captureItem)
-                {
-                    throw MAKE_GENERAL_ERROR("captureItem is Invalid");
-                }
-            }
-            // コンテンツサイズ取得
-            const auto captureItemSize = TRY_WINRT_RET((
-                [&]() { return captureItem.Size(); }
-            ));
-            // ハンドラーインスタンス生成
-            {
-                m_pOnFrameArrived.reset(
-                    new _OnFrameArrived(
-                        m_wrtDevice,
-                        m_state,
-                        m_exceptionTunnel,
-                        captureItemSize,
-                        param.maxWidth,
-                        param.maxHeight
-                    )
-                );
-            }
-            // フレームプール生成
-            /* @note:
-                フレームプールのレベルではアルファチャンネルを切ることはできない
-            */
-            m_framePool = TRY_WINRT_RET((
-                [&]()
-                {
-                    return wgc::Direct3D11CaptureFramePool::Create(
-                        m_wrtDevice,
-                        wgc::DirectXPixelFormat::B8G8R8A8UIntNormalized,
-                        WGC_FRAME_POOL_NUM_BUFFERS,
-                        captureItemSize
-                    );
-                }
-            ));
-            // セッション生成
-            {
-                m_captureSession = TRY_WINRT_RET((
-                    [&]() { return m_framePool.CreateCaptureSession(captureItem); }
-                ));
-            }
-            // セッションの設定を変更
-            {
-                CALL_GCS_MEMBER(m_captureSession, IsCursorCaptureEnabled, false);
-                CALL_GCS_MEMBER(m_captureSession, IsBorderRequired, false);
-                CALL_GCS_MEMBER(m_captureSession, IncludeSecondaryWindows, false);
-            }
-            // セッション開始
-            {
-                TRY_WINRT((
-                    [&]() { m_captureSession.StartCapture(); }
-                ));
-            }
-            // フレーム到達ハンドラ登録
-            {
-                m_revoker = TRY_WINRT_RET((
-                    [&]()
-                    {
-                        return m_framePool.FrameArrived(
-                            winrt::auto_revoke,
-                            { m_pOnFrameArrived.get(), &_OnFrameArrived::Handler }
-                        );
-                    }
-                    ));
-            }
         }
 
         // デストラクタ
-        ~_WinRTClosureConcrete()
+        ~_CaptureWorkerConcrete()
         {
-            // ハンドラ登録解除
-            {
-                TRY_WINRT_NOTHROW((
-                    [&]() { m_revoker.revoke(); }
-                ));
-            }
-            // セッション停止
-            if (m_captureSession)
-            {
-                TRY_WINRT_NOTHROW((
-                    [&]()
-                    {
-                        m_captureSession.Close();
-                        m_captureSession = nullptr;
-                    }
-                    ));
-            }
-            // フレームプール後始末
-            if (m_framePool)
-            {
-                TRY_WINRT_NOTHROW((
-                    [&]()
-                    {
-                        m_framePool.Close();
-                        m_framePool = nullptr;
-                    }
-                ));
-            }
-            // ハンドラーインスタンス後始末
-            {
-                m_pOnFrameArrived.reset();
-            }
             // DispatcherQueue
             if (m_dqc)
             {
                 _ShutdownDispatcherQueueController(m_dqc);
-                m_dqc = nullptr;;
-            }
-            // WinRT D3D11 Device
-            if (m_wrtDevice)
-            {
-                TRY_WINRT_NOTHROW((
-                    [&]()
-                    {
-                        m_wrtDevice.Close();
-                        m_wrtDevice = nullptr;
-                    }
-                ));
+                m_dqc = nullptr;
             }
             // WinRT 後始末
             {
@@ -701,23 +556,30 @@ namespace
         }
 
         // コピー禁止
-        _WinRTClosureConcrete(const _WinRTClosureConcrete&) = delete;
-        _WinRTClosureConcrete& operator =(const _WinRTClosureConcrete&) = delete;
+        _CaptureWorkerConcrete(const _CaptureWorkerConcrete&) = delete;
+        _CaptureWorkerConcrete& operator =(const _CaptureWorkerConcrete&) = delete;
 
-        // セッション開始
-        void Run()
+        // メッセージループ
+        /* @note:
+            stopEvent がシグナルされるまで、メッセージとタスクを処理し続ける。
+            タスクはメッセージと同じスレッド上で順番に処理されるので、
+            各セッションのフレーム到着ハンドラと競合しない。
+            runTasks はタスクが残っていれば true を返す。その時は溜まったメッセージを処理してから次の巡回に移る。
+            taskEvent はメッセージより先に判定されるので、シグナルし直すとメッセージが後回しにされ続けるため。
+        */
+        void Run(
+            HANDLE stopEvent,
+            HANDLE taskEvent,
+            const std::function<bool(void)>& runTasks
+        )
         {
-            // メッセージループ
-            const wgc::DispatcherQueue dq = TRY_WINRT_RET((
-                [&]() { return m_dqc.DispatcherQueue(); }
-            ));
-            MSG msg{};
+            const HANDLE handles[] = { stopEvent, taskEvent };
             for (;;)
             {
                 // イベントを待機
                 const DWORD wait = MsgWaitForMultipleObjects(
-                    /*nCount=*/1,
-                    &m_state.GetStopEvent(),
+                    /*nCount=*/static_cast<DWORD>(std::size(handles)),
+                    handles,
                     /*fWailtAll*/FALSE,
                     /*dwMilliseconds=*/INFINITE,
                     /*dwWakeMask=*/QS_ALLINPUT
@@ -729,37 +591,26 @@ namespace
                 }
                 else if (wait == WAIT_OBJECT_0 + 1)
                 {
-                    for(;;)
+                    // @note: タスクが投入された
+                    while (runTasks())
                     {
-                        // メッセージを１件取得
-                        const bool peekResult = PeekMessage(
-                            &msg,
-                            /*hWnd=*/nullptr,
-                            /*wMsgFilterMin=*/0,
-                            /*wMsgFilterMax=*/0,
-                            /*wRemoveMsg=*/PM_REMOVE
-                        );
-                        // _OnFrameArrived::Handler で発生した例外を再送
-                        {
-                            m_exceptionTunnel.ThrowOut();
-                        }
-                        // メッセージなしなら次の待機へ
-                        if (!peekResult)
-                        {
-                            break;
-                        }
-                        // 終了メッセージなら、メッセージループ終了
-                        if (msg.message == WM_QUIT)
+                        if (!_PumpMessages())
                         {
                             return;
                         }
-                        // メッセージを処理
+                        if (WaitForSingleObject(stopEvent, 0) == WAIT_OBJECT_0)
                         {
-                            TranslateMessage(&msg);
-                            DispatchMessage(&msg);
+                            return;
                         }
                     }
                 }
+                else if (wait == WAIT_OBJECT_0 + 2)
+                {
+                    if (!_PumpMessages())
+                    {
+                        return;
+                    }
+                }
                 else if (wait == WAIT_FAILED)
                 {
                     throw MAKE_GENERAL_ERROR("MsgWaitForMultipleObjects returns WAIT_FAILED");
@@ -768,75 +619,570 @@ namespace
         }
 
     private:
-        // WinRT じゃない
-        ayc::details::WGCSessionState&  m_state;
-        ayc::ExceptionTunnel            m_exceptionTunnel;
+        // 溜まっているメッセージを全て処理する
+        // @note: WM_QUIT を受け取ったら false を返す
+        bool _PumpMessages()
+        {
+            MSG msg{};
+            for (;;)
+            {
+                // メッセージを１件取得
+                const bool peekResult = PeekMessage(
+                    &msg,
+                    /*hWnd=*/nullptr,
+                    /*wMsgFilterMin=*/0,
+                    /*wMsgFilterMax=*/0,
+                    /*wRemoveMsg=*/PM_REMOVE
+                );
+                // メッセージなしなら次の待機へ
+                if (!peekResult)
+                {
+                    return true;
+                }
+                // 終了メッセージなら、メッセージループ終了
+                if (msg.message == WM_QUIT)
+                {
+                    return false;
+                }
+                // メッセージを処理
+                {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+            }
+        }
 
-        // WinRT オブジェクト
-        wgc::IDirect3DDevice                m_wrtDevice;
-        wgc::DispatcherQueueController      m_dqc;
-        std::unique_ptr<_OnFrameArrived>    m_pOnFrameArrived;
-        wgc::Direct3D11CaptureFramePool     m_framePool;
-        wgc::GraphicsCaptureSession		    m_captureSession;
-        wgc::FrameArrived_revoker	        m_revoker;
+        wgc::DispatcherQueueController m_dqc;
     };
 
     //-----------------------------------------------------------------------------
-    // WinRT 関係の一切を閉じ込めるためのスレッドハンドラ
-    void _WinRTClosureThreadHandler(
-        _WINRT_CLOSURE_INIT_PARAM param,
-        ayc::ExceptionTunnel& exceptionTunnel
-    )
+    // WGC 用キャプチャワーカー
+    class _WGCCaptureWorker : public ayc::ICaptureWorker
     {
-        try
+    public:
+        // コンストラクタ
+        _WGCCaptureWorker()
+            : m_guard()
+            , m_tasks()
+            , m_sessionTasks(CAPTURE_WORKER_TASK_BUDGET_PER_SESSION)
+            , m_isStopped(false)
+            , m_stopEvent(nullptr)
+            , m_taskEvent(nullptr)
+            , m_thread()
         {
-            _WinRTClosureConcrete concrete(param);
-            concrete.Run();
-        }
-        catch (const ayc::GeneralError& e)
+            // 同期用イベントを生成
+            {
+                m_stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+                m_taskEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+                if (!m_stopEvent || !m_taskEvent)
+                {
+                    const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+                    _CloseEvents();
+                    throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateEvent failed", hr);
+                }
+            }
+            // スレッド起動、WinRT 環境の初期化完了を待機
+            /* @note:
+                初期化に失敗した場合は、ここで例外として再送する。
+            */
+            {
+                std::promise<void> ready;
+                auto readyFuture = ready.get_future();
+                m_thread = std::thread(
+                    std::bind(&_WGCCaptureWorker::_ThreadHandler, this, std::ref(ready))
+                );
+                try
+                {
+                    readyFuture.get();
+                }
+                catch (...)
+                {
+                    m_thread.join();
+                    _CloseEvents();
+                    throw;
+                }
+            }
+        }
+
+        // デストラクタ
+        ~_WGCCaptureWorker() override
         {
-            exceptionTunnel.ThrowIn(e);
+            // 終了をスレッドに通知
+            if (m_stopEvent)
+            {
+                SetEvent(m_stopEvent);
+            }
+            // スレッド終了を待機
+            if (m_thread.joinable())
+            {
+                m_thread.join();
+            }
+            // イベントを破棄
+            {
+                _CloseEvents();
+            }
         }
-        catch (const std::exception& e)
+
+        // タスクを同期実行する
+        void Invoke(const std::function<void(void)>& task) override
         {
-            exceptionTunnel.ThrowIn(
-                MAKE_GENERAL_ERROR_FROM_CPP_EXCEPTION("Unhandled C++ Exception", e)
-            );
+            // ワーカースレッド自身からの呼び出しなら直接実行
+            // @note: 自分自身の完了を待つとデッドロックするので
+            if (std::this_thread::get_id() == m_thread.get_id())
+            {
+                task();
+                return;
+            }
+            // タスクを投入
+            std::promise<void> done;
+            auto doneFuture = done.get_future();
+            {
+                std::scoped_lock lock(m_guard);
+                if (m_isStopped)
+                {
+                    throw MAKE_GENERAL_ERROR("Capture worker already stopped");
+                }
+                m_tasks.emplace_back(
+                    [&]()
+                    {
+                        try
+                        {
+                            task();
+                            done.set_value();
+                        }
+                        catch (...)
+                        {
+                            done.set_exception(std::current_exception());
+                        }
+                    }
+                );
+            }
+            SetEvent(m_taskEvent);
+            // 完了を待機
+            doneFuture.get();
         }
-        catch (const winrt::hresult_error& e)
+
+        // セッションの仕事を非同期で投入する
+        // @note: 停止済みなら捨てる（フレーム到着の取りこぼしと同じ扱い）
+        void Post(const void* pSession, std::function<void(void)> task) override
         {
-            exceptionTunnel.ThrowIn(
-                MAKE_GENERAL_ERROR_FROM_WINRT_EXCEPTION("Unhandled WinRT Exception", e)
-            );
+            {
+                std::scoped_lock lock(m_guard);
+                if (m_isStopped)
+                {
+                    return;
+                }
+            }
+            m_sessionTasks.Push(pSession, std::move(task));
+            SetEvent(m_taskEvent);
         }
-        catch (...)
+
+        // セッションの未実行の仕事を捨てる
+        void Discard(const void* pSession) override
         {
-            exceptionTunnel.ThrowIn(
-                MAKE_GENERAL_ERROR("Unhandled Unknown Exception")
-            );
+            m_sessionTasks.Discard(pSession);
+        }
+
+    private:
+        // 投入済みのタスクを処理する
+        /* @note:
+            Invoke のタスクは呼び出し元が待っているので全て処理し、
+            セッションの仕事は１巡回だけ処理する。セッションの仕事が残っていれば true を返す。
+        */
+        bool _RunTasks()
+        {
+            for (;;)
+            {
+                std::function<void(void)> task;
+                {
+                    std::scoped_lock lock(m_guard);
+                    if (m_tasks.empty())
+                    {
+                        break;
+                    }
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+            return m_sessionTasks.RunRound();
+        }
+
+        // スレッドハンドラ
+        void _ThreadHandler(std::promise<void>& ready)
+        {
+            // WinRT 環境の初期化
+            std::unique_ptr<_CaptureWorkerConcrete> pConcrete;
+            try
+            {
+                pConcrete.reset(new _CaptureWorkerConcrete());
+            }
+            catch (...)
+            {
+                _MarkStopped();
+                ready.set_exception(std::current_exception());
+                return;
+            }
+            ready.set_value();
+
+            // メッセージループ
+            try
+            {
+                pConcrete->Run(
+                    m_stopEvent,
+                    m_taskEvent,
+                    std::bind(&_WGCCaptureWorker::_RunTasks, this)
+                );
+            }
+            catch (const ayc::GeneralError& e)
+            {
+                WRITE_LOG_GENERAL_ERROR("In _WGCCaptureWorker::_ThreadHandler, message loop has stopped.", e);
+            }
+            catch (const std::exception& e)
+            {
+                WRITE_LOG_CPP_EXCEPTION("In _WGCCaptureWorker::_ThreadHandler, message loop has stopped.", e);
+            }
+            // 以降のタスクは受け付けない
+            /* @note:
+                取り残されたタスクもここで実行しておかないと、呼び出し元が永遠に待たされる。
+            */
+            {
+                _MarkStopped();
+                m_sessionTasks.Clear();
+                _RunTasks();
+            }
+            // WinRT 環境の後始末
+            {
+                pConcrete.reset();
+            }
+        }
+
+        // 停止済みとしてマーク
+        void _MarkStopped()
+        {
+            std::scoped_lock lock(m_guard);
+            m_isStopped = true;
+        }
+
+        // イベントを破棄
+        void _CloseEvents()
+        {
+            if (m_stopEvent)
+            {
+                CloseHandle(m_stopEvent);
+                m_stopEvent = nullptr;
+            }
+            if (m_taskEvent)
+            {
+                CloseHandle(m_taskEvent);
+                m_taskEvent = nullptr;
+            }
+        }
+
+        std::mutex                              m_guard;
+        std::deque<std::function<void(void)>>   m_tasks;
+        ayc::CaptureTaskQueue                   m_sessionTasks;
+        bool                                    m_isStopped;
+        HANDLE                                  m_stopEvent;
+        HANDLE                                  m_taskEvent;
+        std::thread                             m_thread;
+    };
+
+    //-----------------------------------------------------------------------------
+    // プロセス共通のキャプチャスケジューラを得る
+    /* @note:
+        DLL アンロード中にスレッドを join するとローダーロックで詰むので、
+        あえて解放せずにリークさせる。
+    */
+    ayc::CaptureScheduler& _GetCaptureScheduler()
+    {
+        static auto* const s_pScheduler = new ayc::CaptureScheduler(
+            []() { return std::make_shared<_WGCCaptureWorker>(); },
+            CAPTURE_SCHEDULER_DEFAULT_MAX_WORKERS
+        );
+        return *s_pScheduler;
+    }
+
+    //-----------------------------------------------------------------------------
+    // リプレイの時計をフレームバッファ向けの関数に包む
+    // @note: 時計が無ければ nullptr（＝ NowFromQPC）
+    std::function<wgc::TimeSpan()> _ToClockFunction(const std::shared_ptr<ayc::ReplayClock>& pClock)
+    {
+        if (!pClock)
+        {
+            return nullptr;
         }
+        return [pClock]() { return pClock->Now(); };
     }
 }
 
 //-----------------------------------------------------------------------------
-// WGCSessionState
+// WGCCaptureItem
 //-----------------------------------------------------------------------------
 
-//-----------------------------------------------------------------------------
-ayc::details::WGCSessionState::WGCSessionState(double holdInSec)
-: m_frameBuffer(holdInSec)
-, m_stopEvent(nullptr)
+namespace ayc::details
 {
-    // 同期用イベントを生成
+    //-----------------------------------------------------------------------------
+    // キャプチャアイテム初期化パラメータ
+    struct WGC_CAPTURE_ITEM_INIT_PARAM
+    {
+        HWND hwnd;
+        ICaptureWorker& worker;
+        std::optional<std::size_t> maxWidth;
+        std::optional<std::size_t> maxHeight;
+        WGCSessionState& state;
+        ExceptionTunnel& exceptionTunnel;
+    };
+
+    //-----------------------------------------------------------------------------
+    // セッション１つ分の WinRT オブジェクトを閉じ込めるためのクラス
+    /* @note:
+        生成・破棄はどちらも担当キャプチャワーカーのスレッド上で行う必要がある。
+        例外発生時も含めたすべてのコントロールパスで正常にデストラクトできることを保証したかった。
+        なので RAII 的なことが支度で、致し方なくクラス化している。
+    */
+    class WGCCaptureItem
     {
-        m_stopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-        if (!m_stopEvent)
+    public:
+        // コンストラクタ
+        WGCCaptureItem(const WGC_CAPTURE_ITEM_INIT_PARAM& param)
+            : m_worker(param.worker)
+            , m_wrtDevice(nullptr)
+            , m_pOnFrameArrived(nullptr)
+            , m_framePool(nullptr)
+            , m_captureSession(nullptr)
+            , m_revoker()
         {
-            throw MAKE_GENERAL_ERROR_FROM_HRESULT(
-                "CreateEvent failed",
-                HRESULT_FROM_WIN32(GetLastError())
-            );
+            try
+            {
+                _Initialize(param);
+            }
+            catch (...)
+            {
+                // @note: コンストラクタで投げるとデストラクタが呼ばれないので、自前で後始末する
+                _Finalize();
+                throw;
+            }
         }
+
+        // デストラクタ
+        ~WGCCaptureItem()
+        {
+            _Finalize();
+        }
+
+        // コピー禁止
+        WGCCaptureItem(const WGCCaptureItem&) = delete;
+        WGCCaptureItem& operator =(const WGCCaptureItem&) = delete;
+
+    private:
+        // 初期化
+        void _Initialize(const WGC_CAPTURE_ITEM_INIT_PARAM& param)
+        {
+            // WinRT D3D11 Device
+            {
+                const auto dxgiDevice = TRY_WINRT_RET((
+                    [&]() { return ayc::d3d11::Device().as<IDXGIDevice>(); }
+                    ));
+                const HRESULT result = TRY_WINRT_RET((
+                    [&]()
+                    {
+                        return CreateDirect3D11DeviceFromDXGIDevice
+                        (
+                            dxgiDevice.get(),
+                            reinterpret_cast<wgc::GlobalIInspectable**>(wgc::put_abi(m_wrtDevice))
+                        );
+                    }
+                    ));
+                if (result != S_OK)
+                {
+                    throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateDirect3D11DeviceFromDXGIDevice.", result);
+                }
+            }
+            // キャプチャアイテム生成
+            wgc::GraphicsCaptureItem captureItem{ nullptr };
+            {
+                // interop 取得
+                const auto interop = TRY_WINRT_RET((
+                    ([&]() { return wgc::get_activation_factory<wgc::GraphicsCaptureItem, IGraphicsCaptureItemInterop>(); })
+                ));
+                // 指定のウィンドウに対してアイテムを生成
+                const HRESULT result = TRY_WINRT_RET((
+                    [&]()
+                    {
+                        return interop->CreateForWindow(
+                            param.hwnd,
+                            wgc::guid_of<wgc::GraphicsCaptureItem>(),
+                            wgc::put_abi(captureItem)
+                        );
+                    }
+                ));
+                if (result != S_OK)
+                {
+                    throw MAKE_GENERAL_ERROR_FROM_HRESULT("Faield to CreateForWindow", result);
+                }
+                if (!captureItem)
+                {
+                    throw MAKE_GENERAL_ERROR("captureItem is Invalid");
+                }
+            }
+            // コンテンツサイズ取得
+            const auto captureItemSize = TRY_WINRT_RET((
+                [&]() { return captureItem.Size(); }
+            ));
+            // ハンドラーインスタンス生成
+            {
+                m_pOnFrameArrived.reset(
+                    new _OnFrameArrived(
+                        m_worker,
+                        m_wrtDevice,
+                        param.state,
+                        param.exceptionTunnel,
+                        captureItemSize,
+                        param.maxWidth,
+                        param.maxHeight
+                    )
+                );
+            }
+            // フレームプール生成
+            /* @note:
+                フレームプールのレベルではアルファチャンネルを切ることはできない
+            */
+            m_framePool = TRY_WINRT_RET((
+                [&]()
+                {
+                    return wgc::Direct3D11CaptureFramePool::Create(
+                        m_wrtDevice,
+                        wgc::DirectXPixelFormat::B8G8R8A8UIntNormalized,
+                        WGC_FRAME_POOL_NUM_BUFFERS,
+                        captureItemSize
+                    );
+                }
+            ));
+            // セッション生成
+            {
+                m_captureSession = TRY_WINRT_RET((
+                    [&]() { return m_framePool.CreateCaptureSession(captureItem); }
+                ));
+            }
+            // セッションの設定を変更
+            {
+                CALL_GCS_MEMBER(m_captureSession, IsCursorCaptureEnabled, false);
+                CALL_GCS_MEMBER(m_captureSession, IsBorderRequired, false);
+                CALL_GCS_MEMBER(m_captureSession, IncludeSecondaryWindows, false);
+            }
+            // セッション開始
+            {
+                TRY_WINRT((
+                    [&]() { m_captureSession.StartCapture(); }
+                ));
+            }
+            // フレーム到達ハンドラ登録
+            {
+                m_revoker = TRY_WINRT_RET((
+                    [&]()
+                    {
+                        return m_framePool.FrameArrived(
+                            winrt::auto_revoke,
+                            { m_pOnFrameArrived.get(), &_OnFrameArrived::Handler }
+                        );
+                    }
+                    ));
+            }
+        }
+
+        // 後始末
+        void _Finalize()
+        {
+            // ハンドラ登録解除
+            {
+                TRY_WINRT_NOTHROW((
+                    [&]() { m_revoker.revoke(); }
+                ));
+            }
+            // 投入済みで未処理のフレーム取り出しを捨てる
+            // @note: ハンドラーインスタンスを参照しているので、破棄より前に行う
+            if (m_pOnFrameArrived)
+            {
+                m_worker.Discard(m_pOnFrameArrived.get());
+            }
+            // セッション停止
+            if (m_captureSession)
+            {
+                TRY_WINRT_NOTHROW((
+                    [&]()
+                    {
+                        m_captureSession.Close();
+                        m_captureSession = nullptr;
+                    }
+                    ));
+            }
+            // フレームプール後始末
+            if (m_framePool)
+            {
+                TRY_WINRT_NOTHROW((
+                    [&]()
+                    {
+                        m_framePool.Close();
+                        m_framePool = nullptr;
+                    }
+                ));
+            }
+            // ハンドラーインスタンス後始末
+            {
+                m_pOnFrameArrived.reset();
+            }
+            // WinRT D3D11 Device
+            if (m_wrtDevice)
+            {
+                TRY_WINRT_NOTHROW((
+                    [&]()
+                    {
+                        m_wrtDevice.Close();
+                        m_wrtDevice = nullptr;
+                    }
+                ));
+            }
+        }
+
+        // 担当キャプチャワーカー
+        ICaptureWorker&                     m_worker;
+
+        // WinRT オブジェクト
+        wgc::IDirect3DDevice                m_wrtDevice;
+        std::unique_ptr<_OnFrameArrived>    m_pOnFrameArrived;
+        wgc::Direct3D11CaptureFramePool     m_framePool;
+        wgc::GraphicsCaptureSession		    m_captureSession;
+        wgc::FrameArrived_revoker	        m_revoker;
+    };
+}
+
+//-----------------------------------------------------------------------------
+// WGCSessionState
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::details::WGCSessionState::WGCSessionState(
+    double holdInSec,
+    std::shared_ptr<MemoryAccount> pMemoryAccount,
+    bool isDedupEnabled,
+    std::optional<double> hotHoldInSec,
+    std::optional<SPILL_PARAM> spillParam,
+    std::optional<double> sceneCutThreshold,
+    FrameFormat frameFormat,
+    std::function<wgc::TimeSpan()> clock
+)
+: m_frameBuffer(holdInSec, pMemoryAccount, isDedupEnabled, hotHoldInSec, std::move(spillParam), clock)
+, m_pSceneCutIndex()
+, m_frameFormat(frameFormat)
+, m_pPendingSignature()
+, m_pendingSeq(0)
+, m_pendingTimeSpan()
+{
+    // シーン切り替えの索引
+    if (sceneCutThreshold)
+    {
+        m_pSceneCutIndex = std::make_unique<SceneCutIndex>(holdInSec, sceneCutThreshold.value(), std::move(clock));
     }
 }
 
@@ -850,15 +1196,113 @@ ayc::details::WGCSessionState::~WGCSessionState()
 // 後始末
 void ayc::details::WGCSessionState::Close()
 {
-    // 終了通知用イベントを破棄
-    if (m_stopEvent)
+    // フレームバッファを閉じる
+    // @note: 新着フレーム待ちのスレッドもここで起こされる
     {
-        CloseHandle(m_stopEvent);
-        m_stopEvent = nullptr;
+        m_frameBuffer.Close();
     }
-    // フレームバッファをクリア
+}
+
+//-----------------------------------------------------------------------------
+void ayc::details::WGCSessionState::PushCapturedFrame(
+    const wgc::com_ptr<ID3D11Texture2D>& pSrcTex,
+    const wgc::TimeSpan& timeSpan,
+    std::optional<std::size_t> maxWidth,
+    std::optional<std::size_t> maxHeight
+)
+{
+    // コピー元 desc
+    D3D11_TEXTURE2D_DESC srcDesc{};
     {
-        m_frameBuffer.Clear();
+        pSrcTex->GetDesc(&srcDesc);
+    }
+    // 直前のフレームの署名を受け取って、シーン切り替えを記録し、重複していれば畳む
+    {
+        FlushPendingSignature();
+    }
+    // 署名の計算を発行する
+    /* @note:
+        署名はコピー元のテクスチャ上で計算する。
+        重複排除とシーン切り替えの検出で同じ署名を使い回し、到着１回につき１度だけ計算する。
+        読み出しはキャプチャスレッドを GPU 待ちで止めるので、ここでは発行だけして次のフレームの到着時に受け取る。
+        そのため重複したフレームもいったんコピーを取り、受け取った時点でテクスチャを共有させる。
+    */
+    std::unique_ptr<PendingFrameSignature> pPendingSignature;
+    if (m_frameBuffer.IsDedupEnabled() || m_pSceneCutIndex)
+    {
+        pPendingSignature = std::make_unique<PendingFrameSignature>(pSrcTex);
+    }
+    // コピー後サイズを解決
+    const auto [optimalWidth, optimalHeight] = _ResolveOptimalFrameSize(
+        srcDesc.Width,
+        srcDesc.Height,
+        maxWidth,
+        maxHeight
+    );
+    // フレームバッファ用にテクスチャのコピーを取る
+    /* @note:
+        NV12 で保持するなら、変換と縮小を兼ねたシェーダー起動。
+        スケーリング不要ならシンプルにコピー。
+        スケーリングが必要ならシェーダー起動。
+    */
+    wgc::com_ptr<ID3D11Texture2D> pFBTex;
+    if (m_frameFormat == FrameFormat::NV12)
+    {
+        // 変換兼コピー
+        pFBTex = ayc::ConvertTextureToNV12(pSrcTex, optimalWidth, optimalHeight);
+    }
+    else if (srcDesc.Width == optimalWidth && srcDesc.Height == optimalHeight)
+    {
+        // コピー先を生成
+        {
+            const HRESULT result = ayc::d3d11::Device()->CreateTexture2D(
+                &srcDesc,
+                /*pInitialData=*/nullptr,
+                pFBTex.put()
+            );
+            if (result != S_OK)
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("Failed to CreateTexture2D", result);
+            }
+        }
+        // コピー
+        {
+            ayc::d3d11::Context()->CopyResource(pFBTex.get(), pSrcTex.get());
+        }
+    }
+    else
+    {
+        // リサイズ兼コピー
+        pFBTex = ayc::ResizeTexture(pSrcTex, optimalWidth, optimalHeight);
+    }
+    // フレームバッファに詰める
+    {
+        m_pendingSeq = m_frameBuffer.PushFrame(pFBTex, timeSpan);
+        m_pendingTimeSpan = timeSpan;
+        m_pPendingSignature = std::move(pPendingSignature);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::details::WGCSessionState::FlushPendingSignature()
+{
+    if (!m_pPendingSignature)
+    {
+        return;
+    }
+    // @note: 受け取りに失敗しても同じ署名を何度も受け取り直さないよう、先に手放す
+    const auto pPendingSignature = std::move(m_pPendingSignature);
+    const auto pSignature = pPendingSignature->Resolve();
+
+    // シーン切り替えを記録する
+    // @note: 記録はフレーム自身のタイムスタンプで行うので、１フレーム遅れても時刻はずれない
+    if (m_pSceneCutIndex)
+    {
+        m_pSceneCutIndex->Push(pSignature, m_pendingTimeSpan);
+    }
+    // 重複していれば畳む
+    {
+        m_frameBuffer.ResolveSignature(m_pendingSeq, pSignature);
     }
 }
 
@@ -875,9 +1319,9 @@ const ayc::FrameBuffer& ayc::details::WGCSessionState::GetFrameBuffer() const
 }
 
 //-----------------------------------------------------------------------------
-const HANDLE& ayc::details::WGCSessionState::GetStopEvent() const
+const ayc::SceneCutIndex* ayc::details::WGCSessionState::GetSceneCutIndex() const
 {
-    return m_stopEvent;
+    return m_pSceneCutIndex.get();
 }
 
 //-----------------------------------------------------------------------------
@@ -889,26 +1333,102 @@ ayc::WGCSession::WGCSession(
     HWND hwnd,
     double holdInSec,
     std::optional<std::size_t> maxWidth,
-    std::optional<std::size_t> maxHeight
+    std::optional<std::size_t> maxHeight,
+    double weight,
+    double minHoldInSec,
+    bool isDedupEnabled,
+    std::optional<double> hotHoldInSec,
+    std::optional<SPILL_PARAM> spillParam,
+    std::optional<double> sceneCutThreshold,
+    FrameFormat frameFormat
 )
 : m_isClosed(false)
-, m_state(holdInSec)
+, m_pMemoryAccount()
+, m_scopedMemoryAccount(
+    [&]() { m_pMemoryAccount = MemoryArbiter::Instance().Register(reinterpret_cast<std::uint64_t>(hwnd), weight, minHoldInSec); },
+    [this]() { MemoryArbiter::Instance().Unregister(m_pMemoryAccount); }
+)
+, m_pReplayClock()
+, m_state(holdInSec, m_pMemoryAccount, isDedupEnabled, hotHoldInSec, std::move(spillParam), sceneCutThreshold, frameFormat)
 , m_exceptionTunnel()
-, m_wrtClosureThread()
+, m_pCaptureWorker()
+, m_pCaptureItem()
+, m_pReplaySource()
 {
-    // キャプチャスレッドを起動
+    // 担当キャプチャワーカーを割り当ててもらう
+    // @note: 失敗した時の記帳先の登録解除は m_scopedMemoryAccount が行う
+    {
+        m_pCaptureWorker = _GetCaptureScheduler().Register();
+    }
+    // キャプチャアイテムをワーカースレッド上で生成
+    /* @note:
+        生成に失敗した場合は割り当てを返却してから例外を再送する。
+    */
+    try
     {
-        const _WINRT_CLOSURE_INIT_PARAM param =
+        const details::WGC_CAPTURE_ITEM_INIT_PARAM param =
         {
             hwnd,
+            *m_pCaptureWorker,
             maxWidth,
             maxHeight,
-            m_state
+            m_state,
+            m_exceptionTunnel
         };
-        m_wrtClosureThread = std::thread(
-            _WinRTClosureThreadHandler,
-            param,
-            std::ref(m_exceptionTunnel)
+        m_pCaptureWorker->Invoke(
+            [&]() { m_pCaptureItem = std::make_unique<details::WGCCaptureItem>(param); }
+        );
+    }
+    catch (...)
+    {
+        _GetCaptureScheduler().Unregister(m_pCaptureWorker);
+        m_pCaptureWorker.reset();
+        throw;
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::WGCSession::WGCSession(
+    const std::string& archivePath,
+    const REPLAY_PARAM& replayParam,
+    double holdInSec,
+    std::optional<std::size_t> maxWidth,
+    std::optional<std::size_t> maxHeight,
+    double weight,
+    double minHoldInSec,
+    bool isDedupEnabled,
+    std::optional<double> hotHoldInSec,
+    std::optional<SPILL_PARAM> spillParam,
+    std::optional<double> sceneCutThreshold,
+    FrameFormat frameFormat
+)
+: m_isClosed(false)
+, m_pMemoryAccount()
+, m_scopedMemoryAccount(
+    [&]() { m_pMemoryAccount = MemoryArbiter::Instance().Register(reinterpret_cast<std::uint64_t>(this), weight, minHoldInSec); },
+    [this]() { MemoryArbiter::Instance().Unregister(m_pMemoryAccount); }
+)
+, m_pReplayClock(std::make_shared<ReplayClock>(!replayParam.isRealtime))
+, m_state(holdInSec, m_pMemoryAccount, isDedupEnabled, hotHoldInSec, std::move(spillParam), sceneCutThreshold, frameFormat, _ToClockFunction(m_pReplayClock))
+, m_exceptionTunnel()
+, m_pCaptureWorker()
+, m_pCaptureItem()
+, m_pReplaySource()
+{
+    // リプレイ開始
+    /* @note:
+        キャプチャワーカーは使わないので割り当ててもらわない。
+        失敗した時の記帳先の登録解除は m_scopedMemoryAccount が行う。
+    */
+    {
+        m_pReplaySource = std::make_unique<ReplaySource>(
+            archivePath,
+            replayParam,
+            m_pReplayClock,
+            m_state,
+            m_exceptionTunnel,
+            maxWidth,
+            maxHeight
         );
     }
 }
@@ -927,20 +1447,44 @@ void ayc::WGCSession::Close()
     {
         return;
     }
-    // 終了をスレッドに通知
-    if (m_state.GetStopEvent())
+    // キャプチャアイテムをワーカースレッド上で破棄
+    /* @note:
+        デストラクタからも呼ばれるので、ここから例外は出せない。
+    */
+    if (m_pCaptureWorker)
     {
-        SetEvent(m_state.GetStopEvent());
+        try
+        {
+            m_pCaptureWorker->Invoke(
+                [&]() { m_pCaptureItem.reset(); }
+            );
+        }
+        catch (const ayc::GeneralError& e)
+        {
+            WRITE_LOG_GENERAL_ERROR("In WGCSession::Close, failed to release capture item.", e);
+        }
+        catch (const std::exception& e)
+        {
+            WRITE_LOG_CPP_EXCEPTION("In WGCSession::Close, failed to release capture item.", e);
+        }
+        _GetCaptureScheduler().Unregister(m_pCaptureWorker);
+        m_pCaptureWorker.reset();
     }
-    // スレッド終了を待機
-    if (m_wrtClosureThread.joinable())
+    // リプレイを停止
+    if (m_pReplaySource)
     {
-        m_wrtClosureThread.join();
+        m_pReplaySource->Close();
+        m_pReplaySource.reset();
     }
     // ステートを解放
     {
         m_state.Close();
     }
+    // メモリ予算の記帳先を返却
+    // @note: 破棄時に m_scopedMemoryAccount がもう一度呼ぶが、解除済みなら何も変わらない
+    {
+        MemoryArbiter::Instance().Unregister(m_pMemoryAccount);
+    }
     // クローズ済みとしてマーク
     {
         m_isClosed = true;
@@ -953,6 +1497,10 @@ namespace
     bool _Available()
     {
         // 別スレッドでチェック処理を実行
+        /* @note:
+            呼び出し元のアパートメントを汚さないように、使い捨てのスレッド上で行う。
+            ThreadPool のワーカーは他の仕事と共有しているので、STA を初期化してはいけない。
+        */
         bool available = true;
         try
         {
@@ -1060,12 +1608,38 @@ namespace
 }
 
 //-----------------------------------------------------------------------------
-wgc::com_ptr<ID3D11Texture2D> ayc::WGCSession::CopyFrame(double relativeInSec)
+/*static*/ void ayc::WGCSession::SetMaxCaptureThreads(std::size_t maxThreads)
+{
+    _GetCaptureScheduler().SetMaxWorkers(maxThreads);
+}
+
+//-----------------------------------------------------------------------------
+/*static*/ std::vector<std::size_t> ayc::WGCSession::GetCaptureThreadLoads()
+{
+    return _GetCaptureScheduler().GetLoads();
+}
+
+//-----------------------------------------------------------------------------
+ayc::FRAME_SOURCE ayc::WGCSession::CopyFrame(double relativeInSec)
 {
     _PreCondition();
     return m_state.GetFrameBuffer().GetFrame(relativeInSec);
 }
 
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::FRAME ayc::WGCSession::WaitFrame(
+    std::optional<std::uint64_t> afterSeq,
+    std::optional<double> timeoutInSec
+)
+{
+    _PreCondition();
+    auto& frameBuffer = m_state.GetFrameBuffer();
+    return frameBuffer.WaitFrame(
+        afterSeq.has_value() ? afterSeq.value() : frameBuffer.GetLatestSequence(),
+        timeoutInSec
+    );
+}
+
 //-----------------------------------------------------------------------------
 ayc::FreezedFrameBuffer ayc::WGCSession::CopyFrameBuffer(double durationInSec)
 {
@@ -1076,6 +1650,44 @@ ayc::FreezedFrameBuffer ayc::WGCSession::CopyFrameBuffer(double durationInSec)
     );
 }
 
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::DEDUP_STATS ayc::WGCSession::GetDedupStats()
+{
+    _PreCondition();
+    return m_state.GetFrameBuffer().GetDedupStats();
+}
+
+//-----------------------------------------------------------------------------
+ayc::FrameBuffer::TIER_STATS ayc::WGCSession::GetTierStats()
+{
+    _PreCondition();
+    return m_state.GetFrameBuffer().GetTierStats();
+}
+
+//-----------------------------------------------------------------------------
+std::vector<ayc::SCENE_CUT> ayc::WGCSession::GetSceneCuts(double durationInSec)
+{
+    _PreCondition();
+    const auto* pSceneCutIndex = m_state.GetSceneCutIndex();
+    if (!pSceneCutIndex)
+    {
+        throw MAKE_GENERAL_ERROR("Scene cut detection is disabled (scene_cut_threshold is None)");
+    }
+    return pSceneCutIndex->GetCuts(durationInSec);
+}
+
+//-----------------------------------------------------------------------------
+std::shared_ptr<const ayc::MemoryAccount> ayc::WGCSession::GetMemoryAccount() const
+{
+    return m_pMemoryAccount;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::WGCSession::IsReplayFinished() const
+{
+    return m_pReplaySource && m_pReplaySource->IsFinished();
+}
+
 //-----------------------------------------------------------------------------
 void ayc::WGCSession::_PreCondition()
 {
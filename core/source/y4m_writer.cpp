@@ -0,0 +1,570 @@
+﻿//-----------------------------------------------------------------------------
+// Include
+//-----------------------------------------------------------------------------
+
+// pch
+#include "stdafx.h"
+
+// self
+#include "y4m_writer.h"
+
+// other
+#include "utils.h"
+
+//-----------------------------------------------------------------------------
+// Link-Local Constants
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 持ち回すフレームバッファの枚数
+    // @note: 変換中と書き出し中の１枚ずつ
+    const std::size_t Y4M_NUM_BUFFERS = 2;
+
+    // WriteFile １回で書き込む最大バイト数
+    const std::uint64_t Y4M_WRITE_CHUNK_SIZE = 64 * 1024 * 1024;
+
+    // フレームごとのヘッダ
+    const char Y4M_FRAME_HEADER[] = "FRAME\n";
+    const std::size_t Y4M_FRAME_HEADER_SIZE = sizeof(Y4M_FRAME_HEADER) - 1;
+
+    // 変換係数の固定小数点のビット数
+    const int YUV_COEFF_BITS = 14;
+
+    // ピクセルあたりのバイト数
+    const std::size_t BYTES_PER_PIXEL = 3;
+}
+
+//-----------------------------------------------------------------------------
+// Link-Local Functions
+//-----------------------------------------------------------------------------
+
+namespace
+{
+    // 固定小数点の変換係数
+    struct _YUV_COEFFS
+    {
+        int     yr, yg, yb;
+        int     ur, ug, ub;
+        int     vr, vg, vb;
+    };
+
+    // 変換係数を解決する
+    /* @note:
+        limited range（Y: 16-235, U/V: 16-240）。
+        Y = 16 + 219/255 * (Kr R + Kg G + Kb B)
+        U = 128 + 224/255 * (B - Y') / (2 (1 - Kb))
+        V = 128 + 224/255 * (R - Y') / (2 (1 - Kr))
+    */
+    _YUV_COEFFS _GetYuvCoeffs(ayc::YuvMatrix matrix)
+    {
+        const double kr = matrix == ayc::YuvMatrix::BT601 ? 0.299 : 0.2126;
+        const double kb = matrix == ayc::YuvMatrix::BT601 ? 0.114 : 0.0722;
+        const double kg = 1.0 - kr - kb;
+        const double ys = 219.0 / 255.0;
+        const double cs = 224.0 / 255.0;
+        const double scale = static_cast<double>(1 << YUV_COEFF_BITS);
+        const auto toFixed = [&](double value) { return static_cast<int>(std::lround(value * scale)); };
+        return _YUV_COEFFS{
+            toFixed(ys * kr), toFixed(ys * kg), toFixed(ys * kb),
+            toFixed(-cs * kr / (2.0 * (1.0 - kb))), toFixed(-cs * kg / (2.0 * (1.0 - kb))), toFixed(cs * 0.5),
+            toFixed(cs * 0.5), toFixed(-cs * kg / (2.0 * (1.0 - kr))), toFixed(-cs * kb / (2.0 * (1.0 - kr))),
+        };
+    }
+
+    // fps を有理数に直す
+    // @note: 整数と NTSC 系（x 1000/1001）はそのまま表し、それ以外は 1/1000 単位に丸める
+    void _ToFrameRate(std::uint32_t& numerator, std::uint32_t& denominator, double fps)
+    {
+        if (!(fps > 0.0) || !std::isfinite(fps) || fps > 1000000.0)
+        {
+            throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid fps", fps);
+        }
+        const double ntsc = fps * 1.001;
+        if (std::abs(fps - std::round(fps)) < 1e-3)
+        {
+            numerator = static_cast<std::uint32_t>(std::lround(fps));
+            denominator = 1;
+        }
+        else if (std::abs(ntsc - std::round(ntsc)) < 1e-3)
+        {
+            numerator = static_cast<std::uint32_t>(std::lround(ntsc)) * 1000;
+            denominator = 1001;
+        }
+        else
+        {
+            numerator = static_cast<std::uint32_t>(std::lround(fps * 1000.0));
+            denominator = 1000;
+        }
+    }
+
+    // 全バイトを書き込む
+    void _WriteAll(HANDLE hFile, const void* pData, std::uint64_t sizeInBytes)
+    {
+        auto pBytes = static_cast<const std::uint8_t*>(pData);
+        while (sizeInBytes > 0)
+        {
+            const auto chunkSize = static_cast<DWORD>(std::min(sizeInBytes, Y4M_WRITE_CHUNK_SIZE));
+            DWORD numWritten = 0;
+            if (!WriteFile(hFile, pBytes, chunkSize, &numWritten, nullptr))
+            {
+                throw MAKE_GENERAL_ERROR_FROM_HRESULT("WriteFile failed", HRESULT_FROM_WIN32(GetLastError()));
+            }
+            if (numWritten == 0)
+            {
+                throw MAKE_GENERAL_ERROR("WriteFile wrote nothing");
+            }
+            pBytes += numWritten;
+            sizeInBytes -= numWritten;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public Definitions
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+void ayc::ConvertBGRToI420(
+    std::uint8_t* pY,
+    std::uint8_t* pU,
+    std::uint8_t* pV,
+    const std::uint8_t* pSrc,
+    std::size_t width,
+    std::size_t height,
+    YuvMatrix matrix
+)
+{
+    // 係数
+    const auto k = _GetYuvCoeffs(matrix);
+    const int yRound = (16 << YUV_COEFF_BITS) + (1 << (YUV_COEFF_BITS - 1));
+    const int cRound = (128 << (YUV_COEFF_BITS + 2)) + (1 << (YUV_COEFF_BITS + 1));
+
+    // ２行ずつ走査する
+    const std::size_t chromaWidth = (width + 1) / 2;
+    const std::size_t chromaHeight = (height + 1) / 2;
+    const std::size_t srcStride = width * BYTES_PER_PIXEL;
+    for (std::size_t cy = 0; cy < chromaHeight; ++cy)
+    {
+        const std::size_t y0 = cy * 2;
+        const std::size_t y1 = std::min(y0 + 1, height - 1);
+        const auto* const pRow0 = pSrc + y0 * srcStride;
+        const auto* const pRow1 = pSrc + y1 * srcStride;
+        auto* const pY0 = pY + y0 * width;
+        auto* const pY1 = pY + y1 * width;
+        auto* const pURow = pU + cy * chromaWidth;
+        auto* const pVRow = pV + cy * chromaWidth;
+        for (std::size_t cx = 0; cx < chromaWidth; ++cx)
+        {
+            const std::size_t x0 = cx * 2;
+            const std::size_t x1 = std::min(x0 + 1, width - 1);
+            const auto* const p00 = pRow0 + x0 * BYTES_PER_PIXEL;
+            const auto* const p01 = pRow0 + x1 * BYTES_PER_PIXEL;
+            const auto* const p10 = pRow1 + x0 * BYTES_PER_PIXEL;
+            const auto* const p11 = pRow1 + x1 * BYTES_PER_PIXEL;
+
+            // 輝度
+            // @note: 係数の和は 219/255 未満なので、丸めても 235 を超えない
+            pY0[x0] = static_cast<std::uint8_t>((k.yr * p00[2] + k.yg * p00[1] + k.yb * p00[0] + yRound) >> YUV_COEFF_BITS);
+            pY0[x1] = static_cast<std::uint8_t>((k.yr * p01[2] + k.yg * p01[1] + k.yb * p01[0] + yRound) >> YUV_COEFF_BITS);
+            pY1[x0] = static_cast<std::uint8_t>((k.yr * p10[2] + k.yg * p10[1] + k.yb * p10[0] + yRound) >> YUV_COEFF_BITS);
+            pY1[x1] = static_cast<std::uint8_t>((k.yr * p11[2] + k.yg * p11[1] + k.yb * p11[0] + yRound) >> YUV_COEFF_BITS);
+
+            // 色差
+            // @note: 4 画素の和に係数を掛けて、平均の分の２ビットを余計に落とす
+            const int r = p00[2] + p01[2] + p10[2] + p11[2];
+            const int g = p00[1] + p01[1] + p10[1] + p11[1];
+            const int b = p00[0] + p01[0] + p10[0] + p11[0];
+            pURow[cx] = static_cast<std::uint8_t>((k.ur * r + k.ug * g + k.ub * b + cRound) >> (YUV_COEFF_BITS + 2));
+            pVRow[cx] = static_cast<std::uint8_t>((k.vr * r + k.vg * g + k.vb * b + cRound) >> (YUV_COEFF_BITS + 2));
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Y4MWriter
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::Y4MWriter::Y4MWriter(
+    const std::string& path,
+    double fps,
+    YuvMatrix matrix
+)
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_isOwned(true)
+    , m_fpsNumerator(0)
+    , m_fpsDenominator(0)
+    , m_matrix(matrix)
+    , m_width(0)
+    , m_height(0)
+    , m_numFrames(0)
+    , m_guard()
+    , m_cv()
+    , m_freeBuffers()
+    , m_writeQueue()
+    , m_isFinishing(false)
+    , m_pError()
+    , m_writeThread()
+{
+    // パラメータチェック
+    if (path.empty())
+    {
+        throw MAKE_GENERAL_ERROR("path must not be empty");
+    }
+    _ToFrameRate(m_fpsNumerator, m_fpsDenominator, fps);
+
+    // ファイルを開く
+    m_hFile = CreateFileA(
+        path.c_str(),
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+    );
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_HRESULT("CreateFile failed", HRESULT_FROM_WIN32(GetLastError()));
+    }
+    _StartThread();
+}
+
+//-----------------------------------------------------------------------------
+ayc::Y4MWriter::Y4MWriter(
+    int fd,
+    double fps,
+    YuvMatrix matrix
+)
+    : m_hFile(INVALID_HANDLE_VALUE)
+    , m_isOwned(false)
+    , m_fpsNumerator(0)
+    , m_fpsDenominator(0)
+    , m_matrix(matrix)
+    , m_width(0)
+    , m_height(0)
+    , m_numFrames(0)
+    , m_guard()
+    , m_cv()
+    , m_freeBuffers()
+    , m_writeQueue()
+    , m_isFinishing(false)
+    , m_pError()
+    , m_writeThread()
+{
+    // パラメータチェック
+    _ToFrameRate(m_fpsNumerator, m_fpsDenominator, fps);
+
+    // ファイルディスクリプタ --> HANDLE
+    m_hFile = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid file descriptor", fd);
+    }
+    _StartThread();
+}
+
+//-----------------------------------------------------------------------------
+ayc::Y4MWriter::~Y4MWriter()
+{
+    // @note: デストラクタからは例外を出さない
+    _StopThread();
+    if (m_isOwned && m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+    }
+    m_hFile = INVALID_HANDLE_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+bool ayc::Y4MWriter::Append(
+    std::size_t width,
+    std::size_t height,
+    std::span<const std::uint8_t> frameBuffer
+)
+{
+    // パラメータチェック
+    if (width < 1 || height < 1)
+    {
+        throw MAKE_GENERAL_ERROR_FROM_ANY_PARAMETER("Invalid frame size", width * height);
+    }
+    if (frameBuffer.size() < width * height * BYTES_PER_PIXEL)
+    {
+        throw MAKE_GENERAL_ERROR("Frame buffer is too small");
+    }
+    // 空きバッファを待つ
+    std::vector<std::uint8_t> buffer;
+    std::string streamHeader;
+    {
+        std::unique_lock<std::mutex> lock(m_guard);
+        _RethrowError();
+        if (m_isFinishing)
+        {
+            throw MAKE_GENERAL_ERROR("Y4MWriter Already Closed");
+        }
+        if (m_width != 0 && (width != m_width || height != m_height))
+        {
+            return false;
+        }
+        m_cv.wait(lock, [this] { return !m_freeBuffers.empty() || m_pError; });
+        _RethrowError();
+        buffer = std::move(m_freeBuffers.back());
+        m_freeBuffers.pop_back();
+
+        // 最初のフレームならストリームヘッダを前に付ける
+        // @note: 色差の位置は 2x2 の中心、レンジは limited
+        if (m_width == 0)
+        {
+            m_width = width;
+            m_height = height;
+            streamHeader = std::format(
+                "YUV4MPEG2 W{} H{} F{}:{} Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                width, height, m_fpsNumerator, m_fpsDenominator
+            );
+        }
+    }
+    // 変換
+    // @note: ロックの外で行い、直前のフレームの書き出しと重ねる
+    const std::size_t lumaSize = width * height;
+    const std::size_t chromaSize = ((width + 1) / 2) * ((height + 1) / 2);
+    const std::size_t headerSize = streamHeader.size() + Y4M_FRAME_HEADER_SIZE;
+    buffer.resize(headerSize + lumaSize + chromaSize * 2);
+    std::memcpy(buffer.data(), streamHeader.data(), streamHeader.size());
+    std::memcpy(buffer.data() + streamHeader.size(), Y4M_FRAME_HEADER, Y4M_FRAME_HEADER_SIZE);
+    {
+        auto* const pY = buffer.data() + headerSize;
+        ConvertBGRToI420(
+            pY,
+            pY + lumaSize,
+            pY + lumaSize + chromaSize,
+            frameBuffer.data(),
+            width,
+            height,
+            m_matrix
+        );
+    }
+    // 書き出し待ちに積む
+    {
+        std::lock_guard<std::mutex> lock(m_guard);
+        m_writeQueue.push_back(std::move(buffer));
+        m_numFrames += 1;
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MWriter::Close()
+{
+    _StopThread();
+    std::lock_guard<std::mutex> lock(m_guard);
+    _RethrowError();
+}
+
+//-----------------------------------------------------------------------------
+std::uint64_t ayc::Y4MWriter::GetNumFrames() const
+{
+    std::lock_guard<std::mutex> lock(m_guard);
+    return m_numFrames;
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MWriter::_StartThread()
+{
+    m_freeBuffers.resize(Y4M_NUM_BUFFERS);
+    try
+    {
+        m_writeThread = std::thread(std::bind(&Y4MWriter::_WriteThreadHandler, this));
+    }
+    catch (...)
+    {
+        if (m_isOwned)
+        {
+            CloseHandle(m_hFile);
+        }
+        m_hFile = INVALID_HANDLE_VALUE;
+        throw;
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MWriter::_WriteThreadHandler()
+{
+    for (;;)
+    {
+        // 書き出し待ちを取り出す
+        std::vector<std::uint8_t> buffer;
+        {
+            std::unique_lock<std::mutex> lock(m_guard);
+            m_cv.wait(lock, [this] { return !m_writeQueue.empty() || m_isFinishing; });
+            if (m_writeQueue.empty())
+            {
+                break;
+            }
+            buffer = std::move(m_writeQueue.front());
+            m_writeQueue.pop_front();
+        }
+        // 書き出して、バッファを返却する
+        // @note: エラー後は書き出さずに捨て、Append を待たせないようにする
+        try
+        {
+            bool isFailed = false;
+            {
+                std::lock_guard<std::mutex> lock(m_guard);
+                isFailed = static_cast<bool>(m_pError);
+            }
+            if (!isFailed)
+            {
+                _WriteAll(m_hFile, buffer.data(), buffer.size());
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_guard);
+            if (!m_pError)
+            {
+                m_pError = std::current_exception();
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_guard);
+            m_freeBuffers.push_back(std::move(buffer));
+        }
+        m_cv.notify_all();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MWriter::_StopThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_guard);
+        m_isFinishing = true;
+    }
+    m_cv.notify_all();
+    if (m_writeThread.joinable())
+    {
+        m_writeThread.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MWriter::_RethrowError()
+{
+    if (m_pError)
+    {
+        std::rethrow_exception(m_pError);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Y4MFramePublisher
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+ayc::Y4MFramePublisher::Y4MFramePublisher(
+    const std::shared_ptr<FrameDispatcher>& pFrameDispatcher,
+    std::unique_ptr<Y4MWriter> pWriter,
+    std::size_t maxPending,
+    OverflowPolicy overflowPolicy
+)
+    : m_pWriter(std::move(pWriter))
+    , m_pFrameDispatcher(pFrameDispatcher)
+    , m_pSubscriber()
+    , m_numMismatched(0)
+    , m_isFailed(false)
+    , m_thread()
+{
+    // 購読開始
+    {
+        m_pSubscriber = m_pFrameDispatcher->Subscribe(maxPending, overflowPolicy);
+    }
+    // スレッド起動
+    {
+        m_thread = std::thread(std::bind(&Y4MFramePublisher::_ThreadHandler, this));
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::Y4MFramePublisher::~Y4MFramePublisher()
+{
+    Close();
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MFramePublisher::Close()
+{
+    // 購読終了
+    if (m_pFrameDispatcher)
+    {
+        m_pFrameDispatcher->Unsubscribe(m_pSubscriber);
+        m_pFrameDispatcher.reset();
+    }
+    // スレッド終了を待機
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    // 残りを書き出して閉じる
+    /* @note:
+        デストラクタからも呼ばれるので、ここから例外は出せない。
+    */
+    try
+    {
+        m_pWriter->Close();
+    }
+    catch (const ayc::GeneralError& e)
+    {
+        m_isFailed = true;
+        WRITE_LOG_GENERAL_ERROR("In Y4MFramePublisher::Close, failed to close the stream.", e);
+    }
+    catch (const std::exception& e)
+    {
+        m_isFailed = true;
+        WRITE_LOG_CPP_EXCEPTION("In Y4MFramePublisher::Close, failed to close the stream.", e);
+    }
+}
+
+//-----------------------------------------------------------------------------
+ayc::Y4M_FRAME_PUBLISHER_STATS ayc::Y4MFramePublisher::GetStats() const
+{
+    return Y4M_FRAME_PUBLISHER_STATS{
+        m_pWriter->GetNumFrames(),
+        m_numMismatched.load(),
+        m_pSubscriber->GetStats().dropped,
+        m_isFailed.load()
+    };
+}
+
+//-----------------------------------------------------------------------------
+void ayc::Y4MFramePublisher::_ThreadHandler()
+{
+    // クローズされるまで到着順に書き出す
+    SUBSCRIBED_FRAME frame;
+    while (m_pSubscriber->Pop(frame))
+    {
+        if (!m_isFailed)
+        {
+            try
+            {
+                const auto& result = *frame.pResult;
+                if (!m_pWriter->Append(result.width, result.height, result.textureBuffer.GetSpan()))
+                {
+                    m_numMismatched += 1;
+                }
+            }
+            catch (const ayc::GeneralError& e)
+            {
+                m_isFailed = true;
+                WRITE_LOG_GENERAL_ERROR("In Y4MFramePublisher, failed to write a frame.", e);
+            }
+            catch (const std::exception& e)
+            {
+                m_isFailed = true;
+                WRITE_LOG_CPP_EXCEPTION("In Y4MFramePublisher, failed to write a frame.", e);
+            }
+        }
+        m_pSubscriber->MarkDelivered(frame);
+    }
+}
@@ -13,6 +13,26 @@ ext_modules = [
             "core/source/utils.cpp",
             "core/source/wgc_session.cpp",
             "core/source/d3d11_system.cpp",
+            "core/source/frame_subscription.cpp",
+            "core/source/capture_scheduler.cpp",
+            "core/source/memory_arbiter.cpp",
+            "core/source/shared_frame_ring.cpp",
+            "core/source/frame_signature.cpp",
+            "core/source/cold_frame_store.cpp",
+            "core/source/spill_store.cpp",
+            "core/source/lz_codec.cpp",
+            "core/source/frame_archive.cpp",
+            "core/source/replay_source.cpp",
+            "core/source/gif_encoder.cpp",
+            "core/source/y4m_writer.cpp",
+            "core/source/frame_pruner.cpp",
+            "core/source/scene_cut_index.cpp",
+            "core/source/contact_sheet.cpp",
+            "core/source/nv12_texture.cpp",
+            "core/source/memory_tracker.cpp",
+            "core/source/staging_texture_ring.cpp",
+            "core/source/thread_pool.cpp",
+            "core/source/host_arena.cpp",
         ],
         include_dirs=["core/include"],
         libraries=[
@@ -21,6 +41,7 @@ ext_modules = [
             "d3d11",
             "dxgi",
             "d3dcompiler",
+            "advapi32",
         ],
         extra_compile_args=[
             "/EHsc",
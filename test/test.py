@@ -1,4 +1,7 @@
 # std
+import asyncio
+import os
+import tempfile
 import time
 from typing import Optional
 
@@ -84,7 +87,10 @@ if hwnd is None:
 # セッションをスタート
 print(f"hwnd = {hwnd}")
 print(f"title = {title}")
-session = ayc.Session(hwnd, 3.0, 640, 480)
+session = ayc.Session(
+    hwnd, 3.0, 640, 480, deduplicate=True, hot_duration_in_sec=1.0,
+    spill_dir=tempfile.gettempdir(), spill_after_in_sec=2.0, scene_cut_threshold=0.25,
+)
 
 # バッファに溜まるのを待つ
 print("---- バッファが溜まるのを待ちます")
@@ -99,6 +105,37 @@ for _ in range(3):
     print(f'frame_buffer = {id(frame_buffer)}')
     time.sleep(1.0)
 
+# 新着フレーム待機をテスト
+print("---- from WaitForNewFrame")
+seq = None
+for _ in range(3):
+    seq, timestamp, width, height, frame_buffer = session.WaitForNewFrame(1.0, seq)
+    print(f'seq = {seq}')
+    print(f'timestamp = {timestamp}')
+    print(f'width = {width}')
+    print(f'height = {height}')
+    print(f'frame_buffer = {id(frame_buffer)}')
+
+# フレーム購読をテスト
+print("---- from Subscribe")
+def _on_frame(seq, timestamp, width, height, frame_buffer):
+    print(f'seq = {seq}, timestamp = {timestamp}, width = {width}, height = {height}')
+with session.Subscribe(_on_frame, 4, "drop_oldest") as subscription:
+    time.sleep(1.0)
+    print(f'stats = {subscription.stats}')
+
+# 共有メモリへの書き出しをテスト
+print("---- from PublishSharedRing")
+from aynime_capture.shared_ring import SharedFrameRingReader
+with session.PublishSharedRing("aynime_capture_test", 4) as publisher:
+    with SharedFrameRingReader(publisher.name) as reader:
+        latest = reader.wait(0, timeout_in_sec=1.0)
+        frame = reader.read(latest) if latest is not None else None
+        if frame is not None:
+            seq, timestamp, width, height, frame_buffer = frame
+            print(f'seq = {seq}, timestamp = {timestamp}, width = {width}, height = {height}')
+    print(f'stats = {publisher.stats}')
+
 # Snapshot からの画像取得をテスト
 print("---- from Snapshot")
 for _ in range(3):
@@ -111,5 +148,169 @@ for _ in range(3):
             print(f'frame_buffer = {id(frame_buffer)}')
         time.sleep(1.0)
 
+# Snapshot のアーカイブ書き出しと読み出しをテスト
+print("---- from Snapshot.Save / ArchiveSnapshot")
+for compress in (False, True):
+    archive_path = os.path.join(tempfile.gettempdir(), f"aynime_capture_test_{compress}.ayca")
+    with ayc.Snapshot(session, None, 1.0) as snapshot:
+        start = time.perf_counter()
+        snapshot.Save(archive_path, compress=compress)
+        print(f'compress = {compress}, frames = {snapshot.size}, elapsed = {time.perf_counter() - start:.3f}, bytes = {os.path.getsize(archive_path)}')
+        with ayc.ArchiveSnapshot(archive_path) as archive:
+            assert archive.size == snapshot.size
+            for frame_index in range(archive.size):
+                assert archive.GetFrame(frame_index) == snapshot.GetFrame(frame_index)
+                assert archive.GetFrameTime(frame_index) == snapshot.GetFrameTime(frame_index)
+    os.remove(archive_path)
+
+# アニメーション GIF の書き出しをテスト
+print("---- from Snapshot.ExportGif")
+for dither, palette in (("ordered", "global"), ("floyd_steinberg", "local")):
+    gif_path = os.path.join(tempfile.gettempdir(), f"aynime_capture_test_{dither}_{palette}.gif")
+    with ayc.Snapshot(session, 15.0, 1.0) as snapshot:
+        start = time.perf_counter()
+        snapshot.ExportGif(gif_path, dither=dither, palette=palette)
+        print(f'dither = {dither}, palette = {palette}, frames = {snapshot.size}, elapsed = {time.perf_counter() - start:.3f}, bytes = {os.path.getsize(gif_path)}')
+    os.remove(gif_path)
+
+# Y4M の書き出しをテスト
+print("---- from Snapshot.ExportY4M / Session.StreamY4M")
+y4m_path = os.path.join(tempfile.gettempdir(), "aynime_capture_test.y4m")
+with ayc.Snapshot(session, 30.0, 1.0) as snapshot:
+    start = time.perf_counter()
+    snapshot.ExportY4M(y4m_path, matrix="bt709")
+    print(f'frames = {snapshot.size}, elapsed = {time.perf_counter() - start:.3f}, bytes = {os.path.getsize(y4m_path)}')
+    fd = os.open(y4m_path, os.O_WRONLY | os.O_TRUNC | os.O_BINARY)
+    snapshot.ExportY4M(fd, fps=30.0)
+    os.close(fd)
+with open(y4m_path, "rb") as f:
+    print(f'header = {f.readline()}')
+with session.StreamY4M(y4m_path, 60.0) as stream:
+    time.sleep(1.0)
+print(f'stats = {stream.stats}, bytes = {os.path.getsize(y4m_path)}')
+os.remove(y4m_path)
+
+# コンタクトシートをテスト
+print("---- from Snapshot.ContactSheet")
+with ayc.Snapshot(session, None, 2.0) as snapshot:
+    start = time.perf_counter()
+    width, height, frame_buffer = snapshot.ContactSheet(4, 160, count=12)
+    print(f'width = {width}, height = {height}, elapsed = {time.perf_counter() - start:.3f}')
+    assert len(frame_buffer) == width * height * 3
+    width, height, frame_buffer = snapshot.ContactSheet(2, 64, 64, indices=[0, snapshot.size - 1])
+    assert (width, height) == (128, 64)
+
+# ほぼ同一のフレームの統合をテスト
+print("---- from Snapshot.PruneNearDuplicates")
+with ayc.Snapshot(session, 30.0, 1.0) as snapshot:
+    for metric in ("sad", "ssim"):
+        for threshold in (0.0, 0.01, 0.05):
+            pruned = snapshot.PruneNearDuplicates(threshold, metric=metric)
+            total = sum(duration for _, duration in pruned)
+            print(f'metric = {metric}, threshold = {threshold}, frames = {snapshot.size} -> {len(pruned)}, duration = {total:.3f}')
+
+# アーカイブのリプレイをテスト
+print("---- from Session.Replay")
+archive_path = os.path.join(tempfile.gettempdir(), "aynime_capture_test_replay.ayca")
+with ayc.Snapshot(session, None, 1.0) as snapshot:
+    snapshot.Save(archive_path, compress=True)
+with ayc.ArchiveSnapshot(archive_path) as archive:
+    for realtime in (False, True):
+        start = time.perf_counter()
+        replay = ayc.Session.Replay(archive_path, 2.0, realtime=realtime)
+        while not replay.replay_finished:
+            time.sleep(0.01)
+        print(f'realtime = {realtime}, elapsed = {time.perf_counter() - start:.3f}')
+        assert replay.GetFrameByTime(0.0) == archive.GetFrame(archive.size - 1)
+        with ayc.Snapshot(replay, None, 2.0) as snapshot:
+            assert snapshot.size == archive.size
+        replay.Close()
+os.remove(archive_path)
+
+# シーン切り替えの索引をテスト
+print("---- from GetSceneCuts")
+for relative_in_sec, score in session.GetSceneCuts():
+    print(f'relative_in_sec = {relative_in_sec:.3f}, score = {score:.3f}')
+print(f'last 1 sec = {session.GetSceneCuts(1.0)}')
+
+# 重複フレーム排除の統計をテスト
+print("---- from dedup_stats")
+print(f'dedup_stats = {session.dedup_stats}')
+
+# ホット層・コールド層の統計をテスト
+print("---- from tier_stats")
+print(f'tier_stats = {session.tier_stats}')
+
+# メモリ使用量の取得をテスト
+print("---- from memory_usage")
+print(f'memory_usage = {session.memory_usage}')
+ayc.set_memory_budget(64 * 1024 * 1024)
+time.sleep(1.0)
+print(f'get_memory_usage = {ayc.get_memory_usage()}')
+ayc.set_memory_budget(None)
+for name, counters in ayc.get_memory_usage()["categories"].items():
+    print(f'{name} = {counters}')
+
+# スレッドプールの統計をテスト
+print("---- from get_thread_pool_stats")
+print(f'get_thread_pool_stats = {ayc.get_thread_pool_stats()}')
+try:
+    ayc.configure_thread_pool(num_workers=2)
+    print("configure_thread_pool after start: NOT raised")
+except Exception as e:
+    print(f'configure_thread_pool after start: raised {e}')
+
+# スナップショットのアリーナをテスト
+print("---- from Snapshot.GetFrameView / get_host_arena_stats")
+ayc.configure_host_arena(large_pages=False)
+views = []
+for _ in range(3):
+    with ayc.Snapshot(session, None, 1.0) as snapshot:
+        for frame_index in range(snapshot.size):
+            width, height, frame_view = snapshot.GetFrameView(frame_index)
+            assert frame_view.readonly and frame_view.nbytes == width * height * 3
+            assert frame_view == snapshot.GetFrame(frame_index)[2]
+        if snapshot.size > 0:
+            views.append((snapshot.GetFrame(0)[2], snapshot.GetFrameView(0)[2]))
+    print(f'get_host_arena_stats = {ayc.get_host_arena_stats()}')
+# @note: Snapshot を閉じた後も memoryview は読める
+for frame_buffer, frame_view in views:
+    assert frame_view == frame_buffer
+views.clear()
+print(f'get_host_arena_stats (views released) = {ayc.get_host_arena_stats()}')
+
+# asyncio からの画像取得をテスト
+print("---- from GetFrameByTimeAsync / GetFrameAsync")
+async def _test_async():
+    width, height, frame_buffer = await session.GetFrameByTimeAsync(0.1)
+    print(f'width = {width}, height = {height}, frame_buffer = {id(frame_buffer)}')
+    with ayc.Snapshot(session, 23.976, 1.0) as snapshot:
+        frames = await asyncio.gather(
+            *[snapshot.GetFrameAsync(i) for i in range(snapshot.size)]
+        )
+        for frame_index, (width, height, frame_buffer) in enumerate(frames):
+            print(f'frame_index = {frame_index}, width = {width}, height = {height}')
+    # 待ち手を１つキャンセルしても、同じフレームは他の経路で取得できること
+    with ayc.Snapshot(session, None, 1.0) as snapshot:
+        frame_index = snapshot.size - 1
+        cancelled = snapshot.GetFrameAsync(frame_index)
+        kept = snapshot.GetFrameAsync(frame_index)
+        cancelled.cancel()
+        await asyncio.sleep(0)
+        width, height, frame_buffer = snapshot.GetFrame(frame_index)
+        assert frame_buffer is not None
+        width, height, frame_buffer = await kept
+        print(f'cancelled one waiter: frame_index = {frame_index}, width = {width}, height = {height}')
+asyncio.run(_test_async())
+
+# NV12 での保持をテスト
+print("---- from frame_format='nv12'")
+nv12_session = ayc.Session(hwnd, 1.0, 640, 480, frame_format="nv12")
+time.sleep(1.0)
+width, height, frame_buffer = nv12_session.GetFrameByTime(0.1)
+print(f'width = {width}, height = {height}, frame_buffer = {len(frame_buffer)}')
+print(f'tier_stats = {nv12_session.tier_stats}')
+nv12_session.Close()
+
 # セッションを明示的に終了
 session.Close()
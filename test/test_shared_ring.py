@@ -0,0 +1,66 @@
+# std
+import importlib.util
+import multiprocessing
+import os
+import time
+
+# local
+# @note: ネイティブモジュール無し（Linux 等）でも動かせるように、パッケージを経由せず直接読み込む
+_spec = importlib.util.spec_from_file_location(
+    "shared_ring",
+    os.path.join(os.path.dirname(__file__), "..", "aynime_capture", "shared_ring.py"),
+)
+shared_ring = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(shared_ring)
+SharedFrameRingReader = shared_ring.SharedFrameRingReader
+SharedFrameRingWriter = shared_ring.SharedFrameRingWriter
+
+# 合成フレームの設定
+RING_NAME = f"aynime_capture_test_{os.getpid()}"
+WIDTH = 64
+HEIGHT = 32
+NUM_FRAMES = 100
+
+
+def _make_frame(seq: int) -> bytes:
+    """seq で塗りつぶした合成フレームを作る"""
+    return bytes([seq % 256]) * (WIDTH * HEIGHT * 3)
+
+
+def _reader_main(name: str, result_queue) -> None:
+    """別プロセスからフレームを読み出して検証する"""
+    num_checked = 0
+    with SharedFrameRingReader(name) as reader:
+        seq = 0
+        while seq < NUM_FRAMES:
+            latest = reader.wait(seq, timeout_in_sec=5.0)
+            if latest is None:
+                break
+            frame = reader.read()
+            if frame is None:
+                continue
+            seq, _, width, height, frame_buffer = frame
+            assert (width, height) == (WIDTH, HEIGHT)
+            assert frame_buffer == _make_frame(seq), f"torn frame at seq {seq}"
+            num_checked += 1
+    result_queue.put(num_checked)
+
+
+# WGC の代わりに合成フレームを書き込み、複数の読み手プロセスで検証する
+if __name__ == "__main__":
+    print("---- from SharedFrameRingWriter / SharedFrameRingReader")
+    with SharedFrameRingWriter(RING_NAME, 4, WIDTH * HEIGHT * 3) as writer:
+        result_queue = multiprocessing.Queue()
+        readers = [
+            multiprocessing.Process(target=_reader_main, args=(RING_NAME, result_queue))
+            for _ in range(3)
+        ]
+        for reader in readers:
+            reader.start()
+        time.sleep(0.5)
+        for seq in range(1, NUM_FRAMES + 1):
+            writer.publish(seq, seq / 60.0, WIDTH, HEIGHT, _make_frame(seq))
+            time.sleep(0.005)
+        for reader in readers:
+            reader.join()
+            print(f'exitcode = {reader.exitcode}, checked = {result_queue.get()}')